@@ -0,0 +1,170 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "undistort_map.h"
+#include "bird_eye_view.h"
+
+/*** Macro ***/
+/* the number of pixels to use multi threads */
+#define PARALLEL_THRESHOLD 16384
+/* the number of points processed at once in the point path */
+#define BLOCK_SIZE 64
+
+/* [ratio of the image size]. cells projected (without distortion) farther than this out of the image are not mapped */
+static constexpr float kValidMargin = 0.5F;
+
+
+constexpr float BirdEyeView::kInvalidView;  // for link error in Android Studio (clang)
+
+BirdEyeView::BirdEyeView()
+    : image_width_(0), image_height_(0), width_(0), height_(0), image_row_start_(0)
+{
+    /* never matches, so the map is created at the first Update */
+    std::fill(intrinsic_key_, intrinsic_key_ + 9, std::nanf(""));
+    std::fill(H_key_, H_key_ + 9, std::nanf(""));
+}
+
+BirdEyeView::~BirdEyeView()
+{
+}
+
+void BirdEyeView::SetParam(const Param& param)
+{
+    param_ = param;
+    std::fill(H_key_, H_key_ + 9, std::nanf(""));
+}
+
+bool BirdEyeView::Update(const CameraProjection& projection, int32_t image_width, int32_t image_height)
+{
+    if (image_width <= 0 || image_height <= 0 || param_.resolution <= 0) return false;
+    ground_lut_.Update(projection, image_width, image_height, param_.lut_grid_step);
+
+    float intrinsic_key[9];
+    projection.GetIntrinsic(intrinsic_key[0], intrinsic_key[1], intrinsic_key[2], intrinsic_key[3]);
+    std::copy(projection.GetDistortion(), projection.GetDistortion() + 5, intrinsic_key + 4);
+    const float* H = projection.GetGroundHomographyInv();
+    if (image_width == image_width_ && image_height == image_height_
+        && std::memcmp(intrinsic_key, intrinsic_key_, sizeof(intrinsic_key)) == 0
+        && std::memcmp(H, H_key_, sizeof(H_key_)) == 0) {
+        return false;
+    }
+    image_width_ = image_width;
+    image_height_ = image_height;
+    std::copy(intrinsic_key, intrinsic_key + 9, intrinsic_key_);
+    std::copy(H, H + 9, H_key_);
+    CreateMap(projection);
+    return true;
+}
+
+void BirdEyeView::CreateMap(const CameraProjection& projection)
+{
+    width_ = (std::max)(static_cast<int32_t>(std::round((param_.x_max - param_.x_min) / param_.resolution)), 1);
+    height_ = (std::max)(static_cast<int32_t>(std::round((param_.z_max - param_.z_min) / param_.resolution)), 1);
+    map_xy_.resize(static_cast<size_t>(width_) * height_ * 2);
+    map_frac_.resize(static_cast<size_t>(width_) * height_);
+
+    /* each row of the view is a line of the ground at the same depth. it's projected to the image, and converted to fixed-point */
+    /* a point behind the camera or far from the image is (-1, -1), and a point out of the image is out of the image in the map, so they are border */
+    const float x_valid_min = -kValidMargin * image_width_;
+    const float x_valid_max = (1 + kValidMargin) * image_width_;
+    const float y_valid_min = -kValidMargin * image_height_;
+    const float y_valid_max = (1 + kValidMargin) * image_height_;
+    std::vector<int32_t> row_start_list(height_, image_height_);
+#pragma omp parallel if (width_ * height_ > PARALLEL_THRESHOLD)
+    {
+        std::vector<float> object_point(width_ * 3);
+        std::vector<float> image_point(width_ * 2);
+        std::vector<float> map_x(width_), map_y(width_);
+        std::vector<uint8_t> is_valid(width_);
+#pragma omp for
+        for (int32_t v = 0; v < height_; v++) {
+            float x, z;
+            View2Ground(0, static_cast<float>(v), x, z);
+            for (int32_t u = 0; u < width_; u++) {
+                object_point[u * 3 + 0] = x + u * param_.resolution;
+                object_point[u * 3 + 1] = 0.0F;
+                object_point[u * 3 + 2] = z;
+            }
+            /* the distortion model is valid only around the image, so the distortion is applied to points around the image only */
+            projection.World2Image(object_point.data(), width_, image_point.data(), false);
+            for (int32_t u = 0; u < width_; u++) {
+                const float x_undistorted = image_point[u * 2 + 0];
+                const float y_undistorted = image_point[u * 2 + 1];
+                const bool is_behind = x_undistorted == CameraProjection::kInvalidImage && y_undistorted == CameraProjection::kInvalidImage;
+                is_valid[u] = !is_behind && x_undistorted >= x_valid_min && x_undistorted <= x_valid_max && y_undistorted >= y_valid_min && y_undistorted <= y_valid_max;
+            }
+            projection.Distort(image_point.data(), width_, image_point.data());
+            int32_t row_start = image_height_;
+            for (int32_t u = 0; u < width_; u++) {
+                map_x[u] = is_valid[u] ? image_point[u * 2 + 0] : -1.0F;
+                map_y[u] = is_valid[u] ? image_point[u * 2 + 1] : -1.0F;
+                if (map_x[u] >= 0 && map_x[u] < image_width_ && map_y[u] >= 0 && map_y[u] < image_height_) {
+                    row_start = (std::min)(row_start, static_cast<int32_t>(map_y[u]));
+                }
+            }
+            row_start_list[v] = row_start;
+            const size_t offset = static_cast<size_t>(v) * width_;
+            UndistortMap::ConvertToFixed(map_x.data(), map_y.data(), width_, map_xy_.data() + offset * 2, map_frac_.data() + offset);
+        }
+    }
+    image_row_start_ = *std::min_element(row_start_list.begin(), row_start_list.end());
+}
+
+void BirdEyeView::Image2View(const float* image_point, int32_t num, float* view_point) const
+{
+    const float resolution_inv = 1.0F / param_.resolution;
+    const float x_min = param_.x_min;
+    const float z_max = param_.z_max;
+    for (int32_t i0 = 0; i0 < num; i0 += BLOCK_SIZE) {
+        const int32_t n = (std::min)(BLOCK_SIZE, num - i0);
+        float object_point[BLOCK_SIZE * 3];
+        ground_lut_.Image2GroundPlane(image_point + static_cast<size_t>(i0) * 2, n, object_point);
+        float* dst = view_point + static_cast<size_t>(i0) * 2;
+        for (int32_t i = 0; i < n; i++) {
+            if (object_point[i * 3 + 1] == 0.0F) {
+                dst[i * 2 + 0] = (object_point[i * 3 + 0] - x_min) * resolution_inv - 0.5F;
+                dst[i * 2 + 1] = (z_max - object_point[i * 3 + 2]) * resolution_inv - 0.5F;
+            } else {
+                dst[i * 2 + 0] = dst[i * 2 + 1] = kInvalidView;
+            }
+        }
+    }
+}
+
+void BirdEyeView::Image2Ground(const float* image_point, int32_t num, float* object_point) const
+{
+    ground_lut_.Image2GroundPlane(image_point, num, object_point);
+}
+
+void BirdEyeView::Ground2View(float x, float z, float& u, float& v) const
+{
+    /* the inverse of View2Ground (the center of a pixel is at integer coordinates) */
+    u = (x - param_.x_min) / param_.resolution - 0.5F;
+    v = (param_.z_max - z) / param_.resolution - 0.5F;
+}
+
+void BirdEyeView::View2Ground(float u, float v, float& x, float& z) const
+{
+    x = param_.x_min + (u + 0.5F) * param_.resolution;
+    z = param_.z_max - (v + 0.5F) * param_.resolution;
+}
@@ -0,0 +1,89 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef BIRD_EYE_VIEW_
+#define BIRD_EYE_VIEW_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "camera_projection.h"
+#include "ground_lut.h"
+
+/* Bird's eye view (inverse perspective mapping) on a metric grid of the ground plane */
+/*   the center of view pixel (u, v) is (Xw, Zw) = (x_min + (u + 0.5) * resolution, z_max - (v + 0.5) * resolution). top = far */
+/*   image path: a fixed-point remap table (the same format as UndistortMap, for cv::remap(CV_16SC2 + CV_16UC1)) */
+/*   point path: image points -> ground (GroundLut) -> view, for lane points etc. */
+/*   both are created only when the camera parameters (or the view parameters) are changed */
+/*   only the ground is mapped, so the image above the horizon is never read. GetImageRowStart() tells the first image row used */
+class BirdEyeView {
+public:
+    static constexpr float kInvalidView = -1.0F;    /* view point of an image point above the horizon */
+
+    typedef struct Param_ {
+        float   x_min;          /* [m] X+ = right */
+        float   x_max;
+        float   z_min;          /* [m] Z+ = far */
+        float   z_max;
+        float   resolution;     /* [m / px] */
+        int32_t lut_grid_step;  /* [px] grid of GroundLut for the point path */
+        Param_() : x_min(-10.0F), x_max(10.0F), z_min(0.0F), z_max(40.0F), resolution(0.1F), lut_grid_step(8)
+        {}
+    } Param;
+
+public:
+    BirdEyeView();
+    ~BirdEyeView();
+
+    void SetParam(const Param& param);      /* the map is recreated at the next Update */
+    const Param& GetParam() const { return param_; }
+
+    /* recreate the map if the parameters are changed. return true if recreated */
+    bool Update(const CameraProjection& projection, int32_t image_width, int32_t image_height);
+
+    int32_t GetWidth() const { return width_; }
+    int32_t GetHeight() const { return height_; }
+    const int16_t* GetMapXY() const { return map_xy_.data(); }      /* [height][width][2] */
+    const uint16_t* GetMapFrac() const { return map_frac_.data(); } /* [height][width] */
+    int32_t GetImageRowStart() const { return image_row_start_; }   /* [px]. rows above it are not used (e.g. sky) */
+
+    /* image -> view. points which don't hit the ground are kInvalidView. points out of the view are not clipped */
+    void Image2View(const float* image_point, int32_t num, float* view_point) const;
+    /* image -> Mw on the ground plane. the same as GroundLut::Image2GroundPlane */
+    void Image2Ground(const float* image_point, int32_t num, float* object_point) const;
+
+    void Ground2View(float x, float z, float& u, float& v) const;
+    void View2Ground(float u, float v, float& x, float& z) const;
+
+private:
+    void CreateMap(const CameraProjection& projection);
+
+private:
+    Param param_;
+    int32_t image_width_;
+    int32_t image_height_;
+    float intrinsic_key_[9];    /* fx, fy, cx, cy, dist[5] used to create the map */
+    float H_key_[9];            /* the ground plane homography used to create the map */
+
+    int32_t width_;
+    int32_t height_;
+    int32_t image_row_start_;
+    std::vector<int16_t>  map_xy_;
+    std::vector<uint16_t> map_frac_;
+    GroundLut ground_lut_;
+};
+
+#endif
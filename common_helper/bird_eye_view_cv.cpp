@@ -0,0 +1,76 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <string>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper_cv.h"
+#include "bird_eye_view_cv.h"
+
+/*** Macro ***/
+/* [m] interval of the grid lines */
+#define GRID_INTERVAL 5
+
+
+BirdEyeViewCv::BirdEyeViewCv()
+{
+    camera_.width = 0;
+    camera_.height = 0;
+}
+
+BirdEyeViewCv::~BirdEyeViewCv()
+{
+}
+
+void BirdEyeViewCv::SetCameraParam(const CameraParam& camera_param)
+{
+    camera_param_ = camera_param;
+    camera_.width = 0;      /* the intrinsic parameters are set again at the next Update */
+}
+
+bool BirdEyeViewCv::Update(int32_t image_width, int32_t image_height)
+{
+    /* BirdEyeView recreates the map only when the image size or the camera parameters are changed */
+    if (camera_.width != image_width || camera_.height != image_height) {
+        camera_.SetIntrinsic(image_width, image_height, FocalLength(image_width, camera_param_.fov_deg));
+    }
+    camera_.SetExtrinsic(
+        { camera_param_.pitch_deg, 0.0f, 0.0f },    /* rvec [deg] */
+        { 0.0f, -camera_param_.height, 0.0f }, true);   /* tvec (Oc - Ow in world coordinate. X+= Right, Y+ = down, Z+ = far) */
+    return bird_eye_view_.Update(camera_.GetProjection(), image_width, image_height);
+}
+
+void BirdEyeViewCv::CreateImage(const cv::Mat& image, cv::Mat& image_bird_eye_view, const cv::Scalar& color_bg) const
+{
+    /* fixed-point remap (no coordinate calculation for each frame) */
+    const cv::Mat map_xy(bird_eye_view_.GetHeight(), bird_eye_view_.GetWidth(), CV_16SC2, const_cast<int16_t*>(bird_eye_view_.GetMapXY()));
+    const cv::Mat map_frac(bird_eye_view_.GetHeight(), bird_eye_view_.GetWidth(), CV_16UC1, const_cast<uint16_t*>(bird_eye_view_.GetMapFrac()));
+    cv::remap(image, image_bird_eye_view, map_xy, map_frac, cv::INTER_LINEAR, cv::BORDER_CONSTANT, color_bg);
+
+    /* Display Grid lines */
+    const auto& param = bird_eye_view_.GetParam();
+    for (int32_t z = GRID_INTERVAL; z < static_cast<int32_t>(param.z_max); z += GRID_INTERVAL) {
+        float u0, u1, v;
+        bird_eye_view_.Ground2View(param.x_min, static_cast<float>(z), u0, v);
+        bird_eye_view_.Ground2View(param.x_max, static_cast<float>(z), u1, v);
+        cv::line(image_bird_eye_view, cv::Point2f(u0, v), cv::Point2f(u1, v), cv::Scalar(255, 255, 255));
+        CommonHelper::DrawText(image_bird_eye_view, std::to_string(z) + "[m]", cv::Point(0, static_cast<int32_t>(v)), 0.4, 1, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(255, 255, 255), false);
+    }
+}
@@ -0,0 +1,61 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef BIRD_EYE_VIEW_CV_
+#define BIRD_EYE_VIEW_CV_
+
+/* for general */
+#include <cstdint>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "camera_model.h"
+#include "bird_eye_view.h"
+
+/* Bird's eye view of a camera image for display (OpenCV) */
+/*   the camera is a pinhole camera at a height above the ground (e.g. dashcam). BirdEyeView does the mapping */
+class BirdEyeViewCv {
+public:
+    typedef struct CameraParam_ {
+        float fov_deg;          /* horizontal field of view */
+        float height;           /* [m] */
+        float pitch_deg;        /* looking down = positive */
+        CameraParam_() : fov_deg(80.0F), height(1.5F), pitch_deg(0.0F)
+        {}
+    } CameraParam;
+
+public:
+    BirdEyeViewCv();
+    ~BirdEyeViewCv();
+
+    void SetCameraParam(const CameraParam& camera_param);
+    const CameraParam& GetCameraParam() const { return camera_param_; }
+
+    /* recreate the map if the image size or the camera parameters are changed. return true if recreated */
+    bool Update(int32_t image_width, int32_t image_height);
+
+    /* remap the image with the fixed-point map and draw grid lines at every 5 m */
+    void CreateImage(const cv::Mat& image, cv::Mat& image_bird_eye_view, const cv::Scalar& color_bg) const;
+
+    const BirdEyeView& GetBirdEyeView() const { return bird_eye_view_; }
+
+private:
+    CameraParam camera_param_;
+    CameraModel camera_;
+    BirdEyeView bird_eye_view_;
+};
+
+#endif
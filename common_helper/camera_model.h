@@ -24,12 +24,17 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>
 
 #include <opencv2/opencv.hpp>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+#include "camera_projection.h"
+#include "ground_lut.h"
+#include "undistort_point.h"
+
 #ifndef M_PI
 #define M_PI 3.141592653f
 #endif
@@ -83,6 +88,7 @@ public:
 
 public:
     CameraModel() {
+        projection_key_.fill(std::nanf(""));    /* never matches, so the projection is composed at the first use */
         /* Default Parameters */
         SetIntrinsic(1280, 720, 500.0f);
         SetDist({ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f });
@@ -208,102 +214,102 @@ public:
         cv::Rodrigues(R_new, this->rvec); /* Rotation matrix -> rvec */
     }
 
+    /*** Methods for projection ***/
+    /* K * [R t] and the inverse of the ground plane homography are composed only when the parameters are changed */
+    /* public members (K, rvec, tvec, dist_coeff) may be modified directly, so the parameters are compared with the last ones */
+    /* note: the conversions update this cache, so an instance must not be used from multiple threads at the same time */
+    const CameraProjection& GetProjection()
+    {
+        UpdateProjection();
+        return projection_;
+    }
+
+    /*** Batched methods for projection (contiguous points, no memory allocation) ***/
+    void ConvertWorld2Image(const cv::Point3f* object_point, int32_t num, cv::Point2f* image_point)
+    {
+        /* points behind the camera are (-1, -1) */
+        GetProjection().World2Image(reinterpret_cast<const float*>(object_point), num, reinterpret_cast<float*>(image_point));
+    }
+
+    void ConvertWorld2Camera(const cv::Point3f* object_point_in_world, int32_t num, cv::Point3f* object_point_in_camera)
+    {
+        GetProjection().World2Camera(reinterpret_cast<const float*>(object_point_in_world), num, reinterpret_cast<float*>(object_point_in_camera));
+    }
+
+    void ConvertCamera2World(const cv::Point3f* object_point_in_camera, int32_t num, cv::Point3f* object_point_in_world)
+    {
+        GetProjection().Camera2World(reinterpret_cast<const float*>(object_point_in_camera), num, reinterpret_cast<float*>(object_point_in_world));
+    }
+
+    void ConvertImage2GroundPlane(const cv::Point2f* image_point, int32_t num, cv::Point3f* object_point)
+    {
+        /* points which don't hit the ground in front of the camera (above the horizon) are (999, 999, 999) */
+        GetProjection().Image2GroundPlane(reinterpret_cast<const float*>(image_point), num, reinterpret_cast<float*>(object_point));
+    }
+
+    void ConvertImage2Camera(const cv::Point2f* image_point, const float* z, int32_t num, cv::Point3f* object_point)
+    {
+        GetProjection().Image2Camera(reinterpret_cast<const float*>(image_point), z, num, reinterpret_cast<float*>(object_point));
+    }
+
+    void ConvertImage2World(const cv::Point2f* image_point, const float* z, int32_t num, cv::Point3f* object_point)
+    {
+        const CameraProjection& projection = GetProjection();
+        projection.Image2Camera(reinterpret_cast<const float*>(image_point), z, num, reinterpret_cast<float*>(object_point));
+        projection.Camera2World(reinterpret_cast<const float*>(object_point), num, reinterpret_cast<float*>(object_point));
+    }
+
+    /*** Lookup table for image -> ground plane ***/
+    /* the table is rebuilt only when the parameters are changed (only the cheap part when the camera pose is changed) */
+    /* grid_step [px]: interval of the nodes. the error is caused only by the distortion between the nodes */
+    const GroundLut& GetGroundLut(int32_t grid_step = 8)
+    {
+        ground_lut_.Update(GetProjection(), width, height, grid_step);
+        return ground_lut_;
+    }
+
+    void ConvertImage2GroundPlaneLut(const cv::Point2f* image_point, int32_t num, cv::Point3f* object_point, int32_t grid_step = 8)
+    {
+        /* points which don't hit the ground in front of the camera (above the horizon) are (999, 999, 999) */
+        GetGroundLut(grid_step).Image2GroundPlane(reinterpret_cast<const float*>(image_point), num, reinterpret_cast<float*>(object_point));
+    }
+
+    /*** Lookup table for distorted image -> undistorted image ***/
+    /* for results of inference on the raw frame (box corners, keypoints, lane points), instead of undistorting the whole frame */
+    /* the table is rebuilt only when the intrinsic parameters are changed */
+    const UndistortPointLut& GetUndistortLut(int32_t grid_step = 8)
+    {
+        undistort_lut_.Update(GetProjection(), width, height, grid_step);
+        return undistort_lut_;
+    }
+
+    void UndistortPoints(const cv::Point2f* image_point, int32_t num, cv::Point2f* image_point_undistorted, int32_t grid_step = 8)
+    {
+        /* a box is undistorted as its corners (the undistorted box is not a rectangle) */
+        GetUndistortLut(grid_step).Undistort(reinterpret_cast<const float*>(image_point), num, reinterpret_cast<float*>(image_point_undistorted));
+    }
+
     /*** Methods for projection ***/
     void ConvertWorld2Image(const cv::Point3f& object_point, cv::Point2f& image_point)
     {
-        std::vector<cv::Point3f> object_point_list = { object_point };
-        std::vector<cv::Point2f> image_point_list;
-        ConvertWorld2Image(object_point_list, image_point_list);
-        image_point = image_point_list[0];
+        ConvertWorld2Image(&object_point, 1, &image_point);
     }
 
     void ConvertWorld2Image(const std::vector<cv::Point3f>& object_point_list, std::vector<cv::Point2f>& image_point_list)
     {
         /*** Mw -> Image ***/
-        /* the followings get exactly the same result */
-#if 1
-        /*** Projection ***/
         /* s[x, y, 1] = K * [R t] * [M, 1] = K * M_from_cam */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
+        /* the same result as cv::projectPoints except for points behind the camera */
         image_point_list.resize(object_point_list.size());
-
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& object_point = object_point_list[i];
-            auto& image_point = image_point_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point.x, object_point.y, object_point.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            float Zc = Mc.at<float>(2);
-            if (Zc <= 0) {
-                /* Do not project points behind the camera */
-                image_point = cv::Point2f(-1, -1);
-                continue;
-            }
-
-            cv::Mat XY = K * Mc;
-            float x = XY.at<float>(0);
-            float y = XY.at<float>(1);
-            float s = XY.at<float>(2);
-            x /= s;
-            y /= s;
-
-            if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-                image_point.x = x;
-                image_point.y = y;
-            } else {
-                /*** Distort ***/
-                float u = (x - this->cx()) / this->fx();  /* from optical center*/
-                float v = (y - this->cy()) / this->fy();  /* from optical center*/
-                float r2 = u * u + v * v;
-                float r4 = r2 * r2;
-                float k1 = this->dist_coeff.at<float>(0);
-                float k2 = this->dist_coeff.at<float>(1);
-                float p1 = this->dist_coeff.at<float>(3);
-                float p2 = this->dist_coeff.at<float>(4);
-                u = u + u * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p1 * u * v) + p2 * (r2 + 2 * u * u);
-                v = v + v * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p2 * u * v) + p1 * (r2 + 2 * v * v);
-                image_point.x = u * this->fx() + this->cx();
-                image_point.y = v * this->fy() + this->cy();
-            }
-        }
-#else
-        cv::projectPoints(object_point_list, this->rvec, this->tvec, this->K, this->dist_coeff, image_point_list);
-#endif
+        ConvertWorld2Image(object_point_list.data(), static_cast<int32_t>(object_point_list.size()), image_point_list.data());
     }
 
     void ConvertWorld2Camera(const std::vector<cv::Point3f>& object_point_in_world_list, std::vector<cv::Point3f>& object_point_in_camera_list)
     {
         /*** Mw -> Mc ***/
         /* Mc = [R t] * [M, 1] */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
         object_point_in_camera_list.resize(object_point_in_world_list.size());
-
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-        for (int32_t i = 0; i < object_point_in_world_list.size(); i++) {
-            const auto& object_point_in_world = object_point_in_world_list[i];
-            auto& object_point_in_camera = object_point_in_camera_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point_in_world.x, object_point_in_world.y, object_point_in_world.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            object_point_in_camera.x = Mc.at<float>(0);
-            object_point_in_camera.y = Mc.at<float>(1);
-            object_point_in_camera.z = Mc.at<float>(2);
-        }
+        ConvertWorld2Camera(object_point_in_world_list.data(), static_cast<int32_t>(object_point_in_world_list.size()), object_point_in_camera_list.data());
     }
 
     void ConvertCamera2World(const std::vector<cv::Point3f>& object_point_in_camera_list, std::vector<cv::Point3f>& object_point_in_world_list)
@@ -313,26 +319,8 @@ public:
         /* -> [M, 1] = [R t]^1 * Mc <- Unable to get the inverse of [R t] because it's 4x3 */
         /* So, Mc = R * Mw + t */
         /* -> Mw = R^1 * (Mc - t) */
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
-
-
         object_point_in_world_list.resize(object_point_in_camera_list.size());
-
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-        for (int32_t i = 0; i < object_point_in_camera_list.size(); i++) {
-            const auto& object_point_in_camera = object_point_in_camera_list[i];
-            auto& object_point_in_world = object_point_in_world_list[i];
-            cv::Mat Mc = (cv::Mat_<float>(3, 1) << object_point_in_camera.x, object_point_in_camera.y, object_point_in_camera.z);
-            cv::Mat Mw = R_inv * (Mc - t);
-            object_point_in_world.x = Mw.at<float>(0);
-            object_point_in_world.y = Mw.at<float>(1);
-            object_point_in_world.z = Mw.at<float>(2);
-        }
+        ConvertCamera2World(object_point_in_camera_list.data(), static_cast<int32_t>(object_point_in_camera_list.size()), object_point_in_world_list.data());
     }
 
     void ConvertImage2GroundPlane(const std::vector<cv::Point2f>& image_point_list, std::vector<cv::Point3f>& object_point_list)
@@ -341,60 +329,12 @@ public:
         /*** Calculate point in ground plane (in world coordinate) ***/
         /* Main idea:*/
         /*   s * [x, y, 1] = K * [R t] * [M, 1]  */
-        /*   s * [x, y, 1] = K * R * M + K * t */
-        /*   s * Kinv * [x, y, 1] = R * M + t */
-        /*   s * Kinv * [x, y, 1] - t = R * M */
-        /*   Rinv * (s * Kinv * [x, y, 1] - t) = M */
-        /* calculate s */
-        /*   s * Rinv * Kinv * [x, y, 1] = M + R_inv * t */
-        /*      where, M = (X, Y, Z), and we assume Y = 0(ground_plane) */
-        /*      so , we can solve left[1] = R_inv * t[1](camera_height) */
-
-        if (image_point_list.size() == 0) return;
-
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat K_inv;
-        cv::invert(K, K_inv);
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
-
-        /*** Undistort image point ***/
-        std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;
-        } else {
-            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
-        }
-
+        /*   M = (X, 0, Z) on the ground plane, so */
+        /*   s * [x, y, 1] = K * [r1 r3 t] * [X, Z, 1]  (r = column of R) */
+        /*   [X, Z, 1] = s * ([r1 r3 t]^-1 * Kinv) * [x, y, 1]  <- composed once (see CameraProjection) */
         object_point_list.resize(image_point_list.size());
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& image_point = image_point_list[i];
-            auto& object_point = object_point_list[i];
-
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
-            if (y < EstimateVanishmentY()) {
-                object_point.x = 999;
-                object_point.y = 999;
-                object_point.z = 999;
-                continue;
-            }
-
-            cv::Mat XY = (cv::Mat_<float>(3, 1) << x, y, 1);
-
-            /* calculate s */
-            cv::Mat LEFT_WO_S = R_inv * K_inv * XY;
-            cv::Mat RIGHT_WO_M = R_inv * t;         /* no need to add M because M[1] = 0 (ground plane)*/
-            float s = RIGHT_WO_M.at<float>(1) / LEFT_WO_S.at<float>(1);
-
-            /* calculate M */
-            cv::Mat TEMP = R_inv * (s * K_inv * XY - t);
-
-            object_point.x = TEMP.at<float>(0);
-            object_point.y = TEMP.at<float>(1);
-            object_point.z = TEMP.at<float>(2);
+        ConvertImage2GroundPlane(image_point_list.data(), static_cast<int32_t>(image_point_list.size()), object_point_list.data());
+        for (auto& object_point : object_point_list) {
             if (object_point.z < 0) object_point.z = 999;
         }
     }
@@ -410,6 +350,7 @@ public:
             }
             /* Generate the original image point mat */
             /* todo: no need to generate every time */
+            image_point_list.reserve(z_list.size());
             for (int32_t y = 0; y < this->height; y++) {
                 for (int32_t x = 0; x < this->width; x++) {
                     image_point_list.push_back(cv::Point2f(float(x), float(y)));
@@ -423,41 +364,16 @@ public:
             }
         }
 
-        /*** Undistort image point ***/
-        std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;   /* todo: redundant copy. I do this just because to make code simple */
-        } else {
-            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
-        }
-
         object_point_list.resize(image_point_list.size());
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& Zc = z_list[i];
-            auto& object_point = object_point_list[i];
-
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
-
-            float u = x - this->cx();
-            float v = y - this->cy();
-            float Xc = Zc * u / this->fx();
-            float Yc = Zc * v / this->fy();
-            object_point.x = Xc;
-            object_point.y = Yc;
-            object_point.z = Zc;
-        }
+        ConvertImage2Camera(image_point_list.data(), z_list.data(), static_cast<int32_t>(image_point_list.size()), object_point_list.data());
     }
 
     void ConvertImage2World(std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
     {
         /*** Image -> Mw ***/
-        std::vector<cv::Point3f> object_point_in_camera_list;
-        ConvertImage2Camera(image_point_list, z_list, object_point_in_camera_list);
-        ConvertCamera2World(object_point_in_camera_list, object_point_list);
+        object_point_list.clear();
+        ConvertImage2Camera(image_point_list, z_list, object_point_list);
+        ConvertCamera2World(object_point_list.data(), static_cast<int32_t>(object_point_list.size()), object_point_list.data());
     }
 
 
@@ -555,6 +471,36 @@ public:
             object_point.z += z;
         }
     }
+
+private:
+    void UpdateProjection()
+    {
+        /* K (9), rvec (3), tvec (3), dist_coeff (5) */
+        std::array<float, 20> key;
+        key.fill(0);
+        for (int32_t i = 0; i < 9; i++) key[i] = K.at<float>(i);
+        for (int32_t i = 0; i < 3; i++) key[9 + i] = rvec.at<float>(i);
+        for (int32_t i = 0; i < 3; i++) key[12 + i] = tvec.at<float>(i);
+        /* dist_coeff may have less than 5 coefficients (e.g. k1, k2, p1, p2). the rest are 0 */
+        const int32_t dist_num = static_cast<int32_t>(dist_coeff.total());
+        for (int32_t i = 0; i < (std::min)(dist_num, 5); i++) key[15 + i] = dist_coeff.at<float>(i);
+        if (std::memcmp(key.data(), projection_key_.data(), sizeof(key)) == 0) return;
+        projection_key_ = key;
+        if (dist_num > 5) {
+            printf("[UpdateProjection] Only k1, k2, p1, p2, k3 are supported. %d distortion coefficients are ignored\n", dist_num - 5);
+        }
+
+        cv::Mat R = MakeRotationMat(Rad2Deg(rx()), Rad2Deg(ry()), Rad2Deg(rz()));
+        projection_.SetIntrinsic(key[0], key[4], key[2], key[5]);
+        projection_.SetDistortion(&key[15]);    /* k1, k2, p1, p2, k3 */
+        projection_.SetExtrinsic(R.ptr<float>(), &key[12]);
+    }
+
+private:
+    CameraProjection projection_;
+    std::array<float, 20> projection_key_;  /* parameters used to compose projection_ */
+    GroundLut ground_lut_;
+    UndistortPointLut undistort_lut_;
 };
 
 #endif
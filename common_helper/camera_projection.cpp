@@ -0,0 +1,348 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/* for My modules */
+#include "camera_projection.h"
+#include "simd_helper.h"
+
+/*** Macro ***/
+/* the number of points to use multi threads */
+#define PARALLEL_THRESHOLD 4096
+/* the number of points processed at once in planar arrays */
+#define BLOCK_SIZE 64
+
+
+constexpr float CameraProjection::kInvalidImage;  // for link error in Android Studio (clang)
+constexpr float CameraProjection::kInvalidGround;  // for link error in Android Studio (clang)
+constexpr int32_t CameraProjection::kUndistortIterationNum;  // for link error in Android Studio (clang)
+
+/* normalized coordinate (from the optical center, divided by focal length) */
+static inline void DistortNormalized(const float* dist, float x, float y, float& x_distorted, float& y_distorted)
+{
+    const float r2 = x * x + y * y;
+    const float radial = 1 + ((dist[4] * r2 + dist[1]) * r2 + dist[0]) * r2;
+    x_distorted = x * radial + 2 * dist[2] * x * y + dist[3] * (r2 + 2 * x * x);
+    y_distorted = y * radial + dist[2] * (r2 + 2 * y * y) + 2 * dist[3] * x * y;
+}
+
+static inline void UndistortNormalized(const float* dist, float x_distorted, float y_distorted, float& x, float& y)
+{
+    x = x_distorted;
+    y = y_distorted;
+    for (int32_t i = 0; i < CameraProjection::kUndistortIterationNum; i++) {
+        const float r2 = x * x + y * y;
+        const float radial_inv = 1 / (1 + ((dist[4] * r2 + dist[1]) * r2 + dist[0]) * r2);
+        const float delta_x = 2 * dist[2] * x * y + dist[3] * (r2 + 2 * x * x);
+        const float delta_y = dist[2] * (r2 + 2 * y * y) + 2 * dist[3] * x * y;
+        x = (x_distorted - delta_x) * radial_inv;
+        y = (y_distorted - delta_y) * radial_inv;
+    }
+}
+
+/* interleaved points are split into planar arrays block by block so that the kernel is vectorized */
+/* kernel(src_planar, dst_planar, index of the first point, the number of points) */
+template<int32_t SRC_DIM, int32_t DST_DIM, typename KERNEL>
+static void ProcessPointBlock(const float* src, int32_t num, float* dst, const KERNEL& kernel)
+{
+    const int32_t block_num = (num + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for if (num > PARALLEL_THRESHOLD)
+    for (int32_t block = 0; block < block_num; block++) {
+        float src_planar[SRC_DIM][BLOCK_SIZE];
+        float dst_planar[DST_DIM][BLOCK_SIZE];
+        const int32_t i0 = block * BLOCK_SIZE;
+        const int32_t n = (std::min)(BLOCK_SIZE, num - i0);
+        for (int32_t i = 0; i < n; i++) {
+            for (int32_t d = 0; d < SRC_DIM; d++) src_planar[d][i] = src[(i0 + i) * SRC_DIM + d];
+        }
+        kernel(src_planar, dst_planar, i0, n);
+        for (int32_t i = 0; i < n; i++) {
+            for (int32_t d = 0; d < DST_DIM; d++) dst[(i0 + i) * DST_DIM + d] = dst_planar[d][i];
+        }
+    }
+}
+
+
+CameraProjection::CameraProjection()
+{
+    const float dist[5] = { 0, 0, 0, 0, 0 };
+    const float R[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    const float t[3] = { 0, 0, 0 };
+    fx_ = fy_ = 1;
+    cx_ = cy_ = 0;
+    std::copy(dist, dist + 5, dist_);
+    std::copy(R, R + 9, R_);
+    std::copy(t, t + 3, t_);
+    has_distortion_ = false;
+    UpdateComposition();
+}
+
+CameraProjection::~CameraProjection()
+{
+}
+
+void CameraProjection::SetIntrinsic(float fx, float fy, float cx, float cy)
+{
+    fx_ = fx;
+    fy_ = fy;
+    cx_ = cx;
+    cy_ = cy;
+    UpdateComposition();
+}
+
+void CameraProjection::SetDistortion(const float dist[5])
+{
+    std::copy(dist, dist + 5, dist_);
+    has_distortion_ = false;
+    for (int32_t i = 0; i < 5; i++) {
+        if (dist_[i] != 0) has_distortion_ = true;
+    }
+}
+
+void CameraProjection::SetExtrinsic(const float R[9], const float t[3])
+{
+    std::copy(R, R + 9, R_);
+    std::copy(t, t + 3, t_);
+    UpdateComposition();
+}
+
+void CameraProjection::UpdateComposition()
+{
+    /*** P = K * [R t] ***/
+    for (int32_t x = 0; x < 3; x++) {
+        P_[0 * 4 + x] = fx_ * R_[0 * 3 + x] + cx_ * R_[2 * 3 + x];
+        P_[1 * 4 + x] = fy_ * R_[1 * 3 + x] + cy_ * R_[2 * 3 + x];
+        P_[2 * 4 + x] = R_[2 * 3 + x];
+    }
+    P_[0 * 4 + 3] = fx_ * t_[0] + cx_ * t_[2];
+    P_[1 * 4 + 3] = fy_ * t_[1] + cy_ * t_[2];
+    P_[2 * 4 + 3] = t_[2];
+
+    /*** Mw = R^T * (Mc - t) ***/
+    for (int32_t y = 0; y < 3; y++) {
+        for (int32_t x = 0; x < 3; x++) {
+            R_inv_[y * 3 + x] = R_[x * 3 + y];
+        }
+        t_inv_[y] = -(R_inv_[y * 3 + 0] * t_[0] + R_inv_[y * 3 + 1] * t_[1] + R_inv_[y * 3 + 2] * t_[2]);
+    }
+
+    /*** Ground plane homography ***/
+    /* Mc = R * (Xw, 0, Zw) + t = [r1 r3 t] * (Xw, Zw, 1)  (r = column of R) */
+    /* s * K^-1 * [x, y, 1] = G * (Xw, Zw, 1)  ->  (Xw, Zw, 1) = s * G^-1 * K^-1 * [x, y, 1] */
+    const double G[9] = {
+        R_[0], R_[2], t_[0],
+        R_[3], R_[5], t_[1],
+        R_[6], R_[8], t_[2],
+    };
+    const double det = G[0] * (G[4] * G[8] - G[5] * G[7]) - G[1] * (G[3] * G[8] - G[5] * G[6]) + G[2] * (G[3] * G[7] - G[4] * G[6]);
+    double G_inv[9] = { 0 };
+    if (det != 0) {
+        /* the camera is not on the ground plane */
+        G_inv[0] = (G[4] * G[8] - G[5] * G[7]) / det;
+        G_inv[1] = (G[2] * G[7] - G[1] * G[8]) / det;
+        G_inv[2] = (G[1] * G[5] - G[2] * G[4]) / det;
+        G_inv[3] = (G[5] * G[6] - G[3] * G[8]) / det;
+        G_inv[4] = (G[0] * G[8] - G[2] * G[6]) / det;
+        G_inv[5] = (G[2] * G[3] - G[0] * G[5]) / det;
+        G_inv[6] = (G[3] * G[7] - G[4] * G[6]) / det;
+        G_inv[7] = (G[1] * G[6] - G[0] * G[7]) / det;
+        G_inv[8] = (G[0] * G[4] - G[1] * G[3]) / det;
+    }
+    /* K^-1 = [1/fx, 0, -cx/fx; 0, 1/fy, -cy/fy; 0, 0, 1] */
+    for (int32_t y = 0; y < 3; y++) {
+        H_ground_inv_[y * 3 + 0] = static_cast<float>(G_inv[y * 3 + 0] / fx_);
+        H_ground_inv_[y * 3 + 1] = static_cast<float>(G_inv[y * 3 + 1] / fy_);
+        H_ground_inv_[y * 3 + 2] = static_cast<float>(G_inv[y * 3 + 2] - G_inv[y * 3 + 0] * cx_ / fx_ - G_inv[y * 3 + 1] * cy_ / fy_);
+    }
+}
+
+void CameraProjection::World2Image(const float* object_point, int32_t num, float* image_point, bool use_distortion) const
+{
+    if (!use_distortion || !has_distortion_) {
+        const CameraProjection& self = *this;
+        ProcessPointBlock<3, 2>(object_point, num, image_point, [&self](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t, int32_t n) {
+            const float* P = self.P_;
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) {
+                const float X = src[0][i], Y = src[1][i], Z = src[2][i];
+                const float x = P[0] * X + P[1] * Y + P[2] * Z + P[3];
+                const float y = P[4] * X + P[5] * Y + P[6] * Z + P[7];
+                const float s = P[8] * X + P[9] * Y + P[10] * Z + P[11];   /* = Zc */
+                const float s_inv = 1 / s;
+                const float x_image = x * s_inv;
+                const float y_image = y * s_inv;
+                /* Do not project points behind the camera */
+                dst[0][i] = SimdHelper::SelectIfPositive(s, x_image, kInvalidImage);
+                dst[1][i] = SimdHelper::SelectIfPositive(s, y_image, kInvalidImage);
+            }
+        });
+    } else {
+        /* distortion is applied to the normalized coordinate, so use [R t] and K separately */
+        const CameraProjection& self = *this;
+        ProcessPointBlock<3, 2>(object_point, num, image_point, [&self](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t, int32_t n) {
+            const float* R = self.R_;
+            const float* t = self.t_;
+            const float* dist = self.dist_;
+            const float fx = self.fx_, fy = self.fy_, cx = self.cx_, cy = self.cy_;
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) {
+                const float X = src[0][i], Y = src[1][i], Z = src[2][i];
+                const float Xc = R[0] * X + R[1] * Y + R[2] * Z + t[0];
+                const float Yc = R[3] * X + R[4] * Y + R[5] * Z + t[1];
+                const float Zc = R[6] * X + R[7] * Y + R[8] * Z + t[2];
+                const float Zc_inv = 1 / Zc;
+                float u, v;
+                DistortNormalized(dist, Xc * Zc_inv, Yc * Zc_inv, u, v);
+                const float x_image = u * fx + cx;
+                const float y_image = v * fy + cy;
+                dst[0][i] = SimdHelper::SelectIfPositive(Zc, x_image, kInvalidImage);
+                dst[1][i] = SimdHelper::SelectIfPositive(Zc, y_image, kInvalidImage);
+            }
+        });
+    }
+}
+
+/* dst = R * src + t */
+static void TransformRigid(const float* R, const float* t, const float* src, int32_t num, float* dst)
+{
+    ProcessPointBlock<3, 3>(src, num, dst, [R, t](const float(*src_planar)[BLOCK_SIZE], float(*dst_planar)[BLOCK_SIZE], int32_t, int32_t n) {
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const float X = src_planar[0][i], Y = src_planar[1][i], Z = src_planar[2][i];
+            dst_planar[0][i] = R[0] * X + R[1] * Y + R[2] * Z + t[0];
+            dst_planar[1][i] = R[3] * X + R[4] * Y + R[5] * Z + t[1];
+            dst_planar[2][i] = R[6] * X + R[7] * Y + R[8] * Z + t[2];
+        }
+    });
+}
+
+void CameraProjection::World2Camera(const float* object_point_in_world, int32_t num, float* object_point_in_camera) const
+{
+    TransformRigid(R_, t_, object_point_in_world, num, object_point_in_camera);
+}
+
+void CameraProjection::Camera2World(const float* object_point_in_camera, int32_t num, float* object_point_in_world) const
+{
+    TransformRigid(R_inv_, t_inv_, object_point_in_camera, num, object_point_in_world);
+}
+
+void CameraProjection::Image2Camera(const float* image_point, const float* z, int32_t num, float* object_point, bool use_distortion) const
+{
+    const bool is_undistort = use_distortion && has_distortion_;
+    const CameraProjection& self = *this;
+    ProcessPointBlock<2, 3>(image_point, num, object_point, [&self, z, is_undistort](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t i0, int32_t n) {
+        const float* dist = self.dist_;
+        const float fx_inv = 1 / self.fx_, fy_inv = 1 / self.fy_, cx = self.cx_, cy = self.cy_;
+        float u[BLOCK_SIZE], v[BLOCK_SIZE];
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            u[i] = (src[0][i] - cx) * fx_inv;
+            v[i] = (src[1][i] - cy) * fy_inv;
+        }
+        if (is_undistort) {
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) UndistortNormalized(dist, u[i], v[i], u[i], v[i]);
+        }
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const float Zc = z[i0 + i];
+            dst[0][i] = Zc * u[i];
+            dst[1][i] = Zc * v[i];
+            dst[2][i] = Zc;
+        }
+    });
+}
+
+void CameraProjection::Image2GroundPlane(const float* image_point, int32_t num, float* object_point, bool use_distortion) const
+{
+    const bool is_undistort = use_distortion && has_distortion_;
+    const CameraProjection& self = *this;
+    ProcessPointBlock<2, 3>(image_point, num, object_point, [&self, is_undistort](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t, int32_t n) {
+        const float* dist = self.dist_;
+        const float* H = self.H_ground_inv_;
+        const float fx = self.fx_, fy = self.fy_, fx_inv = 1 / self.fx_, fy_inv = 1 / self.fy_, cx = self.cx_, cy = self.cy_;
+        float x[BLOCK_SIZE], y[BLOCK_SIZE];
+        if (is_undistort) {
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) {
+                float u, v;
+                UndistortNormalized(dist, (src[0][i] - cx) * fx_inv, (src[1][i] - cy) * fy_inv, u, v);
+                x[i] = u * fx + cx;
+                y[i] = v * fy + cy;
+            }
+        } else {
+            for (int32_t i = 0; i < n; i++) {
+                x[i] = src[0][i];
+                y[i] = src[1][i];
+            }
+        }
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const float X = H[0] * x[i] + H[1] * y[i] + H[2];
+            const float Z = H[3] * x[i] + H[4] * y[i] + H[5];
+            const float w = H[6] * x[i] + H[7] * y[i] + H[8];    /* = 1 / s. s > 0 if the ray hits the ground in front of the camera */
+            const float w_inv = 1 / w;
+            const float X_ground = X * w_inv;
+            const float Z_ground = Z * w_inv;
+            dst[0][i] = SimdHelper::SelectIfPositive(w, X_ground, kInvalidGround);
+            dst[1][i] = SimdHelper::SelectIfPositive(w, 0.0F, kInvalidGround);
+            dst[2][i] = SimdHelper::SelectIfPositive(w, Z_ground, kInvalidGround);
+        }
+    });
+}
+
+void CameraProjection::Undistort(const float* image_point, int32_t num, float* image_point_undistorted) const
+{
+    if (!has_distortion_) {
+        if (image_point != image_point_undistorted) std::copy(image_point, image_point + num * 2, image_point_undistorted);
+        return;
+    }
+    const CameraProjection& self = *this;
+    ProcessPointBlock<2, 2>(image_point, num, image_point_undistorted, [&self](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t, int32_t n) {
+        const float* dist = self.dist_;
+        const float fx = self.fx_, fy = self.fy_, fx_inv = 1 / self.fx_, fy_inv = 1 / self.fy_, cx = self.cx_, cy = self.cy_;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            float u, v;
+            UndistortNormalized(dist, (src[0][i] - cx) * fx_inv, (src[1][i] - cy) * fy_inv, u, v);
+            dst[0][i] = u * fx + cx;
+            dst[1][i] = v * fy + cy;
+        }
+    });
+}
+
+void CameraProjection::Distort(const float* image_point, int32_t num, float* image_point_distorted) const
+{
+    if (!has_distortion_) {
+        if (image_point != image_point_distorted) std::copy(image_point, image_point + num * 2, image_point_distorted);
+        return;
+    }
+    const CameraProjection& self = *this;
+    ProcessPointBlock<2, 2>(image_point, num, image_point_distorted, [&self](const float(*src)[BLOCK_SIZE], float(*dst)[BLOCK_SIZE], int32_t, int32_t n) {
+        const float* dist = self.dist_;
+        const float fx = self.fx_, fy = self.fy_, fx_inv = 1 / self.fx_, fy_inv = 1 / self.fy_, cx = self.cx_, cy = self.cy_;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            float u, v;
+            DistortNormalized(dist, (src[0][i] - cx) * fx_inv, (src[1][i] - cy) * fy_inv, u, v);
+            dst[0][i] = u * fx + cx;
+            dst[1][i] = v * fy + cy;
+        }
+    });
+}
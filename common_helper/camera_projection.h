@@ -0,0 +1,81 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef CAMERA_PROJECTION_
+#define CAMERA_PROJECTION_
+
+/* for general */
+#include <cstdint>
+
+/* Projection between world, camera and image coordinates (the math of CameraModel without OpenCV) */
+/*   s[x, y, 1] = K * [R t] * [Mw, 1]. see CameraModel for the coordinate system */
+/*   matrices (K * [R t], the inverse of the ground plane homography, etc.) are composed once in Set*() */
+/*   points are contiguous arrays of interleaved float: 3D = (x, y, z), image = (x, y). e.g. the data of std::vector<cv::Point3f> */
+/*   conversions don't allocate memory, and loops are vectorized (omp simd) and parallelized for many points */
+/*   distortion model is the same as OpenCV (k1, k2, p1, p2, k3). undistortion is iterative (the same as cv::undistortPoints) */
+class CameraProjection {
+public:
+    static constexpr float kInvalidImage = -1.0F;      /* image point of an object behind the camera */
+    static constexpr float kInvalidGround = 999.0F;    /* ground point of an image point above the horizon */
+    static constexpr int32_t kUndistortIterationNum = 5;
+
+public:
+    CameraProjection();
+    ~CameraProjection();
+
+    void SetIntrinsic(float fx, float fy, float cx, float cy);
+    void SetDistortion(const float dist[5]);            /* k1, k2, p1, p2, k3 */
+    void SetExtrinsic(const float R[9], const float t[3]);  /* Mc = R * Mw + t */
+
+    bool HasDistortion() const { return has_distortion_; }
+    void GetIntrinsic(float& fx, float& fy, float& cx, float& cy) const { fx = fx_; fy = fy_; cx = cx_; cy = cy_; }
+    const float* GetDistortion() const { return dist_; }
+    /* undistorted image (x, y, 1) -> (Xw, Zw, 1) * w on the ground plane. w > 0 if the ray hits the ground in front of the camera */
+    const float* GetGroundHomographyInv() const { return H_ground_inv_; }
+
+    /* Mw -> image. points behind the camera are (kInvalidImage, kInvalidImage) */
+    void World2Image(const float* object_point, int32_t num, float* image_point, bool use_distortion = true) const;
+    /* Mw -> Mc. src and dst can be the same */
+    void World2Camera(const float* object_point_in_world, int32_t num, float* object_point_in_camera) const;
+    /* Mc -> Mw. src and dst can be the same */
+    void Camera2World(const float* object_point_in_camera, int32_t num, float* object_point_in_world) const;
+    /* image + depth (Zc) -> Mc */
+    void Image2Camera(const float* image_point, const float* z, int32_t num, float* object_point, bool use_distortion = true) const;
+    /* image -> Mw on the ground plane (Yw = 0). points which don't hit the ground in front of the camera are kInvalidGround */
+    void Image2GroundPlane(const float* image_point, int32_t num, float* object_point, bool use_distortion = true) const;
+
+    /* distorted image -> undistorted image (pixel). src and dst can be the same */
+    void Undistort(const float* image_point, int32_t num, float* image_point_undistorted) const;
+    /* undistorted image -> distorted image (pixel). src and dst can be the same */
+    void Distort(const float* image_point, int32_t num, float* image_point_distorted) const;
+
+private:
+    void UpdateComposition();
+
+private:
+    /* parameters */
+    float fx_, fy_, cx_, cy_;
+    float dist_[5];
+    float R_[9];
+    float t_[3];
+    bool has_distortion_;
+
+    /* composed */
+    float P_[12];           /* K * [R t] */
+    float R_inv_[9];        /* R^T */
+    float t_inv_[3];        /* -R^T * t (camera position in world) */
+    float H_ground_inv_[9]; /* undistorted image -> (Xw, Zw, 1) * w on the ground plane */
+};
+
+#endif
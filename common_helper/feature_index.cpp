@@ -0,0 +1,508 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/* for My modules */
+#include "feature_similarity.h"
+#include "feature_index.h"
+
+/*** Macro ***/
+#define ALIGNMENT_NUM 16
+#define KMEANS_ITERATION_NUM 10
+/* the max number of samples processed at once in training (to bound the size of the similarity matrix) */
+#define TRAIN_CHUNK_NUM 1024
+
+
+static bool CompareNeighbor(const FeatureIndex::Neighbor& a, const FeatureIndex::Neighbor& b)
+{
+    /* similarity descending. id is used to make the order deterministic */
+    return (a.similarity > b.similarity) || (a.similarity == b.similarity && a.id < b.id);
+}
+
+static void CenterFeature(const float* mean, const float* feature_normalized, float* dst, int32_t feature_size)
+{
+    for (int32_t j = 0; j < feature_size; j++) dst[j] = feature_normalized[j] - mean[j];
+    FeatureSimilarity::NormalizeL2(dst, dst, feature_size);
+}
+
+FeatureIndex::FeatureIndex()
+    : stride_(0), is_trained_(false), lru_head_(-1), lru_tail_(-1), insert_num_(0)
+{
+    train_.phase = kPhaseIdle;
+}
+
+FeatureIndex::~FeatureIndex()
+{
+}
+
+int32_t FeatureIndex::Initialize(const Param& param)
+{
+    if (param.feature_size <= 0 || param.list_num <= 0 || param.probe_num <= 0 || param.capacity <= 0) {
+        return kRetErr;
+    }
+    param_ = param;
+    stride_ = (param_.feature_size + ALIGNMENT_NUM - 1) / ALIGNMENT_NUM * ALIGNMENT_NUM;
+    query_.assign(stride_, 0.0F);
+    query_centered_.assign(stride_, 0.0F);
+    Clear();
+    return kRetOk;
+}
+
+void FeatureIndex::Clear()
+{
+    is_trained_ = false;
+    mean_.clear();
+    centroid_list_.clear();
+    list_list_.clear();
+    list_list_.resize(1);   /* all entries are in one list until trained */
+    list_list_[0].data.reserve(static_cast<size_t>((std::max)(param_.train_num, 0)) * 2 * stride_);  /* avoid reallocation of a large list in Insert (entries are added during the first training) */
+    entry_list_.clear();
+    entry_of_id_.clear();
+    lru_head_ = -1;
+    lru_tail_ = -1;
+    insert_num_ = 0;
+    train_ = TrainState();
+    train_.phase = kPhaseIdle;
+}
+
+int32_t FeatureIndex::Insert(int32_t id, const float* feature, int64_t time, int32_t label)
+{
+    if (stride_ == 0) return kRetErr;
+    Erase(id);
+
+    std::vector<float>& feature_normalized = query_;
+    if (!FeatureSimilarity::NormalizeL2(feature, feature_normalized.data(), param_.feature_size)) {
+        return kRetErr;
+    }
+
+    /* remove the least recently used entry to keep memory */
+    while (static_cast<int32_t>(entry_list_.size()) >= param_.capacity && lru_head_ >= 0) {
+        EraseEntry(lru_head_);
+    }
+
+    Entry entry;
+    entry.id = id;
+    entry.label = label;
+    entry.list = 0;
+    entry.pos = 0;
+    entry.time = time;
+    entry.lru_prev = -1;
+    entry.lru_next = -1;
+    const auto handle = entry_list_.Insert(entry);
+    const int32_t entry_index = handle.index;
+    entry_of_id_[id] = entry_index;
+    LinkLru(entry_index);
+    AddToList(entry_index, FindNearestList(feature_normalized.data()), feature_normalized.data());
+    insert_num_++;
+
+    /* training is amortized over insertions (a whole training at once takes hundreds of msec) */
+    const int32_t step_num = param_.train_step_num > 0 ? param_.train_step_num : (std::numeric_limits<int32_t>::max)();
+    if (train_.phase != kPhaseIdle) {
+        train_.inserted_entry_list.push_back(handle);
+        StepTraining(step_num);
+    } else if ((!is_trained_ && static_cast<int32_t>(entry_list_.size()) >= param_.train_num)
+        || (is_trained_ && param_.retrain_num > 0 && insert_num_ >= param_.retrain_num)) {
+        StartTraining();
+        if (param_.train_step_num <= 0) StepTraining(step_num);
+    }
+    return kRetOk;
+}
+
+bool FeatureIndex::Erase(int32_t id)
+{
+    const auto& it = entry_of_id_.find(id);
+    if (it == entry_of_id_.end()) return false;
+    EraseEntry(it->second);
+    return true;
+}
+
+bool FeatureIndex::Touch(int32_t id, int64_t time)
+{
+    const auto& it = entry_of_id_.find(id);
+    if (it == entry_of_id_.end()) return false;
+    UnlinkLru(it->second);
+    entry_list_[it->second].time = time;
+    LinkLru(it->second);
+    return true;
+}
+
+int32_t FeatureIndex::RemoveExpired(int64_t time_now)
+{
+    if (param_.ttl <= 0) return 0;
+    /* entries are in the order of time in the LRU list */
+    int32_t removed_num = 0;
+    while (lru_head_ >= 0 && time_now - entry_list_[lru_head_].time > param_.ttl) {
+        EraseEntry(lru_head_);
+        removed_num++;
+    }
+    return removed_num;
+}
+
+void FeatureIndex::Search(const float* feature, int32_t k, std::vector<Neighbor>& neighbor_list, int32_t label)
+{
+    neighbor_list.clear();
+    if (k <= 0 || entry_list_.empty() || !FeatureSimilarity::NormalizeL2(feature, query_.data(), param_.feature_size)) return;
+
+    candidate_list_.clear();
+    if (!is_trained_) {
+        ScanList(0, k, label);
+    } else {
+        /* select lists whose centroids are the most similar to the query */
+        const int32_t list_num = static_cast<int32_t>(list_list_.size());
+        similarity_list_.resize(list_num);
+        Center(query_.data(), query_centered_.data());
+        FeatureSimilarity::MultiplyTransposed(centroid_list_.data(), list_num, stride_, query_centered_.data(), 1, stride_, param_.feature_size, similarity_list_.data(), 1);
+        list_order_.resize(list_num);
+        for (int32_t i = 0; i < list_num; i++) list_order_[i] = { i, similarity_list_[i] };
+        const int32_t probe_num = (std::min)(param_.probe_num, list_num);
+        std::partial_sort(list_order_.begin(), list_order_.begin() + probe_num, list_order_.end(), CompareNeighbor);
+        for (int32_t i = 0; i < probe_num; i++) {
+            ScanList(list_order_[i].id, k, label);
+        }
+    }
+    SelectTop(k, neighbor_list);
+}
+
+void FeatureIndex::SearchExact(const float* feature, int32_t k, std::vector<Neighbor>& neighbor_list, int32_t label)
+{
+    neighbor_list.clear();
+    if (k <= 0 || entry_list_.empty() || !FeatureSimilarity::NormalizeL2(feature, query_.data(), param_.feature_size)) return;
+
+    candidate_list_.clear();
+    for (int32_t list = 0; list < static_cast<int32_t>(list_list_.size()); list++) {
+        ScanList(list, k, label);
+    }
+    SelectTop(k, neighbor_list);
+}
+
+void FeatureIndex::Train()
+{
+    StartTraining();
+    StepTraining((std::numeric_limits<int32_t>::max)());
+}
+
+void FeatureIndex::StartTraining()
+{
+    /* the entries at this time are the samples (entries erased during training are skipped) */
+    insert_num_ = 0;
+    train_.phase = kPhaseGather;
+    train_.cursor = 0;
+    train_.sample_num = 0;
+    train_.list_num = 0;
+    train_.iteration = 0;
+    train_.is_changed = false;
+    train_.entry_list.clear();
+    for (auto it = entry_list_.begin(); it != entry_list_.end(); ++it) {
+        train_.entry_list.push_back(entry_list_.GetHandle(it.GetIndex()));
+    }
+    train_.sample_entry_list.clear();
+    train_.inserted_entry_list.clear();
+    train_.sample_list.clear();
+    train_.sample_list.reserve(train_.entry_list.size() * stride_);
+    train_.mean.assign(stride_, 0.0F);
+}
+
+void FeatureIndex::StepTraining(int32_t step_num)
+{
+    while (step_num > 0 && train_.phase != kPhaseIdle) {
+        if (train_.phase == kPhaseGather) {
+            /*** Gather features ***/
+            const int32_t snapshot_num = static_cast<int32_t>(train_.entry_list.size());
+            const int32_t num = (std::min)(step_num, snapshot_num - train_.cursor);
+            for (int32_t i = train_.cursor; i < train_.cursor + num; i++) {
+                const auto& handle = train_.entry_list[i];
+                if (!entry_list_.IsValid(handle)) continue;
+                const Entry& entry = entry_list_[handle.index];
+                const float* src = &list_list_[entry.list].data[static_cast<size_t>(entry.pos) * stride_];
+                train_.sample_list.insert(train_.sample_list.end(), src, src + stride_);
+                train_.sample_entry_list.push_back(handle);
+                for (int32_t j = 0; j < param_.feature_size; j++) train_.mean[j] += src[j];
+            }
+            train_.cursor += num;
+            step_num -= num;
+            if (train_.cursor < snapshot_num) break;
+
+            train_.sample_num = static_cast<int32_t>(train_.sample_entry_list.size());
+            train_.list_num = (std::min)(param_.list_num, train_.sample_num);
+            if (train_.list_num <= 0) {
+                train_ = TrainState();
+                train_.phase = kPhaseIdle;
+                break;
+            }
+            for (int32_t j = 0; j < param_.feature_size; j++) train_.mean[j] /= train_.sample_num;
+            train_.phase = kPhaseCenter;
+            train_.cursor = 0;
+        } else if (train_.phase == kPhaseCenter) {
+            /*** Center features ***/
+            /* features (e.g. after ReLU) have a large common component, and clustering them as is makes a few huge lists */
+            /* so features are clustered after the mean is subtracted (the original features are stored in the lists) */
+            const int32_t num = (std::min)(step_num, train_.sample_num - train_.cursor);
+            for (int32_t i = train_.cursor; i < train_.cursor + num; i++) {
+                float* sample = &train_.sample_list[static_cast<size_t>(i) * stride_];
+                CenterFeature(train_.mean.data(), sample, sample, param_.feature_size);
+            }
+            train_.cursor += num;
+            step_num -= num;
+            if (train_.cursor < train_.sample_num) break;
+
+            /* initial centroids are evenly sampled so that the result is deterministic */
+            const int32_t list_num = train_.list_num;
+            train_.centroid_list.assign(static_cast<size_t>(list_num) * stride_, 0.0F);
+            for (int32_t c = 0; c < list_num; c++) {
+                const float* src = &train_.sample_list[static_cast<size_t>(c) * train_.sample_num / list_num * stride_];
+                std::copy(src, src + stride_, &train_.centroid_list[static_cast<size_t>(c) * stride_]);
+            }
+            train_.assignment_list.assign(train_.sample_num, 0);
+            train_.sum_list.assign(static_cast<size_t>(list_num) * stride_, 0.0F);
+            train_.count_list.assign(list_num, 0);
+            train_.phase = kPhaseAssign;
+            train_.cursor = 0;
+        } else if (train_.phase == kPhaseAssign) {
+            /*** Spherical k-means ***/
+            /* assign each sample to the most similar centroid, and sum up the samples of each centroid */
+            const int32_t list_num = train_.list_num;
+            const int32_t num = (std::min)((std::min)(step_num, TRAIN_CHUNK_NUM), train_.sample_num - train_.cursor);
+            train_.similarity_matrix.resize(static_cast<size_t>(TRAIN_CHUNK_NUM) * list_num);
+            FeatureSimilarity::MultiplyTransposed(&train_.sample_list[static_cast<size_t>(train_.cursor) * stride_], num, stride_, train_.centroid_list.data(), list_num, stride_, param_.feature_size, train_.similarity_matrix.data(), list_num);
+            for (int32_t i = 0; i < num; i++) {
+                const float* row = &train_.similarity_matrix[static_cast<size_t>(i) * list_num];
+                const int32_t best = static_cast<int32_t>(std::max_element(row, row + list_num) - row);
+                int32_t& assignment = train_.assignment_list[train_.cursor + i];
+                if (train_.iteration == 0 || best != assignment) train_.is_changed = true;
+                assignment = best;
+                float* dst = &train_.sum_list[static_cast<size_t>(best) * stride_];
+                const float* src = &train_.sample_list[static_cast<size_t>(train_.cursor + i) * stride_];
+                for (int32_t j = 0; j < param_.feature_size; j++) dst[j] += src[j];
+                train_.count_list[best]++;
+            }
+            train_.cursor += num;
+            step_num -= num;
+            if (train_.cursor < train_.sample_num) continue;
+
+            /* centroid = normalized mean. an empty list keeps the previous centroid */
+            bool is_finished = !train_.is_changed;
+            if (!is_finished) {
+                for (int32_t c = 0; c < list_num; c++) {
+                    if (train_.count_list[c] == 0) continue;
+                    FeatureSimilarity::NormalizeL2(&train_.sum_list[static_cast<size_t>(c) * stride_], &train_.centroid_list[static_cast<size_t>(c) * stride_], param_.feature_size);
+                }
+                train_.iteration++;
+                is_finished = train_.iteration >= KMEANS_ITERATION_NUM;
+            }
+            if (is_finished) {
+                std::vector<float>().swap(train_.sample_list);
+                std::vector<float>().swap(train_.similarity_matrix);
+                std::vector<float>().swap(train_.sum_list);
+                train_.list_list.assign(list_num, List());
+                train_.list_entry_list.assign(list_num, std::vector<SlotMap<Entry>::Handle>());
+                train_.phase = kPhaseRebuild;
+                train_.cursor = 0;
+                continue;
+            }
+            std::fill(train_.sum_list.begin(), train_.sum_list.end(), 0.0F);
+            std::fill(train_.count_list.begin(), train_.count_list.end(), 0);
+            train_.is_changed = false;
+            train_.cursor = 0;
+        } else {
+            /*** Rebuild lists ***/
+            /* the current lists are used until all the samples and the entries inserted during training are copied */
+            const int32_t total_num = train_.sample_num + static_cast<int32_t>(train_.inserted_entry_list.size());
+            const int32_t num = (std::min)(step_num, total_num - train_.cursor);
+            for (int32_t i = train_.cursor; i < train_.cursor + num; i++) {
+                const auto& handle = i < train_.sample_num ? train_.sample_entry_list[i] : train_.inserted_entry_list[i - train_.sample_num];
+                if (!entry_list_.IsValid(handle)) continue;
+                const Entry& entry = entry_list_[handle.index];
+                const float* src = &list_list_[entry.list].data[static_cast<size_t>(entry.pos) * stride_];
+                const int32_t list = i < train_.sample_num ? train_.assignment_list[i] : FindNearestCentroid(train_.mean.data(), train_.centroid_list.data(), train_.list_num, src);
+                train_.list_list[list].data.insert(train_.list_list[list].data.end(), src, src + stride_);
+                train_.list_entry_list[list].push_back(handle);
+            }
+            train_.cursor += num;
+            step_num -= num;
+            if (train_.cursor < total_num) break;
+            FinishTraining();
+        }
+    }
+}
+
+void FeatureIndex::FinishTraining()
+{
+    /* replace the lists. entries erased during the rebuild are removed from the new lists */
+    std::vector<uint8_t> is_placed_list(entry_list_.GetCapacity(), 0);
+    for (int32_t c = 0; c < train_.list_num; c++) {
+        List& list = train_.list_list[c];
+        auto& list_entry = train_.list_entry_list[c];
+        list.entry_index.clear();
+        for (int32_t row = 0; row < static_cast<int32_t>(list_entry.size());) {
+            if (!entry_list_.IsValid(list_entry[row])) {
+                const int32_t last = static_cast<int32_t>(list_entry.size()) - 1;
+                std::copy(list.data.begin() + static_cast<size_t>(last) * stride_, list.data.begin() + static_cast<size_t>(last + 1) * stride_, list.data.begin() + static_cast<size_t>(row) * stride_);
+                list_entry[row] = list_entry[last];
+                list_entry.pop_back();
+                list.data.resize(static_cast<size_t>(last) * stride_);
+                continue;
+            }
+            const int32_t entry_index = list_entry[row].index;
+            Entry& entry = entry_list_[entry_index];
+            entry.list = c;
+            entry.pos = row;
+            list.entry_index.push_back(entry_index);
+            is_placed_list[entry_index] = 1;
+            row++;
+        }
+    }
+    std::vector<List> list_list_old;
+    list_list_old.swap(list_list_);
+    list_list_.swap(train_.list_list);
+    mean_.swap(train_.mean);
+    centroid_list_.swap(train_.centroid_list);
+    is_trained_ = true;
+
+    /* all the entries have been copied in kPhaseRebuild. this is just in case */
+    for (auto it = entry_list_.begin(); it != entry_list_.end(); ++it) {
+        if (is_placed_list[it.GetIndex()]) continue;
+        const float* src = &list_list_old[it->list].data[static_cast<size_t>(it->pos) * stride_];
+        AddToList(it.GetIndex(), FindNearestList(src), src);
+    }
+
+    /* release the snapshot */
+    train_ = TrainState();
+    train_.phase = kPhaseIdle;
+}
+
+void FeatureIndex::Center(const float* feature_normalized, float* dst) const
+{
+    CenterFeature(mean_.data(), feature_normalized, dst, param_.feature_size);
+}
+
+int32_t FeatureIndex::FindNearestList(const float* feature_normalized)
+{
+    if (!is_trained_) return 0;
+    return FindNearestCentroid(mean_.data(), centroid_list_.data(), static_cast<int32_t>(list_list_.size()), feature_normalized);
+}
+
+int32_t FeatureIndex::FindNearestCentroid(const float* mean, const float* centroid_list, int32_t list_num, const float* feature_normalized)
+{
+    CenterFeature(mean, feature_normalized, query_centered_.data(), param_.feature_size);
+    int32_t best = 0;
+    float similarity_best = -2.0F;
+    for (int32_t c = 0; c < list_num; c++) {
+        const float similarity = FeatureSimilarity::Dot(&centroid_list[static_cast<size_t>(c) * stride_], query_centered_.data(), param_.feature_size);
+        if (similarity > similarity_best) {
+            similarity_best = similarity;
+            best = c;
+        }
+    }
+    return best;
+}
+
+void FeatureIndex::AddToList(int32_t entry_index, int32_t list, const float* feature_normalized)
+{
+    List& dst = list_list_[list];
+    Entry& entry = entry_list_[entry_index];
+    entry.list = list;
+    entry.pos = static_cast<int32_t>(dst.entry_index.size());
+    dst.entry_index.push_back(entry_index);
+    dst.data.insert(dst.data.end(), feature_normalized, feature_normalized + stride_);
+}
+
+void FeatureIndex::RemoveFromList(int32_t entry_index)
+{
+    /* move the last row to the removed position */
+    const Entry& entry = entry_list_[entry_index];
+    List& list = list_list_[entry.list];
+    const int32_t last = static_cast<int32_t>(list.entry_index.size()) - 1;
+    if (entry.pos != last) {
+        std::copy(list.data.begin() + static_cast<size_t>(last) * stride_, list.data.begin() + static_cast<size_t>(last + 1) * stride_, list.data.begin() + static_cast<size_t>(entry.pos) * stride_);
+        list.entry_index[entry.pos] = list.entry_index[last];
+        entry_list_[list.entry_index[entry.pos]].pos = entry.pos;
+    }
+    list.entry_index.pop_back();
+    list.data.resize(static_cast<size_t>(last) * stride_);
+}
+
+void FeatureIndex::EraseEntry(int32_t entry_index)
+{
+    RemoveFromList(entry_index);
+    UnlinkLru(entry_index);
+    entry_of_id_.erase(entry_list_[entry_index].id);
+    entry_list_.Erase(entry_index);
+}
+
+void FeatureIndex::LinkLru(int32_t entry_index)
+{
+    Entry& entry = entry_list_[entry_index];
+    entry.lru_prev = lru_tail_;
+    entry.lru_next = -1;
+    if (lru_tail_ >= 0) {
+        entry_list_[lru_tail_].lru_next = entry_index;
+    } else {
+        lru_head_ = entry_index;
+    }
+    lru_tail_ = entry_index;
+}
+
+void FeatureIndex::UnlinkLru(int32_t entry_index)
+{
+    Entry& entry = entry_list_[entry_index];
+    if (entry.lru_prev >= 0) {
+        entry_list_[entry.lru_prev].lru_next = entry.lru_next;
+    } else {
+        lru_head_ = entry.lru_next;
+    }
+    if (entry.lru_next >= 0) {
+        entry_list_[entry.lru_next].lru_prev = entry.lru_prev;
+    } else {
+        lru_tail_ = entry.lru_prev;
+    }
+    entry.lru_prev = -1;
+    entry.lru_next = -1;
+}
+
+void FeatureIndex::ScanList(int32_t list, int32_t k, int32_t label)
+{
+    /* candidate_list_ is a heap of the best k entries. the front is the worst one */
+    const List& src = list_list_[list];
+    const int32_t num = static_cast<int32_t>(src.entry_index.size());
+    if (num == 0) return;
+    similarity_list_.resize(num);
+    FeatureSimilarity::MultiplyTransposed(src.data.data(), num, stride_, query_.data(), 1, stride_, param_.feature_size, similarity_list_.data(), 1);
+    for (int32_t i = 0; i < num; i++) {
+        const Entry& entry = entry_list_[src.entry_index[i]];
+        if (label >= 0 && entry.label != label) continue;
+        const Neighbor neighbor = { entry.id, similarity_list_[i] };
+        if (static_cast<int32_t>(candidate_list_.size()) < k) {
+            candidate_list_.push_back(neighbor);
+            std::push_heap(candidate_list_.begin(), candidate_list_.end(), CompareNeighbor);
+        } else if (CompareNeighbor(neighbor, candidate_list_.front())) {
+            std::pop_heap(candidate_list_.begin(), candidate_list_.end(), CompareNeighbor);
+            candidate_list_.back() = neighbor;
+            std::push_heap(candidate_list_.begin(), candidate_list_.end(), CompareNeighbor);
+        }
+    }
+}
+
+void FeatureIndex::SelectTop(int32_t k, std::vector<Neighbor>& neighbor_list)
+{
+    (void)k;
+    std::sort_heap(candidate_list_.begin(), candidate_list_.end(), CompareNeighbor);
+    neighbor_list.assign(candidate_list_.begin(), candidate_list_.end());
+}
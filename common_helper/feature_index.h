@@ -0,0 +1,167 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef FEATURE_INDEX_
+#define FEATURE_INDEX_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+/* for My modules */
+#include "slot_map.h"
+
+/* Approximate nearest neighbor index of appearance features (IVF-flat: inverted file of flat lists) */
+/*   features are L2-normalized when inserted, and similarity is the inner product (= cosine similarity) */
+/*   features are clustered into list_num lists by k-means (after the mean is subtracted), which is trained automatically when train_num features are inserted */
+/*     training is amortized over Insert(): each Insert() processes train_step_num samples (the cost is proportional to train_step_num * list_num), and the current lists are used until training finishes */
+/*     the lists are retrained every retrain_num insertions, so that they follow the distribution of the latest features */
+/*   a query scans only probe_num lists whose centroids are the most similar (all features are scanned before training) */
+/*   memory is bounded: the least recently used entry is removed when capacity is exceeded, and entries older than ttl are removed by RemoveExpired() */
+class FeatureIndex {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef struct Param_ {
+        int32_t feature_size;
+        int32_t list_num;
+        int32_t probe_num;
+        int32_t train_num;      /* the number of features to train the lists */
+        int32_t retrain_num;    /* the lists are retrained after this number of insertions since the last training. 0 = never */
+        int32_t train_step_num; /* the number of samples processed in training at each Insert(). 0 = all at once (Insert() stalls) */
+        int32_t capacity;       /* the max number of entries */
+        int64_t ttl;            /* entries not used for this time are removed by RemoveExpired(). 0 = no limit */
+        Param_() : feature_size(512), list_num(64), probe_num(4), train_num(4096), retrain_num(4096), train_step_num(256), capacity(10000), ttl(0)
+        {}
+    } Param;
+
+    typedef struct Neighbor_ {
+        int32_t id;
+        float   similarity;
+    } Neighbor;
+
+public:
+    FeatureIndex();
+    ~FeatureIndex();
+
+    int32_t Initialize(const Param& param);
+    void Clear();
+
+    /* the entry of the same id is replaced. time is any monotonic value (e.g. frame number). label is any value to filter the search (e.g. class id) */
+    int32_t Insert(int32_t id, const float* feature, int64_t time, int32_t label = 0);
+    bool Erase(int32_t id);
+    bool Touch(int32_t id, int64_t time);       /* mark the entry as used at time */
+    int32_t RemoveExpired(int64_t time_now);    /* return the number of removed entries */
+
+    /* top k entries in descending order of similarity. only entries of the label are searched (-1 = all) */
+    void Search(const float* feature, int32_t k, std::vector<Neighbor>& neighbor_list, int32_t label = -1);
+    /* brute force search of all the entries (for reference) */
+    void SearchExact(const float* feature, int32_t k, std::vector<Neighbor>& neighbor_list, int32_t label = -1);
+
+    /* cluster the current entries into lists (k-means) at once. training runs automatically in Insert() (see train_num and retrain_num) */
+    void Train();
+
+    bool IsInitialized() const { return stride_ > 0; }
+    size_t size() const { return entry_list_.size(); }
+    bool IsTrained() const { return is_trained_; }
+    bool IsTraining() const { return train_.phase != kPhaseIdle; }
+    const Param& GetParam() const { return param_; }
+
+private:
+    typedef struct Entry_ {
+        int32_t id;
+        int32_t label;
+        int32_t list;
+        int32_t pos;        /* row in the list */
+        int64_t time;
+        int32_t lru_prev;   /* entry index (-1 = none) */
+        int32_t lru_next;
+    } Entry;
+
+    typedef struct List_ {
+        std::vector<float>   data;          /* [num][stride] */
+        std::vector<int32_t> entry_index;   /* [num] */
+    } List;
+
+    enum {
+        kPhaseIdle = 0,
+        kPhaseGather,       /* copy the features of the snapshot and sum them up for the mean */
+        kPhaseCenter,       /* subtract the mean */
+        kPhaseAssign,       /* an iteration of k-means */
+        kPhaseRebuild,      /* copy the features into the new lists */
+    };
+
+    /* training in progress. it works on a snapshot of the entries, so that entries can be inserted / erased during training */
+    typedef struct TrainState_ {
+        int32_t phase;
+        int32_t cursor;         /* the next sample to process in the phase */
+        int32_t sample_num;
+        int32_t list_num;
+        int32_t iteration;
+        bool    is_changed;
+        std::vector<SlotMap<Entry>::Handle> entry_list;    /* [num of the snapshot]. erased entries are skipped */
+        std::vector<SlotMap<Entry>::Handle> sample_entry_list;  /* [sample_num] */
+        std::vector<SlotMap<Entry>::Handle> inserted_entry_list;    /* entries inserted during training */
+        std::vector<float>   sample_list;       /* [sample_num][stride] (centered) */
+        std::vector<float>   mean;              /* [stride] */
+        std::vector<float>   centroid_list;     /* [list_num][stride] */
+        std::vector<int32_t> assignment_list;   /* [sample_num] */
+        std::vector<float>   similarity_matrix; /* [TRAIN_CHUNK_NUM][list_num] */
+        std::vector<float>   sum_list;          /* [list_num][stride] */
+        std::vector<int32_t> count_list;        /* [list_num] */
+        std::vector<List>    list_list;         /* [list_num] the new lists. entry_index is set when they replace the current lists */
+        std::vector<std::vector<SlotMap<Entry>::Handle>> list_entry_list;  /* [list_num][num] */
+    } TrainState;
+
+    void Center(const float* feature_normalized, float* dst) const;     /* normalize(feature - mean) */
+    int32_t FindNearestList(const float* feature_normalized);
+    int32_t FindNearestCentroid(const float* mean, const float* centroid_list, int32_t list_num, const float* feature_normalized);
+    void AddToList(int32_t entry_index, int32_t list, const float* feature_normalized);
+    void RemoveFromList(int32_t entry_index);
+    void EraseEntry(int32_t entry_index);
+    void LinkLru(int32_t entry_index);
+    void UnlinkLru(int32_t entry_index);
+    void StartTraining();
+    void StepTraining(int32_t step_num);
+    void FinishTraining();
+    void ScanList(int32_t list, int32_t k, int32_t label);
+    void SelectTop(int32_t k, std::vector<Neighbor>& neighbor_list);
+
+private:
+    Param param_;
+    int32_t stride_;
+    bool is_trained_;
+    std::vector<float> mean_;               /* [stride]. mean of the features used for training */
+    std::vector<float> centroid_list_;      /* [list_num][stride] (centered) */
+    std::vector<List> list_list_;
+    SlotMap<Entry> entry_list_;
+    std::unordered_map<int32_t, int32_t> entry_of_id_;
+    int32_t lru_head_;      /* the least recently used */
+    int32_t lru_tail_;      /* the most recently used */
+    int64_t insert_num_;                /* since the last training started */
+    TrainState train_;
+
+    /* reused for every query */
+    std::vector<float> query_;
+    std::vector<float> query_centered_;
+    std::vector<float> similarity_list_;
+    std::vector<Neighbor> candidate_list_;
+    std::vector<Neighbor> list_order_;
+};
+
+#endif
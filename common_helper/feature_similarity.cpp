@@ -0,0 +1,137 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/* for My modules */
+#include "feature_similarity.h"
+
+/*** Macro ***/
+#define BLOCK_SIZE 4
+/* the number of multiply-add to use multi threads */
+#define PARALLEL_THRESHOLD (1 << 20)
+
+
+bool FeatureSimilarity::NormalizeL2(const float* src, float* dst, int32_t size)
+{
+    float norm = 0;
+    for (int32_t i = 0; i < size; i++) norm += src[i] * src[i];
+    if (norm <= 0) {
+        std::fill(dst, dst + size, 0.0F);
+        return false;
+    }
+    const float scale = 1.0F / std::sqrt(norm);
+    for (int32_t i = 0; i < size; i++) dst[i] = src[i] * scale;
+    return true;
+}
+
+void FeatureSimilarity::QuantizeInt8(const float* src_normalized, int8_t* dst, int32_t size)
+{
+    for (int32_t i = 0; i < size; i++) {
+        float v = std::round(src_normalized[i] * kInt8Scale);
+        dst[i] = static_cast<int8_t>((std::min)(kInt8Scale, (std::max)(-kInt8Scale, v)));
+    }
+}
+
+float FeatureSimilarity::Dot(const float* a, const float* b, int32_t size)
+{
+    float sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (int32_t i = 0; i < size; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+float FeatureSimilarity::Dot(const int8_t* a, const int8_t* b, int32_t size)
+{
+    int32_t sum = 0;
+#pragma omp simd reduction(+:sum)
+    for (int32_t i = 0; i < size; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum / (kInt8Scale * kInt8Scale);
+}
+
+
+/* ACC: accumulator type. the result is multiplied by scale */
+template<typename T, typename ACC>
+static void MultiplyTransposedImpl(const T* a, int32_t a_num, int32_t a_stride, const T* b, int32_t b_num, int32_t b_stride, int32_t size, float* dst, int32_t dst_stride, float scale)
+{
+    const int32_t block_num = (a_num + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const bool is_parallel = static_cast<int64_t>(a_num) * b_num * size > PARALLEL_THRESHOLD;
+    (void)is_parallel;
+#pragma omp parallel for if (is_parallel)
+    for (int32_t block = 0; block < block_num; block++) {
+        const int32_t i0 = block * BLOCK_SIZE;
+        int32_t j0 = 0;
+        if (i0 + BLOCK_SIZE <= a_num) {
+            /* 4 x 4 block: each element of a and b is loaded once for 4 multiply-adds */
+            const T* a0 = a + static_cast<size_t>(i0) * a_stride;
+            const T* a1 = a0 + a_stride;
+            const T* a2 = a1 + a_stride;
+            const T* a3 = a2 + a_stride;
+            for (; j0 + BLOCK_SIZE <= b_num; j0 += BLOCK_SIZE) {
+                const T* b0 = b + static_cast<size_t>(j0) * b_stride;
+                const T* b1 = b0 + b_stride;
+                const T* b2 = b1 + b_stride;
+                const T* b3 = b2 + b_stride;
+                ACC s00 = 0, s01 = 0, s02 = 0, s03 = 0;
+                ACC s10 = 0, s11 = 0, s12 = 0, s13 = 0;
+                ACC s20 = 0, s21 = 0, s22 = 0, s23 = 0;
+                ACC s30 = 0, s31 = 0, s32 = 0, s33 = 0;
+#pragma omp simd reduction(+:s00,s01,s02,s03,s10,s11,s12,s13,s20,s21,s22,s23,s30,s31,s32,s33)
+                for (int32_t k = 0; k < size; k++) {
+                    const ACC va0 = a0[k], va1 = a1[k], va2 = a2[k], va3 = a3[k];
+                    const ACC vb0 = b0[k], vb1 = b1[k], vb2 = b2[k], vb3 = b3[k];
+                    s00 += va0 * vb0; s01 += va0 * vb1; s02 += va0 * vb2; s03 += va0 * vb3;
+                    s10 += va1 * vb0; s11 += va1 * vb1; s12 += va1 * vb2; s13 += va1 * vb3;
+                    s20 += va2 * vb0; s21 += va2 * vb1; s22 += va2 * vb2; s23 += va2 * vb3;
+                    s30 += va3 * vb0; s31 += va3 * vb1; s32 += va3 * vb2; s33 += va3 * vb3;
+                }
+                float* d0 = dst + static_cast<size_t>(i0) * dst_stride + j0;
+                float* d1 = d0 + dst_stride;
+                float* d2 = d1 + dst_stride;
+                float* d3 = d2 + dst_stride;
+                d0[0] = s00 * scale; d0[1] = s01 * scale; d0[2] = s02 * scale; d0[3] = s03 * scale;
+                d1[0] = s10 * scale; d1[1] = s11 * scale; d1[2] = s12 * scale; d1[3] = s13 * scale;
+                d2[0] = s20 * scale; d2[1] = s21 * scale; d2[2] = s22 * scale; d2[3] = s23 * scale;
+                d3[0] = s30 * scale; d3[1] = s31 * scale; d3[2] = s32 * scale; d3[3] = s33 * scale;
+            }
+        }
+
+        /* remaining part (edge of a or b) */
+        const int32_t i1 = (std::min)(a_num, i0 + BLOCK_SIZE);
+        for (int32_t i = i0; i < i1; i++) {
+            const T* ai = a + static_cast<size_t>(i) * a_stride;
+            for (int32_t j = j0; j < b_num; j++) {
+                const T* bj = b + static_cast<size_t>(j) * b_stride;
+                ACC sum = 0;
+#pragma omp simd reduction(+:sum)
+                for (int32_t k = 0; k < size; k++) sum += static_cast<ACC>(ai[k]) * bj[k];
+                dst[static_cast<size_t>(i) * dst_stride + j] = sum * scale;
+            }
+        }
+    }
+}
+
+void FeatureSimilarity::MultiplyTransposed(const float* a, int32_t a_num, int32_t a_stride, const float* b, int32_t b_num, int32_t b_stride, int32_t size, float* dst, int32_t dst_stride)
+{
+    MultiplyTransposedImpl<float, float>(a, a_num, a_stride, b, b_num, b_stride, size, dst, dst_stride, 1.0F);
+}
+
+void FeatureSimilarity::MultiplyTransposed(const int8_t* a, int32_t a_num, int32_t a_stride, const int8_t* b, int32_t b_num, int32_t b_stride, int32_t size, float* dst, int32_t dst_stride)
+{
+    MultiplyTransposedImpl<int8_t, int32_t>(a, a_num, a_stride, b, b_num, b_stride, size, dst, dst_stride, 1.0F / (kInt8Scale * kInt8Scale));
+}
@@ -0,0 +1,44 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef FEATURE_SIMILARITY_
+#define FEATURE_SIMILARITY_
+
+/* for general */
+#include <cstdint>
+
+/* Kernels for cosine similarity of appearance features (re-identification) */
+/*   features are L2-normalized once when they are stored, so cosine similarity is just a dot product */
+/*   similarities of many pairs are calculated as a matrix product A * B^T (rows of A and B are features) */
+/*   int8 version: normalized features are quantized with kInt8Scale (a half of the memory bandwidth of fp16, a quarter of fp32) */
+namespace FeatureSimilarity
+{
+
+constexpr float kInt8Scale = 127.0F;
+
+/* return false if the norm is 0 (dst is filled with 0) */
+bool NormalizeL2(const float* src, float* dst, int32_t size);
+void QuantizeInt8(const float* src_normalized, int8_t* dst, int32_t size);
+
+float Dot(const float* a, const float* b, int32_t size);
+float Dot(const int8_t* a, const int8_t* b, int32_t size);   /* already divided by kInt8Scale^2 */
+
+/* dst[i * dst_stride + j] = Dot(a + i * a_stride, b + j * b_stride)  (i < a_num, j < b_num) */
+/* register-blocked (4 x 4) and parallelized over rows of a when the matrix is large */
+void MultiplyTransposed(const float* a, int32_t a_num, int32_t a_stride, const float* b, int32_t b_num, int32_t b_stride, int32_t size, float* dst, int32_t dst_stride);
+void MultiplyTransposed(const int8_t* a, int32_t a_num, int32_t a_stride, const int8_t* b, int32_t b_num, int32_t b_stride, int32_t size, float* dst, int32_t dst_stride);
+
+}
+
+#endif
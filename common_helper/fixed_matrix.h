@@ -0,0 +1,174 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef FIXED_MATRIX_
+#define FIXED_MATRIX_
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <initializer_list>
+
+/* Small matrix with compile-time shape and inline storage (no heap allocation) */
+/*   loops have constant trip counts, so the compiler can unroll them */
+/*   unlike SimpleMatrix, the shape is checked at compile time and no expression is evaluated lazily */
+template<int32_t Rows, int32_t Cols, typename T = float>
+class FixedMatrix
+{
+public:
+    static constexpr int32_t kRows = Rows;
+    static constexpr int32_t kCols = Cols;
+
+    FixedMatrix()
+    {
+        for (int32_t i = 0; i < Rows * Cols; i++) data[i] = 0;
+    }
+
+    FixedMatrix(std::initializer_list<T> list)
+    {
+        int32_t i = 0;
+        for (const auto& v : list) {
+            if (i >= Rows * Cols) break;
+            data[i++] = v;
+        }
+        for (; i < Rows * Cols; i++) data[i] = 0;
+    }
+
+    T& operator() (int32_t y, int32_t x) { return data[y * Cols + x]; }
+    const T& operator() (int32_t y, int32_t x) const { return data[y * Cols + x]; }
+
+    FixedMatrix operator+ (const FixedMatrix& mat2) const
+    {
+        FixedMatrix ret;
+        for (int32_t i = 0; i < Rows * Cols; i++) ret.data[i] = data[i] + mat2.data[i];
+        return ret;
+    }
+
+    FixedMatrix operator- (const FixedMatrix& mat2) const
+    {
+        FixedMatrix ret;
+        for (int32_t i = 0; i < Rows * Cols; i++) ret.data[i] = data[i] - mat2.data[i];
+        return ret;
+    }
+
+    FixedMatrix operator* (const T& k) const
+    {
+        FixedMatrix ret;
+        for (int32_t i = 0; i < Rows * Cols; i++) ret.data[i] = data[i] * k;
+        return ret;
+    }
+
+    template<int32_t Cols2>
+    FixedMatrix<Rows, Cols2, T> operator* (const FixedMatrix<Cols, Cols2, T>& mat2) const
+    {
+        FixedMatrix<Rows, Cols2, T> ret;
+        for (int32_t y = 0; y < Rows; y++) {
+            for (int32_t x = 0; x < Cols2; x++) {
+                T sum = 0;
+                for (int32_t i = 0; i < Cols; i++) {
+                    sum += (*this)(y, i) * mat2(i, x);
+                }
+                ret(y, x) = sum;
+            }
+        }
+        return ret;
+    }
+
+    /* this * mat2^T without creating the transposed matrix */
+    template<int32_t Rows2>
+    FixedMatrix<Rows, Rows2, T> MultiplyTransposed(const FixedMatrix<Rows2, Cols, T>& mat2) const
+    {
+        FixedMatrix<Rows, Rows2, T> ret;
+        for (int32_t y = 0; y < Rows; y++) {
+            for (int32_t x = 0; x < Rows2; x++) {
+                T sum = 0;
+                for (int32_t i = 0; i < Cols; i++) {
+                    sum += (*this)(y, i) * mat2(x, i);
+                }
+                ret(y, x) = sum;
+            }
+        }
+        return ret;
+    }
+
+    FixedMatrix<Cols, Rows, T> Transpose() const
+    {
+        FixedMatrix<Cols, Rows, T> ret;
+        for (int32_t y = 0; y < Rows; y++) {
+            for (int32_t x = 0; x < Cols; x++) {
+                ret(x, y) = (*this)(y, x);
+            }
+        }
+        return ret;
+    }
+
+    void Display() const
+    {
+        for (int32_t y = 0; y < Rows; y++) {
+            for (int32_t x = 0; x < Cols; x++) {
+                printf("%f ", static_cast<double>((*this)(y, x)));
+            }
+            printf("\n");
+        }
+    }
+
+    static FixedMatrix IdentityMatrix()
+    {
+        FixedMatrix ret;
+        for (int32_t i = 0; i < (Rows < Cols ? Rows : Cols); i++) ret(i, i) = 1;
+        return ret;
+    }
+
+    T data[Rows * Cols];
+};
+
+
+/* Solve A * X = B for symmetric positive definite A using Cholesky decomposition (A = L * L^T) */
+/* return false if A is not positive definite */
+template<int32_t N, int32_t M, typename T>
+bool SolveCholesky(const FixedMatrix<N, N, T>& A, const FixedMatrix<N, M, T>& B, FixedMatrix<N, M, T>& X)
+{
+    FixedMatrix<N, N, T> L;
+    for (int32_t y = 0; y < N; y++) {
+        for (int32_t x = 0; x <= y; x++) {
+            T sum = A(y, x);
+            for (int32_t i = 0; i < x; i++) sum -= L(y, i) * L(x, i);
+            if (y == x) {
+                if (!(sum > 0)) return false;
+                L(y, y) = std::sqrt(sum);
+            } else {
+                L(y, x) = sum / L(x, x);
+            }
+        }
+    }
+
+    for (int32_t m = 0; m < M; m++) {
+        /* forward substitution: L * Y = B */
+        T y_list[N];
+        for (int32_t y = 0; y < N; y++) {
+            T sum = B(y, m);
+            for (int32_t i = 0; i < y; i++) sum -= L(y, i) * y_list[i];
+            y_list[y] = sum / L(y, y);
+        }
+        /* backward substitution: L^T * X = Y */
+        for (int32_t y = N - 1; y >= 0; y--) {
+            T sum = y_list[y];
+            for (int32_t i = y + 1; i < N; i++) sum -= L(i, y) * X(i, m);
+            X(y, m) = sum / L(y, y);
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,229 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+/* for My modules */
+#include "common_helper.h"
+#include "bounding_box.h"
+#include "golden_check.h"
+
+/*** Macro ***/
+#define TAG "GoldenCheck"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+static constexpr int32_t kBoundingBoxElementNum = 6;
+
+
+bool GoldenCheck::ReadBoundingBoxFile(const std::string& filename, std::vector<BoundingBox>& bbox_list)
+{
+    std::vector<float> data;
+    if (!ReadRawFile(filename, data)) return false;
+    bbox_list.clear();
+    for (size_t i = 0; i + kBoundingBoxElementNum <= data.size(); i += kBoundingBoxElementNum) {
+        BoundingBox bbox;
+        bbox.class_id = static_cast<int32_t>(data[i + 0]);
+        bbox.score = data[i + 1];
+        bbox.x = static_cast<int32_t>(data[i + 2]);
+        bbox.y = static_cast<int32_t>(data[i + 3]);
+        bbox.w = static_cast<int32_t>(data[i + 4]);
+        bbox.h = static_cast<int32_t>(data[i + 5]);
+        bbox_list.push_back(bbox);
+    }
+    return true;
+}
+
+bool GoldenCheck::WriteBoundingBoxFile(const std::string& filename, const std::vector<BoundingBox>& bbox_list)
+{
+    std::vector<float> data;
+    for (const auto& bbox : bbox_list) {
+        data.push_back(static_cast<float>(bbox.class_id));
+        data.push_back(bbox.score);
+        data.push_back(static_cast<float>(bbox.x));
+        data.push_back(static_cast<float>(bbox.y));
+        data.push_back(static_cast<float>(bbox.w));
+        data.push_back(static_cast<float>(bbox.h));
+    }
+    return WriteRawFile(filename, data);
+}
+
+GoldenCheck::CompareResult GoldenCheck::CompareTensor(const float* ref, const float* opt, size_t num, const Tolerance& tolerance)
+{
+    CompareResult result;
+    size_t index_worst = 0;
+    for (size_t i = 0; i < num; i++) {
+        double diff = std::abs(static_cast<double>(ref[i]) - opt[i]);
+        if (std::isnan(ref[i]) != std::isnan(opt[i])) diff = INFINITY;
+        if (diff > result.metric) {
+            result.metric = diff;
+            index_worst = i;
+        }
+    }
+    result.is_pass = result.metric <= tolerance.tensor_abs_diff_max;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "max abs diff = %g at %zu (tolerance = %g)", result.metric, index_worst, tolerance.tensor_abs_diff_max);
+    result.message = buffer;
+    return result;
+}
+
+GoldenCheck::CompareResult GoldenCheck::CompareBoundingBoxList(const std::vector<BoundingBox>& ref, const std::vector<BoundingBox>& opt, const Tolerance& tolerance)
+{
+    CompareResult result;
+    char buffer[256];
+    if (ref.size() != opt.size()) {
+        snprintf(buffer, sizeof(buffer), "box num mismatch: ref = %zu, opt = %zu", ref.size(), opt.size());
+        result.message = buffer;
+        return result;
+    }
+
+    /* the order of boxes doesn't matter. match each reference box with the best unmatched box */
+    std::vector<bool> is_matched(opt.size(), false);
+    double iou_min = 1.0;
+    double score_diff_max = 0;
+    int32_t label_mismatch_num = 0;
+    for (const auto& bbox_ref : ref) {
+        int32_t index_best = -1;
+        float iou_best = -1;
+        for (size_t i = 0; i < opt.size(); i++) {
+            if (is_matched[i]) continue;
+            if (tolerance.box_check_class_id && opt[i].class_id != bbox_ref.class_id) continue;
+            float iou = BoundingBoxUtils::CalculateIoU(bbox_ref, opt[i]);
+            if (iou > iou_best) {
+                iou_best = iou;
+                index_best = static_cast<int32_t>(i);
+            }
+        }
+        if (index_best < 0) {
+            label_mismatch_num++;
+            iou_min = 0;
+            continue;
+        }
+        is_matched[index_best] = true;
+        iou_min = (std::min)(iou_min, static_cast<double>(iou_best));
+        score_diff_max = (std::max)(score_diff_max, std::abs(static_cast<double>(bbox_ref.score) - opt[index_best].score));
+    }
+
+    result.metric = iou_min;
+    result.is_pass = label_mismatch_num == 0 && iou_min >= tolerance.box_iou_min && score_diff_max <= tolerance.box_score_diff_max;
+    snprintf(buffer, sizeof(buffer), "box num = %zu, min IoU = %.4f, max score diff = %g, label mismatch = %d", ref.size(), iou_min, score_diff_max, label_mismatch_num);
+    result.message = buffer;
+    return result;
+}
+
+GoldenCheck::CompareResult GoldenCheck::CompareLabelMap(const uint8_t* ref, const uint8_t* opt, size_t num, const Tolerance& tolerance)
+{
+    CompareResult result;
+    size_t agree_num = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (ref[i] == opt[i]) agree_num++;
+    }
+    result.metric = num > 0 ? static_cast<double>(agree_num) / num : 1.0;
+    result.is_pass = result.metric >= tolerance.pixel_agreement_min;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "pixel agreement = %.6f (%zu / %zu)", result.metric, agree_num, num);
+    result.message = buffer;
+    return result;
+}
+
+GoldenCheck::CompareResult GoldenCheck::CompareTrackIdSequence(const TrackIdSequence& ref, const TrackIdSequence& opt, const Tolerance& tolerance)
+{
+    CompareResult result;
+    char buffer[128];
+    if (ref.size() != opt.size()) {
+        snprintf(buffer, sizeof(buffer), "frame num mismatch: ref = %zu, opt = %zu", ref.size(), opt.size());
+        result.message = buffer;
+        return result;
+    }
+    /* ids are compared as sets because the order of the track list is implementation detail */
+    size_t agree_num = 0;
+    int32_t first_mismatch_frame = -1;
+    for (size_t frame = 0; frame < ref.size(); frame++) {
+        std::vector<int32_t> id_list_ref = ref[frame];
+        std::vector<int32_t> id_list_opt = opt[frame];
+        std::sort(id_list_ref.begin(), id_list_ref.end());
+        std::sort(id_list_opt.begin(), id_list_opt.end());
+        if (id_list_ref == id_list_opt) {
+            agree_num++;
+        } else if (first_mismatch_frame < 0) {
+            first_mismatch_frame = static_cast<int32_t>(frame);
+        }
+    }
+    result.metric = ref.size() > 0 ? static_cast<double>(agree_num) / ref.size() : 1.0;
+    result.is_pass = result.metric >= tolerance.track_agreement_min;
+    snprintf(buffer, sizeof(buffer), "frame agreement = %.4f (%zu / %zu), first mismatch = %d", result.metric, agree_num, ref.size(), first_mismatch_frame);
+    result.message = buffer;
+    return result;
+}
+
+
+void GoldenCheck::Harness::AddCase(const std::string& name, std::function<void()> func_reference, std::function<void()> func_optimized, std::function<CompareResult()> func_compare)
+{
+    Case c;
+    c.name = name;
+    c.func_reference = func_reference;
+    c.func_optimized = func_optimized;
+    c.func_compare = func_compare;
+    case_list_.push_back(c);
+}
+
+double GoldenCheck::Harness::MeasureTime(const std::function<void()>& func) const
+{
+    std::vector<double> time_list;
+    for (int32_t i = 0; i < (std::max)(1, loop_num_); i++) {
+        const auto& t0 = std::chrono::steady_clock::now();
+        func();
+        const auto& t1 = std::chrono::steady_clock::now();
+        time_list.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    std::sort(time_list.begin(), time_list.end());
+    return time_list[time_list.size() / 2];
+}
+
+int32_t GoldenCheck::Harness::Run(const std::string& filter)
+{
+    int32_t fail_num = 0;
+    report_list_.clear();
+    for (const auto& c : case_list_) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+        Report report;
+        report.name = c.name;
+        /* the output of the last loop is compared. each function must produce the same output every time */
+        report.time_reference = MeasureTime(c.func_reference);
+        report.time_optimized = MeasureTime(c.func_optimized);
+        report.speedup = report.time_optimized > 0 ? report.time_reference / report.time_optimized : 0;
+        report.result = c.func_compare();
+        if (!report.result.is_pass) fail_num++;
+        report_list_.push_back(report);
+    }
+    return fail_num;
+}
+
+void GoldenCheck::Harness::PrintReport() const
+{
+    printf("=== Golden check ===\n");
+    printf("%-24s %-4s %12s %12s %8s  %s\n", "case", "", "ref [msec]", "opt [msec]", "speedup", "detail");
+    for (const auto& report : report_list_) {
+        printf("%-24s %-4s %12.4f %12.4f %7.2fx  %s\n", report.name.c_str(), report.result.is_pass ? "OK" : "NG",
+            report.time_reference, report.time_optimized, report.speedup, report.result.message.c_str());
+    }
+}
@@ -0,0 +1,136 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef GOLDEN_CHECK_
+#define GOLDEN_CHECK_
+
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <functional>
+
+/* for My modules */
+#include "bounding_box.h"
+
+
+/* Golden-output equivalence check for optimized kernels */
+/*   runs a reference implementation and an optimized implementation on the same recorded input, */
+/*   compares the outputs within tolerances and reports the speedup */
+/*   recorded inputs are raw binary files (no header, native endian) so that no model is needed */
+namespace GoldenCheck
+{
+
+typedef struct Tolerance_ {
+    float tensor_abs_diff_max;      /* max |ref - opt| for each element */
+    float box_iou_min;              /* min IoU between corresponding boxes */
+    float box_score_diff_max;       /* max |ref - opt| of score */
+    bool  box_check_class_id;       /* labels must be equal */
+    float pixel_agreement_min;      /* min ratio of pixels having the same label */
+    float track_agreement_min;      /* min ratio of frames having the same track id sequence */
+    Tolerance_()
+        : tensor_abs_diff_max(1e-4F), box_iou_min(0.99F), box_score_diff_max(1e-4F), box_check_class_id(true),
+        pixel_agreement_min(0.999F), track_agreement_min(1.0F)
+    {}
+} Tolerance;
+
+typedef struct CompareResult_ {
+    bool        is_pass;
+    double      metric;     /* the worst value of the checked metric (e.g. max abs diff, min IoU, agreement ratio) */
+    std::string message;
+    CompareResult_() : is_pass(false), metric(0)
+    {}
+} CompareResult;
+
+/* per frame list of track ids in the order of the track list */
+typedef std::vector<std::vector<int32_t>> TrackIdSequence;
+
+
+template<typename T>
+bool ReadRawFile(const std::string& filename, std::vector<T>& data)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data.resize(static_cast<size_t>(size) / sizeof(T));
+    size_t read_num = fread(data.data(), sizeof(T), data.size(), fp);
+    fclose(fp);
+    return read_num == data.size();
+}
+
+template<typename T>
+bool WriteRawFile(const std::string& filename, const std::vector<T>& data)
+{
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp) return false;
+    size_t write_num = fwrite(data.data(), sizeof(T), data.size(), fp);
+    fclose(fp);
+    return write_num == data.size();
+}
+
+/* a box list is stored as float[N][6] = (class_id, score, x, y, w, h) */
+bool ReadBoundingBoxFile(const std::string& filename, std::vector<BoundingBox>& bbox_list);
+bool WriteBoundingBoxFile(const std::string& filename, const std::vector<BoundingBox>& bbox_list);
+
+CompareResult CompareTensor(const float* ref, const float* opt, size_t num, const Tolerance& tolerance);
+CompareResult CompareBoundingBoxList(const std::vector<BoundingBox>& ref, const std::vector<BoundingBox>& opt, const Tolerance& tolerance);
+CompareResult CompareLabelMap(const uint8_t* ref, const uint8_t* opt, size_t num, const Tolerance& tolerance);
+CompareResult CompareTrackIdSequence(const TrackIdSequence& ref, const TrackIdSequence& opt, const Tolerance& tolerance);
+
+
+/* usage: */
+/*   harness.AddCase("nms", [&] { Reference(input, out_ref); }, [&] { Optimized(input, out_opt); }, */
+/*       [&] { return GoldenCheck::CompareBoundingBoxList(out_ref, out_opt, tolerance); }); */
+/*   int32_t fail_num = harness.Run(); */
+class Harness {
+public:
+    typedef struct Report_ {
+        std::string   name;
+        CompareResult result;
+        double        time_reference;   /* [msec] median of loops */
+        double        time_optimized;   /* [msec] median of loops */
+        double        speedup;
+    } Report;
+
+public:
+    Harness(int32_t loop_num = 10) : loop_num_(loop_num) {}
+    ~Harness() {}
+
+    void AddCase(const std::string& name, std::function<void()> func_reference, std::function<void()> func_optimized, std::function<CompareResult()> func_compare);
+    int32_t Run(const std::string& filter = "");    /* run cases whose name contains filter. return the number of failed cases */
+    const std::vector<Report>& GetReportList() const { return report_list_; }
+    void PrintReport() const;
+
+private:
+    typedef struct Case_ {
+        std::string name;
+        std::function<void()> func_reference;
+        std::function<void()> func_optimized;
+        std::function<CompareResult()> func_compare;
+    } Case;
+
+    double MeasureTime(const std::function<void()>& func) const;
+
+private:
+    int32_t loop_num_;
+    std::vector<Case> case_list_;
+    std::vector<Report> report_list_;
+};
+
+}
+
+#endif
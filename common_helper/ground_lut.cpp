@@ -0,0 +1,216 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "ground_lut.h"
+#include "simd_helper.h"
+
+/*** Macro ***/
+/* the number of points to use multi threads */
+#define PARALLEL_THRESHOLD 4096
+/* the number of points processed at once */
+#define BLOCK_SIZE 64
+
+/* (Xw * w, Zw * w, w, padding). padded so that a node is read with one vector */
+static constexpr int32_t kTableDim = 4;
+
+
+GroundLut::GroundLut()
+    : width_(0), height_(0), grid_step_(1), is_direct_(false), col_num_(0), row_num_(0), row_start_(0)
+{
+    /* never matches, so the table is created at the first Update */
+    std::fill(intrinsic_key_, intrinsic_key_ + 9, std::nanf(""));
+    std::fill(H_key_, H_key_ + 9, std::nanf(""));
+}
+
+GroundLut::~GroundLut()
+{
+}
+
+bool GroundLut::Update(const CameraProjection& projection, int32_t width, int32_t height, int32_t grid_step)
+{
+    if (width <= 0 || height <= 0 || grid_step <= 0) return false;
+
+    float intrinsic_key[9];
+    projection.GetIntrinsic(intrinsic_key[0], intrinsic_key[1], intrinsic_key[2], intrinsic_key[3]);
+    std::copy(projection.GetDistortion(), projection.GetDistortion() + 5, intrinsic_key + 4);
+    const bool is_intrinsic_changed = width != width_ || height != height_ || grid_step != grid_step_
+        || std::memcmp(intrinsic_key, intrinsic_key_, sizeof(intrinsic_key)) != 0;
+    const bool is_extrinsic_changed = std::memcmp(projection.GetGroundHomographyInv(), H_key_, sizeof(H_key_)) != 0;
+    if (!is_intrinsic_changed && !is_extrinsic_changed) return false;
+
+    if (is_intrinsic_changed) {
+        width_ = width;
+        height_ = height;
+        grid_step_ = grid_step;
+        std::copy(intrinsic_key, intrinsic_key + 9, intrinsic_key_);
+        is_direct_ = !projection.HasDistortion();
+        UpdateNode(projection);
+    }
+    UpdateTable(projection);
+    return true;
+}
+
+void GroundLut::UpdateNode(const CameraProjection& projection)
+{
+    /* nodes cover the whole image (the last node is at or beyond the edge) */
+    col_num_ = (width_ + grid_step_ - 1) / grid_step_ + 1;
+    row_num_ = (height_ + grid_step_ - 1) / grid_step_ + 1;
+    if (is_direct_) {
+        /* the homography itself is used */
+        node_.clear();
+        return;
+    }
+    node_.resize(static_cast<size_t>(col_num_) * row_num_ * 2);
+    for (int32_t y = 0; y < row_num_; y++) {
+        for (int32_t x = 0; x < col_num_; x++) {
+            node_[(static_cast<size_t>(y) * col_num_ + x) * 2 + 0] = static_cast<float>(x * grid_step_);
+            node_[(static_cast<size_t>(y) * col_num_ + x) * 2 + 1] = static_cast<float>(y * grid_step_);
+        }
+    }
+    projection.Undistort(node_.data(), col_num_ * row_num_, node_.data());
+}
+
+void GroundLut::UpdateTable(const CameraProjection& projection)
+{
+    const float* H = projection.GetGroundHomographyInv();
+    std::copy(H, H + 9, H_key_);
+    if (is_direct_) {
+        table_.clear();
+        return;
+    }
+
+    const int32_t node_num = col_num_ * row_num_;
+    table_.resize(static_cast<size_t>(node_num) * kTableDim);
+    const float* node = node_.data();
+    float* table = table_.data();
+#pragma omp simd
+    for (int32_t i = 0; i < node_num; i++) {
+        const float x = node[i * 2 + 0];
+        const float y = node[i * 2 + 1];
+        table[i * kTableDim + 0] = H[0] * x + H[1] * y + H[2];
+        table[i * kTableDim + 1] = H[3] * x + H[4] * y + H[5];
+        table[i * kTableDim + 2] = H[6] * x + H[7] * y + H[8];
+        table[i * kTableDim + 3] = 0;
+    }
+
+    /* rows above the horizon are not used. the cell just above the first row with the ground may include the horizon */
+    /* (the horizon is found from the table itself, so roll and distortion are considered unlike CameraModel::EstimateVanishmentY) */
+    row_start_ = row_num_;
+    for (int32_t y = 0; y < row_num_ && row_start_ == row_num_; y++) {
+        for (int32_t x = 0; x < col_num_; x++) {
+            if (table_[(static_cast<size_t>(y) * col_num_ + x) * kTableDim + 2] > 0) {
+                row_start_ = (std::max)(y - 1, 0);
+                break;
+            }
+        }
+    }
+}
+
+void GroundLut::Image2GroundPlane(const float* image_point, int32_t num, float* object_point) const
+{
+    constexpr float kInvalid = CameraProjection::kInvalidGround;
+    if (!IsInitialized() || (!is_direct_ && row_start_ > row_num_ - 2)) {
+        /* not initialized, or no ground in the image */
+        std::fill(object_point, object_point + static_cast<size_t>(num) * 3, kInvalid);
+        return;
+    }
+
+    /* index calculation and division are vectorized, and only the table read (gather) is done point by point */
+    /* without distortion, the homography is calculated directly because it's cheaper than reading the table (and exact) */
+    const float step_inv = 1.0F / grid_step_;
+    const float* table = table_.data();
+    const int32_t block_num = (num + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for if (num > PARALLEL_THRESHOLD)
+    for (int32_t block = 0; block < block_num; block++) {
+        const int32_t i0 = block * BLOCK_SIZE;
+        const int32_t n = (std::min)(BLOCK_SIZE, num - i0);
+        const bool is_direct = is_direct_;
+        const int32_t col_num = col_num_;
+        const int32_t row_start = row_start_;
+        const int32_t row_end = row_num_ - 2;
+        const float* src = image_point + static_cast<size_t>(i0) * 2;
+        float* dst = object_point + static_cast<size_t>(i0) * 3;
+        float gx[BLOCK_SIZE], gy[BLOCK_SIZE];
+        int32_t offset[BLOCK_SIZE];
+        float ax[BLOCK_SIZE], ay[BLOCK_SIZE];
+        float vx[BLOCK_SIZE], vz[BLOCK_SIZE], vw[BLOCK_SIZE];     /* interpolated (Xw * w, Zw * w, w) */
+        float dst_x[BLOCK_SIZE], dst_z[BLOCK_SIZE], dst_valid[BLOCK_SIZE];
+
+        for (int32_t i = 0; i < n; i++) {
+            gx[i] = src[i * 2 + 0] * step_inv;
+            gy[i] = src[i * 2 + 1] * step_inv;
+        }
+
+        if (is_direct) {
+            const float* H = H_key_;
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) {
+                const float x = src[i * 2 + 0];
+                const float y = src[i * 2 + 1];
+                vx[i] = H[0] * x + H[1] * y + H[2];
+                vz[i] = H[3] * x + H[4] * y + H[5];
+                vw[i] = H[6] * x + H[7] * y + H[8];
+            }
+        } else {
+            /* points out of the table (above the horizon, out of the image) are extrapolated from the nearest cell */
+            /* floor is done by truncation of a biased value, and clamp is done on int, so that the loop is vectorized */
+#pragma omp simd
+            for (int32_t i = 0; i < n; i++) {
+                const int32_t ix = (std::min)((std::max)(SimdHelper::FloorBiased(gx[i]), 0), col_num - 2);
+                const int32_t iy = (std::min)((std::max)(SimdHelper::FloorBiased(gy[i]), row_start), row_end);
+                ax[i] = gx[i] - ix;
+                ay[i] = gy[i] - iy;
+                offset[i] = (iy * col_num + ix) * kTableDim;
+            }
+
+            for (int32_t i = 0; i < n; i++) {
+                const float* t00 = table + offset[i];
+                const float* t10 = t00 + col_num * kTableDim;
+                float v[kTableDim];
+                for (int32_t k = 0; k < kTableDim; k++) {
+                    const float top = t00[k] + (t00[k + kTableDim] - t00[k]) * ax[i];
+                    const float bottom = t10[k] + (t10[k + kTableDim] - t10[k]) * ax[i];
+                    v[k] = top + (bottom - top) * ay[i];
+                }
+                vx[i] = v[0];
+                vz[i] = v[1];
+                vw[i] = v[2];
+            }
+        }
+
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const float w = vw[i];  /* w > 0 if the ray hits the ground in front of the camera */
+            const float w_inv = 1 / w;
+            dst_x[i] = SimdHelper::SelectIfPositive(w, vx[i] * w_inv, kInvalid);
+            dst_z[i] = SimdHelper::SelectIfPositive(w, vz[i] * w_inv, kInvalid);
+            dst_valid[i] = SimdHelper::SelectIfPositive(w, 0.0F, kInvalid);
+        }
+
+        for (int32_t i = 0; i < n; i++) {
+            dst[i * 3 + 0] = dst_x[i];
+            dst[i * 3 + 1] = dst_valid[i];
+            dst[i * 3 + 2] = dst_z[i];
+        }
+    }
+}
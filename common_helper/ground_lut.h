@@ -0,0 +1,68 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef GROUND_LUT_
+#define GROUND_LUT_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "camera_projection.h"
+
+/* Lookup table of image -> ground plane (the same result as CameraProjection::Image2GroundPlane) */
+/*   the table is a grid of nodes at every grid_step pixels, and a point is bilinearly interpolated from 4 nodes */
+/*   a node holds the homogeneous ground point (Xw * w, Zw * w, w), not (Xw, Zw): */
+/*     it's linear in the undistorted image, so the interpolation is exact without distortion and good near the horizon */
+/*   the undistorted position of each node (iterative, expensive) depends only on the intrinsic parameters and is kept, */
+/*   so when only the camera pose (pitch, yaw, etc.) changes, the table is rebuilt with one 3x3 product per node */
+/*   rows far above the horizon (no ground) are skipped in the query */
+/*   without distortion, the table is not created and the homography is used directly (it's exact and cheaper than the table) */
+class GroundLut {
+public:
+    GroundLut();
+    ~GroundLut();
+
+    /* rebuild the table if the parameters are changed. return true if rebuilt */
+    bool Update(const CameraProjection& projection, int32_t width, int32_t height, int32_t grid_step = 8);
+
+    /* image -> Mw on the ground plane (Yw = 0). points which don't hit the ground in front of the camera are kInvalidGround */
+    void Image2GroundPlane(const float* image_point, int32_t num, float* object_point) const;
+
+    bool IsInitialized() const { return col_num_ > 0; }
+    int32_t GetRowStart() const { return row_start_ * grid_step_; }    /* [px]. the first row of the table with the ground */
+
+private:
+    void UpdateNode(const CameraProjection& projection);
+    void UpdateTable(const CameraProjection& projection);
+
+private:
+    /* parameters */
+    int32_t width_;
+    int32_t height_;
+    int32_t grid_step_;
+    bool is_direct_;            /* no distortion. the homography is used instead of the table */
+    float intrinsic_key_[9];    /* fx, fy, cx, cy, dist[5] used to create node_ */
+    float H_key_[9];            /* the ground plane homography used to create table_ */
+
+    /* table */
+    int32_t col_num_;
+    int32_t row_num_;
+    int32_t row_start_;             /* the first row of the grid used for the query */
+    std::vector<float> node_;       /* [row_num][col_num][2]. undistorted image position of each node */
+    std::vector<float> table_;      /* [row_num][col_num][4]. (Xw * w, Zw * w, w, padding) */
+};
+
+#endif
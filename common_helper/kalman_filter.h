@@ -56,11 +56,12 @@ public:
 
     void Update(const SimpleMatrix& Z)
     {
-        SimpleMatrix S = (H * P) * H.Transpose() + R;
-        SimpleMatrix K = P * H.Transpose() * S.Inverse();
-        SimpleMatrix e = Z - H * X;
-        X = X + K * e;
-        P = (SimpleMatrix::IdentityMatrix(K.rows) - (K * H)) * P;
+        /* K = P * H^T * S^-1 is calculated as K^T = S^-1 * (H * P) without inverse (S and P are symmetric) */
+        SimpleMatrix::Multiply(H, P, HP);
+        S = HP * H.Transpose() + R;
+        K = S.SolveCholesky(HP).Transpose();
+        X += K * (Z - H * X);
+        P -= K * HP;    /* = (I - K * H) * P */
     }
 
 
@@ -84,6 +85,11 @@ public:
     SimpleMatrix X;
     SimpleMatrix P;
 
+private:
+    /* reused at every update */
+    SimpleMatrix HP;
+    SimpleMatrix S;
+    SimpleMatrix K;
 };
 
 
@@ -0,0 +1,355 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef KALMAN_FILTER_BATCH_H_
+#define KALMAN_FILTER_BATCH_H_
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "kalman_filter_fixed.h"
+
+
+/* Kalman filters of many objects sharing the same model (F, Q, H, R) */
+/*   status and covariance are stored in structure-of-arrays form: element (i, j) of all filters is contiguous */
+/*   Predict() / Update() process all filters at once. the innermost loops run across filters so that they are vectorized, */
+/*   and blocks of filters are processed in parallel with OpenMP when the number of filters is large */
+/*   the index of a filter is its position. Remove() keeps the order of the remaining filters */
+/*   alternatively, an index can be reused with Set() without removing (filters of unused indices are just predicted) */
+template<int32_t NState, int32_t NObserve, typename T = float>
+class KalmanFilterBatch {
+public:
+    typedef KalmanFilterFixed<NState, NObserve, T> KalmanFilterSingle;
+    typedef typename KalmanFilterSingle::MatrixStatus        MatrixStatus;
+    typedef typename KalmanFilterSingle::MatrixObserve       MatrixObserve;
+    typedef typename KalmanFilterSingle::MatrixObserveStatus MatrixObserveStatus;
+    typedef typename KalmanFilterSingle::VectorStatus        VectorStatus;
+    typedef typename KalmanFilterSingle::VectorObserve       VectorObserve;
+
+    static constexpr int32_t kBlockSize = 64;               /* number of filters processed with stack temporaries at once */
+    static constexpr int32_t kParallelThreshold = 1024;     /* use OpenMP when the number of filters exceeds this */
+
+public:
+    KalmanFilterBatch() : size_(0), capacity_(0), is_model_set_(false) {}
+    ~KalmanFilterBatch() {}
+
+    /* the model (F, Q, H, R) of the first filter is used for all filters */
+    int32_t Add(const KalmanFilterSingle& kf)
+    {
+        if (!is_model_set_) {
+            F_ = kf.F;
+            Q_ = kf.Q;
+            H_ = kf.H;
+            R_ = kf.R;
+            is_model_set_ = true;
+        }
+        if (size_ >= capacity_) Reserve((std::max)(kBlockSize, capacity_ * 2));
+        const int32_t index = size_++;
+        Set(index, kf);
+        return index;
+    }
+
+    /* overwrite the status of the existing filter (e.g. to reuse the index of a removed object) */
+    void Set(int32_t index, const KalmanFilterSingle& kf)
+    {
+        for (int32_t i = 0; i < NState; i++) x_[i * capacity_ + index] = kf.X.data[i];
+        for (int32_t i = 0; i < NState * NState; i++) p_[i * capacity_ + index] = kf.P.data[i];
+        mask_[index] = 0;
+    }
+
+    /* remove filters whose flag is true. the order of the remaining filters is kept */
+    void Remove(const std::vector<bool>& is_remove_list)
+    {
+        int32_t dst = 0;
+        for (int32_t src = 0; src < size_; src++) {
+            if (src < static_cast<int32_t>(is_remove_list.size()) && is_remove_list[src]) continue;
+            if (dst != src) {
+                for (int32_t i = 0; i < NState; i++) x_[i * capacity_ + dst] = x_[i * capacity_ + src];
+                for (int32_t i = 0; i < NState * NState; i++) p_[i * capacity_ + dst] = p_[i * capacity_ + src];
+                for (int32_t i = 0; i < NObserve; i++) z_[i * capacity_ + dst] = z_[i * capacity_ + src];
+                mask_[dst] = mask_[src];
+            }
+            dst++;
+        }
+        size_ = dst;
+    }
+
+    void Clear() { size_ = 0; }
+    int32_t GetSize() const { return size_; }
+
+    VectorStatus GetStatus(int32_t index) const
+    {
+        VectorStatus X;
+        for (int32_t i = 0; i < NState; i++) X.data[i] = x_[i * capacity_ + index];
+        return X;
+    }
+
+    MatrixStatus GetCovariance(int32_t index) const
+    {
+        MatrixStatus P;
+        for (int32_t i = 0; i < NState * NState; i++) P.data[i] = p_[i * capacity_ + index];
+        return P;
+    }
+
+    /* set the observation of the filter. it is applied at the next Update() */
+    void SetObservation(int32_t index, const VectorObserve& Z)
+    {
+        for (int32_t i = 0; i < NObserve; i++) z_[i * capacity_ + index] = Z.data[i];
+        mask_[index] = 1;
+    }
+
+    void Predict()
+    {
+        const int32_t block_num = (size_ + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel for if (size_ > kParallelThreshold)
+        for (int32_t block = 0; block < block_num; block++) {
+            PredictBlock(block * kBlockSize, (std::min)(size_, (block + 1) * kBlockSize));
+        }
+    }
+
+    void Predict(int32_t index)
+    {
+        PredictBlock(index, index + 1);
+    }
+
+    /* update the filters which have the observation set by SetObservation() */
+    void Update()
+    {
+        const int32_t block_num = (size_ + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel for if (size_ > kParallelThreshold)
+        for (int32_t block = 0; block < block_num; block++) {
+            UpdateBlock(block * kBlockSize, (std::min)(size_, (block + 1) * kBlockSize));
+        }
+    }
+
+    void Update(int32_t index, const VectorObserve& Z)
+    {
+        SetObservation(index, Z);
+        UpdateBlock(index, index + 1);
+    }
+
+private:
+    void Reserve(int32_t capacity)
+    {
+        std::vector<T> x(static_cast<size_t>(NState) * capacity);
+        std::vector<T> p(static_cast<size_t>(NState) * NState * capacity);
+        std::vector<T> z(static_cast<size_t>(NObserve) * capacity);
+        std::vector<T> mask(capacity);
+        for (int32_t t = 0; t < size_; t++) {
+            for (int32_t i = 0; i < NState; i++) x[i * capacity + t] = x_[i * capacity_ + t];
+            for (int32_t i = 0; i < NState * NState; i++) p[i * capacity + t] = p_[i * capacity_ + t];
+            for (int32_t i = 0; i < NObserve; i++) z[i * capacity + t] = z_[i * capacity_ + t];
+            mask[t] = mask_[t];
+        }
+        x_.swap(x);
+        p_.swap(p);
+        z_.swap(z);
+        mask_.swap(mask);
+        capacity_ = capacity;
+    }
+
+    /* X = F * X,  P = F * P * F^T + Q  for filters [t0, t1) */
+    void PredictBlock(int32_t t0, int32_t t1)
+    {
+        const int32_t n = t1 - t0;
+        T x_new[NState][kBlockSize];
+        T fp[NState * NState][kBlockSize];
+
+        for (int32_t i = 0; i < NState; i++) {
+            for (int32_t t = 0; t < n; t++) x_new[i][t] = 0;
+            for (int32_t k = 0; k < NState; k++) {
+                const T f = F_(i, k);
+                if (f == 0) continue;   /* F of a motion model is sparse */
+                const T* x = &x_[k * capacity_ + t0];
+                for (int32_t t = 0; t < n; t++) x_new[i][t] += f * x[t];
+            }
+        }
+        for (int32_t i = 0; i < NState; i++) {
+            T* x = &x_[i * capacity_ + t0];
+            for (int32_t t = 0; t < n; t++) x[t] = x_new[i][t];
+        }
+
+        for (int32_t i = 0; i < NState; i++) {
+            for (int32_t j = 0; j < NState; j++) {
+                T* dst = fp[i * NState + j];
+                for (int32_t t = 0; t < n; t++) dst[t] = 0;
+                for (int32_t k = 0; k < NState; k++) {
+                    const T f = F_(i, k);
+                    if (f == 0) continue;
+                    const T* p = &p_[(k * NState + j) * capacity_ + t0];
+                    for (int32_t t = 0; t < n; t++) dst[t] += f * p[t];
+                }
+            }
+        }
+        for (int32_t i = 0; i < NState; i++) {
+            for (int32_t j = 0; j < NState; j++) {
+                T* p = &p_[(i * NState + j) * capacity_ + t0];
+                const T q = Q_(i, j);
+                for (int32_t t = 0; t < n; t++) p[t] = q;
+                for (int32_t k = 0; k < NState; k++) {
+                    const T f = F_(j, k);
+                    if (f == 0) continue;
+                    const T* src = fp[i * NState + k];
+                    for (int32_t t = 0; t < n; t++) p[t] += src[t] * f;
+                }
+            }
+        }
+    }
+
+    /* same calculation as KalmanFilterFixed::Update for filters [t0, t1) whose mask is set */
+    void UpdateBlock(int32_t t0, int32_t t1)
+    {
+        const int32_t n = t1 - t0;
+        T hp[NObserve * NState][kBlockSize];
+        T l[NObserve * NObserve][kBlockSize];
+        T kt[NObserve * NState][kBlockSize];
+        T e[NObserve][kBlockSize];
+        T valid[kBlockSize];
+        const T* mask = &mask_[t0];
+
+        /* HP = H * P */
+        for (int32_t o = 0; o < NObserve; o++) {
+            for (int32_t j = 0; j < NState; j++) {
+                T* dst = hp[o * NState + j];
+                for (int32_t t = 0; t < n; t++) dst[t] = 0;
+                for (int32_t k = 0; k < NState; k++) {
+                    const T h = H_(o, k);
+                    if (h == 0) continue;
+                    const T* p = &p_[(k * NState + j) * capacity_ + t0];
+                    for (int32_t t = 0; t < n; t++) dst[t] += h * p[t];
+                }
+            }
+        }
+
+        /* S = HP * H^T + R, then Cholesky decomposition S = L * L^T (in place, lower triangle) */
+        for (int32_t o = 0; o < NObserve; o++) {
+            for (int32_t q = 0; q <= o; q++) {
+                T* s = l[o * NObserve + q];
+                const T r = R_(o, q);
+                for (int32_t t = 0; t < n; t++) s[t] = r;
+                for (int32_t k = 0; k < NState; k++) {
+                    const T h = H_(q, k);
+                    if (h == 0) continue;
+                    const T* src = hp[o * NState + k];
+                    for (int32_t t = 0; t < n; t++) s[t] += src[t] * h;
+                }
+            }
+        }
+        for (int32_t t = 0; t < n; t++) valid[t] = mask[t];
+        for (int32_t y = 0; y < NObserve; y++) {
+            for (int32_t x = 0; x <= y; x++) {
+                T* dst = l[y * NObserve + x];
+                for (int32_t i = 0; i < x; i++) {
+                    const T* ly = l[y * NObserve + i];
+                    const T* lx = l[x * NObserve + i];
+                    for (int32_t t = 0; t < n; t++) dst[t] -= ly[t] * lx[t];
+                }
+                if (y == x) {
+                    for (int32_t t = 0; t < n; t++) {
+                        /* not positive definite: the filter is not updated */
+                        valid[t] = dst[t] > 0 ? valid[t] : 0;
+                        dst[t] = std::sqrt(dst[t] > 0 ? dst[t] : 1);
+                    }
+                } else {
+                    const T* lxx = l[x * NObserve + x];
+                    for (int32_t t = 0; t < n; t++) dst[t] /= lxx[t];
+                }
+            }
+        }
+
+        /* S * K^T = HP  (forward and backward substitution for each column) */
+        for (int32_t j = 0; j < NState; j++) {
+            for (int32_t y = 0; y < NObserve; y++) {
+                T* dst = kt[y * NState + j];
+                const T* b = hp[y * NState + j];
+                for (int32_t t = 0; t < n; t++) dst[t] = b[t];
+                for (int32_t i = 0; i < y; i++) {
+                    const T* lyi = l[y * NObserve + i];
+                    const T* src = kt[i * NState + j];
+                    for (int32_t t = 0; t < n; t++) dst[t] -= lyi[t] * src[t];
+                }
+                const T* lyy = l[y * NObserve + y];
+                for (int32_t t = 0; t < n; t++) dst[t] /= lyy[t];
+            }
+            for (int32_t y = NObserve - 1; y >= 0; y--) {
+                T* dst = kt[y * NState + j];
+                for (int32_t i = y + 1; i < NObserve; i++) {
+                    const T* liy = l[i * NObserve + y];
+                    const T* src = kt[i * NState + j];
+                    for (int32_t t = 0; t < n; t++) dst[t] -= liy[t] * src[t];
+                }
+                const T* lyy = l[y * NObserve + y];
+                for (int32_t t = 0; t < n; t++) dst[t] /= lyy[t];
+            }
+        }
+
+        /* e = Z - H * X. masked out filters get e = 0 and K = 0, so that X and P are not changed */
+        for (int32_t o = 0; o < NObserve; o++) {
+            const T* z = &z_[o * capacity_ + t0];
+            for (int32_t t = 0; t < n; t++) e[o][t] = z[t];
+            for (int32_t k = 0; k < NState; k++) {
+                const T h = H_(o, k);
+                if (h == 0) continue;
+                const T* x = &x_[k * capacity_ + t0];
+                for (int32_t t = 0; t < n; t++) e[o][t] -= h * x[t];
+            }
+            for (int32_t t = 0; t < n; t++) e[o][t] *= valid[t];
+        }
+        for (int32_t i = 0; i < NObserve * NState; i++) {
+            for (int32_t t = 0; t < n; t++) kt[i][t] *= valid[t];
+        }
+
+        /* X = X + K * e,  P = P - K * HP */
+        for (int32_t i = 0; i < NState; i++) {
+            T* x = &x_[i * capacity_ + t0];
+            for (int32_t o = 0; o < NObserve; o++) {
+                const T* k = kt[o * NState + i];
+                for (int32_t t = 0; t < n; t++) x[t] += k[t] * e[o][t];
+            }
+        }
+        for (int32_t i = 0; i < NState; i++) {
+            for (int32_t j = 0; j < NState; j++) {
+                T* p = &p_[(i * NState + j) * capacity_ + t0];
+                for (int32_t o = 0; o < NObserve; o++) {
+                    const T* k = kt[o * NState + i];
+                    const T* src = hp[o * NState + j];
+                    for (int32_t t = 0; t < n; t++) p[t] -= k[t] * src[t];
+                }
+            }
+        }
+
+        for (int32_t t = 0; t < n; t++) mask_[t0 + t] = 0;
+    }
+
+private:
+    MatrixStatus        F_;
+    MatrixStatus        Q_;
+    MatrixObserveStatus H_;
+    MatrixObserve       R_;
+
+    std::vector<T> x_;      /* [NState][capacity] */
+    std::vector<T> p_;      /* [NState * NState][capacity] */
+    std::vector<T> z_;      /* [NObserve][capacity] */
+    std::vector<T> mask_;   /* [capacity] 1 = observation is set */
+    int32_t size_;
+    int32_t capacity_;
+    bool is_model_set_;
+};
+
+template<int32_t NState, int32_t NObserve, typename T>
+constexpr int32_t KalmanFilterBatch<NState, NObserve, T>::kBlockSize;  // for link error in Android Studio (clang)
+
+#endif
@@ -0,0 +1,97 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef KALMAN_FILTER_FIXED_H_
+#define KALMAN_FILTER_FIXED_H_
+
+#include <cstdint>
+
+#include "fixed_matrix.h"
+
+
+/* Kalman filter with compile-time dimensions */
+/*   same model as KalmanFilter, but all matrices are FixedMatrix (stack / inline storage) */
+/*   and the gain is calculated by Cholesky solve instead of the explicit inverse of S */
+template<int32_t NState, int32_t NObserve, typename T = float>
+class KalmanFilterFixed {
+public:
+    typedef FixedMatrix<NState, NState, T>   MatrixStatus;
+    typedef FixedMatrix<NObserve, NObserve, T> MatrixObserve;
+    typedef FixedMatrix<NObserve, NState, T> MatrixObserveStatus;
+    typedef FixedMatrix<NState, 1, T>        VectorStatus;
+    typedef FixedMatrix<NObserve, 1, T>      VectorObserve;
+
+public:
+    KalmanFilterFixed() {}
+    ~KalmanFilterFixed() {}
+
+    void Initialize(
+        const MatrixStatus& _F,
+        const MatrixStatus& _Q,
+        const MatrixObserveStatus& _H,
+        const MatrixObserve& _R,
+        const VectorStatus& _X,
+        const MatrixStatus& _P
+    )
+    {
+        F = _F;
+        Q = _Q;
+        H = _H;
+        R = _R;
+        X = _X;
+        P = _P;
+    }
+
+    void Predict()
+    {
+        X = F * X;
+        P = (F * P).MultiplyTransposed(F) + Q;
+    }
+
+    /* return false if S is not positive definite (the status is not updated) */
+    bool Update(const VectorObserve& Z)
+    {
+        /* K = P * H^T * S^-1  <=>  S * K^T = (P * H^T)^T = H * P  (S and P are symmetric) */
+        const MatrixObserveStatus HP = H * P;
+        const MatrixObserve S = HP.MultiplyTransposed(H) + R;
+        MatrixObserveStatus Kt;
+        if (!SolveCholesky(S, HP, Kt)) return false;
+
+        const VectorObserve e = Z - H * X;
+        const auto K = Kt.Transpose();
+        X = X + K * e;
+        P = P - K * HP;     /* (I - K * H) * P */
+        return true;
+    }
+
+public:
+    /*** X(t) = F * X(t-1) + w(t) ***/
+    /* Matrix to calculate X(t) from X(t-1) */
+    MatrixStatus F;
+    /* w(t), = noise, follows Q */
+    MatrixStatus Q;
+
+    /*** Z(t) = H * X(t) + v(t) ***/
+    /* Matrix to calculate Z(observed value) from X(internal status) */
+    MatrixObserveStatus H;
+    /* v(t), = noise, follows R */
+    MatrixObserve R;
+
+    /*** Internal status ***/
+    VectorStatus X;
+    MatrixStatus P;
+};
+
+
+#endif
@@ -0,0 +1,184 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef LAPJV_
+#define LAPJV_
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+
+/* Linear assignment solver (Jonker-Volgenant shortest augmenting path) */
+/* Reference: */
+/*   R. Jonker and A. Volgenant, "A Shortest Augmenting Path Algorithm for Dense and Sparse Linear Assignment Problems", 1987 */
+/*   D. F. Crouse, "On implementing 2D rectangular assignment algorithms", 2016 */
+/* - the cost matrix is a flat row-major array (rows x cols). rows and cols can be different */
+/* - a pair whose cost >= cost_limit is never assigned, and leaving a row unassigned costs cost_limit */
+/*   (the same result as padding the matrix to square with cost_limit, without the padding) */
+/* - internal buffers are reused, so Solve() doesn't allocate memory once the buffers are large enough */
+template<typename T>
+class Lapjv
+{
+public:
+    Lapjv() {}
+    ~Lapjv() {}
+
+    /* assign_for_row[row] = col (-1 = unassigned), assign_for_col[col] = row (-1 = unassigned) */
+    /* return the total cost of the assigned pairs */
+    double Solve(const T* cost_matrix, int32_t rows, int32_t cols, T cost_limit, std::vector<int32_t>& assign_for_row, std::vector<int32_t>& assign_for_col)
+    {
+        cost_ = cost_matrix;
+        rows_ = rows;
+        cols_ = cols;
+        cost_limit_ = cost_limit;
+
+        /* each row has its own virtual column (cols + row) whose cost is cost_limit, so a solution always exists */
+        const int32_t col_num = cols + rows;
+        Resize(u_, rows);
+        Resize(v_, col_num);
+        Resize(shortest_path_cost_, col_num);
+        Resize(path_, col_num);
+        Resize(col4row_, rows);
+        Resize(row4col_, col_num);
+        Resize(sr_, rows);
+        Resize(sc_, col_num);
+        Resize(remaining_, col_num);
+        std::fill(u_.begin(), u_.begin() + rows, 0.0);
+        std::fill(v_.begin(), v_.begin() + col_num, 0.0);
+        std::fill(col4row_.begin(), col4row_.begin() + rows, -1);
+        std::fill(row4col_.begin(), row4col_.begin() + col_num, -1);
+
+        for (int32_t cur_row = 0; cur_row < rows; cur_row++) {
+            double min_val;
+            int32_t sink = AugmentingPath(cur_row, col_num, min_val);
+            if (sink < 0) break;    /* never happens because of the virtual columns */
+
+            /* update dual variables */
+            u_[cur_row] += min_val;
+            for (int32_t i = 0; i < rows; i++) {
+                if (sr_[i] && i != cur_row) u_[i] += min_val - shortest_path_cost_[col4row_[i]];
+            }
+            for (int32_t j = 0; j < col_num; j++) {
+                if (sc_[j]) v_[j] -= min_val - shortest_path_cost_[j];
+            }
+
+            /* augment the previous solution */
+            for (int32_t j = sink;;) {
+                int32_t i = path_[j];
+                row4col_[j] = i;
+                std::swap(col4row_[i], j);
+                if (i == cur_row) break;
+            }
+        }
+
+        double total_cost = 0;
+        assign_for_row.assign(rows, -1);
+        assign_for_col.assign(cols, -1);
+        for (int32_t i = 0; i < rows; i++) {
+            int32_t j = col4row_[i];
+            if (j >= 0 && j < cols) {
+                assign_for_row[i] = j;
+                assign_for_col[j] = i;
+                total_cost += cost_matrix[static_cast<size_t>(i) * cols + j];
+            }
+        }
+        return total_cost;
+    }
+
+private:
+    template<typename U>
+    static void Resize(std::vector<U>& buffer, int32_t size)
+    {
+        if (static_cast<int32_t>(buffer.size()) < size) buffer.resize(size);
+    }
+
+    double GetCost(int32_t row, int32_t col) const
+    {
+        if (col < cols_) {
+            const T c = cost_[static_cast<size_t>(row) * cols_ + col];
+            return (c < cost_limit_) ? static_cast<double>(c) : std::numeric_limits<double>::infinity();
+        }
+        return (col - cols_ == row) ? static_cast<double>(cost_limit_) : std::numeric_limits<double>::infinity();
+    }
+
+    /* Dijkstra from cur_row to the nearest unassigned column on the reduced costs. return the column (sink) */
+    int32_t AugmentingPath(int32_t cur_row, int32_t col_num, double& min_val)
+    {
+        const double kInf = std::numeric_limits<double>::infinity();
+        min_val = 0;
+        int32_t num_remaining = col_num;
+        for (int32_t it = 0; it < col_num; it++) {
+            remaining_[it] = col_num - it - 1;  /* real columns are checked last, so that they win ties with virtual columns */
+            shortest_path_cost_[it] = kInf;
+            sc_[it] = 0;
+        }
+        std::fill(sr_.begin(), sr_.begin() + rows_, 0);
+
+        int32_t sink = -1;
+        for (int32_t i = cur_row; sink == -1;) {
+            int32_t index = -1;
+            double lowest = kInf;
+            sr_[i] = 1;
+            const double u_i = u_[i];
+            for (int32_t it = 0; it < num_remaining; it++) {
+                int32_t j = remaining_[it];
+                const double c = GetCost(i, j);
+                if (c < kInf) {
+                    double r = min_val + c - u_i - v_[j];
+                    if (r < shortest_path_cost_[j]) {
+                        path_[j] = i;
+                        shortest_path_cost_[j] = r;
+                    }
+                }
+                if (shortest_path_cost_[j] < lowest || (shortest_path_cost_[j] == lowest && lowest < kInf && row4col_[j] == -1)) {
+                    lowest = shortest_path_cost_[j];
+                    index = it;
+                }
+            }
+
+            min_val = lowest;
+            if (index < 0 || min_val == kInf) return -1;
+
+            int32_t j = remaining_[index];
+            if (row4col_[j] == -1) {
+                sink = j;
+            } else {
+                i = row4col_[j];
+            }
+            sc_[j] = 1;
+            remaining_[index] = remaining_[--num_remaining];
+        }
+        return sink;
+    }
+
+private:
+    const T* cost_;
+    int32_t rows_;
+    int32_t cols_;
+    T cost_limit_;
+
+    std::vector<double>  u_;
+    std::vector<double>  v_;
+    std::vector<double>  shortest_path_cost_;
+    std::vector<int32_t> path_;
+    std::vector<int32_t> col4row_;
+    std::vector<int32_t> row4col_;
+    std::vector<uint8_t> sr_;
+    std::vector<uint8_t> sc_;
+    std::vector<int32_t> remaining_;
+};
+
+#endif
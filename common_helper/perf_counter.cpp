@@ -0,0 +1,259 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#if defined(COMMON_HELPER_WITH_PERF_COUNTER) && defined(__linux__)
+#define PERF_COUNTER_ENABLED
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* for My modules */
+#include "common_helper.h"
+#include "perf_counter.h"
+
+/*** Macro ***/
+#define TAG "PerfCounter"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+
+PerfCounter::PerfCounter(int32_t scope)
+{
+    scope_ = scope;
+    is_tried_to_open_ = false;
+}
+
+PerfCounter::~PerfCounter()
+{
+    Close();
+}
+
+PerfCounter& PerfCounter::GetThreadInstance(int32_t scope)
+{
+    /* counters are opened for the calling thread, so each thread has its own instance */
+    static thread_local PerfCounter s_perf_counter_thread(kScopeThread);
+    static thread_local PerfCounter s_perf_counter_process(kScopeProcess);
+    return (scope == kScopeProcess) ? s_perf_counter_process : s_perf_counter_thread;
+}
+
+const char* PerfCounter::GetEventName(int32_t event)
+{
+    static const char* kEventNameList[kEventNum] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+    if (event < 0 || event >= kEventNum) return "unknown";
+    return kEventNameList[event];
+}
+
+bool PerfCounter::IsAvailable() const
+{
+    return !group_list_.empty();
+}
+
+#ifdef PERF_COUNTER_ENABLED
+static int32_t OpenEvent(uint32_t type, uint64_t config, int32_t tid, int32_t group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = (group_fd == -1) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /* inherit is not used because it doesn't work with PERF_FORMAT_GROUP, and it counts only threads created after opening */
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int32_t>(syscall(__NR_perf_event_open, &attr, tid, -1, group_fd, 0));     /* pid = tid (0 = the calling thread), cpu = -1: on any cpu */
+}
+
+bool PerfCounter::OpenGroup(int32_t tid, Group& group)
+{
+    static const std::array<uint64_t, kEventNum> kConfigList = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    group.tid = tid;
+    group.fd_leader = -1;
+    group.fd_list.fill(-1);
+    group.index_in_group.fill(-1);
+    group.event_num_in_group = 0;
+    for (int32_t event = 0; event < kEventNum; event++) {
+        int32_t fd = OpenEvent(PERF_TYPE_HARDWARE, kConfigList[event], tid, group.fd_leader);
+        if (fd < 0) continue;   /* some events may not be supported (e.g. on VM) */
+        if (group.fd_leader < 0) group.fd_leader = fd;
+        group.fd_list[event] = fd;
+        group.index_in_group[event] = group.event_num_in_group++;
+    }
+    return group.fd_leader >= 0;
+}
+
+void PerfCounter::CloseGroup(Group& group)
+{
+    for (auto& fd : group.fd_list) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    group.fd_leader = -1;
+}
+
+void PerfCounter::UpdateThreadList()
+{
+    /* threads of the process: /proc/self/task/[tid] */
+    std::vector<int32_t> tid_list;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return;
+    for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        const int32_t tid = atoi(entry->d_name);
+        if (tid > 0) tid_list.push_back(tid);
+    }
+    closedir(dir);
+    std::sort(tid_list.begin(), tid_list.end());
+
+    /* close the events of finished threads, and open events for new threads */
+    for (auto it = group_list_.begin(); it != group_list_.end();) {
+        if (!std::binary_search(tid_list.begin(), tid_list.end(), it->tid)) {
+            CloseGroup(*it);
+            it = group_list_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (int32_t tid : tid_list) {
+        const bool is_opened = std::any_of(group_list_.begin(), group_list_.end(), [tid](const Group& group) { return group.tid == tid; });
+        if (is_opened) continue;
+        Group group;
+        if (OpenGroup(tid, group)) group_list_.push_back(group);
+    }
+}
+
+bool PerfCounter::Open()
+{
+    if (scope_ == kScopeProcess) {
+        UpdateThreadList();
+    } else {
+        Group group;
+        if (OpenGroup(0, group)) group_list_.push_back(group);
+    }
+    if (group_list_.empty()) {
+        PRINT_E("perf_event_open failed. check /proc/sys/kernel/perf_event_paranoid\n");
+        return false;
+    }
+    return true;
+}
+
+void PerfCounter::Close()
+{
+    for (auto& group : group_list_) CloseGroup(group);
+    group_list_.clear();
+}
+
+void PerfCounter::Start()
+{
+    if (!is_tried_to_open_) {
+        is_tried_to_open_ = true;
+        if (!Open()) return;
+    } else if (scope_ == kScopeProcess && !group_list_.empty()) {
+        UpdateThreadList();
+    }
+    for (const auto& group : group_list_) {
+        ioctl(group.fd_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group.fd_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+PerfCounter::Values PerfCounter::Stop()
+{
+    Values values;
+    if (group_list_.empty()) return values;
+    for (const auto& group : group_list_) {
+        ioctl(group.fd_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    std::array<double, kEventNum> sum;
+    std::array<bool, kEventNum> is_opened;
+    std::array<bool, kEventNum> is_measured;
+    sum.fill(0);
+    is_opened.fill(false);
+    is_measured.fill(true);
+    for (const auto& group : group_list_) {
+        /* PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING: { u64 nr; u64 time_enabled; u64 time_running; u64 values[nr]; } */
+        std::array<uint64_t, 3 + kEventNum> buffer;
+        const ssize_t size_expected = static_cast<ssize_t>(sizeof(uint64_t) * (3 + group.event_num_in_group));
+        const ssize_t size = read(group.fd_leader, buffer.data(), size_expected);
+        if (size < size_expected) continue;     /* e.g. the thread has finished */
+        const uint64_t time_enabled = buffer[1];
+        const uint64_t time_running = buffer[2];
+        for (int32_t event = 0; event < kEventNum; event++) {
+            if (group.index_in_group[event] < 0) continue;
+            is_opened[event] = true;
+            if (time_enabled == 0) continue;    /* the thread didn't run */
+            if (time_running == 0) {
+                is_measured[event] = false;     /* the group was never scheduled on a counter (multiplexing) */
+                continue;
+            }
+            /* the group runs only for a part of the time when counters are multiplexed */
+            sum[event] += static_cast<double>(buffer[3 + group.index_in_group[event]]) * time_enabled / time_running;
+        }
+    }
+    for (int32_t event = 0; event < kEventNum; event++) {
+        values.is_valid[event] = is_opened[event] && is_measured[event];
+        values.value[event] = values.is_valid[event] ? static_cast<uint64_t>(sum[event] + 0.5) : 0;
+    }
+    return values;
+}
+
+#else
+bool PerfCounter::Open()
+{
+    return false;
+}
+
+void PerfCounter::Close()
+{
+}
+
+bool PerfCounter::OpenGroup(int32_t tid, Group& group)
+{
+    (void)tid;
+    (void)group;
+    return false;
+}
+
+void PerfCounter::CloseGroup(Group& group)
+{
+    (void)group;
+}
+
+void PerfCounter::UpdateThreadList()
+{
+}
+
+void PerfCounter::Start()
+{
+}
+
+PerfCounter::Values PerfCounter::Stop()
+{
+    return Values();
+}
+#endif
@@ -0,0 +1,97 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef PERF_COUNTER_
+#define PERF_COUNTER_
+
+/* for general */
+#include <cstdint>
+#include <array>
+#include <vector>
+
+
+/* Hardware performance counters (cycles, instructions, cache misses, branch misses) */
+/*   uses perf_event_open on Linux when built with COMMON_HELPER_WITH_PERF_COUNTER */
+/*   otherwise (or when the kernel doesn't allow it. see /proc/sys/kernel/perf_event_paranoid), Stop() returns invalid values and costs nothing */
+/*   scope: */
+/*     kScopeThread : the calling thread only */
+/*     kScopeProcess: all the threads of the process (e.g. worker threads of the inference engine). events are opened for each thread, */
+/*                    and threads created after the last Start() are added at the next Start(). other threads working in parallel are also counted */
+/*   when there are more events than hardware counters, the kernel multiplexes them. values are scaled by time_enabled / time_running */
+/* usage: */
+/*   PerfCounter& perf_counter = PerfCounter::GetThreadInstance(); */
+/*   perf_counter.Start(); */
+/*   DoSomething(); */
+/*   PerfCounter::Values values = perf_counter.Stop(); */
+class PerfCounter {
+public:
+    enum {
+        kEventCycles = 0,
+        kEventInstructions,
+        kEventCacheMisses,
+        kEventBranchMisses,
+        kEventNum,
+    };
+
+    enum {
+        kScopeThread = 0,
+        kScopeProcess,
+        kScopeNum,
+    };
+
+    typedef struct Values_ {
+        std::array<uint64_t, kEventNum> value;
+        std::array<bool, kEventNum> is_valid;
+        Values_()
+        {
+            value.fill(0);
+            is_valid.fill(false);
+        }
+    } Values;
+
+public:
+    PerfCounter(int32_t scope = kScopeThread);
+    ~PerfCounter();
+
+    bool IsAvailable() const;
+    void Start();
+    Values Stop();      /* counters are disabled even if reading fails */
+
+    /* an instance for the calling thread (Start and Stop must be called in the same thread) */
+    static PerfCounter& GetThreadInstance(int32_t scope = kScopeThread);
+    static const char* GetEventName(int32_t event);
+
+private:
+    /* events of a thread, read at once */
+    typedef struct Group_ {
+        int32_t tid;        /* 0 = the calling thread */
+        int32_t fd_leader;
+        std::array<int32_t, kEventNum> fd_list;
+        std::array<int32_t, kEventNum> index_in_group;   /* position in the group read. -1 = not opened */
+        int32_t event_num_in_group;
+    } Group;
+
+    bool Open();
+    void Close();
+    bool OpenGroup(int32_t tid, Group& group);
+    void CloseGroup(Group& group);
+    void UpdateThreadList();
+
+private:
+    int32_t scope_;
+    std::vector<Group> group_list_;
+    bool is_tried_to_open_;
+};
+
+#endif
@@ -0,0 +1,262 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+/* for My modules */
+#include "common_helper.h"
+#include "processing_stats.h"
+
+/*** Macro ***/
+#define TAG "ProcessingStats"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+
+constexpr int32_t LatencyHistogram::kSubBucketBits;  // for link error in Android Studio (clang)
+constexpr int32_t LatencyHistogram::kSubBucketNum;
+constexpr int32_t LatencyHistogram::kOctaveNum;
+constexpr int32_t LatencyHistogram::kBucketNum;
+constexpr int32_t LatencyHistogram::kWindowNum;
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+int32_t LatencyHistogram::GetBucketIndex(uint64_t value_us)
+{
+    if (value_us < kSubBucketNum) return static_cast<int32_t>(value_us);
+
+    int32_t msb = 0;
+    for (uint64_t v = value_us; v > 1; v >>= 1) msb++;
+    int32_t octave = msb - kSubBucketBits + 1;
+    int32_t sub_index = static_cast<int32_t>((value_us >> (msb - kSubBucketBits)) & (kSubBucketNum - 1));
+    int32_t index = octave * kSubBucketNum + sub_index;
+    return (std::min)(index, kBucketNum - 1);
+}
+
+double LatencyHistogram::GetBucketValue(int32_t index)
+{
+    /* return the middle of the bucket in [msec] */
+    int32_t octave = index / kSubBucketNum;
+    int32_t sub_index = index % kSubBucketNum;
+    if (octave == 0) return sub_index / 1000.0;
+    double lower = static_cast<double>(static_cast<uint64_t>(kSubBucketNum + sub_index) << (octave - 1));
+    double width = static_cast<double>(1ULL << (octave - 1));
+    return (lower + width / 2) / 1000.0;
+}
+
+void LatencyHistogram::Record(double time_ms)
+{
+    uint64_t value_us = time_ms > 0 ? static_cast<uint64_t>(time_ms * 1000.0) : 0;
+    Window& window = window_list_[current_window_.load(std::memory_order_relaxed)];
+    window.bucket_list[GetBucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+    window.count.fetch_add(1, std::memory_order_relaxed);
+    window.sum_us.fetch_add(value_us, std::memory_order_relaxed);
+    uint64_t max_us = window.max_us.load(std::memory_order_relaxed);
+    while (value_us > max_us && !window.max_us.compare_exchange_weak(max_us, value_us, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Rotate()
+{
+    /* clear the oldest window first, then make it current */
+    int32_t next_window = (current_window_.load(std::memory_order_relaxed) + 1) % kWindowNum;
+    Window& window = window_list_[next_window];
+    for (auto& bucket : window.bucket_list) bucket.store(0, std::memory_order_relaxed);
+    window.count.store(0, std::memory_order_relaxed);
+    window.sum_us.store(0, std::memory_order_relaxed);
+    window.max_us.store(0, std::memory_order_relaxed);
+    current_window_.store(next_window, std::memory_order_release);
+}
+
+void LatencyHistogram::Reset()
+{
+    for (auto& window : window_list_) {
+        for (auto& bucket : window.bucket_list) bucket.store(0, std::memory_order_relaxed);
+        window.count.store(0, std::memory_order_relaxed);
+        window.sum_us.store(0, std::memory_order_relaxed);
+        window.max_us.store(0, std::memory_order_relaxed);
+    }
+    current_window_.store(0, std::memory_order_release);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+    Snapshot snapshot;
+    std::vector<uint64_t> bucket_sum(kBucketNum, 0);
+    uint64_t sum_us = 0;
+    uint64_t max_us = 0;
+    for (const auto& window : window_list_) {
+        for (int32_t i = 0; i < kBucketNum; i++) {
+            bucket_sum[i] += window.bucket_list[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count += window.count.load(std::memory_order_relaxed);
+        sum_us += window.sum_us.load(std::memory_order_relaxed);
+        max_us = (std::max)(max_us, window.max_us.load(std::memory_order_relaxed));
+    }
+    if (snapshot.count == 0) return snapshot;
+
+    snapshot.mean = sum_us / 1000.0 / snapshot.count;
+    snapshot.max = max_us / 1000.0;
+
+    const std::array<double, 3> percentile_list = { 0.50, 0.90, 0.99 };
+    std::array<double*, 3> dst_list = { &snapshot.p50, &snapshot.p90, &snapshot.p99 };
+    uint64_t accumulated = 0;
+    size_t i_percentile = 0;
+    for (int32_t i = 0; i < kBucketNum && i_percentile < percentile_list.size(); i++) {
+        accumulated += bucket_sum[i];
+        while (i_percentile < percentile_list.size() && accumulated >= std::ceil(percentile_list[i_percentile] * snapshot.count)) {
+            *dst_list[i_percentile] = (std::min)(GetBucketValue(i), snapshot.max);
+            i_percentile++;
+        }
+    }
+    return snapshot;
+}
+
+
+
+ProcessingStats::ProcessingStats(double window_sec, double log_interval_sec)
+{
+    window_sec_ = window_sec;
+    log_interval_sec_ = log_interval_sec;
+    Reset();
+}
+
+void ProcessingStats::RecordTime(int32_t stage, double time_ms)
+{
+    if (stage < 0 || stage >= kStageNum) return;
+    histogram_list_[stage].Record(time_ms);
+}
+
+void ProcessingStats::RecordPerf(int32_t stage, const PerfCounter::Values& values)
+{
+    if (stage < 0 || stage >= kStageNum) return;
+    bool is_valid = false;
+    for (int32_t i = 0; i < PerfCounter::kEventNum; i++) {
+        if (!values.is_valid[i]) continue;
+        perf_sum_list_[stage][i].fetch_add(values.value[i], std::memory_order_relaxed);
+        is_valid = true;
+    }
+    if (is_valid) perf_count_list_[stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProcessingStats::AddCount(int32_t counter, uint64_t num)
+{
+    if (counter < 0 || counter >= kCounterNum) return;
+    counter_list_[counter].fetch_add(num, std::memory_order_relaxed);
+}
+
+void ProcessingStats::Tick()
+{
+    const auto time_now = std::chrono::steady_clock::now();
+    if (window_sec_ > 0 && std::chrono::duration<double>(time_now - time_last_rotate_).count() >= window_sec_) {
+        for (auto& histogram : histogram_list_) histogram.Rotate();
+        time_last_rotate_ = time_now;
+    }
+    if (log_interval_sec_ > 0 && std::chrono::duration<double>(time_now - time_last_log_).count() >= log_interval_sec_) {
+        Print();
+        time_last_log_ = time_now;
+    }
+}
+
+void ProcessingStats::Reset()
+{
+    for (auto& histogram : histogram_list_) histogram.Reset();
+    for (auto& counter : counter_list_) counter.store(0, std::memory_order_relaxed);
+    for (auto& perf_sum : perf_sum_list_) {
+        for (auto& sum : perf_sum) sum.store(0, std::memory_order_relaxed);
+    }
+    for (auto& perf_count : perf_count_list_) perf_count.store(0, std::memory_order_relaxed);
+    time_last_rotate_ = std::chrono::steady_clock::now();
+    time_last_log_ = time_last_rotate_;
+}
+
+void ProcessingStats::SetLogInterval(double log_interval_sec)
+{
+    log_interval_sec_ = log_interval_sec;
+}
+
+ProcessingStats::Snapshot ProcessingStats::GetSnapshot() const
+{
+    Snapshot snapshot;
+    for (int32_t i = 0; i < kCounterNum; i++) {
+        snapshot.counter_list[i] = counter_list_[i].load(std::memory_order_relaxed);
+    }
+    for (int32_t i = 0; i < kStageNum; i++) {
+        snapshot.stage_list[i] = histogram_list_[i].GetSnapshot();
+        snapshot.perf_list[i].count = perf_count_list_[i].load(std::memory_order_relaxed);
+        for (int32_t j = 0; j < PerfCounter::kEventNum; j++) {
+            snapshot.perf_list[i].sum[j] = perf_sum_list_[i][j].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+std::string ProcessingStats::ToString() const
+{
+    /* one line of key=value so that it can be scraped easily */
+    const Snapshot snapshot = GetSnapshot();
+    std::string str;
+    char buffer[256];
+    for (int32_t i = 0; i < kCounterNum; i++) {
+        snprintf(buffer, sizeof(buffer), "%s%s=%llu", i == 0 ? "" : " ", GetCounterName(i), static_cast<unsigned long long>(snapshot.counter_list[i]));
+        str += buffer;
+    }
+    for (int32_t i = 0; i < kStageNum; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        if (stage.count == 0) continue;
+        snprintf(buffer, sizeof(buffer), " %s.count=%llu %s.mean=%.3f %s.p50=%.3f %s.p90=%.3f %s.p99=%.3f %s.max=%.3f",
+            GetStageName(i), static_cast<unsigned long long>(stage.count), GetStageName(i), stage.mean, GetStageName(i), stage.p50,
+            GetStageName(i), stage.p90, GetStageName(i), stage.p99, GetStageName(i), stage.max);
+        str += buffer;
+
+        /* average per span */
+        const auto& perf = snapshot.perf_list[i];
+        if (perf.count == 0) continue;
+        for (int32_t j = 0; j < PerfCounter::kEventNum; j++) {
+            snprintf(buffer, sizeof(buffer), " %s.%s=%llu", GetStageName(i), PerfCounter::GetEventName(j), static_cast<unsigned long long>(perf.sum[j] / perf.count));
+            str += buffer;
+        }
+    }
+    return str;
+}
+
+void ProcessingStats::Print() const
+{
+    PRINT("%s\n", ToString().c_str());
+}
+
+const char* ProcessingStats::GetStageName(int32_t stage)
+{
+    static const char* kStageNameList[kStageNum] = { "pre_process", "inference", "post_process", "second_stage", "tracking", "total" };
+    if (stage < 0 || stage >= kStageNum) return "unknown";
+    return kStageNameList[stage];
+}
+
+const char* ProcessingStats::GetCounterName(int32_t counter)
+{
+    static const char* kCounterNameList[kCounterNum] = { "frame", "drop", "detection", "track", "second_stage", "second_stage_skip" };
+    if (counter < 0 || counter >= kCounterNum) return "unknown";
+    return kCounterNameList[counter];
+}
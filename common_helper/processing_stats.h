@@ -0,0 +1,143 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef PROCESSING_STATS_
+#define PROCESSING_STATS_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+/* for My modules */
+#include "perf_counter.h"
+
+
+/* HDR-style latency histogram */
+/*   values are recorded in [usec] into log-linear buckets (16 sub buckets per power of two, i.e. within 6.25% error) */
+/*   the histogram keeps kWindowNum sub windows. Rotate() drops the oldest one, so a snapshot covers the last (kWindowNum - 1) to kWindowNum periods */
+/*   Record() can be called from any thread without lock */
+class LatencyHistogram {
+public:
+    static constexpr int32_t kSubBucketBits = 4;
+    static constexpr int32_t kSubBucketNum = 1 << kSubBucketBits;
+    static constexpr int32_t kOctaveNum = 33;     /* up to 2^36 usec */
+    static constexpr int32_t kBucketNum = kOctaveNum * kSubBucketNum;
+    static constexpr int32_t kWindowNum = 4;
+
+    typedef struct Snapshot_ {
+        uint64_t count;
+        double   mean;  // [msec]
+        double   p50;   // [msec]
+        double   p90;   // [msec]
+        double   p99;   // [msec]
+        double   max;   // [msec]
+        Snapshot_() : count(0), mean(0), p50(0), p90(0), p99(0), max(0)
+        {}
+    } Snapshot;
+
+public:
+    LatencyHistogram();
+    ~LatencyHistogram() {}
+
+    void Record(double time_ms);
+    void Rotate();
+    void Reset();
+    Snapshot GetSnapshot() const;
+
+private:
+    static int32_t GetBucketIndex(uint64_t value_us);
+    static double GetBucketValue(int32_t index);
+
+private:
+    struct Window {
+        std::array<std::atomic<uint32_t>, kBucketNum> bucket_list;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum_us;
+        std::atomic<uint64_t> max_us;
+    };
+    std::array<Window, kWindowNum> window_list_;
+    std::atomic<int32_t> current_window_;
+};
+
+
+/* Runtime telemetry for ImageProcessor */
+/*   latency histogram for each processing stage and counters */
+/*   Tick() is expected to be called once per frame. It rotates histograms and emits a log line periodically */
+class ProcessingStats {
+public:
+    enum {
+        kStagePreProcess = 0,
+        kStageInference,
+        kStagePostProcess,
+        kStageSecondStage,
+        kStageTracking,
+        kStageTotal,
+        kStageNum,
+    };
+
+    enum {
+        kCounterFrame = 0,
+        kCounterDrop,
+        kCounterDetection,
+        kCounterTrack,
+        kCounterSecondStage,
+        kCounterSecondStageSkip,
+        kCounterNum,
+    };
+
+    typedef struct PerfSummary_ {
+        uint64_t count;     /* number of spans with valid counter values */
+        std::array<uint64_t, PerfCounter::kEventNum> sum;
+    } PerfSummary;
+
+    typedef struct Snapshot_ {
+        std::array<uint64_t, kCounterNum> counter_list;
+        std::array<LatencyHistogram::Snapshot, kStageNum> stage_list;
+        std::array<PerfSummary, kStageNum> perf_list;
+    } Snapshot;
+
+public:
+    ProcessingStats(double window_sec = 10.0, double log_interval_sec = 10.0);
+    ~ProcessingStats() {}
+
+    void RecordTime(int32_t stage, double time_ms);
+    void RecordPerf(int32_t stage, const PerfCounter::Values& values);
+    void AddCount(int32_t counter, uint64_t num = 1);
+    void Tick();
+    void Reset();
+    void SetLogInterval(double log_interval_sec);
+
+    Snapshot GetSnapshot() const;
+    std::string ToString() const;
+    void Print() const;
+
+    static const char* GetStageName(int32_t stage);
+    static const char* GetCounterName(int32_t counter);
+
+private:
+    std::array<LatencyHistogram, kStageNum> histogram_list_;
+    std::array<std::atomic<uint64_t>, kCounterNum> counter_list_;
+    std::array<std::array<std::atomic<uint64_t>, PerfCounter::kEventNum>, kStageNum> perf_sum_list_;
+    std::array<std::atomic<uint64_t>, kStageNum> perf_count_list_;
+    double window_sec_;
+    double log_interval_sec_;
+    std::chrono::steady_clock::time_point time_last_rotate_;
+    std::chrono::steady_clock::time_point time_last_log_;
+};
+
+#endif
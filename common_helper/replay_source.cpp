@@ -0,0 +1,303 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <condition_variable>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "processing_stats.h"
+#include "replay_source.h"
+
+/*** Macro ***/
+#define TAG "ReplaySource"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+static constexpr int32_t kDefaultFrameNumForStillImage = 100;
+
+/* a still image file (the extension is checked case-insensitively) */
+static bool HasImageExtension(const std::string& input_name)
+{
+    static const char* kExtensionList[] = { ".jpg", ".jpeg", ".png", ".bmp" };
+    const size_t pos = input_name.find_last_of('.');
+    if (pos == std::string::npos) return false;
+    std::string extension = input_name.substr(pos);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const auto& ext : kExtensionList) {
+        if (extension == ext) return true;
+    }
+    return false;
+}
+
+
+ReplaySource::ReplaySource()
+    : is_producer_finished_(true), is_started_(false), is_stop_requested_(false),
+    released_num_(0), processed_num_(0), dropped_num_(0), deadline_miss_num_(0)
+{
+}
+
+ReplaySource::~ReplaySource()
+{
+    Close();
+}
+
+bool ReplaySource::Open(const std::string& input_name, const Param& param)
+{
+    Close();
+
+    param_ = param;
+    if (param_.fps <= 0) {
+        PRINT_E("Invalid fps: %f\n", param_.fps);
+        return false;
+    }
+    param_.burst_size = (std::max)(1, param_.burst_size);
+    param_.queue_size = (std::max)(1, param_.queue_size);
+    if (param_.deadline_ms <= 0) param_.deadline_ms = 1000.0 / param_.fps;
+
+    /* a still image is released repeatedly. a video file or an image sequence ("%04d.jpg") is opened by VideoCapture */
+    if (HasImageExtension(input_name) && input_name.find('%') == std::string::npos) {
+        still_image_ = cv::imread(input_name);
+        if (still_image_.empty()) {
+            PRINT_E("Invalid input source: %s\n", input_name.c_str());
+            return false;
+        }
+        if (param_.frame_num <= 0) param_.frame_num = kDefaultFrameNumForStillImage;
+    } else {
+        cap_ = cv::VideoCapture(input_name);
+        if (!cap_.isOpened()) {
+            PRINT_E("Invalid input source: %s\n", input_name.c_str());
+            return false;
+        }
+    }
+
+    queue_.clear();
+    released_num_ = 0;
+    processed_num_ = 0;
+    dropped_num_ = 0;
+    deadline_miss_num_ = 0;
+    histogram_latency_.Reset();
+    histogram_queue_wait_.Reset();
+    is_stop_requested_ = false;
+    is_producer_finished_ = false;
+    is_started_ = false;    /* the producer starts at the first Read */
+    time_start_ = std::chrono::steady_clock::now();
+    time_last_done_ = time_start_;
+    return true;
+}
+
+void ReplaySource::Start()
+{
+    is_started_ = true;
+    time_start_ = std::chrono::steady_clock::now();
+    time_last_done_ = time_start_;
+    thread_producer_ = std::thread(&ReplaySource::ThreadProducer, this);
+}
+
+void ReplaySource::Close()
+{
+    is_stop_requested_ = true;
+    cv_.notify_all();
+    if (thread_producer_.joinable()) thread_producer_.join();
+    if (cap_.isOpened()) cap_.release();
+    still_image_.release();
+    std::lock_guard<std::mutex> lock(mtx_);
+    queue_.clear();
+    is_producer_finished_ = true;
+    is_started_ = false;
+}
+
+bool ReplaySource::ReadSource(cv::Mat& image)
+{
+    if (!still_image_.empty()) {
+        image = still_image_.clone();   /* the consumer may draw on the image */
+        return true;
+    }
+    cap_.read(image);
+    if (image.empty() && param_.loop) {
+        cap_.set(cv::CAP_PROP_POS_FRAMES, 0);
+        cap_.read(image);
+    }
+    return !image.empty();
+}
+
+void ReplaySource::ThreadProducer()
+{
+    const std::chrono::duration<double> period(1.0 / param_.fps);
+    for (int32_t frame_id = 0; !is_stop_requested_; frame_id++) {
+        if (param_.frame_num > 0 && frame_id >= param_.frame_num) break;
+
+        /* decode before the release time so that decoding cost is not included in the latency */
+        /* note: if decoding is slower than the target rate, frames are released late (the capture timestamp is the actual release time) */
+        cv::Mat image;
+        if (!ReadSource(image)) break;
+
+        const int32_t burst_index = frame_id / param_.burst_size;
+        const auto time_release = time_start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * (static_cast<double>(burst_index) * param_.burst_size));
+        std::this_thread::sleep_until(time_release);
+
+        Frame frame;
+        frame.image = image;
+        frame.frame_id = frame_id;
+        frame.time_capture = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            released_num_++;
+            if (param_.policy != kPolicyQueue && static_cast<int32_t>(queue_.size()) >= param_.queue_size) {
+                dropped_num_++;
+                if (param_.policy == kPolicyDropOldest) {
+                    queue_.pop_front();
+                    queue_.push_back(frame);
+                }
+            } else {
+                queue_.push_back(frame);
+            }
+        }
+        cv_.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_producer_finished_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool ReplaySource::Read(Frame& frame)
+{
+    if (!is_started_ && !is_producer_finished_) Start();
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [this] { return !queue_.empty() || is_producer_finished_ || is_stop_requested_; });
+    if (queue_.empty()) return false;
+    frame = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+
+    histogram_queue_wait_.Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.time_capture).count());
+    return true;
+}
+
+void ReplaySource::Done(const Frame& frame)
+{
+    const auto time_now = std::chrono::steady_clock::now();
+    double latency = std::chrono::duration<double, std::milli>(time_now - frame.time_capture).count();
+    histogram_latency_.Record(latency);
+    processed_num_++;
+    if (latency > param_.deadline_ms) deadline_miss_num_++;
+    std::lock_guard<std::mutex> lock(mtx_);
+    time_last_done_ = time_now;
+}
+
+ReplaySource::Report ReplaySource::GetReport() const
+{
+    Report report;
+    report.target_fps = param_.fps;
+    report.deadline_ms = param_.deadline_ms;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        report.duration_sec = std::chrono::duration<double>(time_last_done_ - time_start_).count();
+    }
+    report.released_num = released_num_;
+    report.processed_num = processed_num_;
+    report.dropped_num = dropped_num_;
+    report.deadline_miss_num = deadline_miss_num_;
+    report.drop_rate = report.released_num > 0 ? static_cast<double>(report.dropped_num) / report.released_num : 0;
+    report.deadline_miss_rate = report.processed_num > 0 ? static_cast<double>(report.deadline_miss_num) / report.processed_num : 0;
+    report.throughput_fps = report.duration_sec > 0 ? report.processed_num / report.duration_sec : 0;
+    report.latency = histogram_latency_.GetSnapshot();
+    report.queue_wait = histogram_queue_wait_.GetSnapshot();
+    return report;
+}
+
+static std::string LatencyToJson(const LatencyHistogram::Snapshot& snapshot)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\"count\": %llu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+        static_cast<unsigned long long>(snapshot.count), snapshot.mean, snapshot.p50, snapshot.p90, snapshot.p99, snapshot.max);
+    return buffer;
+}
+
+std::string ReplaySource::ToJson(const std::string& extra_member) const
+{
+    static const char* kPolicyNameList[] = { "drop_oldest", "drop_newest", "queue" };
+    const Report report = GetReport();
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer),
+        "{\n"
+        "  \"target_fps\": %.3f,\n"
+        "  \"burst_size\": %d,\n"
+        "  \"policy\": \"%s\",\n"
+        "  \"queue_size\": %d,\n"
+        "  \"deadline_ms\": %.3f,\n"
+        "  \"duration_sec\": %.3f,\n"
+        "  \"released\": %llu,\n"
+        "  \"processed\": %llu,\n"
+        "  \"dropped\": %llu,\n"
+        "  \"deadline_miss\": %llu,\n"
+        "  \"drop_rate\": %.4f,\n"
+        "  \"deadline_miss_rate\": %.4f,\n"
+        "  \"throughput_fps\": %.3f,\n",
+        report.target_fps, param_.burst_size, kPolicyNameList[(std::min)((std::max)(param_.policy, 0), 2)], param_.queue_size, report.deadline_ms, report.duration_sec,
+        static_cast<unsigned long long>(report.released_num), static_cast<unsigned long long>(report.processed_num),
+        static_cast<unsigned long long>(report.dropped_num), static_cast<unsigned long long>(report.deadline_miss_num),
+        report.drop_rate, report.deadline_miss_rate, report.throughput_fps);
+    std::string json = buffer;
+    json += "  \"latency_ms\": " + LatencyToJson(report.latency) + ",\n";
+    json += "  \"queue_wait_ms\": " + LatencyToJson(report.queue_wait);
+    if (!extra_member.empty()) json += ",\n  " + extra_member;
+    json += "\n}\n";
+    return json;
+}
+
+bool ReplaySource::WriteJson(const std::string& filename, const std::string& extra_member) const
+{
+    std::ofstream ofs(filename);
+    if (ofs.fail()) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return false;
+    }
+    ofs << ToJson(extra_member);
+    return true;
+}
+
+void ReplaySource::PrintReport() const
+{
+    const Report report = GetReport();
+    printf("=== Replay report ===\n");
+    printf("Target:              %9.3lf [fps] (burst = %d, deadline = %.3lf [msec])\n", report.target_fps, param_.burst_size, report.deadline_ms);
+    printf("Throughput:          %9.3lf [fps]\n", report.throughput_fps);
+    printf("Released / Processed / Dropped: %llu / %llu / %llu (drop rate = %.2lf %%)\n",
+        static_cast<unsigned long long>(report.released_num), static_cast<unsigned long long>(report.processed_num),
+        static_cast<unsigned long long>(report.dropped_num), report.drop_rate * 100);
+    printf("Deadline miss:       %llu (%.2lf %%)\n", static_cast<unsigned long long>(report.deadline_miss_num), report.deadline_miss_rate * 100);
+    printf("Latency:             mean = %.3lf, p50 = %.3lf, p90 = %.3lf, p99 = %.3lf, max = %.3lf [msec]\n",
+        report.latency.mean, report.latency.p50, report.latency.p90, report.latency.p99, report.latency.max);
+    printf("  Queue wait:        mean = %.3lf, p50 = %.3lf, p90 = %.3lf, p99 = %.3lf, max = %.3lf [msec]\n",
+        report.queue_wait.mean, report.queue_wait.p50, report.queue_wait.p90, report.queue_wait.p99, report.queue_wait.max);
+}
@@ -0,0 +1,126 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef REPLAY_SOURCE_
+#define REPLAY_SOURCE_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "processing_stats.h"
+
+
+/* Real-time replay load generator */
+/*   releases frames from a video file, an image sequence ("img_%04d.jpg") or a still image at a fixed or bursty rate */
+/*   frames which cannot be consumed in time are dropped or queued according to the policy */
+/*   the consumer calls Read() to get a frame and Done() when the result is ready, so that the end-to-end latency from the capture timestamp is measured */
+/*   the release clock starts at the first Read(), so that the setup of the consumer (e.g. model loading) after Open() is not counted as drops and misses */
+class ReplaySource {
+public:
+    enum {
+        kPolicyDropOldest = 0,  /* keep the latest frames (typical for live camera) */
+        kPolicyDropNewest,      /* discard arriving frames while the queue is full */
+        kPolicyQueue,           /* never drop. latency grows if the consumer is slower than the arrival rate */
+    };
+
+    typedef struct Param_ {
+        double  fps;                /* target arrival rate */
+        int32_t burst_size;         /* number of frames released back-to-back. the average rate is still fps */
+        int32_t policy;
+        int32_t queue_size;         /* max number of frames waiting for the consumer (ignored for kPolicyQueue) */
+        double  deadline_ms;        /* end-to-end latency limit. 0 = 1 / fps */
+        int32_t frame_num;          /* number of frames to release. 0 = until the end of the source (still image: 100) */
+        bool    loop;               /* rewind the source at the end */
+        Param_() : fps(30.0), burst_size(1), policy(kPolicyDropOldest), queue_size(1), deadline_ms(0), frame_num(0), loop(false)
+        {}
+    } Param;
+
+    typedef struct Frame_ {
+        cv::Mat image;
+        int32_t frame_id;
+        std::chrono::steady_clock::time_point time_capture;
+        Frame_() : frame_id(-1)
+        {}
+    } Frame;
+
+    typedef struct Report_ {
+        double   target_fps;
+        double   deadline_ms;
+        double   duration_sec;
+        uint64_t released_num;
+        uint64_t processed_num;
+        uint64_t dropped_num;
+        uint64_t deadline_miss_num;
+        double   drop_rate;
+        double   deadline_miss_rate;
+        double   throughput_fps;
+        LatencyHistogram::Snapshot latency;     /* capture -> result */
+        LatencyHistogram::Snapshot queue_wait;  /* capture -> Read() */
+    } Report;
+
+public:
+    ReplaySource();
+    ~ReplaySource();
+    bool Open(const std::string& input_name, const Param& param);
+    void Close();
+
+    bool Read(Frame& frame);
+    void Done(const Frame& frame);
+
+    Report GetReport() const;
+    std::string ToJson(const std::string& extra_member = "") const;     /* extra_member: additional "key": value pairs appended to the top level object */
+    bool WriteJson(const std::string& filename, const std::string& extra_member = "") const;
+    void PrintReport() const;
+
+private:
+    void Start();
+    void ThreadProducer();
+    bool ReadSource(cv::Mat& image);
+
+private:
+    Param param_;
+    cv::VideoCapture cap_;
+    cv::Mat still_image_;
+
+    std::thread thread_producer_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Frame> queue_;
+    bool is_producer_finished_;
+    bool is_started_;
+    std::atomic<bool> is_stop_requested_;
+
+    std::chrono::steady_clock::time_point time_start_;
+    std::chrono::steady_clock::time_point time_last_done_;
+    std::atomic<uint64_t> released_num_;
+    std::atomic<uint64_t> processed_num_;
+    std::atomic<uint64_t> dropped_num_;
+    std::atomic<uint64_t> deadline_miss_num_;
+    LatencyHistogram histogram_latency_;
+    LatencyHistogram histogram_queue_wait_;
+};
+
+#endif
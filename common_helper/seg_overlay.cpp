@@ -0,0 +1,170 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "seg_overlay.h"
+
+/*** Macro ***/
+/* the number of pixels to use multi threads */
+#define PARALLEL_THRESHOLD 16384
+/* the number of pixels processed at once in a row */
+#define BLOCK_SIZE 256
+
+static constexpr int32_t kWeightBits = 8;
+static constexpr int32_t kWeightOne = 1 << kWeightBits;
+static constexpr int32_t kWeightHalf = kWeightOne / 2;
+
+
+constexpr int32_t SegOverlay::kColorNumMax;  // for link error in Android Studio (clang)
+
+SegOverlay::SegOverlay()
+    : palette_(kColorNumMax * 4, 0)
+{
+    std::fill(index_key_, index_key_ + 3, -1);
+}
+
+SegOverlay::~SegOverlay()
+{
+}
+
+void SegOverlay::SetPalette(const uint8_t* palette, int32_t num, const uint8_t* alpha)
+{
+    std::fill(palette_.begin(), palette_.end(), static_cast<uint8_t>(0));
+    num = (std::min)(num, kColorNumMax);
+    for (int32_t i = 0; i < num; i++) {
+        palette_[i * 4 + 0] = palette[i * 3 + 0];
+        palette_[i * 4 + 1] = palette[i * 3 + 1];
+        palette_[i * 4 + 2] = palette[i * 3 + 2];
+        palette_[i * 4 + 3] = alpha ? alpha[i] : 255;
+    }
+}
+
+void SegOverlay::BlendLabel(const uint8_t* label, int32_t width, int32_t height, uint8_t* image, int32_t image_width, int32_t image_height,
+    float ratio, int32_t interpolation)
+{
+    const float scale = (std::min)((std::max)(ratio, 0.0F), 1.0F) * kWeightOne / 255;
+    for (int32_t i = 0; i < kColorNumMax; i++) {
+        const int32_t a = static_cast<int32_t>(std::round(palette_[i * 4 + 3] * scale));
+        for (int32_t k = 0; k < 3; k++) lut_[i][k] = palette_[i * 4 + k] * a;
+        lut_[i][3] = a;
+    }
+    Composite(label, width, height, image, image_width, image_height, interpolation);
+}
+
+void SegOverlay::BlendAlpha(const uint8_t* alpha, int32_t width, int32_t height, const uint8_t color[3], uint8_t* image, int32_t image_width, int32_t image_height,
+    float ratio, int32_t interpolation)
+{
+    const float scale = (std::min)((std::max)(ratio, 0.0F), 1.0F) * kWeightOne / 255;
+    for (int32_t i = 0; i < kColorNumMax; i++) {
+        const int32_t a = static_cast<int32_t>(std::round(i * scale));
+        for (int32_t k = 0; k < 3; k++) lut_[i][k] = color[k] * a;
+        lut_[i][3] = a;
+    }
+    Composite(alpha, width, height, image, image_width, image_height, interpolation);
+}
+
+void SegOverlay::UpdateIndex(int32_t width, int32_t image_width, int32_t interpolation)
+{
+    if (index_key_[0] == width && index_key_[1] == image_width && index_key_[2] == interpolation) return;
+    index_key_[0] = width;
+    index_key_[1] = image_width;
+    index_key_[2] = interpolation;
+    x0_list_.resize(image_width);
+    x1_list_.resize(image_width);
+    fx_list_.resize(image_width);
+    const double scale = static_cast<double>(width) / image_width;
+    for (int32_t x = 0; x < image_width; x++) {
+        if (interpolation == kInterNearest) {
+            x0_list_[x] = x1_list_[x] = (std::min)(static_cast<int32_t>((x + 0.5) * scale), width - 1);
+            fx_list_[x] = 0;
+        } else {
+            /* the same coordinates as cv::resize(INTER_LINEAR) */
+            const double sx = (std::max)((x + 0.5) * scale - 0.5, 0.0);
+            const int32_t x0 = (std::min)(static_cast<int32_t>(sx), width - 1);
+            x0_list_[x] = x0;
+            x1_list_[x] = (std::min)(x0 + 1, width - 1);
+            fx_list_[x] = static_cast<int32_t>(std::lround((sx - x0) * kWeightOne));
+        }
+    }
+}
+
+void SegOverlay::Composite(const uint8_t* src, int32_t width, int32_t height, uint8_t* image, int32_t image_width, int32_t image_height, int32_t interpolation)
+{
+    if (width <= 0 || height <= 0 || image_width <= 0 || image_height <= 0) return;
+    UpdateIndex(width, image_width, interpolation);
+    const int32_t* x0_list = x0_list_.data();
+    const int32_t* x1_list = x1_list_.data();
+    const int32_t* fx_list = fx_list_.data();
+    const double scale_y = static_cast<double>(height) / image_height;
+
+#pragma omp parallel if (image_width * image_height > PARALLEL_THRESHOLD)
+    {
+        /* a row of the source interpolated vertically: [width][4] */
+        std::vector<int32_t> row(static_cast<size_t>(width) * 4);
+#pragma omp for
+        for (int32_t y = 0; y < image_height; y++) {
+            int32_t y0, y1, fy;
+            if (interpolation == kInterNearest) {
+                y0 = y1 = (std::min)(static_cast<int32_t>((y + 0.5) * scale_y), height - 1);
+                fy = 0;
+            } else {
+                const double sy = (std::max)((y + 0.5) * scale_y - 0.5, 0.0);
+                y0 = (std::min)(static_cast<int32_t>(sy), height - 1);
+                y1 = (std::min)(y0 + 1, height - 1);
+                fy = static_cast<int32_t>(std::lround((sy - y0) * kWeightOne));
+            }
+            /* colorization and vertical interpolation at the source resolution (cheaper than at the image resolution) */
+            const uint8_t* src0 = src + static_cast<size_t>(y0) * width;
+            const uint8_t* src1 = src + static_cast<size_t>(y1) * width;
+            for (int32_t x = 0; x < width; x++) {
+                const int32_t* c0 = lut_[src0[x]];
+                const int32_t* c1 = lut_[src1[x]];
+                for (int32_t k = 0; k < 4; k++) {
+                    row[x * 4 + k] = (c0[k] * (kWeightOne - fy) + c1[k] * fy + kWeightHalf) >> kWeightBits;
+                }
+            }
+
+            /* horizontal interpolation, and then blending of the row as a flat array (B, G, R, B, ...) in SIMD lanes */
+            uint8_t* dst_row = image + static_cast<size_t>(y) * image_width * 3;
+            for (int32_t x_start = 0; x_start < image_width; x_start += BLOCK_SIZE) {
+                const int32_t n = (std::min)(BLOCK_SIZE, image_width - x_start);
+                int32_t color[BLOCK_SIZE * 3];
+                int32_t alpha_inv[BLOCK_SIZE * 3];
+                for (int32_t i = 0; i < n; i++) {
+                    const int32_t* p0 = &row[x0_list[x_start + i] * 4];
+                    const int32_t* p1 = &row[x1_list[x_start + i] * 4];
+                    const int32_t fx = fx_list[x_start + i];
+                    for (int32_t k = 0; k < 3; k++) {
+                        color[i * 3 + k] = (p0[k] * (kWeightOne - fx) + p1[k] * fx + kWeightHalf) >> kWeightBits;
+                    }
+                    const int32_t a = (p0[3] * (kWeightOne - fx) + p1[3] * fx + kWeightHalf) >> kWeightBits;
+                    alpha_inv[i * 3 + 0] = alpha_inv[i * 3 + 1] = alpha_inv[i * 3 + 2] = kWeightOne - a;
+                }
+                uint8_t* dst = dst_row + x_start * 3;
+                /* color and alpha are rounded independently, so the sum may exceed 255 by 1 */
+#pragma omp simd
+                for (int32_t j = 0; j < n * 3; j++) {
+                    dst[j] = static_cast<uint8_t>((std::min)((dst[j] * alpha_inv[j] + color[j] + kWeightHalf) >> kWeightBits, 255));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SEG_OVERLAY_
+#define SEG_OVERLAY_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* Overlay of a segmentation result (low resolution label map or alpha map) on the frame */
+/*   colorization (LUT), upscaling (nearest / bilinear) and alpha blending are fused into one pass over the frame, row by row in parallel */
+/*   no intermediate full size image. both label maps and alpha maps are a uint8_t map + a LUT of 256 premultiplied colors: */
+/*     label: (color * alpha, alpha) of the class, alpha: (color * alpha, alpha) of the alpha value */
+/*   bilinear interpolates the colors (the same as resizing the colorized map), not the labels */
+/*   fixed point (alpha and weights are 0 - 256) */
+class SegOverlay {
+public:
+    enum {
+        kInterNearest = 0,
+        kInterLinear,
+    };
+    static constexpr int32_t kColorNumMax = 256;
+
+public:
+    SegOverlay();
+    ~SegOverlay();
+
+    /* palette: [num][3] (B, G, R). alpha: [num] (0 - 255), nullptr for opaque. labels out of the palette are transparent */
+    void SetPalette(const uint8_t* palette, int32_t num, const uint8_t* alpha = nullptr);
+
+    /* image: [image_height][image_width][3] (B, G, R), blended in place. ratio: opacity of the overlay (0.0 - 1.0) */
+    void BlendLabel(const uint8_t* label, int32_t width, int32_t height, uint8_t* image, int32_t image_width, int32_t image_height,
+        float ratio, int32_t interpolation = kInterLinear);
+    /* alpha: [height][width] (0 - 255). color (B, G, R) is blended with the opacity of alpha * ratio */
+    void BlendAlpha(const uint8_t* alpha, int32_t width, int32_t height, const uint8_t color[3], uint8_t* image, int32_t image_width, int32_t image_height,
+        float ratio, int32_t interpolation = kInterLinear);
+
+private:
+    void Composite(const uint8_t* src, int32_t width, int32_t height, uint8_t* image, int32_t image_width, int32_t image_height, int32_t interpolation);
+    void UpdateIndex(int32_t width, int32_t image_width, int32_t interpolation);
+
+private:
+    std::vector<uint8_t> palette_;      /* [kColorNumMax][4] (B, G, R, alpha) */
+    int32_t lut_[kColorNumMax][4];      /* premultiplied (B * a, G * a, R * a, a). a = 0 - 256 */
+
+    /* horizontal index for the image width (kept while the size is the same) */
+    int32_t index_key_[3];              /* width, image_width, interpolation */
+    std::vector<int32_t> x0_list_;
+    std::vector<int32_t> x1_list_;
+    std::vector<int32_t> fx_list_;      /* 0 - 256 */
+};
+
+#endif
@@ -0,0 +1,345 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "seg_post_process.h"
+
+/*** Macro ***/
+/* the number of pixels to use multi threads */
+#define PARALLEL_THRESHOLD 16384
+/* the number of pixels processed at once */
+#define BLOCK_SIZE 64
+
+
+namespace SegPostProcess
+{
+
+/* float -> int32_t with the same order (for the comparison in int, which is vectorized unlike the comparison in float) */
+static inline int32_t OrderedKey(float value)
+{
+    int32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits ^ ((bits >> 31) & 0x7FFFFFFF);
+}
+
+/* the same as fast_exp in common_helper.cpp, except that the underflow (x < about -88) is 0 */
+static inline float FastExp(float x)
+{
+    const int32_t bits = (std::max)(static_cast<int32_t>((1 << 23) * (1.4426950409f * x + 126.93490512f)), 0);
+    float ret;
+    std::memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+
+/* argmax only: pixels in SIMD lanes. each channel is read with the stride of the pixel (no transposition to a buffer) */
+static void ArgMaxBlock(const float* logit, int32_t n, int32_t channel, uint8_t* label)
+{
+    int32_t key_max[BLOCK_SIZE];
+    int32_t index_max[BLOCK_SIZE];
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) {
+        key_max[i] = OrderedKey(logit[i * channel]);
+        index_max[i] = 0;
+    }
+    for (int32_t c = 1; c < channel; c++) {
+        const float* src = logit + c;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const int32_t key = OrderedKey(src[i * channel]);
+            const bool is_larger = key > key_max[i];
+            key_max[i] = is_larger ? key : key_max[i];
+            index_max[i] = is_larger ? c : index_max[i];
+        }
+    }
+    for (int32_t i = 0; i < n; i++) label[i] = static_cast<uint8_t>(index_max[i]);
+}
+
+static void SoftMaxArgMaxBlock(const float* logit, int32_t n, int32_t channel, uint8_t* label, float* prob, int32_t prob_stride, float* buffer)
+{
+    /* buffer: [channel][BLOCK_SIZE] */
+    for (int32_t i = 0; i < n; i++) {
+        for (int32_t c = 0; c < channel; c++) {
+            buffer[c * BLOCK_SIZE + i] = logit[i * channel + c];
+        }
+    }
+
+    int32_t key_max[BLOCK_SIZE];
+    int32_t index_max[BLOCK_SIZE];
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) {
+        key_max[i] = OrderedKey(buffer[i]);
+        index_max[i] = 0;
+    }
+    for (int32_t c = 1; c < channel; c++) {
+        const float* src = buffer + c * BLOCK_SIZE;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const int32_t key = OrderedKey(src[i]);
+            const bool is_larger = key > key_max[i];
+            key_max[i] = is_larger ? key : key_max[i];
+            index_max[i] = is_larger ? c : index_max[i];
+        }
+    }
+    for (int32_t i = 0; i < n; i++) label[i] = static_cast<uint8_t>(index_max[i]);
+
+    /* the max value is recovered from the key (the key is its own inverse) */
+    float value_max[BLOCK_SIZE];
+    float sum[BLOCK_SIZE];
+    for (int32_t i = 0; i < n; i++) {
+        const int32_t bits = key_max[i] ^ ((key_max[i] >> 31) & 0x7FFFFFFF);
+        std::memcpy(&value_max[i], &bits, sizeof(float));
+        sum[i] = 0;
+    }
+    for (int32_t c = 0; c < channel; c++) {
+        float* src = buffer + c * BLOCK_SIZE;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            src[i] = FastExp(src[i] - value_max[i]);
+            sum[i] += src[i];
+        }
+    }
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) sum[i] = 1 / sum[i];
+    for (int32_t c = 0; c < channel; c++) {
+        const float* src = buffer + c * BLOCK_SIZE;
+        float* dst = prob + static_cast<size_t>(c) * prob_stride;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            dst[i] = src[i] * sum[i];
+        }
+    }
+}
+
+/* softmax of one class for SegClassMap. pixels are at every pixel_stride floats */
+/*   value_max, sum_inv: the denominator (to be cached), value: the logit of the class, prob: the probability of the class */
+static void SoftMaxClassBlock(const float* logit, int32_t n, int32_t channel, int32_t pixel_stride, int32_t class_id, float* buffer,
+    float* value_max, float* sum_inv, float* value, float* prob)
+{
+    /* buffer: [channel][BLOCK_SIZE] */
+    for (int32_t i = 0; i < n; i++) {
+        for (int32_t c = 0; c < channel; c++) {
+            buffer[c * BLOCK_SIZE + i] = logit[i * pixel_stride + c];
+        }
+    }
+
+    int32_t key_max[BLOCK_SIZE];
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) key_max[i] = OrderedKey(buffer[i]);
+    for (int32_t c = 1; c < channel; c++) {
+        const float* src = buffer + c * BLOCK_SIZE;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) key_max[i] = (std::max)(key_max[i], OrderedKey(src[i]));
+    }
+    float sum[BLOCK_SIZE];
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) {
+        const int32_t bits = key_max[i] ^ ((key_max[i] >> 31) & 0x7FFFFFFF);
+        std::memcpy(&value_max[i], &bits, sizeof(float));
+        sum[i] = 0;
+    }
+    for (int32_t c = 0; c < channel; c++) {
+        const float* src = buffer + c * BLOCK_SIZE;
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) sum[i] += FastExp(src[i] - value_max[i]);
+    }
+    const float* src = buffer + class_id * BLOCK_SIZE;
+#pragma omp simd
+    for (int32_t i = 0; i < n; i++) {
+        sum_inv[i] = 1 / sum[i];
+        value[i] = src[i];
+        prob[i] = FastExp(src[i] - value_max[i]) * sum_inv[i];
+    }
+}
+
+void SoftMaxArgMax(const float* logit, int32_t pixel_num, int32_t channel, uint8_t* label, float* prob)
+{
+    if (pixel_num <= 0 || channel <= 0 || channel > kChannelMax) return;
+    const int32_t block_num = (pixel_num + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel if (pixel_num > PARALLEL_THRESHOLD)
+    {
+        std::vector<float> buffer(prob ? static_cast<size_t>(channel) * BLOCK_SIZE : 0);
+#pragma omp for
+        for (int32_t block = 0; block < block_num; block++) {
+            const int32_t i0 = block * BLOCK_SIZE;
+            const int32_t n = (std::min)(BLOCK_SIZE, pixel_num - i0);
+            if (prob) {
+                SoftMaxArgMaxBlock(logit + static_cast<size_t>(i0) * channel, n, channel, label + i0, prob + i0, pixel_num, buffer.data());
+            } else {
+                ArgMaxBlock(logit + static_cast<size_t>(i0) * channel, n, channel, label + i0);
+            }
+        }
+    }
+}
+
+}
+
+
+SegClassMap::SegClassMap()
+    : tensor_(nullptr), height_(0), width_(0), channel_(0), is_logit_(false)
+{
+}
+
+SegClassMap::~SegClassMap()
+{
+}
+
+void SegClassMap::Set(const float* tensor, int32_t height, int32_t width, int32_t channel, bool is_logit)
+{
+    tensor_ = tensor;
+    height_ = height;
+    width_ = width;
+    channel_ = channel;
+    is_logit_ = is_logit;
+    for (auto& cache : cache_list_) cache.is_valid = false;
+}
+
+SegClassMap::Cache& SegClassMap::FindCache(int32_t type, int32_t class_id, int32_t step)
+{
+    for (auto& cache : cache_list_) {
+        if (cache.type == type && cache.class_id == class_id && cache.step == step) return cache;
+    }
+    Cache cache;
+    cache.type = type;
+    cache.class_id = class_id;
+    cache.step = step;
+    cache.is_valid = false;
+    cache_list_.push_back(cache);
+    return cache_list_.back();
+}
+
+const float* SegClassMap::GetValue(int32_t class_id, int32_t step)
+{
+    if (!tensor_ || class_id < 0 || class_id >= channel_ || step <= 0) return nullptr;
+    Cache& cache = FindCache(kTypeValue, class_id, step);
+    if (cache.is_valid) return cache.data.data();
+
+    const int32_t height = GetHeight(step);
+    const int32_t width = GetWidth(step);
+    cache.data.resize(static_cast<size_t>(height) * width);
+    float* dst = cache.data.data();
+#pragma omp parallel for if (height * width > PARALLEL_THRESHOLD)
+    for (int32_t y = 0; y < height; y++) {
+        const float* src = tensor_ + static_cast<size_t>(y) * step * width_ * channel_ + class_id;
+        for (int32_t x = 0; x < width; x++) {
+            dst[y * width + x] = src[static_cast<size_t>(x) * step * channel_];
+        }
+    }
+    cache.is_valid = true;
+    return cache.data.data();
+}
+
+const float* SegClassMap::GetProbabilityAll(uint8_t* label)
+{
+    if (!tensor_ || channel_ <= 0 || channel_ > SegPostProcess::kChannelMax) return nullptr;
+    Cache& cache = FindCache(kTypeProbabilityAll, -1, 1);
+    const int32_t pixel_num = height_ * width_;
+    if (cache.is_valid) {
+        if (label) SegPostProcess::SoftMaxArgMax(tensor_, pixel_num, channel_, label);
+        return cache.data.data();
+    }
+
+    cache.data.resize(static_cast<size_t>(channel_) * pixel_num);
+    float* dst = cache.data.data();
+    if (is_logit_) {
+        if (!label) {
+            label_.resize(pixel_num);
+            label = label_.data();
+        }
+        SegPostProcess::SoftMaxArgMax(tensor_, pixel_num, channel_, label, dst);
+    } else {
+        /* already probabilities: only the transposition to planar */
+        const int32_t channel = channel_;
+        const float* tensor = tensor_;
+#pragma omp parallel for if (pixel_num > PARALLEL_THRESHOLD)
+        for (int32_t i0 = 0; i0 < pixel_num; i0 += BLOCK_SIZE) {
+            const int32_t n = (std::min)(BLOCK_SIZE, pixel_num - i0);
+            for (int32_t c = 0; c < channel; c++) {
+                for (int32_t i = i0; i < i0 + n; i++) {
+                    dst[static_cast<size_t>(c) * pixel_num + i] = tensor[static_cast<size_t>(i) * channel + c];
+                }
+            }
+        }
+        if (label) SegPostProcess::SoftMaxArgMax(tensor_, pixel_num, channel_, label);
+    }
+    cache.is_valid = true;
+    return cache.data.data();
+}
+
+const float* SegClassMap::GetProbability(int32_t class_id, int32_t step)
+{
+    if (!tensor_ || class_id < 0 || class_id >= channel_ || step <= 0) return nullptr;
+    if (step == 1) {
+        const Cache& cache_all = FindCache(kTypeProbabilityAll, -1, 1);
+        if (cache_all.is_valid) return cache_all.data.data() + static_cast<size_t>(class_id) * height_ * width_;
+    }
+    if (!is_logit_) return GetValue(class_id, step);
+    /* all the entries are created first, so that the list is not changed and the references are kept after here */
+    FindCache(kTypeDenominator, 0, step);
+    FindCache(kTypeValue, class_id, step);
+    Cache& cache = FindCache(kTypeProbability, class_id, step);
+    Cache& cache_denominator = FindCache(kTypeDenominator, 0, step);
+    Cache& cache_value = FindCache(kTypeValue, class_id, step);
+    if (cache.is_valid) return cache.data.data();
+
+    const int32_t height = GetHeight(step);
+    const int32_t width = GetWidth(step);
+    const size_t size = static_cast<size_t>(height) * width;
+    const bool has_denominator = cache_denominator.is_valid;
+    const float* value = has_denominator ? GetValue(class_id, step) : nullptr;
+    cache.data.resize(size);
+    float* dst = cache.data.data();
+
+    if (has_denominator) {
+        /* p = exp(logit - max) / sum. the same as SoftMaxArgMax */
+        const float* value_max = cache_denominator.data.data();
+        const float* sum_inv = value_max + size;
+#pragma omp simd
+        for (int32_t i = 0; i < static_cast<int32_t>(size); i++) {
+            dst[i] = SegPostProcess::FastExp(value[i] - value_max[i]) * sum_inv[i];
+        }
+    } else {
+        /* the first class: the denominator, the value and the probability in one pass of the tensor */
+        cache_denominator.data.resize(size * 2);
+        cache_value.data.resize(size);
+        float* value_max = cache_denominator.data.data();
+        float* sum_inv = value_max + size;
+        float* dst_value = cache_value.data.data();
+        const int32_t block_num = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel if (height * width > PARALLEL_THRESHOLD)
+        {
+            std::vector<float> buffer(static_cast<size_t>(channel_) * BLOCK_SIZE);
+#pragma omp for
+            for (int32_t y = 0; y < height; y++) {
+                for (int32_t block = 0; block < block_num; block++) {
+                    const int32_t x0 = block * BLOCK_SIZE;
+                    const size_t offset = static_cast<size_t>(y) * width + x0;
+                    const float* src = tensor_ + (static_cast<size_t>(y) * step * width_ + static_cast<size_t>(x0) * step) * channel_;
+                    SegPostProcess::SoftMaxClassBlock(src, (std::min)(BLOCK_SIZE, width - x0), channel_, step * channel_, class_id, buffer.data(),
+                        value_max + offset, sum_inv + offset, dst_value + offset, dst + offset);
+                }
+            }
+        }
+        cache_denominator.is_valid = true;
+        cache_value.is_valid = true;
+    }
+    cache.is_valid = true;
+    return cache.data.data();
+}
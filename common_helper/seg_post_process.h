@@ -0,0 +1,94 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SEG_POST_PROCESS_
+#define SEG_POST_PROCESS_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* Post process of semantic segmentation output */
+/*   the output tensor is interleaved ([pixel][channel], NHWC), and the results are planar ([channel][pixel]) */
+/*   no allocation per pixel, and argmax and softmax are done in one pass of the tensor */
+/*   with softmax, pixels are processed in blocks: a block is transposed to planar in a small buffer, and then every step runs over pixels in SIMD lanes */
+/*   argmax only also runs over pixels in SIMD lanes, but reads the tensor with the stride of the pixel instead of the transposition */
+namespace SegPostProcess
+{
+
+constexpr int32_t kChannelMax = 256;    /* label is uint8_t */
+
+/* logit: [pixel_num][channel], label: [pixel_num] (index of the max logit. the first one for ties, the same as std::max_element) */
+/* prob: [channel][pixel_num] (softmax with the same approximated exp as CommonHelper::SoftMaxFast). nullptr to calculate argmax only */
+void SoftMaxArgMax(const float* logit, int32_t pixel_num, int32_t channel, uint8_t* label, float* prob = nullptr);
+
+}
+
+/* Per-class maps of a segmentation output tensor, computed on the first access and cached until the next Set */
+/*   most consumers use only the argmax map or a few classes (e.g. road), so maps are not created for all the classes every frame */
+/*   a map can be at reduced resolution (pixels at every step, nearest), which also reduces reading the tensor */
+/*   the softmax denominator (max and 1 / sum of each pixel) is created with the first class and cached per step, */
+/*   so the second class costs only reading the class and one exp per pixel */
+/*   buffers are kept across frames */
+/*   when all the classes are used, GetProbabilityAll creates them in one fused pass (SegPostProcess::SoftMaxArgMax), */
+/*   which is much cheaper than GetProbability for each class (a strided read of the whole tensor per class) */
+class SegClassMap {
+public:
+    SegClassMap();
+    ~SegClassMap();
+
+    /* tensor: [height][width][channel]. is_logit: softmax is applied for probabilities (otherwise the tensor is already probabilities) */
+    /* the tensor is not copied, and must be kept until the next Set */
+    void Set(const float* tensor, int32_t height, int32_t width, int32_t channel, bool is_logit);
+
+    int32_t GetHeight(int32_t step = 1) const { return (height_ + step - 1) / step; }
+    int32_t GetWidth(int32_t step = 1) const { return (width_ + step - 1) / step; }
+    int32_t GetChannel() const { return channel_; }
+
+    /* [GetHeight(step)][GetWidth(step)]. nullptr for an invalid class or step */
+    const float* GetProbability(int32_t class_id, int32_t step = 1);
+    const float* GetValue(int32_t class_id, int32_t step = 1);      /* the tensor as is (logit or probability) */
+
+    /* all the classes at full resolution: [channel][height][width]. GetProbability(class_id) returns a plane of it after this */
+    /* label: [height][width] (argmax) is also written if not nullptr, without another pass for logits */
+    const float* GetProbabilityAll(uint8_t* label = nullptr);
+
+private:
+    enum {
+        kTypeValue = 0,
+        kTypeProbability,
+        kTypeDenominator,   /* [2][height][width] = (max, 1 / sum) */
+        kTypeProbabilityAll,/* [channel][height][width] */
+    };
+    typedef struct Cache_ {
+        int32_t type;
+        int32_t class_id;
+        int32_t step;
+        bool    is_valid;
+        std::vector<float> data;
+    } Cache;
+
+    Cache& FindCache(int32_t type, int32_t class_id, int32_t step);
+
+private:
+    const float* tensor_;
+    int32_t height_;
+    int32_t width_;
+    int32_t channel_;
+    bool is_logit_;
+    std::vector<Cache> cache_list_;
+    std::vector<uint8_t> label_;    /* argmax of GetProbabilityAll when the caller doesn't need it */
+};
+
+#endif
@@ -0,0 +1,53 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SIMD_HELPER_
+#define SIMD_HELPER_
+
+#include <cstdint>
+#include <cstring>
+
+/* Small inline helpers written so that the loops calling them are vectorized (#pragma omp simd) */
+namespace SimdHelper
+{
+/* added before truncation to int so that the truncation works as floor for values down to -kFloorBias */
+static constexpr int32_t kFloorBias = 4096;
+
+/* floor(x) for x > -kFloorBias */
+/*   x a little (< 1 / 2048 for |x| < 4096) below an integer may be rounded up to it. it's harmless for the interpolation, where the fraction becomes a little negative */
+/*   std::floor is a library call on SSE2 and stops the vectorization, the truncation of the biased value is one instruction */
+static inline int32_t FloorBiased(float x)
+{
+    return static_cast<int32_t>(x + kFloorBias) - kFloorBias;
+}
+
+/* (s > 0) ? a : b */
+/*   the compiler keeps a ternary on a floating point comparison as a branch ("control flow in loop"), */
+/*   so the select is done with an integer mask on the bit patterns, which is straight-line code and vectorized */
+/*   s is compared as int32, so +0 and any negative value (including -0) select b */
+static inline float SelectIfPositive(float s, float a, float b)
+{
+    int32_t bits_s, bits_a, bits_b;
+    std::memcpy(&bits_s, &s, sizeof(bits_s));
+    std::memcpy(&bits_a, &a, sizeof(bits_a));
+    std::memcpy(&bits_b, &b, sizeof(bits_b));
+    const int32_t mask = -static_cast<int32_t>(bits_s > 0);
+    const int32_t bits = (bits_a & mask) | (bits_b & ~mask);
+    float ret;
+    std::memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+}
+
+#endif
@@ -18,12 +18,56 @@ limitations under the License.
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
 #include <vector>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
-class SimpleMatrix
+/*** Switch ***/
+/* index of operator() is checked only in debug build */
+#ifndef NDEBUG
+#define SIMPLE_MATRIX_CHECK_INDEX
+#endif
+
+/* Matrix with dynamic shape (double) */
+/*   operator+, -, * and Transpose() return lazy expressions, which are evaluated element by element when assigned to a SimpleMatrix */
+/*   e.g. "P = F * P * F.Transpose() + Q" has no temporary except for the nested product (F * P) */
+/*   an operand of a product is evaluated once in advance if it contains a product (otherwise each element would be calculated many times) */
+/*   an expression refers to its operands, so don't keep it (e.g. "auto e = a + b;") longer than the operands */
+class SimpleMatrix;
+
+template<typename E>
+class SimpleMatrixTranspose;
+
+template<typename E>
+class SimpleMatrixExpr
+{
+public:
+	const E& Derived() const { return static_cast<const E&>(*this); }
+	SimpleMatrixTranspose<E> Transpose() const;
+	SimpleMatrix Eval() const;
+	void Display() const;
+};
+
+/* how an expression is held as an operand: a matrix by reference, an expression node by value */
+template<typename E>
+struct SimpleMatrixOperand { typedef const E type; };
+template<>
+struct SimpleMatrixOperand<SimpleMatrix> { typedef const SimpleMatrix& type; };
+
+/* an operand of a product is evaluated in advance if it contains a product */
+template<typename E>
+struct SimpleMatrixProductOperand {
+	typedef typename std::conditional<E::kHasProduct, const SimpleMatrix, typename SimpleMatrixOperand<E>::type>::type type;
+};
+
+
+class SimpleMatrix : public SimpleMatrixExpr<SimpleMatrix>
 {
 public:
+	enum { kHasProduct = 0 };
+
 	SimpleMatrix()
 	{
 		rows = 0;
@@ -48,107 +92,129 @@ public:
 		}
 	}
 
+	template<typename E>
+	SimpleMatrix(const SimpleMatrixExpr<E>& expr)
+	{
+		rows = 0;
+		cols = 0;
+		Assign(expr.Derived());
+	}
+
+	SimpleMatrix(const SimpleMatrix&) = default;
+	SimpleMatrix(SimpleMatrix&&) = default;
+	SimpleMatrix& operator=(const SimpleMatrix&) = default;
+	SimpleMatrix& operator=(SimpleMatrix&&) = default;
+
 	~SimpleMatrix() {}
 
+	template<typename E>
+	SimpleMatrix& operator=(const SimpleMatrixExpr<E>& expr)
+	{
+		if (expr.Derived().IsAliased(*this)) {
+			/* e.g. X = F * X */
+			SimpleMatrix ret(expr);
+			*this = std::move(ret);
+		} else {
+			Assign(expr.Derived());
+		}
+		return *this;
+	}
+
 	double& operator() (int32_t y, int32_t x)
 	{
+#ifdef SIMPLE_MATRIX_CHECK_INDEX
 		if (y >= rows || x >= cols) {
 			throw std::out_of_range("Invalid index");
 		}
+#endif
 		return data_array[y * cols + x];
 	}
 
 	const double& operator() (int32_t y, int32_t x) const
 	{
+#ifdef SIMPLE_MATRIX_CHECK_INDEX
 		if (y >= rows || x >= cols) {
 			throw std::out_of_range("Invalid index");
 		}
+#endif
 		return data_array[y * cols + x];
 	}
 
-	const SimpleMatrix operator+ (const SimpleMatrix& mat2) const
+	/*** In-place operations (no allocation) ***/
+	template<typename E>
+	SimpleMatrix& operator+= (const SimpleMatrixExpr<E>& expr)
 	{
-		if (!CheckShape() || !mat2.CheckShape() || !CheckShapeSame(mat2)) {
-			throw std::out_of_range("Invalid shape at add");
-		}
-
-		const SimpleMatrix& mat1 = *this;
-		SimpleMatrix ret(mat1.rows, mat1.cols);
-
-		for (int32_t y = 0; y < rows; y++) {
-			for (int32_t x = 0; x < cols; x++) {
-				ret(y, x) = mat1(y, x) + mat2(y, x);
-			}
-		}
-		return ret;
+		return AddInPlace(expr.Derived(), 1.0, "Invalid shape at add");
 	}
 
-	const SimpleMatrix operator- (const SimpleMatrix& mat2) const
+	template<typename E>
+	SimpleMatrix& operator-= (const SimpleMatrixExpr<E>& expr)
 	{
-		if (!CheckShape() || !mat2.CheckShape() || !CheckShapeSame(mat2)) {
-			throw std::out_of_range("Invalid shape at sub");
-		}
-
-		const SimpleMatrix& mat1 = *this;
-		SimpleMatrix ret(mat1.rows, mat1.cols);
+		return AddInPlace(expr.Derived(), -1.0, "Invalid shape at sub");
+	}
 
-		for (int32_t y = 0; y < rows; y++) {
-			for (int32_t x = 0; x < cols; x++) {
-				ret(y, x) = mat1(y, x) - mat2(y, x);
-			}
-		}
-		return ret;
+	SimpleMatrix& operator*= (const double& k)
+	{
+		for (auto& v : data_array) v *= k;
+		return *this;
 	}
 
-	const SimpleMatrix operator* (const SimpleMatrix& mat2) const 
+	/* this = this * mat2. each row is calculated in a row buffer */
+	SimpleMatrix& operator*= (const SimpleMatrix& mat2);
+
+	/*** Products into a destination (dst must be different from the operands. dst is reallocated only when the shape changes) ***/
+	/* dst = mat1 * mat2 */
+	static void Multiply(const SimpleMatrix& mat1, const SimpleMatrix& mat2, SimpleMatrix& dst)
 	{
-		if (!CheckShape() || !mat2.CheckShape() || !CheckShapeMul(mat2)) {
-			throw std::out_of_range("Invalid shape at mul");
+		if (!mat1.CheckShape() || !mat2.CheckShape() || mat1.cols != mat2.rows || &dst == &mat1 || &dst == &mat2) {
+			throw std::out_of_range("Invalid shape at Multiply");
 		}
-		
-		const SimpleMatrix& mat1 = *this;
-		SimpleMatrix ret(mat1.rows, mat2.cols);
-
+		dst.Resize(mat1.rows, mat2.cols);
 		for (int32_t y = 0; y < mat1.rows; y++) {
-			for (int32_t x = 0; x < mat2.cols; x++) {
-				double sum = 0;
-				for (int32_t i = 0; i < mat1.cols; i++) {
-					sum += mat1(y, i) * mat2(i, x);
-				}
-				ret(y, x) = sum;
+			double* d = &dst.data_array[y * dst.cols];
+			for (int32_t x = 0; x < dst.cols; x++) d[x] = 0;
+			for (int32_t i = 0; i < mat1.cols; i++) {
+				const double a = mat1.data_array[y * mat1.cols + i];
+				const double* b = &mat2.data_array[i * mat2.cols];
+				for (int32_t x = 0; x < dst.cols; x++) d[x] += a * b[x];
 			}
 		}
-		return ret;
 	}
 
-	const SimpleMatrix operator* (const double& k) const
+	/* dst = mat1 * mat2^T (both operands are read row by row) */
+	static void MultiplyTransposed(const SimpleMatrix& mat1, const SimpleMatrix& mat2, SimpleMatrix& dst)
 	{
-		const SimpleMatrix& mat1 = *this;
-		SimpleMatrix ret(mat1.rows, mat1.cols);
-
-		for (int32_t y = 0; y < rows; y++) {
-			for (int32_t x = 0; x < cols; x++) {
-				ret(y, x) = mat1(y, x) * k;
+		if (!mat1.CheckShape() || !mat2.CheckShape() || mat1.cols != mat2.cols || &dst == &mat1 || &dst == &mat2) {
+			throw std::out_of_range("Invalid shape at MultiplyTransposed");
+		}
+		dst.Resize(mat1.rows, mat2.rows);
+		for (int32_t y = 0; y < mat1.rows; y++) {
+			const double* a = &mat1.data_array[y * mat1.cols];
+			for (int32_t x = 0; x < mat2.rows; x++) {
+				const double* b = &mat2.data_array[x * mat2.cols];
+				double sum = 0;
+				for (int32_t i = 0; i < mat1.cols; i++) sum += a[i] * b[i];
+				dst.data_array[y * dst.cols + x] = sum;
 			}
 		}
-		return ret;
 	}
 
-	SimpleMatrix Transpose() const
+	/* dst = mat1^T * mat2 */
+	static void TransposedMultiply(const SimpleMatrix& mat1, const SimpleMatrix& mat2, SimpleMatrix& dst)
 	{
-		if (!CheckShape()) {
-			throw std::out_of_range("Invalid shape at transpose");
+		if (!mat1.CheckShape() || !mat2.CheckShape() || mat1.rows != mat2.rows || &dst == &mat1 || &dst == &mat2) {
+			throw std::out_of_range("Invalid shape at TransposedMultiply");
 		}
-		
-		const SimpleMatrix& mat1 = *this;
-		SimpleMatrix ret(mat1.cols, mat1.rows);
-
-		for (int32_t y = 0; y < rows; y++) {
-			for (int32_t x = 0; x < cols; x++) {
-				ret(x, y) = mat1(y, x);
+		dst.Resize(mat1.cols, mat2.cols);
+		for (auto& v : dst.data_array) v = 0;
+		for (int32_t i = 0; i < mat1.rows; i++) {
+			const double* b = &mat2.data_array[i * mat2.cols];
+			for (int32_t y = 0; y < mat1.cols; y++) {
+				const double a = mat1.data_array[i * mat1.cols + y];
+				double* d = &dst.data_array[y * dst.cols];
+				for (int32_t x = 0; x < dst.cols; x++) d[x] += a * b[x];
 			}
 		}
-		return ret;
 	}
 
 	SimpleMatrix Inverse() const
@@ -161,7 +227,7 @@ public:
 		SimpleMatrix mat = *this;
 		int32_t n = mat.rows;
 		SimpleMatrix I = SimpleMatrix::IdentityMatrix(n);
-		
+
 		for (int32_t y = 0; y < n; y++) {
 			if (mat(y, y) == 0) {
 				throw std::out_of_range("Tried to calculate an inverse of non - singular matrix");
@@ -185,6 +251,87 @@ public:
 		return I;
 	}
 
+	/*** Linear solve (use instead of Inverse()) ***/
+	/* return X such that this * X = b. LU decomposition with partial pivoting */
+	SimpleMatrix SolveLu(const SimpleMatrix& b) const
+	{
+		if (!CheckShape() || !b.CheckShape() || rows != cols || b.rows != rows) {
+			throw std::out_of_range("Invalid shape at SolveLu");
+		}
+		const int32_t n = rows;
+		SimpleMatrix lu = *this;
+		SimpleMatrix x = b;
+		for (int32_t k = 0; k < n; k++) {
+			int32_t pivot = k;
+			for (int32_t y = k + 1; y < n; y++) {
+				if (std::fabs(lu.data_array[y * n + k]) > std::fabs(lu.data_array[pivot * n + k])) pivot = y;
+			}
+			if (lu.data_array[pivot * n + k] == 0) {
+				throw std::out_of_range("Tried to solve with a singular matrix");
+			}
+			if (pivot != k) {
+				lu.SwapRows(pivot, k);
+				x.SwapRows(pivot, k);
+			}
+			const double scale = 1.0 / lu.data_array[k * n + k];
+			for (int32_t y = k + 1; y < n; y++) {
+				const double l = lu.data_array[y * n + k] * scale;
+				lu.data_array[y * n + k] = l;
+				for (int32_t i = k + 1; i < n; i++) lu.data_array[y * n + i] -= l * lu.data_array[k * n + i];
+				for (int32_t i = 0; i < x.cols; i++) x.data_array[y * x.cols + i] -= l * x.data_array[k * x.cols + i];
+			}
+		}
+		/* back substitution (U * X = L^-1 * P * b) */
+		for (int32_t y = n - 1; y >= 0; y--) {
+			const double scale = 1.0 / lu.data_array[y * n + y];
+			for (int32_t i = 0; i < x.cols; i++) {
+				double sum = x.data_array[y * x.cols + i];
+				for (int32_t k = y + 1; k < n; k++) sum -= lu.data_array[y * n + k] * x.data_array[k * x.cols + i];
+				x.data_array[y * x.cols + i] = sum * scale;
+			}
+		}
+		return x;
+	}
+
+	/* return X such that this * X = b. this must be symmetric positive definite (e.g. covariance). Cholesky decomposition (this = L * L^T) */
+	SimpleMatrix SolveCholesky(const SimpleMatrix& b) const
+	{
+		if (!CheckShape() || !b.CheckShape() || rows != cols || b.rows != rows) {
+			throw std::out_of_range("Invalid shape at SolveCholesky");
+		}
+		const int32_t n = rows;
+		SimpleMatrix l(n, n);
+		for (int32_t y = 0; y < n; y++) {
+			for (int32_t x = 0; x <= y; x++) {
+				double sum = data_array[y * n + x];
+				for (int32_t k = 0; k < x; k++) sum -= l.data_array[y * n + k] * l.data_array[x * n + k];
+				if (x == y) {
+					if (sum <= 0) {
+						throw std::out_of_range("Tried to solve with a non positive definite matrix");
+					}
+					l.data_array[y * n + y] = std::sqrt(sum);
+				} else {
+					l.data_array[y * n + x] = sum / l.data_array[x * n + x];
+				}
+			}
+		}
+		/* L * Y = b, then L^T * X = Y */
+		SimpleMatrix x = b;
+		for (int32_t i = 0; i < x.cols; i++) {
+			for (int32_t y = 0; y < n; y++) {
+				double sum = x.data_array[y * x.cols + i];
+				for (int32_t k = 0; k < y; k++) sum -= l.data_array[y * n + k] * x.data_array[k * x.cols + i];
+				x.data_array[y * x.cols + i] = sum / l.data_array[y * n + y];
+			}
+			for (int32_t y = n - 1; y >= 0; y--) {
+				double sum = x.data_array[y * x.cols + i];
+				for (int32_t k = y + 1; k < n; k++) sum -= l.data_array[k * n + y] * x.data_array[k * x.cols + i];
+				x.data_array[y * x.cols + i] = sum / l.data_array[y * n + y];
+			}
+		}
+		return x;
+	}
+
 
 	void Display() const
 	{
@@ -209,60 +356,7 @@ public:
 		return ret;
 	}
 
-	static void Test()
-	{
-		try {
-			SimpleMatrix mat1(2, 3, { 1, 2, 3, 4, 5, 6 });
-			SimpleMatrix mat2(2, 3, { 7, 8, 9, 10, 11, 12 });
-			SimpleMatrix mat3(3, 2, { 1, 2, 3, 4, 5, 6 });
-			SimpleMatrix mat4(2, 2, { 1, 2, 3, 4 });
-			SimpleMatrix mat5(3, 3, { 2, 2, 3, 4, 5, 6, 7, 8, 9 });
-			SimpleMatrix mat6(3, 3, { 1, 2, 3, 4, 5, 6, 7, 8, 9 });
-
-			printf("\n--- mat1 ---\n");
-			mat1.Display();
-			
-			printf("\n--- mat2 ---\n");
-			mat2.Display();
-
-			printf("\n--- add ---\n");
-			SimpleMatrix matAdd = mat1 + mat2;
-			matAdd.Display();
-
-			printf("\n--- sub ---\n");
-			SimpleMatrix matSub = mat1 - mat2;
-			matSub.Display();
-
-			printf("\n--- mul ---\n");
-			SimpleMatrix matMul = mat1 * mat3;
-			matMul.Display();
-
-			printf("\n--- transpose ---\n");
-			SimpleMatrix matTranspose = mat1.Transpose();
-			matTranspose.Display();
-
-			printf("\n--- Identity matrix ---\n");
-			SimpleMatrix matI = SimpleMatrix::IdentityMatrix(3);
-			matI.Display();
-
-			printf("\n--- Inverse matrix 2x2 ---\n");
-			SimpleMatrix matInv = mat4.Inverse();
-			matInv.Display();
-			(mat4 * matInv).Display();
-			(matInv * mat4).Display();
-
-			printf("\n--- Inverse matrix 3x3 ---\n");
-			matInv = mat5.Inverse();
-			matInv.Display();
-			(mat5 * matInv).Display();
-			(matInv * mat5).Display();
-
-			printf("\n--- Inverse of non-singular matrix 3x3 ---\n");
-			matInv = mat6.Inverse();
-		} catch (std::exception& e) {
-			printf("Exception: %s\n", e.what());
-		}
-	}
+	static void Test();
 
 	bool CheckShape() const
 	{
@@ -283,10 +377,276 @@ public:
 		return true;
 	}
 
+	/*** Interface as an expression ***/
+	int32_t GetRows() const { return rows; }
+	int32_t GetCols() const { return cols; }
+	double Get(int32_t y, int32_t x) const { return data_array[y * cols + x]; }
+	bool Refers(const SimpleMatrix& mat) const { return &mat == this; }
+	bool IsAliased(const SimpleMatrix& mat) const { (void)mat; return false; }  /* reading the same element as writing is safe */
+
+private:
+	void Resize(int32_t _rows, int32_t _cols)
+	{
+		rows = _rows;
+		cols = _cols;
+		data_array.resize(rows * cols);     /* no allocation if the size is the same */
+	}
+
+	template<typename E>
+	void Assign(const E& expr)
+	{
+		Resize(expr.GetRows(), expr.GetCols());
+		for (int32_t y = 0; y < rows; y++) {
+			for (int32_t x = 0; x < cols; x++) {
+				data_array[y * cols + x] = expr.Get(y, x);
+			}
+		}
+	}
+
+	template<typename E>
+	SimpleMatrix& AddInPlace(const E& expr, double sign, const char* message)
+	{
+		if (!CheckShape() || rows != expr.GetRows() || cols != expr.GetCols()) {
+			throw std::out_of_range(message);
+		}
+		if (expr.IsAliased(*this)) {
+			const SimpleMatrix mat(expr);
+			return AddInPlace(mat, sign, message);
+		}
+		for (int32_t y = 0; y < rows; y++) {
+			for (int32_t x = 0; x < cols; x++) {
+				data_array[y * cols + x] += sign * expr.Get(y, x);
+			}
+		}
+		return *this;
+	}
+
+	void SwapRows(int32_t y0, int32_t y1)
+	{
+		for (int32_t x = 0; x < cols; x++) std::swap(data_array[y0 * cols + x], data_array[y1 * cols + x]);
+	}
+
+public:
 	std::vector<double> data_array;
 	int32_t rows;
 	int32_t cols;
 };
 
 
+/*** Expression nodes ***/
+/* Sign = 1: L + R, Sign = -1: L - R */
+template<typename L, typename R, int32_t Sign>
+class SimpleMatrixSum : public SimpleMatrixExpr<SimpleMatrixSum<L, R, Sign>>
+{
+public:
+	enum { kHasProduct = L::kHasProduct || R::kHasProduct };
+	SimpleMatrixSum(const L& lhs, const R& rhs) : lhs_(lhs), rhs_(rhs) {}
+	int32_t GetRows() const { return lhs_.GetRows(); }
+	int32_t GetCols() const { return lhs_.GetCols(); }
+	double Get(int32_t y, int32_t x) const { return (Sign > 0) ? lhs_.Get(y, x) + rhs_.Get(y, x) : lhs_.Get(y, x) - rhs_.Get(y, x); }
+	bool Refers(const SimpleMatrix& mat) const { return lhs_.Refers(mat) || rhs_.Refers(mat); }
+	bool IsAliased(const SimpleMatrix& mat) const { return lhs_.IsAliased(mat) || rhs_.IsAliased(mat); }
+private:
+	typename SimpleMatrixOperand<L>::type lhs_;
+	typename SimpleMatrixOperand<R>::type rhs_;
+};
+
+template<typename E>
+class SimpleMatrixScale : public SimpleMatrixExpr<SimpleMatrixScale<E>>
+{
+public:
+	enum { kHasProduct = E::kHasProduct };
+	SimpleMatrixScale(const E& expr, double k) : expr_(expr), k_(k) {}
+	int32_t GetRows() const { return expr_.GetRows(); }
+	int32_t GetCols() const { return expr_.GetCols(); }
+	double Get(int32_t y, int32_t x) const { return expr_.Get(y, x) * k_; }
+	bool Refers(const SimpleMatrix& mat) const { return expr_.Refers(mat); }
+	bool IsAliased(const SimpleMatrix& mat) const { return expr_.IsAliased(mat); }
+private:
+	typename SimpleMatrixOperand<E>::type expr_;
+	double k_;
+};
+
+template<typename E>
+class SimpleMatrixTranspose : public SimpleMatrixExpr<SimpleMatrixTranspose<E>>
+{
+public:
+	enum { kHasProduct = E::kHasProduct };
+	explicit SimpleMatrixTranspose(const E& expr) : expr_(expr) {}
+	int32_t GetRows() const { return expr_.GetCols(); }
+	int32_t GetCols() const { return expr_.GetRows(); }
+	double Get(int32_t y, int32_t x) const { return expr_.Get(x, y); }
+	bool Refers(const SimpleMatrix& mat) const { return expr_.Refers(mat); }
+	bool IsAliased(const SimpleMatrix& mat) const { return expr_.Refers(mat); }
+private:
+	typename SimpleMatrixOperand<E>::type expr_;
+};
+
+template<typename L, typename R>
+class SimpleMatrixProduct : public SimpleMatrixExpr<SimpleMatrixProduct<L, R>>
+{
+public:
+	enum { kHasProduct = 1 };
+	SimpleMatrixProduct(const L& lhs, const R& rhs) : lhs_(lhs), rhs_(rhs) {}
+	int32_t GetRows() const { return lhs_.GetRows(); }
+	int32_t GetCols() const { return rhs_.GetCols(); }
+	double Get(int32_t y, int32_t x) const
+	{
+		double sum = 0;
+		const int32_t n = lhs_.GetCols();
+		for (int32_t i = 0; i < n; i++) sum += lhs_.Get(y, i) * rhs_.Get(i, x);
+		return sum;
+	}
+	bool Refers(const SimpleMatrix& mat) const { return lhs_.Refers(mat) || rhs_.Refers(mat); }
+	bool IsAliased(const SimpleMatrix& mat) const { return lhs_.Refers(mat) || rhs_.Refers(mat); }
+private:
+	typename SimpleMatrixProductOperand<L>::type lhs_;
+	typename SimpleMatrixProductOperand<R>::type rhs_;
+};
+
+
+template<typename E>
+SimpleMatrixTranspose<E> SimpleMatrixExpr<E>::Transpose() const
+{
+	return SimpleMatrixTranspose<E>(Derived());
+}
+
+template<typename E>
+SimpleMatrix SimpleMatrixExpr<E>::Eval() const
+{
+	return SimpleMatrix(*this);
+}
+
+template<typename E>
+void SimpleMatrixExpr<E>::Display() const
+{
+	Eval().Display();
+}
+
+template<typename L, typename R>
+SimpleMatrixSum<L, R, 1> operator+ (const SimpleMatrixExpr<L>& mat1, const SimpleMatrixExpr<R>& mat2)
+{
+	if (mat1.Derived().GetRows() != mat2.Derived().GetRows() || mat1.Derived().GetCols() != mat2.Derived().GetCols()) {
+		throw std::out_of_range("Invalid shape at add");
+	}
+	return SimpleMatrixSum<L, R, 1>(mat1.Derived(), mat2.Derived());
+}
+
+template<typename L, typename R>
+SimpleMatrixSum<L, R, -1> operator- (const SimpleMatrixExpr<L>& mat1, const SimpleMatrixExpr<R>& mat2)
+{
+	if (mat1.Derived().GetRows() != mat2.Derived().GetRows() || mat1.Derived().GetCols() != mat2.Derived().GetCols()) {
+		throw std::out_of_range("Invalid shape at sub");
+	}
+	return SimpleMatrixSum<L, R, -1>(mat1.Derived(), mat2.Derived());
+}
+
+template<typename L, typename R>
+SimpleMatrixProduct<L, R> operator* (const SimpleMatrixExpr<L>& mat1, const SimpleMatrixExpr<R>& mat2)
+{
+	if (mat1.Derived().GetCols() != mat2.Derived().GetRows()) {
+		throw std::out_of_range("Invalid shape at mul");
+	}
+	return SimpleMatrixProduct<L, R>(mat1.Derived(), mat2.Derived());
+}
+
+template<typename E>
+SimpleMatrixScale<E> operator* (const SimpleMatrixExpr<E>& mat1, const double& k)
+{
+	return SimpleMatrixScale<E>(mat1.Derived(), k);
+}
+
+
+inline SimpleMatrix& SimpleMatrix::operator*= (const SimpleMatrix& mat2)
+{
+	if (!CheckShape() || !mat2.CheckShape() || !CheckShapeMul(mat2) || mat2.rows != mat2.cols) {
+		throw std::out_of_range("Invalid shape at mul");
+	}
+	if (&mat2 == this) {
+		SimpleMatrix ret(*this * mat2);
+		*this = std::move(ret);
+		return *this;
+	}
+	static constexpr int32_t kRowBufferSize = 16;
+	double row_buffer_fixed[kRowBufferSize];
+	std::vector<double> row_buffer_dynamic(cols > kRowBufferSize ? cols : 0);
+	double* row_buffer = cols > kRowBufferSize ? row_buffer_dynamic.data() : row_buffer_fixed;
+	for (int32_t y = 0; y < rows; y++) {
+		double* row = &data_array[y * cols];
+		for (int32_t x = 0; x < cols; x++) row_buffer[x] = row[x];
+		for (int32_t x = 0; x < cols; x++) {
+			double sum = 0;
+			for (int32_t i = 0; i < cols; i++) sum += row_buffer[i] * mat2.data_array[i * cols + x];
+			row[x] = sum;
+		}
+	}
+	return *this;
+}
+
+inline void SimpleMatrix::Test()
+{
+	try {
+		SimpleMatrix mat1(2, 3, { 1, 2, 3, 4, 5, 6 });
+		SimpleMatrix mat2(2, 3, { 7, 8, 9, 10, 11, 12 });
+		SimpleMatrix mat3(3, 2, { 1, 2, 3, 4, 5, 6 });
+		SimpleMatrix mat4(2, 2, { 1, 2, 3, 4 });
+		SimpleMatrix mat5(3, 3, { 2, 2, 3, 4, 5, 6, 7, 8, 9 });
+		SimpleMatrix mat6(3, 3, { 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+		SimpleMatrix mat7(3, 3, { 4, 2, 1, 2, 5, 3, 1, 3, 6 });
+
+		printf("\n--- mat1 ---\n");
+		mat1.Display();
+
+		printf("\n--- mat2 ---\n");
+		mat2.Display();
+
+		printf("\n--- add ---\n");
+		SimpleMatrix matAdd = mat1 + mat2;
+		matAdd.Display();
+
+		printf("\n--- sub ---\n");
+		SimpleMatrix matSub = mat1 - mat2;
+		matSub.Display();
+
+		printf("\n--- mul ---\n");
+		SimpleMatrix matMul = mat1 * mat3;
+		matMul.Display();
+
+		printf("\n--- transpose ---\n");
+		SimpleMatrix matTranspose = mat1.Transpose();
+		matTranspose.Display();
+
+		printf("\n--- mul transposed (mat1 * mat2^T) ---\n");
+		SimpleMatrix::MultiplyTransposed(mat1, mat2, matMul);
+		matMul.Display();
+		(mat1 * mat2.Transpose()).Display();
+
+		printf("\n--- Identity matrix ---\n");
+		SimpleMatrix matI = SimpleMatrix::IdentityMatrix(3);
+		matI.Display();
+
+		printf("\n--- Inverse matrix 2x2 ---\n");
+		SimpleMatrix matInv = mat4.Inverse();
+		matInv.Display();
+		(mat4 * matInv).Display();
+		(matInv * mat4).Display();
+
+		printf("\n--- Inverse matrix 3x3 ---\n");
+		matInv = mat5.Inverse();
+		matInv.Display();
+		(mat5 * matInv).Display();
+		(matInv * mat5).Display();
+
+		printf("\n--- Solve (LU, Cholesky) 3x3 ---\n");
+		(mat5 * mat5.SolveLu(mat3)).Display();
+		(mat7 * mat7.SolveCholesky(mat3)).Display();
+
+		printf("\n--- Inverse of non-singular matrix 3x3 ---\n");
+		matInv = mat6.Inverse();
+	} catch (std::exception& e) {
+		printf("Exception: %s\n", e.what());
+	}
+}
+
+
 #endif
@@ -0,0 +1,148 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SLOT_MAP_
+#define SLOT_MAP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/* Container with stable slots */
+/*   an element never moves once inserted, so its slot index can be used as a key of other arrays (e.g. KalmanFilterBatch) */
+/*   Erase() just marks the slot as free, and Insert() reuses a free slot (the most recently freed one first) */
+/*   Handle has a generation number to detect access to an erased (and possibly reused) slot */
+/*   range-based for iterates over the alive elements in slot order */
+template<typename T>
+class SlotMap
+{
+public:
+    typedef struct Handle_ {
+        int32_t  index;
+        uint32_t generation;
+    } Handle;
+
+    template<typename MAP, typename VALUE>
+    class IteratorBase {
+    public:
+        IteratorBase(MAP* map, int32_t index) : map_(map), index_(index) { SkipFree(); }
+        VALUE& operator*() const { return map_->slot_list_[index_]; }
+        VALUE* operator->() const { return &map_->slot_list_[index_]; }
+        IteratorBase& operator++() { index_++; SkipFree(); return *this; }
+        bool operator!=(const IteratorBase& other) const { return index_ != other.index_; }
+        bool operator==(const IteratorBase& other) const { return index_ == other.index_; }
+        int32_t GetIndex() const { return index_; }
+    private:
+        void SkipFree() { while (index_ < map_->GetCapacity() && !map_->alive_list_[index_]) index_++; }
+        MAP* map_;
+        int32_t index_;
+    };
+    typedef IteratorBase<SlotMap, T> iterator;
+    typedef IteratorBase<const SlotMap, const T> const_iterator;
+
+public:
+    SlotMap() : alive_num_(0) {}
+    ~SlotMap() {}
+
+    /* slot index which is used by the next Insert() */
+    int32_t GetFreeIndex() const
+    {
+        return free_list_.empty() ? static_cast<int32_t>(slot_list_.size()) : free_list_.back();
+    }
+
+    Handle Insert(const T& value)
+    {
+        int32_t index;
+        if (free_list_.empty()) {
+            index = static_cast<int32_t>(slot_list_.size());
+            slot_list_.push_back(value);
+            alive_list_.push_back(1);
+            generation_list_.push_back(0);
+        } else {
+            index = free_list_.back();
+            free_list_.pop_back();
+            slot_list_[index] = value;
+            alive_list_[index] = 1;
+        }
+        alive_num_++;
+        return { index, generation_list_[index] };
+    }
+
+    void Erase(int32_t index)
+    {
+        if (!IsAlive(index)) return;
+        alive_list_[index] = 0;
+        generation_list_[index]++;
+        free_list_.push_back(index);
+        alive_num_--;
+    }
+
+    void Erase(const Handle& handle)
+    {
+        if (IsValid(handle)) Erase(handle.index);
+    }
+
+    bool IsAlive(int32_t index) const
+    {
+        return index >= 0 && index < GetCapacity() && alive_list_[index];
+    }
+
+    bool IsValid(const Handle& handle) const
+    {
+        return IsAlive(handle.index) && generation_list_[handle.index] == handle.generation;
+    }
+
+    /* handle of the alive slot */
+    Handle GetHandle(int32_t index) const
+    {
+        return { index, generation_list_[index] };
+    }
+
+    /* return nullptr if the element has been erased */
+    T* Get(const Handle& handle)
+    {
+        return IsValid(handle) ? &slot_list_[handle.index] : nullptr;
+    }
+
+    /* access by slot index. the slot must be alive */
+    T& operator[] (int32_t index) { return slot_list_[index]; }
+    const T& operator[] (int32_t index) const { return slot_list_[index]; }
+
+    void clear()
+    {
+        slot_list_.clear();
+        alive_list_.clear();
+        generation_list_.clear();
+        free_list_.clear();
+        alive_num_ = 0;
+    }
+
+    size_t size() const { return static_cast<size_t>(alive_num_); }
+    bool empty() const { return alive_num_ == 0; }
+    int32_t GetCapacity() const { return static_cast<int32_t>(slot_list_.size()); }    /* the number of slots including free ones */
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, GetCapacity()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, GetCapacity()); }
+
+private:
+    std::vector<T> slot_list_;
+    std::vector<uint8_t> alive_list_;
+    std::vector<uint32_t> generation_list_;
+    std::vector<int32_t> free_list_;
+    int32_t alive_num_;
+};
+
+#endif
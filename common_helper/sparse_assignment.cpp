@@ -0,0 +1,184 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* for My modules */
+#include "lapjv.h"
+#include "sparse_assignment.h"
+
+/*** Macro ***/
+
+constexpr int32_t SparseAssignment::kParallelThreshold;  // for link error in Android Studio (clang)
+
+
+/* counting sort of items by key (key < 0 is skipped). sorted_list[start_list[key]] is the first item of the key */
+template<typename KEY_FUNC>
+static void SortByKey(int32_t item_num, int32_t key_num, KEY_FUNC key_func, std::vector<int32_t>& start_list, std::vector<int32_t>& sorted_list)
+{
+    start_list.assign(key_num + 1, 0);
+    for (int32_t i = 0; i < item_num; i++) {
+        const int32_t key = key_func(i);
+        if (key >= 0) start_list[key + 1]++;
+    }
+    for (int32_t key = 0; key < key_num; key++) start_list[key + 1] += start_list[key];
+    sorted_list.resize(start_list[key_num]);
+    for (int32_t i = 0; i < item_num; i++) {
+        /* use start_list[key] as a write position, then shift it back */
+        const int32_t key = key_func(i);
+        if (key >= 0) sorted_list[start_list[key]++] = i;
+    }
+    for (int32_t key = key_num; key > 0; key--) start_list[key] = start_list[key - 1];
+    start_list[0] = 0;
+}
+
+
+SparseAssignment::SparseAssignment()
+    : row_num_(0), col_num_(0), component_num_(0), max_component_size_(0)
+{
+}
+
+SparseAssignment::~SparseAssignment()
+{
+}
+
+void SparseAssignment::Reset(int32_t row_num, int32_t col_num)
+{
+    row_num_ = row_num;
+    col_num_ = col_num;
+    component_num_ = 0;
+    max_component_size_ = 0;
+    edge_list_.clear();
+}
+
+void SparseAssignment::AddEdge(int32_t row, int32_t col, float cost)
+{
+    edge_list_.push_back({ row, col, cost });
+}
+
+int32_t SparseAssignment::FindRoot(int32_t node)
+{
+    while (parent_list_[node] != node) {
+        parent_list_[node] = parent_list_[parent_list_[node]];   /* path halving */
+        node = parent_list_[node];
+    }
+    return node;
+}
+
+void SparseAssignment::Solve(float cost_limit, std::vector<int32_t>& assign_for_row, std::vector<int32_t>& assign_for_col)
+{
+    assign_for_row.assign(row_num_, -1);
+    assign_for_col.assign(col_num_, -1);
+    const int32_t node_num = row_num_ + col_num_;
+    const int32_t edge_num = static_cast<int32_t>(edge_list_.size());
+
+    /*** Connected components (union-find) ***/
+    parent_list_.resize(node_num);
+    for (int32_t node = 0; node < node_num; node++) parent_list_[node] = node;
+    has_edge_list_.assign(node_num, 0);
+    for (const auto& edge : edge_list_) {
+        const int32_t root_row = FindRoot(edge.row);
+        const int32_t root_col = FindRoot(row_num_ + edge.col);
+        if (root_row != root_col) parent_list_[root_col] = root_row;
+        has_edge_list_[edge.row] = 1;
+        has_edge_list_[row_num_ + edge.col] = 1;
+    }
+
+    /* component id is given in the order of the first node, so the result doesn't depend on thread scheduling */
+    component_of_node_list_.assign(node_num, -1);
+    component_of_root_list_.assign(node_num, -1);
+    component_num_ = 0;
+    for (int32_t node = 0; node < node_num; node++) {
+        if (!has_edge_list_[node]) continue;     /* isolated node is never assigned */
+        const int32_t root = FindRoot(node);
+        if (component_of_root_list_[root] < 0) component_of_root_list_[root] = component_num_++;
+        component_of_node_list_[node] = component_of_root_list_[root];
+    }
+
+    /*** Sort rows, cols and edges by component ***/
+    SortByKey(row_num_, component_num_, [this](int32_t row) { return component_of_node_list_[row]; }, row_start_list_, row_sorted_list_);
+    SortByKey(col_num_, component_num_, [this](int32_t col) { return component_of_node_list_[row_num_ + col]; }, col_start_list_, col_sorted_list_);
+    SortByKey(edge_num, component_num_, [this](int32_t i) { return component_of_node_list_[edge_list_[i].row]; }, edge_start_list_, edge_sorted_list_);
+
+    local_index_list_.resize(node_num);
+    max_component_size_ = 0;
+    for (int32_t component = 0; component < component_num_; component++) {
+        for (int32_t p = row_start_list_[component]; p < row_start_list_[component + 1]; p++) {
+            local_index_list_[row_sorted_list_[p]] = p - row_start_list_[component];
+        }
+        for (int32_t p = col_start_list_[component]; p < col_start_list_[component + 1]; p++) {
+            local_index_list_[row_num_ + col_sorted_list_[p]] = p - col_start_list_[component];
+        }
+        const int32_t size = (row_start_list_[component + 1] - row_start_list_[component]) * (col_start_list_[component + 1] - col_start_list_[component]);
+        max_component_size_ = (std::max)(max_component_size_, size);
+    }
+
+    /*** Solve each component ***/
+    int32_t thread_num = 1;
+#ifdef _OPENMP
+    if (component_num_ >= kParallelThreshold) thread_num = omp_get_max_threads();
+#endif
+    if (static_cast<int32_t>(work_list_.size()) < thread_num) work_list_.resize(thread_num);
+#pragma omp parallel for schedule(dynamic) if (component_num_ >= kParallelThreshold)
+    for (int32_t component = 0; component < component_num_; component++) {
+        int32_t thread_index = 0;
+#ifdef _OPENMP
+        thread_index = omp_get_thread_num();
+#endif
+        /* each component writes to different rows and cols */
+        SolveComponent(component, cost_limit, work_list_[thread_index], assign_for_row, assign_for_col);
+    }
+}
+
+void SparseAssignment::SolveComponent(int32_t component, float cost_limit, Work& work, std::vector<int32_t>& assign_for_row, std::vector<int32_t>& assign_for_col)
+{
+    const int32_t row_start = row_start_list_[component];
+    const int32_t col_start = col_start_list_[component];
+    const int32_t rows = row_start_list_[component + 1] - row_start;
+    const int32_t cols = col_start_list_[component + 1] - col_start;
+    const int32_t edge_start = edge_start_list_[component];
+    const int32_t edge_end = edge_start_list_[component + 1];
+
+    if (edge_end - edge_start == 1) {
+        /* the most common case: one track and one det */
+        const auto& edge = edge_list_[edge_sorted_list_[edge_start]];
+        if (edge.cost < cost_limit) {
+            assign_for_row[edge.row] = edge.col;
+            assign_for_col[edge.col] = edge.row;
+        }
+        return;
+    }
+
+    work.cost_matrix.assign(static_cast<size_t>(rows) * cols, cost_limit);
+    for (int32_t p = edge_start; p < edge_end; p++) {
+        const auto& edge = edge_list_[edge_sorted_list_[p]];
+        work.cost_matrix[local_index_list_[edge.row] * cols + local_index_list_[row_num_ + edge.col]] = edge.cost;
+    }
+    work.solver.Solve(work.cost_matrix.data(), rows, cols, cost_limit, work.assign_for_row, work.assign_for_col);
+    for (int32_t local_row = 0; local_row < rows; local_row++) {
+        const int32_t local_col = work.assign_for_row[local_row];
+        if (local_col < 0) continue;
+        const int32_t row = row_sorted_list_[row_start + local_row];
+        const int32_t col = col_sorted_list_[col_start + local_col];
+        assign_for_row[row] = col;
+        assign_for_col[col] = row;
+    }
+}
@@ -0,0 +1,86 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SPARSE_ASSIGNMENT_
+#define SPARSE_ASSIGNMENT_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "lapjv.h"
+
+/* Linear assignment on a sparse bipartite graph */
+/*   only pairs which can be assigned (cost < cost_limit) are added as edges */
+/*   the graph is split into connected components, and each component is solved by Lapjv independently (in parallel when there are many) */
+/*   the total cost is the same as solving the dense matrix whose missing pairs are cost_limit */
+class SparseAssignment {
+public:
+    SparseAssignment();
+    ~SparseAssignment();
+
+    void Reset(int32_t row_num, int32_t col_num);
+    void AddEdge(int32_t row, int32_t col, float cost);
+    /* assign_for_row[row] = col (-1 = unassigned), assign_for_col[col] = row (-1 = unassigned) */
+    void Solve(float cost_limit, std::vector<int32_t>& assign_for_row, std::vector<int32_t>& assign_for_col);
+
+    int32_t GetEdgeNum() const { return static_cast<int32_t>(edge_list_.size()); }
+    int32_t GetComponentNum() const { return component_num_; }
+    int32_t GetMaxComponentSize() const { return max_component_size_; }   /* rows * cols of the largest component */
+
+private:
+    typedef struct Edge_ {
+        int32_t row;
+        int32_t col;
+        float   cost;
+    } Edge;
+
+    typedef struct Work_ {
+        Lapjv<float> solver;
+        std::vector<float> cost_matrix;
+        std::vector<int32_t> assign_for_row;
+        std::vector<int32_t> assign_for_col;
+    } Work;
+
+    int32_t FindRoot(int32_t node);
+    void SolveComponent(int32_t component, float cost_limit, Work& work, std::vector<int32_t>& assign_for_row, std::vector<int32_t>& assign_for_col);
+
+private:
+    static constexpr int32_t kParallelThreshold = 16;   /* the number of components to use multi threads */
+
+    int32_t row_num_;
+    int32_t col_num_;
+    int32_t component_num_;
+    int32_t max_component_size_;
+    std::vector<Edge> edge_list_;
+
+    /* node = row (0 - row_num - 1) or row_num + col */
+    std::vector<int32_t> parent_list_;          /* union-find */
+    std::vector<uint8_t> has_edge_list_;
+    std::vector<int32_t> component_of_root_list_;
+    std::vector<int32_t> component_of_node_list_;
+    std::vector<int32_t> local_index_list_;     /* index of the node in the component */
+    /* nodes and edges sorted by component. [component_start, component_start + 1) */
+    std::vector<int32_t> row_start_list_;
+    std::vector<int32_t> row_sorted_list_;
+    std::vector<int32_t> col_start_list_;
+    std::vector<int32_t> col_sorted_list_;
+    std::vector<int32_t> edge_start_list_;
+    std::vector<int32_t> edge_sorted_list_;
+
+    std::vector<Work> work_list_;                /* for each thread */
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+/* for My modules */
+#include "bounding_box.h"
+#include "spatial_grid.h"
+
+/*** Macro ***/
+/* the number of cells is limited to avoid a huge grid when boxes are widely spread */
+#define MAX_CELL_NUM_PER_BOX 4
+
+
+SpatialGrid::SpatialGrid()
+    : bbox_list_(nullptr), origin_x_(0), origin_y_(0), cell_size_(1), cell_num_x_(0), cell_num_y_(0), max_width_(0), max_height_(0)
+{
+}
+
+SpatialGrid::~SpatialGrid()
+{
+}
+
+void SpatialGrid::Build(const std::vector<BoundingBox>& bbox_list, int32_t cell_size)
+{
+    bbox_list_ = &bbox_list;
+    const int32_t box_num = static_cast<int32_t>(bbox_list.size());
+    max_width_ = 0;
+    max_height_ = 0;
+    if (box_num == 0) {
+        cell_num_x_ = 0;
+        cell_num_y_ = 0;
+        return;
+    }
+
+    int32_t x_min = (std::numeric_limits<int32_t>::max)();
+    int32_t y_min = (std::numeric_limits<int32_t>::max)();
+    int32_t x_max = (std::numeric_limits<int32_t>::min)();
+    int32_t y_max = (std::numeric_limits<int32_t>::min)();
+    int64_t size_sum = 0;
+    for (const auto& bbox : bbox_list) {
+        x_min = (std::min)(x_min, bbox.x);
+        y_min = (std::min)(y_min, bbox.y);
+        x_max = (std::max)(x_max, bbox.x);
+        y_max = (std::max)(y_max, bbox.y);
+        max_width_ = (std::max)(max_width_, bbox.w);
+        max_height_ = (std::max)(max_height_, bbox.h);
+        size_sum += (bbox.w + bbox.h) / 2;
+    }
+    if (cell_size <= 0) cell_size = static_cast<int32_t>(size_sum / box_num);
+    cell_size = (std::max)(1, cell_size);
+    const int64_t range_x = static_cast<int64_t>(x_max) - x_min + 1;
+    const int64_t range_y = static_cast<int64_t>(y_max) - y_min + 1;
+    while ((range_x / cell_size + 1) * (range_y / cell_size + 1) > static_cast<int64_t>(box_num) * MAX_CELL_NUM_PER_BOX) {
+        cell_size *= 2;
+    }
+    origin_x_ = x_min;
+    origin_y_ = y_min;
+    cell_size_ = cell_size;
+    cell_num_x_ = static_cast<int32_t>(range_x / cell_size + 1);
+    cell_num_y_ = static_cast<int32_t>(range_y / cell_size + 1);
+
+    /* counting sort by cell */
+    const int32_t cell_num = cell_num_x_ * cell_num_y_;
+    cell_start_list_.assign(cell_num + 1, 0);
+    cell_of_box_list_.resize(box_num);
+    index_list_.resize(box_num);
+    for (int32_t i = 0; i < box_num; i++) {
+        const int32_t cell = CellY(bbox_list[i].y) * cell_num_x_ + CellX(bbox_list[i].x);
+        cell_of_box_list_[i] = cell;
+        cell_start_list_[cell + 1]++;
+    }
+    for (int32_t cell = 0; cell < cell_num; cell++) {
+        cell_start_list_[cell + 1] += cell_start_list_[cell];
+    }
+    for (int32_t i = 0; i < box_num; i++) {
+        /* use cell_start_list_[cell] as a write position, then shift it back */
+        index_list_[cell_start_list_[cell_of_box_list_[i]]++] = i;
+    }
+    for (int32_t cell = cell_num; cell > 0; cell--) {
+        cell_start_list_[cell] = cell_start_list_[cell - 1];
+    }
+    cell_start_list_[0] = 0;
+}
+
+void SpatialGrid::Query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, std::vector<int32_t>& index_list) const
+{
+    if (cell_num_x_ == 0 || x1 < x0 || y1 < y0) return;
+    const int32_t cx0 = CellX(x0);
+    const int32_t cy0 = CellY(y0);
+    const int32_t cx1 = CellX(x1);
+    const int32_t cy1 = CellY(y1);
+    for (int32_t cy = cy0; cy <= cy1; cy++) {
+        for (int32_t cx = cx0; cx <= cx1; cx++) {
+            const int32_t cell = cy * cell_num_x_ + cx;
+            for (int32_t p = cell_start_list_[cell]; p < cell_start_list_[cell + 1]; p++) {
+                const int32_t index = index_list_[p];
+                const auto& bbox = (*bbox_list_)[index];
+                if (bbox.x >= x0 && bbox.x <= x1 && bbox.y >= y0 && bbox.y <= y1) {
+                    index_list.push_back(index);
+                }
+            }
+        }
+    }
+}
+
+int32_t SpatialGrid::CellX(int32_t x) const
+{
+    int64_t cell = (static_cast<int64_t>(x) - origin_x_) / cell_size_;
+    return static_cast<int32_t>((std::min)((std::max)(cell, static_cast<int64_t>(0)), static_cast<int64_t>(cell_num_x_ - 1)));
+}
+
+int32_t SpatialGrid::CellY(int32_t y) const
+{
+    int64_t cell = (static_cast<int64_t>(y) - origin_y_) / cell_size_;
+    return static_cast<int32_t>((std::min)((std::max)(cell, static_cast<int64_t>(0)), static_cast<int64_t>(cell_num_y_ - 1)));
+}
@@ -0,0 +1,59 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SPATIAL_GRID_
+#define SPATIAL_GRID_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "bounding_box.h"
+
+/* Uniform grid over the top-left points of bounding boxes */
+/*   Query() returns the boxes whose top-left point is in a rectangle, without checking all the boxes */
+/*   cells are stored as a flat list sorted by cell (counting sort), and buffers are reused for every Build() */
+class SpatialGrid {
+public:
+    SpatialGrid();
+    ~SpatialGrid();
+
+    /* cell_size <= 0: average of (w + h) / 2 of the boxes */
+    void Build(const std::vector<BoundingBox>& bbox_list, int32_t cell_size = 0);
+    /* index of boxes whose (x, y) is in [x0, x1] x [y0, y1]. the result is appended to index_list */
+    void Query(int32_t x0, int32_t y0, int32_t x1, int32_t y1, std::vector<int32_t>& index_list) const;
+
+    int32_t GetMaxWidth() const { return max_width_; }
+    int32_t GetMaxHeight() const { return max_height_; }
+
+private:
+    int32_t CellX(int32_t x) const;
+    int32_t CellY(int32_t y) const;
+
+private:
+    const std::vector<BoundingBox>* bbox_list_;
+    int32_t origin_x_;
+    int32_t origin_y_;
+    int32_t cell_size_;
+    int32_t cell_num_x_;
+    int32_t cell_num_y_;
+    int32_t max_width_;
+    int32_t max_height_;
+    std::vector<int32_t> cell_start_list_;     /* [cell_num + 1], start position in index_list_ */
+    std::vector<int32_t> index_list_;          /* box index sorted by cell */
+    std::vector<int32_t> cell_of_box_list_;
+};
+
+#endif
@@ -0,0 +1,265 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#define TENSOR_RECORD_WITH_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* for My modules */
+#include "common_helper.h"
+#include "tensor_record.h"
+
+/*** Macro ***/
+#define TAG "TensorRecord"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+static constexpr char kMagic[4] = { 'T', 'R', 'E', 'C' };
+static constexpr size_t kFileHeaderSize = TensorRecord::kAlignment;     /* magic, version, reserved */
+static constexpr size_t kFrameHeaderSize = TensorRecord::kAlignment;    /* frame_size, tensor_num, reserved */
+
+static size_t Align(size_t size)
+{
+    return (size + TensorRecord::kAlignment - 1) / TensorRecord::kAlignment * TensorRecord::kAlignment;
+}
+
+constexpr int32_t TensorRecord::kNameLength;   // for link error in Android Studio (clang)
+constexpr int32_t TensorRecord::kMaxDims;
+constexpr int32_t TensorRecord::kAlignment;
+constexpr uint32_t TensorRecord::kVersion;
+int32_t TensorRecord::GetTypeSize(int32_t type)
+{
+    switch (type) {
+    case kTypeFp32: return sizeof(float);
+    case kTypeUint8: return sizeof(uint8_t);
+    case kTypeInt32: return sizeof(int32_t);
+    default: return 0;
+    }
+}
+
+
+TensorRecorder::TensorRecorder()
+    : fp_(nullptr), tensor_num_(0), frame_num_(0)
+{
+}
+
+TensorRecorder::~TensorRecorder()
+{
+    Close();
+}
+
+bool TensorRecorder::Open(const std::string& filename)
+{
+    Close();
+    fp_ = fopen(filename.c_str(), "wb");
+    if (!fp_) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return false;
+    }
+    fwrite(kMagic, 1, sizeof(kMagic), fp_);
+    fwrite(&TensorRecord::kVersion, sizeof(uint32_t), 1, fp_);
+    const uint8_t reserved[kFileHeaderSize - sizeof(kMagic) - sizeof(uint32_t)] = { 0 };
+    fwrite(reserved, 1, sizeof(reserved), fp_);
+    frame_num_ = 0;
+    return true;
+}
+
+void TensorRecorder::Close()
+{
+    if (fp_) {
+        fclose(fp_);
+        fp_ = nullptr;
+    }
+}
+
+void TensorRecorder::BeginFrame()
+{
+    /* frame header is filled at EndFrame() */
+    frame_buffer_.assign(kFrameHeaderSize, 0);
+    tensor_num_ = 0;
+}
+
+void TensorRecorder::AddTensor(const std::string& name, int32_t type, const std::vector<int32_t>& dims, const void* data)
+{
+    TensorRecord::TensorHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.name, name.c_str(), TensorRecord::kNameLength - 1);
+    header.type = type;
+    header.dim_num = (std::min)(static_cast<int32_t>(dims.size()), TensorRecord::kMaxDims);
+    size_t element_num = 1;
+    for (size_t i = 0; i < dims.size(); i++) {
+        element_num *= dims[i];
+        if (static_cast<int32_t>(i) < TensorRecord::kMaxDims) header.dims[i] = dims[i];
+    }
+    header.byte_size = element_num * TensorRecord::GetTypeSize(type);
+
+    size_t offset = frame_buffer_.size();
+    frame_buffer_.resize(offset + Align(sizeof(header)) + Align(header.byte_size), 0);
+    memcpy(&frame_buffer_[offset], &header, sizeof(header));
+    memcpy(&frame_buffer_[offset + Align(sizeof(header))], data, header.byte_size);
+    tensor_num_++;
+}
+
+bool TensorRecorder::EndFrame()
+{
+    if (!fp_) return false;
+    uint32_t frame_size = static_cast<uint32_t>(frame_buffer_.size() - sizeof(uint32_t));
+    memcpy(&frame_buffer_[0], &frame_size, sizeof(uint32_t));
+    memcpy(&frame_buffer_[sizeof(uint32_t)], &tensor_num_, sizeof(uint32_t));
+    if (fwrite(frame_buffer_.data(), 1, frame_buffer_.size(), fp_) != frame_buffer_.size()) {
+        PRINT_E("Failed to write\n");
+        return false;
+    }
+    frame_num_++;
+    return true;
+}
+
+
+TensorPlayer::TensorPlayer()
+    : data_(nullptr), size_(0), current_frame_(-1), loop_(true)
+{
+}
+
+TensorPlayer::~TensorPlayer()
+{
+    Close();
+}
+
+bool TensorPlayer::Open(const std::string& filename, bool loop)
+{
+    Close();
+    loop_ = loop;
+#ifdef TENSOR_RECORD_WITH_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            data_ = static_cast<const uint8_t*>(addr);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    if (fd >= 0) close(fd);
+#endif
+    if (!data_) {
+        FILE* fp = fopen(filename.c_str(), "rb");
+        if (fp) {
+            fseek(fp, 0, SEEK_END);
+            file_buffer_.resize(static_cast<size_t>(ftell(fp)));
+            fseek(fp, 0, SEEK_SET);
+            if (fread(file_buffer_.data(), 1, file_buffer_.size(), fp) == file_buffer_.size() && !file_buffer_.empty()) {
+                data_ = file_buffer_.data();
+                size_ = file_buffer_.size();
+            }
+            fclose(fp);
+        }
+    }
+    if (!data_) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return false;
+    }
+
+    uint32_t version = 0;
+    if (size_ < kFileHeaderSize || memcmp(data_, kMagic, sizeof(kMagic)) != 0) {
+        PRINT_E("Invalid file: %s\n", filename.c_str());
+        Close();
+        return false;
+    }
+    memcpy(&version, data_ + sizeof(kMagic), sizeof(version));
+    if (version != TensorRecord::kVersion) {
+        PRINT_E("Unsupported version: %u\n", version);
+        Close();
+        return false;
+    }
+
+    /* index frames */
+    for (size_t offset = kFileHeaderSize; offset + kFrameHeaderSize <= size_;) {
+        uint32_t frame_size;
+        memcpy(&frame_size, data_ + offset, sizeof(frame_size));
+        if (offset + sizeof(uint32_t) + frame_size > size_) break;  /* truncated */
+        frame_offset_list_.push_back(offset);
+        offset += sizeof(uint32_t) + frame_size;
+    }
+    current_frame_ = -1;
+    PRINT("%s: %d frames\n", filename.c_str(), GetFrameNum());
+    return true;
+}
+
+void TensorPlayer::Close()
+{
+#ifdef TENSOR_RECORD_WITH_MMAP
+    if (data_ && file_buffer_.empty()) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    file_buffer_.clear();
+    frame_offset_list_.clear();
+    current_frame_ = -1;
+}
+
+bool TensorPlayer::Next()
+{
+    if (frame_offset_list_.empty()) return false;
+    current_frame_++;
+    if (current_frame_ >= GetFrameNum()) {
+        if (!loop_) return false;
+        current_frame_ = 0;
+    }
+    return true;
+}
+
+const void* TensorPlayer::GetTensor(const std::string& name, TensorRecord::TensorHeader* header) const
+{
+    if (current_frame_ < 0 || current_frame_ >= GetFrameNum()) return nullptr;
+    size_t offset = frame_offset_list_[current_frame_];
+    uint32_t frame_size, tensor_num;
+    memcpy(&frame_size, data_ + offset, sizeof(uint32_t));
+    memcpy(&tensor_num, data_ + offset + sizeof(uint32_t), sizeof(uint32_t));
+    const size_t offset_end = offset + sizeof(uint32_t) + frame_size;
+    offset += kFrameHeaderSize;
+    for (uint32_t i = 0; i < tensor_num && offset + sizeof(TensorRecord::TensorHeader) <= offset_end; i++) {
+        TensorRecord::TensorHeader current_header;
+        memcpy(&current_header, data_ + offset, sizeof(current_header));
+        const size_t offset_data = offset + Align(sizeof(current_header));
+        if (name == current_header.name) {
+            if (header) *header = current_header;
+            return data_ + offset_data;
+        }
+        offset = offset_data + Align(current_header.byte_size);
+    }
+    return nullptr;
+}
+
+const float* TensorPlayer::GetTensorAsFloat(const std::string& name, TensorRecord::TensorHeader* header) const
+{
+    TensorRecord::TensorHeader current_header;
+    const void* data = GetTensor(name, &current_header);
+    if (!data || current_header.type != TensorRecord::kTypeFp32) return nullptr;
+    if (header) *header = current_header;
+    return static_cast<const float*>(data);
+}
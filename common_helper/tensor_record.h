@@ -0,0 +1,101 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSOR_RECORD_
+#define TENSOR_RECORD_
+
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+/* Record / replay of model tensors */
+/*   an engine records its input and output tensors for each frame with TensorRecorder, */
+/*   and replays the recorded output tensors with TensorPlayer instead of running the interpreter, */
+/*   so that post-process and tracking can be benchmarked without model files */
+/* file format (native endian): */
+/*   "TREC", uint32_t version, (reserved up to kAlignment bytes) */
+/*   frame: uint32_t frame_size, uint32_t tensor_num, (reserved), { TensorHeader, data } x tensor_num */
+/*   every block is padded to kAlignment bytes so that the tensor data in the mapped file is aligned */
+class TensorRecord {
+public:
+    enum {
+        kTypeFp32 = 0,
+        kTypeUint8,
+        kTypeInt32,
+    };
+    static constexpr int32_t kNameLength = 48;
+    static constexpr int32_t kMaxDims = 4;
+    static constexpr int32_t kAlignment = 16;
+    static constexpr uint32_t kVersion = 1;
+
+    typedef struct TensorHeader_ {
+        char     name[kNameLength];
+        int32_t  type;
+        int32_t  dim_num;
+        int32_t  dims[kMaxDims];
+        uint64_t byte_size;
+    } TensorHeader;
+
+    static int32_t GetTypeSize(int32_t type);
+};
+
+
+class TensorRecorder {
+public:
+    TensorRecorder();
+    ~TensorRecorder();
+    bool Open(const std::string& filename);
+    void Close();
+    bool IsOpened() const { return fp_ != nullptr; }
+
+    /* AddTensor() copies the data. the frame is written at EndFrame() */
+    void BeginFrame();
+    void AddTensor(const std::string& name, int32_t type, const std::vector<int32_t>& dims, const void* data);
+    bool EndFrame();
+    int32_t GetFrameNum() const { return frame_num_; }
+
+private:
+    FILE* fp_;
+    std::vector<uint8_t> frame_buffer_;
+    uint32_t tensor_num_;
+    int32_t frame_num_;
+};
+
+
+class TensorPlayer {
+public:
+    TensorPlayer();
+    ~TensorPlayer();
+    bool Open(const std::string& filename, bool loop = true);   /* the file is memory-mapped */
+    void Close();
+    bool IsOpened() const { return data_ != nullptr; }
+
+    int32_t GetFrameNum() const { return static_cast<int32_t>(frame_offset_list_.size()); }
+    bool Next();    /* move to the next frame. return false at the end (when not loop) */
+    const void* GetTensor(const std::string& name, TensorRecord::TensorHeader* header = nullptr) const;   /* in the current frame. nullptr if not found */
+    const float* GetTensorAsFloat(const std::string& name, TensorRecord::TensorHeader* header = nullptr) const;
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    std::vector<uint8_t> file_buffer_;      /* used when mmap is not available */
+    std::vector<size_t> frame_offset_list_;
+    int32_t current_frame_;
+    bool loop_;
+};
+
+#endif
@@ -21,22 +21,28 @@ limitations under the License.
 #include <list>
 #include <array>
 #include <memory>
+#include <algorithm>
 
 /* for My modules */
 #include "common_helper.h"
 #include "bounding_box.h"
 #include "tracker.h"
-#include "hungarian_algorithm.h"
 
 
-Track::Track(const int32_t id, const BoundingBox& bbox_det)
+Track::Track(const int32_t id, const BoundingBox& bbox_det, KalmanFilterStore* kf_store, int32_t kf_index)
 {
     Data data;
     data.bbox = bbox_det;
     data.bbox_raw = bbox_det;
     data_history_.push_back(data);
 
-    kf_ = CreateKalmanFilter_UniformLinearMotion(bbox_det);
+    kf_store_ = kf_store;
+    kf_index_ = kf_index;
+    if (kf_index_ < kf_store_->GetSize()) {
+        kf_store_->Set(kf_index_, CreateKalmanFilter_UniformLinearMotion(bbox_det));
+    } else {
+        kf_index_ = kf_store_->Add(CreateKalmanFilter_UniformLinearMotion(bbox_det));
+    }
 
     cnt_detected_ = 1;
     cnt_undetected_ = 0;
@@ -49,10 +55,14 @@ Track::~Track()
 
 BoundingBox Track::Predict()
 {
-    kf_.Predict();
+    kf_store_->Predict(kf_index_);
+    return OnPredicted();
+}
 
+BoundingBox Track::OnPredicted()
+{
     BoundingBox bbox = GetLatestBoundingBox();
-    BoundingBox bbox_pred = KalmanStatus2Bbox(kf_.X);   // w, y, w, h only
+    BoundingBox bbox_pred = KalmanStatus2Bbox(kf_store_->GetStatus(kf_index_));   // w, y, w, h only
     bbox.w = bbox_pred.w;
     bbox.h = bbox_pred.h;
     bbox.x = bbox_pred.x;
@@ -62,25 +72,22 @@ BoundingBox Track::Predict()
     Data data = GetLatestData();
     data.bbox = bbox;
     data.bbox_raw = bbox;
-    data_history_.push_back(data);
-    if (data_history_.size() > kMaxHistoryNum) {
-        data_history_.pop_front();
-    }
+    data_history_.push_back(data);     /* the oldest one is overwritten */
 
     return bbox;
 }
 
 void Track::Update(const BoundingBox& bbox_det)
 {
-    kf_.Update(Bbox2KalmanObserved(bbox_det));
-
-    Data data;
-    data.bbox = bbox_det;
-    data.bbox_raw = bbox_det;
+    kf_store_->Update(kf_index_, Bbox2KalmanObserved(bbox_det));
+    OnUpdated(bbox_det);
+}
 
+void Track::OnUpdated(const BoundingBox& bbox_det)
+{
     BoundingBox& bbox = data_history_.back().bbox;
     BoundingBox& bbox_raw = data_history_.back().bbox_raw;
-    BoundingBox bbox_est = KalmanStatus2Bbox(kf_.X);   // w, y, w, h only
+    BoundingBox bbox_est = KalmanStatus2Bbox(kf_store_->GetStatus(kf_index_));   // w, y, w, h only
     bbox_raw = bbox_det;
     bbox = bbox_det;
     bbox.w = bbox_est.w;
@@ -97,7 +104,7 @@ void Track::UpdateNoDetect()
     cnt_undetected_++;
 }
 
-std::deque<Track::Data>& Track::GetDataHistory()
+Track::DataHistory& Track::GetDataHistory()
 {
     return data_history_;
 }
@@ -128,13 +135,11 @@ const int32_t Track::GetDetectedCount() const
 }
 
 
-static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
-static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
-KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start)
+Track::KalmanFilterBbox Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start)
 {
     /*** X(t) = F * X(t-1) + w(t) ***/
     /* Matrix to calculate X(t) from X(t-1). assume uniform motion: x(t) = x(t-1) + vt, v(t) = v(t-1) */
-    const SimpleMatrix F(kNumStatus, kNumStatus, {
+    const KalmanFilterBbox::MatrixStatus F({
         1, 0, 0, 0, 1, 0, 0,
         0, 1, 0, 0, 0, 1, 0,
         0, 0, 1, 0, 0, 0, 1,
@@ -146,7 +151,7 @@ KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bb
 
 
     /* w(t), = noise, follows Q */
-    const SimpleMatrix Q(kNumStatus, kNumStatus, {
+    const KalmanFilterBbox::MatrixStatus Q({
         1, 0, 0, 0,    0,    0,     0,
         0, 1, 0, 0,    0,    0,     0,
         0, 0, 1, 0,    0,    0,     0,
@@ -158,7 +163,7 @@ KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bb
 
     /*** Z(t) = H * X(t) + v(t) ***/
     /* Matrix to calculate Z(observed value) from X(internal status) */
-    const SimpleMatrix H(kNumObserve, kNumStatus, {
+    const KalmanFilterBbox::MatrixObserveStatus H({
         1, 0, 0, 0, 0, 0, 0,
         0, 1, 0, 0, 0, 0, 0,
         0, 0, 1, 0, 0, 0, 0,
@@ -166,7 +171,7 @@ KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bb
         });
 
     /* v(t), = noise, follows R */
-    const SimpleMatrix R(kNumObserve, kNumObserve, {
+    const KalmanFilterBbox::MatrixObserve R({
         1, 0,  0,  0,
         0, 1,  0,  0,
         0, 0, 10,  0,
@@ -174,12 +179,12 @@ KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bb
         });
 
     /* First internal status */
-    SimpleMatrix P0 = SimpleMatrix::IdentityMatrix(kNumStatus);
-    P0 = P0 * 10;   /* Set big noise at first to make K=1 and trust observed value rather than estimated value */
+    KalmanFilterBbox::MatrixStatus P0 = KalmanFilterBbox::MatrixStatus::IdentityMatrix();
+    P0 = P0 * 10.0F;   /* Set big noise at first to make K=1 and trust observed value rather than estimated value */
 
-    const SimpleMatrix X0 = Bbox2KalmanStatus(bbox_start);
+    const KalmanFilterBbox::VectorStatus X0 = Bbox2KalmanStatus(bbox_start);
 
-    KalmanFilter kf;
+    KalmanFilterBbox kf;
     kf.Initialize(
         F,
         Q,
@@ -192,13 +197,13 @@ KalmanFilter Track::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bb
     return kf;
 }
 
-SimpleMatrix Track::Bbox2KalmanStatus(const BoundingBox& bbox)
+Track::KalmanFilterBbox::VectorStatus Track::Bbox2KalmanStatus(const BoundingBox& bbox)
 {
-    SimpleMatrix X(kNumStatus, 1, {
-        static_cast<double>(bbox.x + bbox.w / 2),
-        static_cast<double>(bbox.y + bbox.h / 2),
-        static_cast<double>(bbox.w * bbox.h),
-        static_cast<double>(bbox.w) / bbox.h,
+    KalmanFilterBbox::VectorStatus X({
+        static_cast<float>(bbox.x + bbox.w / 2),
+        static_cast<float>(bbox.y + bbox.h / 2),
+        static_cast<float>(bbox.w * bbox.h),
+        static_cast<float>(bbox.w) / bbox.h,
         0,
         0,
         0
@@ -206,18 +211,18 @@ SimpleMatrix Track::Bbox2KalmanStatus(const BoundingBox& bbox)
     return X;
 }
 
-SimpleMatrix Track::Bbox2KalmanObserved(const BoundingBox& bbox)
+Track::KalmanFilterBbox::VectorObserve Track::Bbox2KalmanObserved(const BoundingBox& bbox)
 {
-    SimpleMatrix Z(kNumObserve, 1, {
-        static_cast<double>(bbox.x + bbox.w / 2),
-        static_cast<double>(bbox.y + bbox.h / 2),
-        static_cast<double>(bbox.w * bbox.h),
-        static_cast<double>(bbox.w) / bbox.h,
+    KalmanFilterBbox::VectorObserve Z({
+        static_cast<float>(bbox.x + bbox.w / 2),
+        static_cast<float>(bbox.y + bbox.h / 2),
+        static_cast<float>(bbox.w * bbox.h),
+        static_cast<float>(bbox.w) / bbox.h,
         });
     return Z;
 }
 
-BoundingBox Track::KalmanStatus2Bbox(const SimpleMatrix& X)
+BoundingBox Track::KalmanStatus2Bbox(const KalmanFilterBbox::VectorStatus& X)
 {
     BoundingBox bbox;
     bbox.w = static_cast<int32_t>(std::sqrt(X(2, 0) * X(3, 0)));
@@ -243,11 +248,12 @@ Tracker::~Tracker()
 void Tracker::Reset()
 {
     track_list_.clear();
+    kf_store_.Clear();
     track_sequence_num_ = 0;
 }
 
 
-std::vector<Track>& Tracker::GetTrackList()
+Tracker::TrackList& Tracker::GetTrackList()
 {
     return track_list_;
 }
@@ -276,36 +282,37 @@ float Tracker::CalculateCost(Track& track, const BoundingBox& det_bbox)
 void Tracker::Update(const std::vector<BoundingBox>& det_list)
 {
     /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
+    kf_store_.Predict();
     for (auto& track : track_list_) {
-        track.Predict();
+        track.OnPredicted();
     }
 
     /*** Association ***/
     /* Calculate IoU b/w predicted position and detected position */
-    size_t size_cost_matrix = (std::max)(track_list_.size(), det_list.size());  /* workaround: my hungarian algorithm sometimes outputs wrong result when the input matrix is not squared */
-    std::vector<std::vector<float>> cost_matrix(size_cost_matrix, std::vector<float>(size_cost_matrix, kCostMax));
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
-        for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
-            cost_matrix[i_track][i_det] = CalculateCost(track_list_[i_track], det_list[i_det]);
+    /* only for pairs which overlap. dets are searched by their top-left point using the spatial grid */
+    /* rows of the assignment are slot indices (free slots have no edge) */
+    const int32_t slot_num = track_list_.GetCapacity();
+    const int32_t det_num = static_cast<int32_t>(det_list.size());
+    det_grid_.Build(det_list);
+    assignment_.Reset(slot_num, det_num);
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (!track_list_.IsAlive(i_track)) continue;
+        const auto& track_bbox = track_list_[i_track].GetLatestBoundingBox();
+        candidate_list_.clear();
+        det_grid_.Query(track_bbox.x - det_grid_.GetMaxWidth(), track_bbox.y - det_grid_.GetMaxHeight(), track_bbox.x + track_bbox.w, track_bbox.y + track_bbox.h, candidate_list_);
+        for (int32_t i_det : candidate_list_) {
+            float cost = CalculateCost(track_list_[i_track], det_list[i_det]);
+            if (cost < kCostMax) assignment_.AddEdge(i_track, i_det, cost);
         }
     }
 
-    /* Assign track and det */
-    std::vector<int32_t> det_index_for_track(size_cost_matrix, -1);
-    std::vector<int32_t> track_index_for_det(size_cost_matrix, -1);
-    if (track_list_.size() > 0 && det_list.size() > 0) {
-        HungarianAlgorithm<float> solver(cost_matrix);
-        solver.Solve(det_index_for_track, track_index_for_det);
-    }
+    /* Assign track and det. each connected component of the graph is solved independently */
+    std::vector<int32_t> det_index_for_track;
+    std::vector<int32_t> track_index_for_det;
+    assignment_.Solve(kCostMax, det_index_for_track, track_index_for_det);
 
 #if 0
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
-        for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
-            printf("%.3f  ", cost_matrix[i_track][i_det]);
-        }
-        printf("\n");
-    }
-
+    printf("edge = %d, component = %d, max component size = %d\n", assignment_.GetEdgeNum(), assignment_.GetComponentNum(), assignment_.GetMaxComponentSize());
     printf("track:  det\n");
     for (size_t i = 0; i < det_index_for_track.size(); i++) {
         printf("%3d:  %3d\n", i, det_index_for_track[i]);
@@ -317,32 +324,38 @@ void Tracker::Update(const std::vector<BoundingBox>& det_list)
 #endif
 
     /*** Update track ***/
-    std::vector<bool> is_det_assigned_list(size_cost_matrix, false);
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
+    /* set observations, then update all the Kalman filters at once */
+    std::vector<bool> is_det_assigned_list(det_num, false);
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
         int32_t assigned_det_index = det_index_for_track[i_track];
-        if (assigned_det_index >= 0 && assigned_det_index < static_cast<int32_t>(det_list.size()) && cost_matrix[i_track][assigned_det_index] < kCostMax) {
-            track_list_[i_track].Update(det_list[assigned_det_index]);
+        if (assigned_det_index >= 0) {
+            kf_store_.SetObservation(track_list_[i_track].kf_index_, track_list_[i_track].Bbox2KalmanObserved(det_list[assigned_det_index]));
             is_det_assigned_list[assigned_det_index] = true;
-        } else{
+        }
+    }
+    kf_store_.Update();
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (!track_list_.IsAlive(i_track)) continue;
+        if (det_index_for_track[i_track] >= 0) {
+            track_list_[i_track].OnUpdated(det_list[det_index_for_track[i_track]]);
+        } else {
             track_list_[i_track].UpdateNoDetect();
         }
     }
 
     /*** Delete tracks ***/
-    for (auto it = track_list_.begin(); it != track_list_.end();) {
-        if (it->GetUndetectedCount() >= threshold_frame_to_delete_) {
-            it = track_list_.erase(it);
-        } else {
-            it++;
+    /* the slot is just released. the filter in kf_store_ is overwritten when the slot is reused */
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (track_list_.IsAlive(i_track) && track_list_[i_track].GetUndetectedCount() >= threshold_frame_to_delete_) {
+            track_list_.Erase(i_track);
         }
     }
 
     /*** Add new tracks ***/
-    for (size_t i = 0; i < det_list.size(); i++) {
+    for (int32_t i = 0; i < det_num; i++) {
         if (is_det_assigned_list[i] == false) {
-            track_list_.push_back(Track(track_sequence_num_, det_list[i]));
+            track_list_.Insert(Track(track_sequence_num_, det_list[i], &kf_store_, track_list_.GetFreeIndex()));
             track_sequence_num_++;
         }
     }
 }
-
@@ -27,28 +27,43 @@ limitations under the License.
 
 /* for My modules */
 #include "bounding_box.h"
-#include "kalman_filter.h"
+#include "kalman_filter_fixed.h"
+#include "kalman_filter_batch.h"
+#include "spatial_grid.h"
+#include "sparse_assignment.h"
+#include "ring_buffer.h"
+#include "slot_map.h"
 
 
+/* Track is a view of the Kalman filter status in the KalmanFilterStore owned by Tracker, plus its own history */
+/*   the history is a fixed-size ring buffer, so a Track doesn't allocate memory after construction */
 class Track {
+    friend class Tracker;
 private:
     static constexpr int32_t kMaxHistoryNum = 30;
+    static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
+    static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
 
 public:
+    typedef KalmanFilterFixed<kNumStatus, kNumObserve, float> KalmanFilterBbox;
+    typedef KalmanFilterBatch<kNumStatus, kNumObserve, float> KalmanFilterStore;
+
     typedef struct Data_ {
         BoundingBox bbox;
         BoundingBox bbox_raw;
     } Data;
+    typedef RingBuffer<Data, kMaxHistoryNum> DataHistory;
 
 public:
-    Track(const int32_t id, const BoundingBox& bbox_det);
+    /* kf_index: index in kf_store. a new filter is added if kf_index is the size of kf_store, otherwise the filter at kf_index is overwritten */
+    Track(const int32_t id, const BoundingBox& bbox_det, KalmanFilterStore* kf_store, int32_t kf_index);
     ~Track();
 
     BoundingBox Predict();
     void Update(const BoundingBox& bbox_det);
     void UpdateNoDetect();
 
-    std::deque<Data>& GetDataHistory();
+    DataHistory& GetDataHistory();
     Data& GetLatestData() ;
     BoundingBox& GetLatestBoundingBox();
 
@@ -57,14 +72,19 @@ public:
     const int32_t GetDetectedCount() const;
 
 private:
-    KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
-    SimpleMatrix Bbox2KalmanObserved(const BoundingBox& bbox);
-    SimpleMatrix Bbox2KalmanStatus(const BoundingBox& bbox);
-    BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X);
+    /* called after the status in the store is predicted / updated */
+    BoundingBox OnPredicted();
+    void OnUpdated(const BoundingBox& bbox_det);
+
+    KalmanFilterBbox CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
+    KalmanFilterBbox::VectorObserve Bbox2KalmanObserved(const BoundingBox& bbox);
+    KalmanFilterBbox::VectorStatus Bbox2KalmanStatus(const BoundingBox& bbox);
+    BoundingBox KalmanStatus2Bbox(const KalmanFilterBbox::VectorStatus& X);
 
 private:
-    std::deque<Data> data_history_;
-    KalmanFilter kf_;
+    DataHistory data_history_;
+    KalmanFilterStore* kf_store_;
+    int32_t kf_index_;
     int32_t id_;
     int32_t cnt_detected_;
     int32_t cnt_undetected_;
@@ -75,23 +95,35 @@ class Tracker {
 private:
     static constexpr float kCostMax = 1.0F;
 
+public:
+    /* tracks never move in the list. the slot index of a track is also its index in kf_store_ */
+    typedef SlotMap<Track> TrackList;
+
 public:
     Tracker(int32_t threshold_frame_to_delete = 2);
     ~Tracker();
+    Tracker(const Tracker&) = delete;               /* tracks refer to kf_store_ */
+    Tracker& operator=(const Tracker&) = delete;
     void Reset();
 
     void Update(const std::vector<BoundingBox>& det_list);
 
-    std::vector<Track>& GetTrackList();
+    TrackList& GetTrackList();
 
 private:
     float CalculateCost(Track& track, const BoundingBox& det_bbox);
 
 private:
-    std::vector<Track> track_list_;
+    TrackList track_list_;
+    Track::KalmanFilterStore kf_store_;     /* kf_store_[i] is the status of track_list_[i] (slot index) */
     int32_t track_sequence_num_;
 
     int32_t threshold_frame_to_delete_;
+
+    /* reused every frame to avoid allocation */
+    SpatialGrid det_grid_;
+    SparseAssignment assignment_;
+    std::vector<int32_t> candidate_list_;
 };
 
 #endif
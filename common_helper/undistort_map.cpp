@@ -0,0 +1,126 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "undistort_map.h"
+
+/*** Macro ***/
+/* the number of pixels to use multi threads */
+#define PARALLEL_THRESHOLD 16384
+
+
+namespace UndistortMap
+{
+
+/* reference: https://github.com/alexvbogdan/DeepCalib/blob/master/undistortion/undistSphIm.m */
+/*   (X_cam, Y_cam, Z_cam) = ((x - u0_undist) / f_undist, (y - v0_undist) / f_undist, 1) */
+/*   (X_sph, Y_sph, Z_sph) = (X_cam, Y_cam, Z_cam) / |(X_cam, Y_cam, Z_cam)|  (on the unit sphere) */
+/*   map = (X_sph, Y_sph) * f_dist / (xi * |(X_sph, Y_sph, Z_sph)| + Z_sph) + (u0_dist, v0_dist) */
+/*       = (X_cam, Y_cam) * f_dist / (xi * |(X_cam, Y_cam, 1)| + 1) + (u0_dist, v0_dist)  <- one sqrt and one division per pixel */
+static void CreateUnifiedRow(const UnifiedParam& param, int32_t y, float* map_x, float* map_y)
+{
+    const int32_t width = param.width;
+    const float f_inv = 1 / param.f_undist;
+    const float u0_undist = param.u0_undist;
+    const float xi = param.xi;
+    const float f_dist = param.f_dist;
+    const float u0_dist = param.u0_dist;
+    const float v0_dist = param.v0_dist;
+    const float Y = (y - param.v0_undist) * f_inv;
+    const float YY1 = Y * Y + 1;
+#pragma omp simd
+    for (int32_t x = 0; x < width; x++) {
+        const float X = (x - u0_undist) * f_inv;
+        const float scale = f_dist / (xi * std::sqrt(X * X + YY1) + 1);
+        map_x[x] = X * scale + u0_dist;
+        map_y[x] = Y * scale + v0_dist;
+    }
+}
+
+void CreateUnified(const UnifiedParam& param, float* map_x, float* map_y)
+{
+#pragma omp parallel for if (param.width * param.height > PARALLEL_THRESHOLD)
+    for (int32_t y = 0; y < param.height; y++) {
+        CreateUnifiedRow(param, y, map_x + static_cast<size_t>(y) * param.width, map_y + static_cast<size_t>(y) * param.width);
+    }
+}
+
+/* the inverse of CreateUnifiedRow */
+/*   m = (x - u0_dist, y - v0_dist) / f_dist, r2 = |m|^2 */
+/*   the point on the unit sphere: (X_sph, Y_sph, Z_sph) = eta * (m, 1) - (0, 0, xi), eta = (xi + sqrt(1 + (1 - xi^2) * r2)) / (r2 + 1) */
+/*   undistorted = (X_sph, Y_sph) / Z_sph * f_undist + (u0_undist, v0_undist) */
+void UndistortPointUnified(const UnifiedParam& param, const float* image_point, int32_t num, float* image_point_undistorted)
+{
+    const float f_dist_inv = 1 / param.f_dist;
+    const float xi = param.xi;
+    for (int32_t i = 0; i < num; i++) {
+        const float mx = (image_point[i * 2 + 0] - param.u0_dist) * f_dist_inv;
+        const float my = (image_point[i * 2 + 1] - param.v0_dist) * f_dist_inv;
+        const float r2 = mx * mx + my * my;
+        const float d = 1 + (1 - xi * xi) * r2;
+        const float eta = (xi + std::sqrt((std::max)(d, 0.0F))) / (r2 + 1);
+        const float z = eta - xi;
+        if (d < 0 || z <= 0) {
+            /* out of the field of view of the model, or 90 deg or more from the optical axis */
+            image_point_undistorted[i * 2 + 0] = image_point_undistorted[i * 2 + 1] = kInvalidPoint;
+            continue;
+        }
+        const float scale = eta / z * param.f_undist;
+        image_point_undistorted[i * 2 + 0] = mx * scale + param.u0_undist;
+        image_point_undistorted[i * 2 + 1] = my * scale + param.v0_undist;
+    }
+}
+
+void CreateUnifiedFixed(const UnifiedParam& param, int16_t* map_xy, uint16_t* map_frac)
+{
+    /* float values are kept only for one row (in cache) */
+#pragma omp parallel if (param.width * param.height > PARALLEL_THRESHOLD)
+    {
+        std::vector<float> row_x(param.width), row_y(param.width);
+#pragma omp for
+        for (int32_t y = 0; y < param.height; y++) {
+            const size_t offset = static_cast<size_t>(y) * param.width;
+            CreateUnifiedRow(param, y, row_x.data(), row_y.data());
+            ConvertToFixed(row_x.data(), row_y.data(), param.width, map_xy + offset * 2, map_frac + offset);
+        }
+    }
+}
+
+void ConvertToFixed(const float* map_x, const float* map_y, int32_t num, int16_t* map_xy, uint16_t* map_frac)
+{
+    /* round(v * kInterTabSize), then split into the integer part and the fraction, and saturate to int16 */
+    /* a positive bias is added so that the conversion to int (truncation) works as floor, and the fraction is a positive remainder */
+    /* the biased value is calculated in double to keep the fraction exact (|v| must be less than 2^26) */
+    /* saturation is done on int, because a comparison of float in the loop prevents vectorization */
+    constexpr int32_t kIntMin = -32768;
+    constexpr int32_t kBiasedMax = (32767 - kIntMin) * kInterTabSize + (kInterTabSize - 1);
+    constexpr double kBias = -kIntMin * kInterTabSize + 0.5;
+#pragma omp simd
+    for (int32_t i = 0; i < num; i++) {
+        const int32_t ix = std::min(std::max(static_cast<int32_t>(static_cast<double>(map_x[i]) * kInterTabSize + kBias), 0), kBiasedMax);
+        const int32_t iy = std::min(std::max(static_cast<int32_t>(static_cast<double>(map_y[i]) * kInterTabSize + kBias), 0), kBiasedMax);
+        map_xy[i * 2 + 0] = static_cast<int16_t>((ix >> kInterBits) + kIntMin);
+        map_xy[i * 2 + 1] = static_cast<int16_t>((iy >> kInterBits) + kIntMin);
+        map_frac[i] = static_cast<uint16_t>((iy & (kInterTabSize - 1)) * kInterTabSize + (ix & (kInterTabSize - 1)));
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef UNDISTORT_MAP_
+#define UNDISTORT_MAP_
+
+/* for general */
+#include <cstdint>
+
+/* Remap tables for undistortion (for each pixel of the undistorted image, the position in the distorted image) */
+/*   a map is generated in one pass without intermediate images: rows in parallel, pixels in a row with vectorized loops */
+/*   fixed-point map is the same format as cv::convertMaps(CV_16SC2): */
+/*     map_xy = integer part of (x, y) (int16 x 2), map_frac = (y_frac * kInterTabSize + x_frac) (uint16, 1 / kInterTabSize px) */
+/*     they can be passed to cv::remap(src, dst, map_xy, map_frac, INTER_LINEAR) directly (cv::remap converts float maps to this format internally) */
+namespace UndistortMap
+{
+
+constexpr int32_t kInterBits = 5;   /* the same as cv::INTER_BITS */
+constexpr int32_t kInterTabSize = 1 << kInterBits;
+constexpr float kInvalidPoint = -1.0F;
+
+/* Unified projection model (DeepCalib) */
+/*   the undistorted image is a perspective image of (f_undist, u0_undist, v0_undist) */
+/*   a ray is projected on the unit sphere, and then to the distorted image from the point at xi above the center of the sphere */
+typedef struct UnifiedParam_ {
+    int32_t width;      /* size of the undistorted image (= size of the map) */
+    int32_t height;
+    float   f_undist;
+    float   u0_undist;
+    float   v0_undist;
+    float   xi;
+    float   f_dist;
+    float   u0_dist;
+    float   v0_dist;
+    UnifiedParam_() : width(0), height(0), f_undist(1), u0_undist(0), v0_undist(0), xi(0), f_dist(1), u0_dist(0), v0_dist(0)
+    {}
+} UnifiedParam;
+
+/* map_x, map_y: [height][width] */
+void CreateUnified(const UnifiedParam& param, float* map_x, float* map_y);
+/* the inverse of the map for points: distorted image -> undistorted image (closed form). src and dst can be the same */
+/*   points whose ray is not in front of the undistorted (perspective) camera are (kInvalidPoint, kInvalidPoint) */
+void UndistortPointUnified(const UnifiedParam& param, const float* image_point, int32_t num, float* image_point_undistorted);
+/* map_xy: [height][width][2], map_frac: [height][width] */
+void CreateUnifiedFixed(const UnifiedParam& param, int16_t* map_xy, uint16_t* map_frac);
+
+/* float maps -> fixed-point map (the same as cv::convertMaps except for rounding of exact ties) */
+void ConvertToFixed(const float* map_x, const float* map_y, int32_t num, int16_t* map_xy, uint16_t* map_frac);
+
+}
+
+#endif
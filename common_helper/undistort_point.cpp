@@ -0,0 +1,128 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/* for My modules */
+#include "undistort_point.h"
+#include "simd_helper.h"
+
+/*** Macro ***/
+/* the number of points to use multi threads */
+#define PARALLEL_THRESHOLD 4096
+/* the number of points processed at once */
+#define BLOCK_SIZE 64
+
+
+UndistortPointLut::UndistortPointLut()
+    : width_(0), height_(0), grid_step_(1), is_direct_(false), col_num_(0), row_num_(0)
+{
+    /* never matches, so the table is created at the first Update */
+    std::fill(intrinsic_key_, intrinsic_key_ + 9, std::nanf(""));
+}
+
+UndistortPointLut::~UndistortPointLut()
+{
+}
+
+bool UndistortPointLut::Update(const CameraProjection& projection, int32_t width, int32_t height, int32_t grid_step)
+{
+    if (width <= 0 || height <= 0 || grid_step <= 0) return false;
+
+    float intrinsic_key[9];
+    projection.GetIntrinsic(intrinsic_key[0], intrinsic_key[1], intrinsic_key[2], intrinsic_key[3]);
+    std::copy(projection.GetDistortion(), projection.GetDistortion() + 5, intrinsic_key + 4);
+    if (width == width_ && height == height_ && grid_step == grid_step_
+        && std::memcmp(intrinsic_key, intrinsic_key_, sizeof(intrinsic_key)) == 0) {
+        return false;
+    }
+    width_ = width;
+    height_ = height;
+    grid_step_ = grid_step;
+    std::copy(intrinsic_key, intrinsic_key + 9, intrinsic_key_);
+    is_direct_ = !projection.HasDistortion();
+
+    /* nodes cover the whole image (the last node is at or beyond the edge) */
+    col_num_ = (width_ + grid_step_ - 1) / grid_step_ + 1;
+    row_num_ = (height_ + grid_step_ - 1) / grid_step_ + 1;
+    if (is_direct_) {
+        table_.clear();
+        return true;
+    }
+    table_.resize(static_cast<size_t>(col_num_) * row_num_ * 2);
+    for (int32_t y = 0; y < row_num_; y++) {
+        for (int32_t x = 0; x < col_num_; x++) {
+            table_[(static_cast<size_t>(y) * col_num_ + x) * 2 + 0] = static_cast<float>(x * grid_step_);
+            table_[(static_cast<size_t>(y) * col_num_ + x) * 2 + 1] = static_cast<float>(y * grid_step_);
+        }
+    }
+    projection.Undistort(table_.data(), col_num_ * row_num_, table_.data());
+    return true;
+}
+
+void UndistortPointLut::Undistort(const float* image_point, int32_t num, float* image_point_undistorted) const
+{
+    if (!IsInitialized() || is_direct_) {
+        /* not initialized (nothing is known about the distortion), or no distortion */
+        if (image_point != image_point_undistorted) {
+            std::copy(image_point, image_point + static_cast<size_t>(num) * 2, image_point_undistorted);
+        }
+        return;
+    }
+
+    /* index calculation is vectorized, and only the table read (gather) is done point by point */
+    const float step_inv = 1.0F / grid_step_;
+    const float* table = table_.data();
+    const int32_t block_num = (num + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp parallel for if (num > PARALLEL_THRESHOLD)
+    for (int32_t block = 0; block < block_num; block++) {
+        const int32_t i0 = block * BLOCK_SIZE;
+        const int32_t n = (std::min)(BLOCK_SIZE, num - i0);
+        const int32_t col_num = col_num_;
+        const int32_t row_end = row_num_ - 2;
+        const float* src = image_point + static_cast<size_t>(i0) * 2;
+        float* dst = image_point_undistorted + static_cast<size_t>(i0) * 2;
+        int32_t offset[BLOCK_SIZE];
+        float ax[BLOCK_SIZE], ay[BLOCK_SIZE];
+
+        /* floor is done by truncation of a biased value, and clamp is done on int, so that the loop is vectorized */
+#pragma omp simd
+        for (int32_t i = 0; i < n; i++) {
+            const float gx = src[i * 2 + 0] * step_inv;
+            const float gy = src[i * 2 + 1] * step_inv;
+            const int32_t ix = (std::min)((std::max)(SimdHelper::FloorBiased(gx), 0), col_num - 2);
+            const int32_t iy = (std::min)((std::max)(SimdHelper::FloorBiased(gy), 0), row_end);
+            ax[i] = gx - ix;
+            ay[i] = gy - iy;
+            offset[i] = (iy * col_num + ix) * 2;
+        }
+
+        /* src is not read after here, so dst can be the same as src */
+        for (int32_t i = 0; i < n; i++) {
+            const float* t00 = table + offset[i];
+            const float* t10 = t00 + col_num * 2;
+            for (int32_t k = 0; k < 2; k++) {
+                const float top = t00[k] + (t00[k + 2] - t00[k]) * ax[i];
+                const float bottom = t10[k] + (t10[k + 2] - t10[k]) * ax[i];
+                dst[i * 2 + k] = top + (bottom - top) * ay[i];
+            }
+        }
+    }
+}
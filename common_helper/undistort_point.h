@@ -0,0 +1,59 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef UNDISTORT_POINT_
+#define UNDISTORT_POINT_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+
+/* for My modules */
+#include "camera_projection.h"
+
+/* Lookup table of distorted image -> undistorted image for points (the same result as CameraProjection::Undistort) */
+/*   inference runs on the raw (distorted) frame, and only the results (box corners, keypoints, lane points) are undistorted, */
+/*   so the full-frame remap is not needed */
+/*   the table is a grid of nodes at every grid_step pixels, and a point is bilinearly interpolated from 4 nodes */
+/*   the undistortion of each node (iterative, expensive) is done only when the intrinsic parameters are changed */
+/*   without distortion, the table is not created and points are just copied */
+class UndistortPointLut {
+public:
+    UndistortPointLut();
+    ~UndistortPointLut();
+
+    /* rebuild the table if the parameters are changed. return true if rebuilt */
+    bool Update(const CameraProjection& projection, int32_t width, int32_t height, int32_t grid_step = 8);
+
+    /* distorted image -> undistorted image. src and dst can be the same */
+    /*   points out of the image are extrapolated from the nearest cell (the error grows with the distance) */
+    void Undistort(const float* image_point, int32_t num, float* image_point_undistorted) const;
+
+    bool IsInitialized() const { return col_num_ > 0; }
+
+private:
+    /* parameters */
+    int32_t width_;
+    int32_t height_;
+    int32_t grid_step_;
+    bool is_direct_;            /* no distortion. points are copied */
+    float intrinsic_key_[9];    /* fx, fy, cx, cy, dist[5] used to create table_ */
+
+    /* table */
+    int32_t col_num_;
+    int32_t row_num_;
+    std::vector<float> table_;  /* [row_num][col_num][2]. undistorted image position of each node */
+};
+
+#endif
@@ -0,0 +1,1622 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+/* for My modules */
+#include "common_helper.h"
+#include "bounding_box.h"
+#include "tracker.h"
+#include "tracker_deepsort.h"
+#include "kalman_filter.h"
+#include "kalman_filter_fixed.h"
+#include "kalman_filter_batch.h"
+#include "hungarian_algorithm.h"
+#include "lapjv.h"
+#include "spatial_grid.h"
+#include "sparse_assignment.h"
+#include "feature_similarity.h"
+#include "feature_index.h"
+#include "camera_projection.h"
+#include "ground_lut.h"
+#include "undistort_point.h"
+#include "bird_eye_view.h"
+#include "undistort_map.h"
+#include "seg_post_process.h"
+#include "seg_overlay.h"
+#include "reference.h"
+#include "golden_check.h"
+
+/*** Macro ***/
+#define DEFAULT_DATA_DIR    "./golden/"
+#define LOOP_NUM            10
+
+/* recorded data (raw files in the data directory). synthetic data is used when a file doesn't exist */
+#define FILE_SOFTMAX_INPUT  "softmax_input.raw"     /* float[N][SOFTMAX_LENGTH] */
+#define SOFTMAX_LENGTH      19
+#define FILE_NMS_INPUT      "nms_input.raw"         /* float[N][6], see GoldenCheck::ReadBoundingBoxFile */
+#define NMS_IOU_THRESHOLD   0.5F
+#define FILE_SEG_INPUT      "seg_output.raw"        /* float[SEG_HEIGHT][SEG_WIDTH][SEG_CHANNEL] (paddleseg output) */
+#define SEG_HEIGHT          180
+#define SEG_WIDTH           320
+#define SEG_CHANNEL         19
+#define SEG_LARGE_HEIGHT    512     /* softmax + argmax of the whole output */
+#define SEG_LARGE_WIDTH     1024
+#define SEG_CLASS_MAP_CLASS 0       /* the class used by a consumer of the class map (e.g. road) */
+#define SEG_OVERLAY_WIDTH   1920    /* the label map (SEG_HEIGHT x SEG_WIDTH) is drawn on a 1080p frame */
+#define SEG_OVERLAY_HEIGHT  1080
+#define SEG_OVERLAY_RATIO   0.5F
+#define FILE_TRACKER_INPUT  "tracker_input.raw"     /* float[N][7] = (frame, class_id, score, x, y, w, h) */
+#define TRACKER_FRAME_NUM   300
+#define TRACKER_OBJECT_NUM  20
+#define REID_FRAME_NUM      600     /* TrackerDeepSort with / without skipping feature of dets matched by motion */
+#define REID_PERSON_NUM     20      /* class 0 (feature is calculated) */
+#define REID_OTHER_NUM      5       /* class 1 (feature is never calculated) */
+#define REID_FEATURE_SIZE   128
+#define REID_MISS_RATIO     0.05F
+#define KALMAN_TRACK_NUM    500
+#define KALMAN_FRAME_NUM    20
+#define KALMAN_BATCH_TRACK_NUM  5000
+#define ASSIGNMENT_COST_MAX     1.0F
+#define ASSIGNMENT_SIZE_NUM     5
+#define ASSIGNMENT_HUNGARIAN_MAX    500
+static const int32_t kAssignmentObjectNumList[ASSIGNMENT_SIZE_NUM] = { 10, 100, 500, 1000, 2000 };
+#define ASSIGNMENT_SPARSE_SIZE_NUM  3
+static const int32_t kAssignmentSparseObjectNumList[ASSIGNMENT_SPARSE_SIZE_NUM] = { 100, 500, 2000 };
+#define FEATURE_TRACK_NUM       200     /* persons */
+#define FEATURE_GALLERY_NUM     10      /* features per person */
+#define FEATURE_DET_NUM         200
+#define FEATURE_SIZE            512
+#define FEATURE_INDEX_SIZE_NUM  2
+static const int32_t kFeatureIndexEntryNumList[FEATURE_INDEX_SIZE_NUM] = { 10000, 100000 };
+/* 10000: the configuration of TrackerDeepSort (FeatureIndex::Param default), 100000: a large scale index trained once */
+static const int32_t kFeatureIndexListNumList[FEATURE_INDEX_SIZE_NUM] = { 64, 512 };
+static const int32_t kFeatureIndexProbeNumList[FEATURE_INDEX_SIZE_NUM] = { 4, 8 };
+#define FEATURE_INDEX_MODE_NUM  1000    /* identities are generated around these appearance modes */
+#define FEATURE_INDEX_QUERY_NUM 20
+#define FEATURE_INDEX_TOP_K     10
+#define FEATURE_INDEX_RECALL_MIN    0.9
+#define PROJECTION_POINT_NUM    100000
+#define PROJECTION_WIDTH        1280
+#define PROJECTION_HEIGHT       720
+#define PROJECTION_FOCAL        500.0
+#define PROJECTION_GROUND_MAX   100.0   /* [m]. image points close to the horizon are not used because float can't resolve them */
+#define GROUND_LUT_GRID_STEP    8
+#define UNDISTORT_MAP_WIDTH     1920
+#define UNDISTORT_MAP_HEIGHT    1080
+#define UNDISTORT_POINT_NUM     1000    /* e.g. 100 boxes x 4 corners + keypoints */
+
+/*** Function ***/
+static void GenerateRandom(std::vector<float>& data, size_t num, float min_val, float max_val)
+{
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist(min_val, max_val);
+    data.resize(num);
+    for (auto& v : data) v = dist(engine);
+}
+
+static void GenerateDetection(std::vector<BoundingBox>& bbox_list, int32_t num)
+{
+    std::mt19937 engine(1234);
+    std::uniform_int_distribution<int32_t> dist_pos(0, 600);
+    std::uniform_int_distribution<int32_t> dist_size(20, 100);
+    std::uniform_real_distribution<float> dist_score(0.3F, 1.0F);
+    bbox_list.clear();
+    for (int32_t i = 0; i < num; i++) {
+        /* several candidates around the same object like the raw output of a detector */
+        BoundingBox bbox(i % 3, "", dist_score(engine), dist_pos(engine), dist_pos(engine), dist_size(engine), dist_size(engine));
+        for (int32_t j = 0; j < 4; j++) {
+            BoundingBox bbox_near = bbox;
+            bbox_near.x += j * 2;
+            bbox_near.score -= j * 0.01F;
+            bbox_list.push_back(bbox_near);
+        }
+    }
+}
+
+static void GenerateDetectionSequence(std::vector<std::vector<BoundingBox>>& det_list_list)
+{
+    /* objects moving linearly. some detections are missing and some are noisy */
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist_pos(0, 1000);
+    std::uniform_real_distribution<float> dist_speed(-5, 5);
+    std::uniform_real_distribution<float> dist_noise(-2, 2);
+    std::uniform_real_distribution<float> dist_prob(0, 1);
+    std::vector<std::array<float, 4>> object_list(TRACKER_OBJECT_NUM);
+    for (auto& object : object_list) object = { dist_pos(engine), dist_pos(engine), dist_speed(engine), dist_speed(engine) };
+    det_list_list.resize(TRACKER_FRAME_NUM);
+    for (auto& det_list : det_list_list) {
+        for (int32_t i = 0; i < TRACKER_OBJECT_NUM; i++) {
+            auto& object = object_list[i];
+            object[0] += object[2];
+            object[1] += object[3];
+            if (dist_prob(engine) < 0.1F) continue;
+            det_list.push_back(BoundingBox(i % 3, "", 0.9F, static_cast<int32_t>(object[0] + dist_noise(engine)), static_cast<int32_t>(object[1] + dist_noise(engine)), 60, 120));
+        }
+    }
+}
+
+static bool ReadDetectionSequence(const std::string& filename, std::vector<std::vector<BoundingBox>>& det_list_list)
+{
+    std::vector<float> data;
+    if (!GoldenCheck::ReadRawFile(filename, data)) return false;
+    det_list_list.clear();
+    for (size_t i = 0; i + 7 <= data.size(); i += 7) {
+        size_t frame = static_cast<size_t>(data[i]);
+        if (det_list_list.size() <= frame) det_list_list.resize(frame + 1);
+        det_list_list[frame].push_back(BoundingBox(static_cast<int32_t>(data[i + 1]), "", data[i + 2],
+            static_cast<int32_t>(data[i + 3]), static_cast<int32_t>(data[i + 4]), static_cast<int32_t>(data[i + 5]), static_cast<int32_t>(data[i + 6])));
+    }
+    return true;
+}
+
+
+/*** Reference implementations ***/
+static void SoftMaxReference(const float* src, float* dst, int32_t length)
+{
+    const float max_val = *std::max_element(src, src + length);
+    double sum = 0;
+    for (int32_t i = 0; i < length; i++) {
+        dst[i] = std::exp(src[i] - max_val);
+        sum += dst[i];
+    }
+    for (int32_t i = 0; i < length; i++) {
+        dst[i] = static_cast<float>(dst[i] / sum);
+    }
+}
+
+static void ArgMaxReference(const std::vector<float>& src, std::vector<uint8_t>& dst, int32_t pixel_num, int32_t channel)
+{
+    dst.resize(pixel_num);
+    for (int32_t i = 0; i < pixel_num; i++) {
+        const float* current = src.data() + static_cast<size_t>(i) * channel;
+        dst[i] = static_cast<uint8_t>(std::max_element(current, current + channel) - current);
+    }
+}
+
+/* the original post process of pj_tflite_seg_paddleseg_cityscapessota: */
+/*   copy of the output, softmax with a vector allocated for each pixel, scatter to a plane for each class, and another pass for argmax */
+static void SoftMaxArgMaxReference(const float* logit, int32_t pixel_num, int32_t channel, std::vector<uint8_t>& label, std::vector<float>& prob)
+{
+    const std::vector<float> value_list(logit, logit + static_cast<size_t>(pixel_num) * channel);
+    prob.resize(static_cast<size_t>(pixel_num) * channel);
+#pragma omp parallel for
+    for (int32_t i = 0; i < pixel_num; i++) {
+        std::vector<float> score_list(channel, 0);
+        CommonHelper::SoftMaxFast(value_list.data() + static_cast<size_t>(i) * channel, score_list.data(), channel);
+        for (int32_t c = 0; c < channel; c++) {
+            prob[static_cast<size_t>(c) * pixel_num + i] = score_list[c];
+        }
+    }
+    label.resize(pixel_num);
+#pragma omp parallel for
+    for (int32_t i = 0; i < pixel_num; i++) {
+        const auto& current_iter = value_list.begin() + static_cast<size_t>(i) * channel;
+        label[i] = static_cast<uint8_t>(std::distance(current_iter, std::max_element(current_iter, current_iter + channel)));
+    }
+}
+
+/* uniform linear motion model used in Track (cx, cy, area, aspect, vx, vy, vz) */
+static constexpr int32_t kKalmanNumStatus = 7;
+static constexpr int32_t kKalmanNumObserve = 4;
+typedef KalmanFilterFixed<kKalmanNumStatus, kKalmanNumObserve, float> KalmanFilterBbox;
+static const std::vector<double> kKalmanF = {
+    1, 0, 0, 0, 1, 0, 0,
+    0, 1, 0, 0, 0, 1, 0,
+    0, 0, 1, 0, 0, 0, 1,
+    0, 0, 0, 1, 0, 0, 0,
+    0, 0, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 1 };
+static const std::vector<double> kKalmanQ = {
+    1, 0, 0, 0,    0,    0,     0,
+    0, 1, 0, 0,    0,    0,     0,
+    0, 0, 1, 0,    0,    0,     0,
+    0, 0, 0, 1,    0,    0,     0,
+    0, 0, 0, 0, 0.01,    0,     0,
+    0, 0, 0, 0,    0, 0.01,     0,
+    0, 0, 0, 0,    0,    0, 0.001 };
+static const std::vector<double> kKalmanH = {
+    1, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 1, 0, 0, 0 };
+static const std::vector<double> kKalmanR = {
+    1, 0,  0,  0,
+    0, 1,  0,  0,
+    0, 0, 10,  0,
+    0, 0,  0, 10 };
+
+template<typename MATRIX>
+static MATRIX ToFixedMatrix(const std::vector<double>& data)
+{
+    MATRIX mat;
+    for (size_t i = 0; i < data.size(); i++) mat.data[i] = static_cast<float>(data[i]);
+    return mat;
+}
+
+static std::vector<double> BboxToObserved(const BoundingBox& bbox)
+{
+    return { static_cast<double>(bbox.x + bbox.w / 2), static_cast<double>(bbox.y + bbox.h / 2), static_cast<double>(bbox.w * bbox.h), static_cast<double>(bbox.w) / bbox.h };
+}
+
+template<typename MATRIX>
+static BoundingBox StatusToBbox(const MATRIX& X)
+{
+    BoundingBox bbox;
+    bbox.w = static_cast<int32_t>(std::sqrt(X(2, 0) * X(3, 0)));
+    bbox.h = static_cast<int32_t>(X(2, 0) / bbox.w);
+    bbox.x = static_cast<int32_t>(X(0, 0) - bbox.w / 2);
+    bbox.y = static_cast<int32_t>(X(1, 0) - bbox.h / 2);
+    return bbox;
+}
+
+/* Predict and Update of each track for each frame. the observation is the detection of the same object */
+static void RunKalmanReference(const std::vector<std::vector<BoundingBox>>& det_list_list, std::vector<BoundingBox>& bbox_list)
+{
+    const SimpleMatrix F(kKalmanNumStatus, kKalmanNumStatus, kKalmanF);
+    const SimpleMatrix Q(kKalmanNumStatus, kKalmanNumStatus, kKalmanQ);
+    const SimpleMatrix H(kKalmanNumObserve, kKalmanNumStatus, kKalmanH);
+    const SimpleMatrix R(kKalmanNumObserve, kKalmanNumObserve, kKalmanR);
+    std::vector<KalmanFilter> kf_list(det_list_list[0].size());
+    for (size_t i = 0; i < kf_list.size(); i++) {
+        std::vector<double> x0 = BboxToObserved(det_list_list[0][i]);
+        x0.resize(kKalmanNumStatus, 0);
+        kf_list[i].Initialize(F, Q, H, R, SimpleMatrix(kKalmanNumStatus, 1, x0), SimpleMatrix::IdentityMatrix(kKalmanNumStatus) * 10);
+    }
+    bbox_list.clear();
+    for (size_t frame = 1; frame < det_list_list.size(); frame++) {
+        for (size_t i = 0; i < kf_list.size(); i++) {
+            kf_list[i].Predict();
+            kf_list[i].Update(SimpleMatrix(kKalmanNumObserve, 1, BboxToObserved(det_list_list[frame][i])));
+            bbox_list.push_back(StatusToBbox(kf_list[i].X));
+        }
+    }
+}
+
+static void RunKalmanFixed(const std::vector<std::vector<BoundingBox>>& det_list_list, std::vector<BoundingBox>& bbox_list)
+{
+    const auto F = ToFixedMatrix<KalmanFilterBbox::MatrixStatus>(kKalmanF);
+    const auto Q = ToFixedMatrix<KalmanFilterBbox::MatrixStatus>(kKalmanQ);
+    const auto H = ToFixedMatrix<KalmanFilterBbox::MatrixObserveStatus>(kKalmanH);
+    const auto R = ToFixedMatrix<KalmanFilterBbox::MatrixObserve>(kKalmanR);
+    std::vector<KalmanFilterBbox> kf_list(det_list_list[0].size());
+    for (size_t i = 0; i < kf_list.size(); i++) {
+        kf_list[i].Initialize(F, Q, H, R, ToFixedMatrix<KalmanFilterBbox::VectorStatus>(BboxToObserved(det_list_list[0][i])), KalmanFilterBbox::MatrixStatus::IdentityMatrix() * 10.0F);
+    }
+    bbox_list.clear();
+    for (size_t frame = 1; frame < det_list_list.size(); frame++) {
+        for (size_t i = 0; i < kf_list.size(); i++) {
+            kf_list[i].Predict();
+            kf_list[i].Update(ToFixedMatrix<KalmanFilterBbox::VectorObserve>(BboxToObserved(det_list_list[frame][i])));
+            bbox_list.push_back(StatusToBbox(kf_list[i].X));
+        }
+    }
+}
+
+static void RunKalmanBatch(const std::vector<std::vector<BoundingBox>>& det_list_list, std::vector<BoundingBox>& bbox_list)
+{
+    const auto F = ToFixedMatrix<KalmanFilterBbox::MatrixStatus>(kKalmanF);
+    const auto Q = ToFixedMatrix<KalmanFilterBbox::MatrixStatus>(kKalmanQ);
+    const auto H = ToFixedMatrix<KalmanFilterBbox::MatrixObserveStatus>(kKalmanH);
+    const auto R = ToFixedMatrix<KalmanFilterBbox::MatrixObserve>(kKalmanR);
+    KalmanFilterBatch<kKalmanNumStatus, kKalmanNumObserve, float> kf_batch;
+    for (size_t i = 0; i < det_list_list[0].size(); i++) {
+        KalmanFilterBbox kf;
+        kf.Initialize(F, Q, H, R, ToFixedMatrix<KalmanFilterBbox::VectorStatus>(BboxToObserved(det_list_list[0][i])), KalmanFilterBbox::MatrixStatus::IdentityMatrix() * 10.0F);
+        kf_batch.Add(kf);
+    }
+    bbox_list.clear();
+    for (size_t frame = 1; frame < det_list_list.size(); frame++) {
+        kf_batch.Predict();
+        for (int32_t i = 0; i < kf_batch.GetSize(); i++) {
+            kf_batch.SetObservation(i, ToFixedMatrix<KalmanFilterBbox::VectorObserve>(BboxToObserved(det_list_list[frame][i])));
+        }
+        kf_batch.Update();
+        for (int32_t i = 0; i < kf_batch.GetSize(); i++) {
+            bbox_list.push_back(StatusToBbox(kf_batch.GetStatus(i)));
+        }
+    }
+}
+
+static void GenerateKalmanInput(std::vector<std::vector<BoundingBox>>& det_list_list, int32_t track_num)
+{
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist_pos(0, 1000);
+    std::uniform_real_distribution<float> dist_speed(-5, 5);
+    std::uniform_real_distribution<float> dist_noise(-2, 2);
+    det_list_list.assign(KALMAN_FRAME_NUM, std::vector<BoundingBox>());
+    for (int32_t i = 0; i < track_num; i++) {
+        float x = dist_pos(engine), y = dist_pos(engine), vx = dist_speed(engine), vy = dist_speed(engine);
+        for (auto& det_list : det_list_list) {
+            x += vx;
+            y += vy;
+            det_list.push_back(BoundingBox(0, "", 0.9F, static_cast<int32_t>(x + dist_noise(engine)), static_cast<int32_t>(y + dist_noise(engine)), 60, 120));
+        }
+    }
+}
+
+/*** Assignment (track x det cost matrix like Tracker) ***/
+static void GenerateAssignmentBox(std::vector<BoundingBox>& track_list, std::vector<BoundingBox>& det_list, int32_t object_num)
+{
+    /* the same density of objects regardless of the number. 10% of tracks are lost and 5% of dets are new */
+    std::mt19937 engine(1234);
+    const float canvas_size = 60.0F * std::sqrt(static_cast<float>(object_num));
+    std::uniform_real_distribution<float> dist_pos(0, canvas_size);
+    std::uniform_real_distribution<float> dist_noise(-8, 8);
+    std::uniform_real_distribution<float> dist_prob(0, 1);
+    track_list.clear();
+    det_list.clear();
+    for (int32_t i = 0; i < object_num; i++) {
+        BoundingBox bbox(0, "", 0.9F, static_cast<int32_t>(dist_pos(engine)), static_cast<int32_t>(dist_pos(engine)), 40, 80);
+        track_list.push_back(bbox);
+        if (dist_prob(engine) < 0.1F) continue;
+        bbox.x += static_cast<int32_t>(dist_noise(engine));
+        bbox.y += static_cast<int32_t>(dist_noise(engine));
+        det_list.push_back(bbox);
+    }
+    for (int32_t i = 0; i < object_num / 20; i++) {
+        det_list.push_back(BoundingBox(0, "", 0.9F, static_cast<int32_t>(dist_pos(engine)), static_cast<int32_t>(dist_pos(engine)), 40, 80));
+    }
+    std::shuffle(det_list.begin(), det_list.end(), engine);
+}
+
+static float CalculateAssignmentCost(const BoundingBox& track_bbox, const BoundingBox& det_bbox)
+{
+    float iou = BoundingBoxUtils::CalculateIoU(track_bbox, det_bbox);
+    return (iou < 0.3F) ? ASSIGNMENT_COST_MAX : ASSIGNMENT_COST_MAX - iou;
+}
+
+static void GenerateAssignmentCost(std::vector<float>& cost_matrix, int32_t& track_num, int32_t& det_num, int32_t object_num)
+{
+    std::vector<BoundingBox> track_list, det_list;
+    GenerateAssignmentBox(track_list, det_list, object_num);
+    track_num = static_cast<int32_t>(track_list.size());
+    det_num = static_cast<int32_t>(det_list.size());
+    cost_matrix.resize(static_cast<size_t>(track_num) * det_num);
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        for (int32_t i_det = 0; i_det < det_num; i_det++) {
+            cost_matrix[i_track * det_num + i_det] = CalculateAssignmentCost(track_list[i_track], det_list[i_det]);
+        }
+    }
+}
+
+/* the previous implementation in Tracker: pad to a square matrix, then drop pairs at the cost limit */
+static void RunAssignmentHungarian(const std::vector<float>& cost_matrix, int32_t track_num, int32_t det_num, std::vector<float>& result)
+{
+    size_t size_cost_matrix = (std::max)(track_num, det_num);
+    std::vector<std::vector<float>> cost_matrix_square(size_cost_matrix, std::vector<float>(size_cost_matrix, ASSIGNMENT_COST_MAX));
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        for (int32_t i_det = 0; i_det < det_num; i_det++) {
+            cost_matrix_square[i_track][i_det] = cost_matrix[i_track * det_num + i_det];
+        }
+    }
+    std::vector<int32_t> det_index_for_track(size_cost_matrix, -1);
+    std::vector<int32_t> track_index_for_det(size_cost_matrix, -1);
+    HungarianAlgorithm<float> solver(cost_matrix_square);
+    solver.Solve(det_index_for_track, track_index_for_det);
+
+    double total_cost = 0;
+    int32_t assigned_num = 0;
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        int32_t i_det = det_index_for_track[i_track];
+        if (i_det >= 0 && i_det < det_num && cost_matrix[i_track * det_num + i_det] < ASSIGNMENT_COST_MAX) {
+            total_cost += cost_matrix[i_track * det_num + i_det];
+            assigned_num++;
+        }
+    }
+    result = { static_cast<float>(total_cost), static_cast<float>(assigned_num) };
+}
+
+static void RunAssignmentLapjv(Lapjv<float>& solver, const std::vector<float>& cost_matrix, int32_t track_num, int32_t det_num, std::vector<float>& result)
+{
+    std::vector<int32_t> det_index_for_track, track_index_for_det;
+    double total_cost = solver.Solve(cost_matrix.data(), track_num, det_num, ASSIGNMENT_COST_MAX, det_index_for_track, track_index_for_det);
+    int32_t assigned_num = 0;
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        if (det_index_for_track[i_track] >= 0) assigned_num++;
+    }
+    result = { static_cast<float>(total_cost), static_cast<float>(assigned_num) };
+}
+
+/* the same as Tracker::Update: dense cost matrix for all pairs vs pairs gated by SpatialGrid */
+static void RunAssignmentDense(Lapjv<float>& solver, std::vector<float>& cost_matrix, const std::vector<BoundingBox>& track_list, const std::vector<BoundingBox>& det_list, std::vector<int32_t>& det_index_for_track)
+{
+    const int32_t track_num = static_cast<int32_t>(track_list.size());
+    const int32_t det_num = static_cast<int32_t>(det_list.size());
+    cost_matrix.resize(static_cast<size_t>(track_num) * det_num);
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        for (int32_t i_det = 0; i_det < det_num; i_det++) {
+            cost_matrix[i_track * det_num + i_det] = CalculateAssignmentCost(track_list[i_track], det_list[i_det]);
+        }
+    }
+    std::vector<int32_t> track_index_for_det;
+    solver.Solve(cost_matrix.data(), track_num, det_num, ASSIGNMENT_COST_MAX, det_index_for_track, track_index_for_det);
+}
+
+static void RunAssignmentSparse(SpatialGrid& grid, SparseAssignment& assignment, const std::vector<BoundingBox>& track_list, const std::vector<BoundingBox>& det_list, std::vector<int32_t>& det_index_for_track)
+{
+    const int32_t track_num = static_cast<int32_t>(track_list.size());
+    const int32_t det_num = static_cast<int32_t>(det_list.size());
+    grid.Build(det_list);
+    assignment.Reset(track_num, det_num);
+    std::vector<int32_t> candidate_list;
+    for (int32_t i_track = 0; i_track < track_num; i_track++) {
+        const auto& track_bbox = track_list[i_track];
+        candidate_list.clear();
+        grid.Query(track_bbox.x - grid.GetMaxWidth(), track_bbox.y - grid.GetMaxHeight(), track_bbox.x + track_bbox.w, track_bbox.y + track_bbox.h, candidate_list);
+        for (int32_t i_det : candidate_list) {
+            float cost = CalculateAssignmentCost(track_bbox, det_list[i_det]);
+            if (cost < ASSIGNMENT_COST_MAX) assignment.AddEdge(i_track, i_det, cost);
+        }
+    }
+    std::vector<int32_t> track_index_for_det;
+    assignment.Solve(ASSIGNMENT_COST_MAX, det_index_for_track, track_index_for_det);
+}
+
+static std::vector<float> SummarizeAssignment(const std::vector<BoundingBox>& track_list, const std::vector<BoundingBox>& det_list, const std::vector<int32_t>& det_index_for_track)
+{
+    double total_cost = 0;
+    int32_t assigned_num = 0;
+    for (size_t i_track = 0; i_track < det_index_for_track.size(); i_track++) {
+        if (det_index_for_track[i_track] < 0) continue;
+        total_cost += CalculateAssignmentCost(track_list[i_track], det_list[det_index_for_track[i_track]]);
+        assigned_num++;
+    }
+    return { static_cast<float>(total_cost), static_cast<float>(assigned_num) };
+}
+
+/*** Feature similarity (DeepSORT) ***/
+static float CosineSimilarityReference(const float* feature0, const float* feature1, int32_t size)
+{
+    /* the previous implementation in TrackerDeepSort: norms are calculated for every pair */
+    float norm_0 = 0;
+    float norm_1 = 0;
+    float dot = 0;
+    for (int32_t i = 0; i < size; i++) {
+        norm_0 += feature0[i] * feature0[i];
+        norm_1 += feature1[i] * feature1[i];
+        dot += feature0[i] * feature1[i];
+    }
+    return dot / (std::sqrt(norm_0) * std::sqrt(norm_1));
+}
+
+static void RunFeatureSimilarityReference(const std::vector<float>& gallery, const std::vector<float>& det, std::vector<float>& similarity)
+{
+    const int32_t gallery_num = static_cast<int32_t>(gallery.size() / FEATURE_SIZE);
+    const int32_t det_num = static_cast<int32_t>(det.size() / FEATURE_SIZE);
+    similarity.resize(static_cast<size_t>(gallery_num) * det_num);
+    for (int32_t i = 0; i < gallery_num; i++) {
+        for (int32_t j = 0; j < det_num; j++) {
+            similarity[i * det_num + j] = CosineSimilarityReference(&gallery[i * FEATURE_SIZE], &det[j * FEATURE_SIZE], FEATURE_SIZE);
+        }
+    }
+}
+
+/* gallery is normalized when it's stored. dets are normalized every frame */
+static void RunFeatureSimilarityGemm(const std::vector<float>& gallery_normalized, const std::vector<float>& det, std::vector<float>& det_normalized, std::vector<float>& similarity)
+{
+    const int32_t gallery_num = static_cast<int32_t>(gallery_normalized.size() / FEATURE_SIZE);
+    const int32_t det_num = static_cast<int32_t>(det.size() / FEATURE_SIZE);
+    det_normalized.resize(det.size());
+    for (int32_t j = 0; j < det_num; j++) {
+        FeatureSimilarity::NormalizeL2(&det[j * FEATURE_SIZE], &det_normalized[j * FEATURE_SIZE], FEATURE_SIZE);
+    }
+    similarity.resize(static_cast<size_t>(gallery_num) * det_num);
+    FeatureSimilarity::MultiplyTransposed(gallery_normalized.data(), gallery_num, FEATURE_SIZE, det_normalized.data(), det_num, FEATURE_SIZE, FEATURE_SIZE, similarity.data(), det_num);
+}
+
+static void RunFeatureSimilarityGemmInt8(const std::vector<int8_t>& gallery_int8, const std::vector<float>& det, std::vector<float>& det_normalized, std::vector<int8_t>& det_int8, std::vector<float>& similarity)
+{
+    const int32_t gallery_num = static_cast<int32_t>(gallery_int8.size() / FEATURE_SIZE);
+    const int32_t det_num = static_cast<int32_t>(det.size() / FEATURE_SIZE);
+    det_normalized.resize(det.size());
+    det_int8.resize(det.size());
+    for (int32_t j = 0; j < det_num; j++) {
+        FeatureSimilarity::NormalizeL2(&det[j * FEATURE_SIZE], &det_normalized[j * FEATURE_SIZE], FEATURE_SIZE);
+        FeatureSimilarity::QuantizeInt8(&det_normalized[j * FEATURE_SIZE], &det_int8[j * FEATURE_SIZE], FEATURE_SIZE);
+    }
+    similarity.resize(static_cast<size_t>(gallery_num) * det_num);
+    FeatureSimilarity::MultiplyTransposed(gallery_int8.data(), gallery_num, FEATURE_SIZE, det_int8.data(), det_num, FEATURE_SIZE, FEATURE_SIZE, similarity.data(), det_num);
+}
+/*** Feature index (re-identification of lost tracks) ***/
+static void GenerateFeatureIndexData(std::vector<float>& entry_list, std::vector<float>& query_list, int32_t entry_num)
+{
+    /* features like the output after ReLU. each identity = one of the appearance modes + noise, each query = one of the identities + small noise */
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist_mode(0.0F, 1.0F);
+    std::uniform_real_distribution<float> dist_identity(-0.3F, 0.3F);
+    std::uniform_real_distribution<float> dist_query(-0.1F, 0.1F);
+    std::vector<float> mode_list(FEATURE_INDEX_MODE_NUM * FEATURE_SIZE);
+    for (auto& v : mode_list) v = dist_mode(engine);
+    entry_list.resize(static_cast<size_t>(entry_num) * FEATURE_SIZE);
+    for (int32_t i = 0; i < entry_num; i++) {
+        const int32_t mode = engine() % FEATURE_INDEX_MODE_NUM;
+        for (int32_t j = 0; j < FEATURE_SIZE; j++) {
+            entry_list[static_cast<size_t>(i) * FEATURE_SIZE + j] = (std::max)(0.0F, mode_list[mode * FEATURE_SIZE + j] + dist_identity(engine));
+        }
+    }
+    query_list.resize(FEATURE_INDEX_QUERY_NUM * FEATURE_SIZE);
+    for (int32_t i = 0; i < FEATURE_INDEX_QUERY_NUM; i++) {
+        const int32_t identity = engine() % entry_num;
+        for (int32_t j = 0; j < FEATURE_SIZE; j++) {
+            query_list[i * FEATURE_SIZE + j] = (std::max)(0.0F, entry_list[static_cast<size_t>(identity) * FEATURE_SIZE + j] + dist_query(engine));
+        }
+    }
+}
+
+static void RunFeatureIndex(FeatureIndex& index, const std::vector<float>& query_list, bool is_exact, std::vector<std::vector<FeatureIndex::Neighbor>>& result)
+{
+    result.resize(FEATURE_INDEX_QUERY_NUM);
+    for (int32_t i = 0; i < FEATURE_INDEX_QUERY_NUM; i++) {
+        if (is_exact) {
+            index.SearchExact(&query_list[i * FEATURE_SIZE], FEATURE_INDEX_TOP_K, result[i]);
+        } else {
+            index.Search(&query_list[i * FEATURE_SIZE], FEATURE_INDEX_TOP_K, result[i]);
+        }
+    }
+}
+
+/* return the max time of an insertion [msec] */
+static double BuildFeatureIndex(FeatureIndex& index, const FeatureIndex::Param& param, const std::vector<float>& entry_list, int32_t entry_num)
+{
+    double time_max = 0;
+    index.Initialize(param);
+    for (int32_t j = 0; j < entry_num; j++) {
+        const auto t0 = std::chrono::steady_clock::now();
+        index.Insert(j, &entry_list[static_cast<size_t>(j) * FEATURE_SIZE], j);
+        const auto t1 = std::chrono::steady_clock::now();
+        time_max = (std::max)(time_max, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return time_max;
+}
+
+static GoldenCheck::CompareResult CompareFeatureIndexRecall(const std::vector<std::vector<FeatureIndex::Neighbor>>& ref, const std::vector<std::vector<FeatureIndex::Neighbor>>& opt)
+{
+    int32_t found_num = 0;
+    int32_t total_num = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        for (const auto& neighbor_ref : ref[i]) {
+            for (const auto& neighbor_opt : opt[i]) {
+                if (neighbor_ref.id == neighbor_opt.id) {
+                    found_num++;
+                    break;
+                }
+            }
+            total_num++;
+        }
+    }
+    GoldenCheck::CompareResult result;
+    result.metric = total_num > 0 ? static_cast<double>(found_num) / total_num : 0;
+    result.is_pass = result.metric >= FEATURE_INDEX_RECALL_MIN;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "recall@%d = %.3f (min = %.3f), %d queries", FEATURE_INDEX_TOP_K, result.metric, FEATURE_INDEX_RECALL_MIN, FEATURE_INDEX_QUERY_NUM);
+    result.message = buffer;
+    return result;
+}
+
+
+/*** Camera projection ***/
+typedef struct ProjectionParam_ {
+    double fx, fy, cx, cy;
+    double dist[5];     /* k1, k2, p1, p2, k3 */
+    double R[9];
+    double t[3];
+} ProjectionParam;
+
+static ProjectionParam MakeProjectionParam(bool use_distortion)
+{
+    /* camera at 1.5 m above the ground (Y+ = down), pitch = 10 deg (looking down), yaw = 5 deg, roll = 2 deg */
+    ProjectionParam param;
+    param.fx = param.fy = PROJECTION_FOCAL;
+    param.cx = PROJECTION_WIDTH / 2.0;
+    param.cy = PROJECTION_HEIGHT / 2.0;
+    const double dist[5] = { -0.1, 0.01, -0.005, -0.001, 0.0 };
+    for (int32_t i = 0; i < 5; i++) param.dist[i] = use_distortion ? dist[i] : 0.0;
+
+    /* Rodrigues */
+    const double deg2rad = std::acos(-1.0) / 180;
+    const double rvec[3] = { 10.0 * deg2rad, 5.0 * deg2rad, 2.0 * deg2rad };
+    const double theta = std::sqrt(rvec[0] * rvec[0] + rvec[1] * rvec[1] + rvec[2] * rvec[2]);
+    const double k[3] = { rvec[0] / theta, rvec[1] / theta, rvec[2] / theta };
+    const double c = std::cos(theta), s = std::sin(theta);
+    const double R[9] = {
+        c + k[0] * k[0] * (1 - c),        k[0] * k[1] * (1 - c) - k[2] * s, k[0] * k[2] * (1 - c) + k[1] * s,
+        k[1] * k[0] * (1 - c) + k[2] * s, c + k[1] * k[1] * (1 - c),        k[1] * k[2] * (1 - c) - k[0] * s,
+        k[2] * k[0] * (1 - c) - k[1] * s, k[2] * k[1] * (1 - c) + k[0] * s, c + k[2] * k[2] * (1 - c),
+    };
+    const double T[3] = { 0.0, -1.5, 0.0 };
+    for (int32_t i = 0; i < 9; i++) param.R[i] = R[i];
+    for (int32_t i = 0; i < 3; i++) param.t[i] = -(R[i * 3 + 0] * T[0] + R[i * 3 + 1] * T[1] + R[i * 3 + 2] * T[2]); /* t = -RT */
+    return param;
+}
+
+static void SetProjection(const ProjectionParam& param, CameraProjection& projection)
+{
+    float dist[5], R[9], t[3];
+    for (int32_t i = 0; i < 5; i++) dist[i] = static_cast<float>(param.dist[i]);
+    for (int32_t i = 0; i < 9; i++) R[i] = static_cast<float>(param.R[i]);
+    for (int32_t i = 0; i < 3; i++) t[i] = static_cast<float>(param.t[i]);
+    projection.SetIntrinsic(static_cast<float>(param.fx), static_cast<float>(param.fy), static_cast<float>(param.cx), static_cast<float>(param.cy));
+    projection.SetDistortion(dist);
+    projection.SetExtrinsic(R, t);
+}
+
+static void DistortReference(const double* dist, double x, double y, double& x_distorted, double& y_distorted)
+{
+    const double r2 = x * x + y * y;
+    const double radial = 1 + dist[0] * r2 + dist[1] * r2 * r2 + dist[4] * r2 * r2 * r2;
+    x_distorted = x * radial + 2 * dist[2] * x * y + dist[3] * (r2 + 2 * x * x);
+    y_distorted = y * radial + dist[2] * (r2 + 2 * y * y) + 2 * dist[3] * x * y;
+}
+
+static void UndistortReference(const double* dist, double x_distorted, double y_distorted, double& x, double& y)
+{
+    /* the same iteration as cv::undistortPoints */
+    x = x_distorted;
+    y = y_distorted;
+    for (int32_t i = 0; i < CameraProjection::kUndistortIterationNum; i++) {
+        const double r2 = x * x + y * y;
+        const double radial = 1 + dist[0] * r2 + dist[1] * r2 * r2 + dist[4] * r2 * r2 * r2;
+        const double delta_x = 2 * dist[2] * x * y + dist[3] * (r2 + 2 * x * x);
+        const double delta_y = dist[2] * (r2 + 2 * y * y) + 2 * dist[3] * x * y;
+        x = (x_distorted - delta_x) / radial;
+        y = (y_distorted - delta_y) / radial;
+    }
+}
+
+/* the same calculation as the original CameraModel: small matrices for each point */
+static void RunProjectionWorld2ImageReference(const ProjectionParam& param, const std::vector<float>& object_point, std::vector<float>& image_point)
+{
+    const SimpleMatrix Rt(3, 4, {
+        param.R[0], param.R[1], param.R[2], param.t[0],
+        param.R[3], param.R[4], param.R[5], param.t[1],
+        param.R[6], param.R[7], param.R[8], param.t[2] });
+    const int32_t num = static_cast<int32_t>(object_point.size() / 3);
+    image_point.resize(num * 2);
+    for (int32_t i = 0; i < num; i++) {
+        const SimpleMatrix Mw(4, 1, { object_point[i * 3 + 0], object_point[i * 3 + 1], object_point[i * 3 + 2], 1 });
+        const SimpleMatrix Mc = Rt * Mw;
+        if (Mc(2, 0) <= 0) {
+            image_point[i * 2 + 0] = image_point[i * 2 + 1] = CameraProjection::kInvalidImage;
+            continue;
+        }
+        double u, v;
+        DistortReference(param.dist, Mc(0, 0) / Mc(2, 0), Mc(1, 0) / Mc(2, 0), u, v);
+        image_point[i * 2 + 0] = static_cast<float>(u * param.fx + param.cx);
+        image_point[i * 2 + 1] = static_cast<float>(v * param.fy + param.cy);
+    }
+}
+
+static bool Image2GroundReference(const ProjectionParam& param, const SimpleMatrix& K_inv, const SimpleMatrix& R_inv, const SimpleMatrix& t, float x_image, float y_image, double& X, double& Z)
+{
+    /* s * Rinv * Kinv * [x, y, 1] = M + Rinv * t, where M[1] = 0 (ground plane) */
+    double u, v;
+    UndistortReference(param.dist, (x_image - param.cx) / param.fx, (y_image - param.cy) / param.fy, u, v);
+    const SimpleMatrix XY(3, 1, { u * param.fx + param.cx, v * param.fy + param.cy, 1 });
+    const SimpleMatrix LEFT_WO_S = R_inv * K_inv * XY;
+    const SimpleMatrix RIGHT_WO_M = R_inv * t;
+    const double s = RIGHT_WO_M(1, 0) / LEFT_WO_S(1, 0);
+    const SimpleMatrix M = R_inv * ((K_inv * XY) * s - t);
+    X = M(0, 0);
+    Z = M(2, 0);
+    return s > 0;   /* in front of the camera */
+}
+
+static void RunProjectionImage2GroundReference(const ProjectionParam& param, const std::vector<float>& image_point, std::vector<float>& object_point)
+{
+    const SimpleMatrix K_inv = SimpleMatrix(3, 3, { param.fx, 0, param.cx, 0, param.fy, param.cy, 0, 0, 1 }).Inverse();
+    const SimpleMatrix R_inv = SimpleMatrix(3, 3, std::vector<double>(param.R, param.R + 9)).Transpose();
+    const SimpleMatrix t(3, 1, std::vector<double>(param.t, param.t + 3));
+    const int32_t num = static_cast<int32_t>(image_point.size() / 2);
+    object_point.resize(num * 3);
+    for (int32_t i = 0; i < num; i++) {
+        double X, Z;
+        const bool is_valid = Image2GroundReference(param, K_inv, R_inv, t, image_point[i * 2 + 0], image_point[i * 2 + 1], X, Z);
+        object_point[i * 3 + 0] = is_valid ? static_cast<float>(X) : CameraProjection::kInvalidGround;
+        object_point[i * 3 + 1] = is_valid ? 0.0F : CameraProjection::kInvalidGround;
+        object_point[i * 3 + 2] = is_valid ? static_cast<float>(Z) : CameraProjection::kInvalidGround;
+    }
+}
+
+static void GenerateProjectionInput(const ProjectionParam& param, std::vector<float>& object_point, std::vector<float>& image_point)
+{
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<double> dist_normalized(-1.2, 1.2);
+    std::uniform_real_distribution<double> dist_depth(1.0, 80.0);
+    std::uniform_real_distribution<float> dist_x(0.0F, static_cast<float>(PROJECTION_WIDTH));
+    std::uniform_real_distribution<float> dist_y(0.0F, static_cast<float>(PROJECTION_HEIGHT));
+
+    /* world points in the field of view. 10 % of them are behind the camera */
+    object_point.resize(PROJECTION_POINT_NUM * 3);
+    for (int32_t i = 0; i < PROJECTION_POINT_NUM; i++) {
+        const double Zc = (i % 10 == 0) ? -dist_depth(engine) : dist_depth(engine);
+        const double Mc[3] = { dist_normalized(engine) * Zc, dist_normalized(engine) * Zc, Zc };
+        for (int32_t j = 0; j < 3; j++) {
+            /* Mw = R^T * (Mc - t) */
+            object_point[i * 3 + j] = static_cast<float>(param.R[0 * 3 + j] * (Mc[0] - param.t[0]) + param.R[1 * 3 + j] * (Mc[1] - param.t[1]) + param.R[2 * 3 + j] * (Mc[2] - param.t[2]));
+        }
+    }
+
+    /* image points on the whole image (above and below the horizon) */
+    const SimpleMatrix K_inv = SimpleMatrix(3, 3, { param.fx, 0, param.cx, 0, param.fy, param.cy, 0, 0, 1 }).Inverse();
+    const SimpleMatrix R_inv = SimpleMatrix(3, 3, std::vector<double>(param.R, param.R + 9)).Transpose();
+    const SimpleMatrix t(3, 1, std::vector<double>(param.t, param.t + 3));
+    image_point.clear();
+    while (image_point.size() < PROJECTION_POINT_NUM * 2) {
+        const float x = dist_x(engine), y = dist_y(engine);
+        double X, Z;
+        Image2GroundReference(param, K_inv, R_inv, t, x, y, X, Z);
+        if (std::abs(X) > PROJECTION_GROUND_MAX || std::abs(Z) > PROJECTION_GROUND_MAX) continue;
+        image_point.push_back(x);
+        image_point.push_back(y);
+    }
+}
+
+
+/*** Undistortion map (unified projection model of DeepCalib) ***/
+static UndistortMap::UnifiedParam MakeUndistortMapParam()
+{
+    /* 1080p output of a fisheye image (640 x 360, f = 200 px, xi = 0.8) */
+    UndistortMap::UnifiedParam param;
+    param.width = UNDISTORT_MAP_WIDTH;
+    param.height = UNDISTORT_MAP_HEIGHT;
+    param.f_undist = 200.0F;
+    param.u0_undist = param.width / 2.0F;
+    param.v0_undist = param.height / 2.0F;
+    param.xi = 0.8F;
+    param.f_dist = 200.0F;
+    param.u0_dist = 640 / 2.0F;
+    param.v0_dist = 360 / 2.0F;
+    return param;
+}
+
+/* the original CreateUndistortMap of pj_tflite_camera_deep_calib: a full size image for each intermediate value and a pass for each */
+static void CreateUndistortMapReference(const UndistortMap::UnifiedParam& param, std::vector<float>& map_x, std::vector<float>& map_y)
+{
+    const int32_t width = param.width;
+    const int32_t height = param.height;
+    const size_t size = static_cast<size_t>(width) * height;
+    std::vector<float> grid_x(size), grid_y(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            grid_x[y * width + x] = x + 0.0f;
+            grid_y[y * width + x] = y + 0.0f;
+        }
+    }
+    std::vector<float> X_Cam(size), Y_Cam(size), Z_Cam(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            X_Cam[y * width + x] = (grid_x[y * width + x] - param.u0_undist) / param.f_undist;
+            Y_Cam[y * width + x] = (grid_y[y * width + x] - param.v0_undist) / param.f_undist;
+            Z_Cam[y * width + x] = 1.0f;
+        }
+    }
+    std::vector<float> Alpha_Cam(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const int32_t i = y * width + x;
+            Alpha_Cam[i] = 1 / sqrtf(X_Cam[i] * X_Cam[i] + Y_Cam[i] * Y_Cam[i] + Z_Cam[i] * Z_Cam[i]);
+        }
+    }
+    std::vector<float> X_Sph(size), Y_Sph(size), Z_Sph(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const int32_t i = y * width + x;
+            X_Sph[i] = X_Cam[i] * Alpha_Cam[i];
+            Y_Sph[i] = Y_Cam[i] * Alpha_Cam[i];
+            Z_Sph[i] = Z_Cam[i] * Alpha_Cam[i];
+        }
+    }
+    std::vector<float> den(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const int32_t i = y * width + x;
+            den[i] = param.xi * sqrtf(X_Sph[i] * X_Sph[i] + Y_Sph[i] * Y_Sph[i] + Z_Sph[i] * Z_Sph[i]) + Z_Sph[i];
+        }
+    }
+    map_x.resize(size);
+    map_y.resize(size);
+#pragma omp parallel for
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const int32_t i = y * width + x;
+            map_x[i] = (X_Sph[i] * param.f_dist) / den[i] + param.u0_dist;
+            map_y[i] = (Y_Sph[i] * param.f_dist) / den[i] + param.v0_dist;
+        }
+    }
+}
+
+/* the same as cv::convertMaps(CV_32FC1 x 2 -> CV_16SC2 + CV_16UC1) */
+static void ConvertMapsReference(const std::vector<float>& map_x, const std::vector<float>& map_y, std::vector<int16_t>& map_xy, std::vector<uint16_t>& map_frac)
+{
+    map_xy.resize(map_x.size() * 2);
+    map_frac.resize(map_x.size());
+    for (size_t i = 0; i < map_x.size(); i++) {
+        const int32_t ix = static_cast<int32_t>(std::lrint(map_x[i] * UndistortMap::kInterTabSize));
+        const int32_t iy = static_cast<int32_t>(std::lrint(map_y[i] * UndistortMap::kInterTabSize));
+        map_xy[i * 2 + 0] = static_cast<int16_t>((std::min)((std::max)(ix >> UndistortMap::kInterBits, -32768), 32767));
+        map_xy[i * 2 + 1] = static_cast<int16_t>((std::min)((std::max)(iy >> UndistortMap::kInterBits, -32768), 32767));
+        map_frac[i] = static_cast<uint16_t>((iy & (UndistortMap::kInterTabSize - 1)) * UndistortMap::kInterTabSize + (ix & (UndistortMap::kInterTabSize - 1)));
+    }
+}
+
+static std::vector<float> DecodeFixedMap(const std::vector<int16_t>& map_xy, const std::vector<uint16_t>& map_frac)
+{
+    std::vector<float> map(map_xy.size());
+    for (size_t i = 0; i < map_frac.size(); i++) {
+        map[i * 2 + 0] = map_xy[i * 2 + 0] + static_cast<float>(map_frac[i] % UndistortMap::kInterTabSize) / UndistortMap::kInterTabSize;
+        map[i * 2 + 1] = map_xy[i * 2 + 1] + static_cast<float>(map_frac[i] / UndistortMap::kInterTabSize) / UndistortMap::kInterTabSize;
+    }
+    return map;
+}
+
+/*** Point-level undistortion ***/
+/* random points in the distorted image (640 x 360) whose undistorted position is in the map */
+static void GenerateUndistortPointInput(const UndistortMap::UnifiedParam& param, std::vector<float>& image_point)
+{
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist_x(0.0F, 640.0F);
+    std::uniform_real_distribution<float> dist_y(0.0F, 360.0F);
+    image_point.clear();
+    while (image_point.size() < UNDISTORT_POINT_NUM * 2) {
+        const float x = dist_x(engine);
+        const float y = dist_y(engine);
+        float x_undistorted[2];
+        const float x_distorted[2] = { x, y };
+        UndistortMap::UndistortPointUnified(param, x_distorted, 1, x_undistorted);
+        if (x_undistorted[0] < 1 || x_undistorted[0] > param.width - 2 || x_undistorted[1] < 1 || x_undistorted[1] > param.height - 2) continue;
+        image_point.push_back(x);
+        image_point.push_back(y);
+    }
+}
+
+/* the same as cv::remap(src, dst, map_xy, map_frac, INTER_LINEAR, BORDER_CONSTANT) for 8UC3 */
+static void RemapFixedReference(const std::vector<uint8_t>& src, int32_t src_width, int32_t src_height,
+    const std::vector<int16_t>& map_xy, const std::vector<uint16_t>& map_frac, std::vector<uint8_t>& dst)
+{
+    constexpr int32_t kScale = UndistortMap::kInterTabSize * UndistortMap::kInterTabSize;
+    dst.resize(map_frac.size() * 3);
+#pragma omp parallel for
+    for (int32_t i = 0; i < static_cast<int32_t>(map_frac.size()); i++) {
+        const int32_t x = map_xy[i * 2 + 0];
+        const int32_t y = map_xy[i * 2 + 1];
+        const int32_t ax = map_frac[i] % UndistortMap::kInterTabSize;
+        const int32_t ay = map_frac[i] / UndistortMap::kInterTabSize;
+        const int32_t weight[4] = { (UndistortMap::kInterTabSize - ax) * (UndistortMap::kInterTabSize - ay), ax * (UndistortMap::kInterTabSize - ay), (UndistortMap::kInterTabSize - ax) * ay, ax * ay };
+        if (x >= 0 && x < src_width - 1 && y >= 0 && y < src_height - 1) {
+            const uint8_t* p00 = &src[(static_cast<size_t>(y) * src_width + x) * 3];
+            const uint8_t* p10 = p00 + src_width * 3;
+            for (int32_t c = 0; c < 3; c++) {
+                const int32_t sum = p00[c] * weight[0] + p00[c + 3] * weight[1] + p10[c] * weight[2] + p10[c + 3] * weight[3];
+                dst[static_cast<size_t>(i) * 3 + c] = static_cast<uint8_t>((sum + kScale / 2) / kScale);
+            }
+            continue;
+        }
+        /* border */
+        for (int32_t c = 0; c < 3; c++) {
+            int32_t sum = 0;
+            for (int32_t k = 0; k < 4; k++) {
+                const int32_t sx = x + (k & 1);
+                const int32_t sy = y + (k >> 1);
+                if (sx < 0 || sx >= src_width || sy < 0 || sy >= src_height) continue;
+                sum += src[(static_cast<size_t>(sy) * src_width + sx) * 3 + c] * weight[k];
+            }
+            dst[static_cast<size_t>(i) * 3 + c] = static_cast<uint8_t>((sum + kScale / 2) / kScale);
+        }
+    }
+}
+
+/* undistorted points -> distorted points with the map (bilinear), to check points against the full-frame remap */
+static void MapPointReference(const std::vector<float>& map_x, const std::vector<float>& map_y, int32_t width, const std::vector<float>& image_point_undistorted, std::vector<float>& image_point)
+{
+    image_point.resize(image_point_undistorted.size());
+    for (size_t i = 0; i < image_point_undistorted.size() / 2; i++) {
+        const float x = image_point_undistorted[i * 2 + 0];
+        const float y = image_point_undistorted[i * 2 + 1];
+        const int32_t ix = static_cast<int32_t>(std::floor(x));
+        const int32_t iy = static_cast<int32_t>(std::floor(y));
+        const float ax = x - ix;
+        const float ay = y - iy;
+        const size_t i00 = static_cast<size_t>(iy) * width + ix;
+        const std::vector<float>* map_list[2] = { &map_x, &map_y };
+        for (int32_t k = 0; k < 2; k++) {
+            const std::vector<float>& map = *map_list[k];
+            const float top = map[i00] + (map[i00 + 1] - map[i00]) * ax;
+            const float bottom = map[i00 + width] + (map[i00 + width + 1] - map[i00 + width]) * ax;
+            image_point[i * 2 + k] = top + (bottom - top) * ay;
+        }
+    }
+}
+
+/*** Segmentation overlay ***/
+/* the original drawing of the segmentation projects: colorize (cv::LUT), cv::resize(INTER_LINEAR) to the frame size, and cv::add(color * ratio, frame * (1 - ratio)) */
+/* palette: [256][3] (for label) or nullptr (for alpha: color * alpha / 255, and the frame * (1 - alpha / 255 * ratio)) */
+static void SegOverlayReference(const std::vector<uint8_t>& src, int32_t width, int32_t height, const uint8_t* palette, const uint8_t color[3],
+    std::vector<uint8_t>& image, int32_t image_width, int32_t image_height, float ratio)
+{
+    /* colorize at the source resolution: (B, G, R, alpha) */
+    std::vector<float> src_color(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < src.size(); i++) {
+        for (int32_t k = 0; k < 3; k++) {
+            src_color[i * 4 + k] = palette ? palette[src[i] * 3 + k] : color[k] * src[i] / 255.0F;
+        }
+        src_color[i * 4 + 3] = palette ? 1.0F : src[i] / 255.0F;
+    }
+    const float scale_x = static_cast<float>(width) / image_width;
+    const float scale_y = static_cast<float>(height) / image_height;
+#pragma omp parallel for
+    for (int32_t y = 0; y < image_height; y++) {
+        const float sy = (std::max)((y + 0.5F) * scale_y - 0.5F, 0.0F);
+        const int32_t y0 = (std::min)(static_cast<int32_t>(sy), height - 1);
+        const int32_t y1 = (std::min)(y0 + 1, height - 1);
+        const float fy = sy - y0;
+        for (int32_t x = 0; x < image_width; x++) {
+            const float sx = (std::max)((x + 0.5F) * scale_x - 0.5F, 0.0F);
+            const int32_t x0 = (std::min)(static_cast<int32_t>(sx), width - 1);
+            const int32_t x1 = (std::min)(x0 + 1, width - 1);
+            const float fx = sx - x0;
+            float value[4];
+            for (int32_t k = 0; k < 4; k++) {
+                const float top = src_color[(y0 * width + x0) * 4 + k] * (1 - fx) + src_color[(y0 * width + x1) * 4 + k] * fx;
+                const float bottom = src_color[(y1 * width + x0) * 4 + k] * (1 - fx) + src_color[(y1 * width + x1) * 4 + k] * fx;
+                value[k] = top * (1 - fy) + bottom * fy;
+            }
+            uint8_t* dst = &image[(static_cast<size_t>(y) * image_width + x) * 3];
+            for (int32_t k = 0; k < 3; k++) {
+                const float blended = std::round(value[k] * ratio) + std::round(dst[k] * (1 - value[3] * ratio));
+                dst[k] = static_cast<uint8_t>((std::min)(blended, 255.0F));
+            }
+        }
+    }
+}
+
+/*** Bird's eye view ***/
+/* each cell of the view is projected with small matrices (the same as projection_world2image), then converted to fixed-point */
+static void CreateBirdEyeViewMapReference(const ProjectionParam& param, const BirdEyeView& bird_eye_view, std::vector<int16_t>& map_xy, std::vector<uint16_t>& map_frac)
+{
+    const int32_t width = bird_eye_view.GetWidth();
+    const int32_t height = bird_eye_view.GetHeight();
+    std::vector<float> object_point;
+    object_point.reserve(static_cast<size_t>(width) * height * 3);
+    for (int32_t v = 0; v < height; v++) {
+        for (int32_t u = 0; u < width; u++) {
+            float x, z;
+            bird_eye_view.View2Ground(static_cast<float>(u), static_cast<float>(v), x, z);
+            object_point.push_back(x);
+            object_point.push_back(0.0F);
+            object_point.push_back(z);
+        }
+    }
+    std::vector<float> image_point, image_point_undistorted;
+    RunProjectionWorld2ImageReference(param, object_point, image_point);
+    ProjectionParam param_undistorted = param;
+    for (int32_t i = 0; i < 5; i++) param_undistorted.dist[i] = 0;
+    RunProjectionWorld2ImageReference(param_undistorted, object_point, image_point_undistorted);
+    std::vector<float> map_x(static_cast<size_t>(width) * height), map_y(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < map_x.size(); i++) {
+        /* the distortion model is not valid far from the image (behind the camera is (-1, -1) as well) */
+        const float x = image_point_undistorted[i * 2 + 0];
+        const float y = image_point_undistorted[i * 2 + 1];
+        const bool is_valid = image_point[i * 2 + 0] != CameraProjection::kInvalidImage
+            && x >= -0.5F * PROJECTION_WIDTH && x <= 1.5F * PROJECTION_WIDTH && y >= -0.5F * PROJECTION_HEIGHT && y <= 1.5F * PROJECTION_HEIGHT;
+        map_x[i] = is_valid ? image_point[i * 2 + 0] : -1.0F;
+        map_y[i] = is_valid ? image_point[i * 2 + 1] : -1.0F;
+    }
+    ConvertMapsReference(map_x, map_y, map_xy, map_frac);
+}
+
+
+template<typename TRACKER>
+static void RunTracker(TRACKER& tracker, const std::vector<std::vector<BoundingBox>>& det_list_list, GoldenCheck::TrackIdSequence& id_sequence)
+{
+    tracker.Reset();
+    id_sequence.clear();
+    for (const auto& det_list : det_list_list) {
+        tracker.Update(det_list);
+        std::vector<int32_t> id_list;
+        for (auto& track : tracker.GetTrackList()) {
+            if (track.GetUndetectedCount() == 0) id_list.push_back(track.GetId());
+        }
+        id_sequence.push_back(id_list);
+    }
+}
+
+
+/*** TrackerDeepSort (feature skip) ***/
+typedef struct ReidFrame_ {
+    std::vector<BoundingBox> det_list;                  /* label = ground truth id */
+    std::vector<std::vector<float>> feature_list;       /* feature which the re-ID model would give. empty for class 1 */
+} ReidFrame;
+
+typedef struct ReidResult_ {
+    int32_t call_num;       /* feature calculations (calls of the re-ID model) */
+    int32_t skip_num;       /* feature calculations saved by TrackerDeepSort::Predict */
+    int32_t id_switch_num;  /* the number of times the track id of a ground truth object changed */
+    ReidResult_() : call_num(0), skip_num(0), id_switch_num(0)
+    {}
+} ReidResult;
+
+static void GenerateReidSequence(std::vector<ReidFrame>& frame_list)
+{
+    /* persons walking and crossing each other (bounced at the border of a 1080p frame), and other objects without feature */
+    /* feature of a person = its own direction + noise of each frame (cosine similarity is about 0.99 for the same person, 0 for others) */
+    std::mt19937 engine(1234);
+    std::uniform_real_distribution<float> dist_x(0, 1880);
+    std::uniform_real_distribution<float> dist_y(0, 980);
+    std::uniform_real_distribution<float> dist_speed(-3, 3);
+    std::uniform_real_distribution<float> dist_noise(-2, 2);
+    std::uniform_real_distribution<float> dist_prob(0, 1);
+    std::normal_distribution<float> dist_feature(0, 1);
+    const int32_t object_num = REID_PERSON_NUM + REID_OTHER_NUM;
+    std::vector<std::array<float, 4>> object_list(object_num);
+    for (auto& object : object_list) object = { dist_x(engine), dist_y(engine), dist_speed(engine), dist_speed(engine) };
+    std::vector<std::vector<float>> base_feature_list(REID_PERSON_NUM, std::vector<float>(REID_FEATURE_SIZE));
+    for (auto& feature : base_feature_list) {
+        for (auto& v : feature) v = dist_feature(engine);
+    }
+    frame_list.resize(REID_FRAME_NUM);
+    for (auto& frame : frame_list) {
+        for (int32_t i = 0; i < object_num; i++) {
+            auto& object = object_list[i];
+            object[0] += object[2];
+            object[1] += object[3];
+            if (object[0] < 0 || object[0] > 1880) object[2] = -object[2];
+            if (object[1] < 0 || object[1] > 980) object[3] = -object[3];
+            if (dist_prob(engine) < REID_MISS_RATIO) continue;
+            const bool is_person = i < REID_PERSON_NUM;
+            frame.det_list.push_back(BoundingBox(is_person ? 0 : 1, std::to_string(i), 0.9F,
+                static_cast<int32_t>(object[0] + dist_noise(engine)), static_cast<int32_t>(object[1] + dist_noise(engine)), 40, 100));
+            std::vector<float> feature;
+            if (is_person) {
+                feature = base_feature_list[i];
+                for (auto& v : feature) v += 0.1F * dist_feature(engine);
+            }
+            frame.feature_list.push_back(feature);
+        }
+    }
+}
+
+/* feature is given only for persons, and only for dets which need it if is_skip (the same as the deepsort projects) */
+static void RunTrackerDeepSort(TrackerDeepSort& tracker, const std::vector<ReidFrame>& frame_list, bool is_skip, ReidResult& result)
+{
+    tracker.Reset();
+    result = ReidResult();
+    std::vector<int32_t> track_id_for_object(REID_PERSON_NUM + REID_OTHER_NUM, -1);
+    std::vector<uint8_t> is_feature_required_list;
+    std::vector<std::vector<float>> feature_list;
+    for (const auto& frame : frame_list) {
+        const size_t det_num = frame.det_list.size();
+        if (is_skip) {
+            tracker.Predict(frame.det_list, is_feature_required_list);
+        } else {
+            is_feature_required_list.assign(det_num, 1);
+        }
+        feature_list.assign(det_num, std::vector<float>());
+        for (size_t i = 0; i < det_num; i++) {
+            if (frame.det_list[i].class_id != 0) continue;
+            if (is_feature_required_list[i]) {
+                feature_list[i] = frame.feature_list[i];
+                result.call_num++;
+            } else {
+                result.skip_num++;
+            }
+        }
+        tracker.Update(frame.det_list, feature_list);
+        for (auto& track : tracker.GetTrackList()) {
+            if (track.GetUndetectedCount() != 0) continue;
+            const int32_t object_id = std::stoi(track.GetLatestData().bbox_raw.label);
+            if (track_id_for_object[object_id] >= 0 && track_id_for_object[object_id] != track.GetId()) result.id_switch_num++;
+            track_id_for_object[object_id] = track.GetId();
+        }
+    }
+}
+
+static GoldenCheck::CompareResult CompareReidResult(const ReidResult& ref, const ReidResult& opt)
+{
+    GoldenCheck::CompareResult result;
+    result.metric = opt.id_switch_num;
+    result.is_pass = opt.id_switch_num <= ref.id_switch_num && opt.call_num + opt.skip_num == ref.call_num;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "feature calls = %d -> %d (%d skipped), id switches = %d -> %d",
+        ref.call_num, opt.call_num, opt.skip_num, ref.id_switch_num, opt.id_switch_num);
+    result.message = buffer;
+    return result;
+}
+
+
+int32_t main(int argc, char* argv[])
+{
+    /* usage: main [data_dir] [case_name_filter] */
+    const std::string data_dir = (argc > 1) ? std::string(argv[1]) + "/" : DEFAULT_DATA_DIR;
+    const std::string filter = (argc > 2) ? argv[2] : "";
+    GoldenCheck::Harness harness(LOOP_NUM);
+
+    /*** Softmax (CommonHelper::SoftMaxFast) ***/
+    std::vector<float> softmax_input;
+    if (!GoldenCheck::ReadRawFile(data_dir + FILE_SOFTMAX_INPUT, softmax_input)) {
+        GenerateRandom(softmax_input, SEG_HEIGHT * SEG_WIDTH * SOFTMAX_LENGTH, -20.0F, 20.0F);
+    }
+    std::vector<float> softmax_ref(softmax_input.size()), softmax_opt(softmax_input.size());
+    GoldenCheck::Tolerance tolerance_softmax;
+    tolerance_softmax.tensor_abs_diff_max = 0.05F;  /* SoftMaxFast uses an approximated exp */
+    harness.AddCase("softmax",
+        [&] { for (size_t i = 0; i + SOFTMAX_LENGTH <= softmax_input.size(); i += SOFTMAX_LENGTH) SoftMaxReference(&softmax_input[i], &softmax_ref[i], SOFTMAX_LENGTH); },
+        [&] { for (size_t i = 0; i + SOFTMAX_LENGTH <= softmax_input.size(); i += SOFTMAX_LENGTH) CommonHelper::SoftMaxFast(&softmax_input[i], &softmax_opt[i], SOFTMAX_LENGTH); },
+        [&] { return GoldenCheck::CompareTensor(softmax_ref.data(), softmax_opt.data(), softmax_ref.size(), tolerance_softmax); });
+
+    /*** Segmentation argmax ***/
+    std::vector<float> seg_input;
+    if (!GoldenCheck::ReadRawFile(data_dir + FILE_SEG_INPUT, seg_input)) {
+        GenerateRandom(seg_input, SEG_HEIGHT * SEG_WIDTH * SEG_CHANNEL, -20.0F, 20.0F);
+    }
+    const int32_t seg_pixel_num = static_cast<int32_t>(seg_input.size() / SEG_CHANNEL);
+    std::vector<uint8_t> seg_ref, seg_opt;
+    GoldenCheck::Tolerance tolerance_seg;
+    harness.AddCase("seg_argmax",
+        [&] { ArgMaxReference(seg_input, seg_ref, seg_pixel_num, SEG_CHANNEL); },
+        [&] { seg_opt.resize(seg_pixel_num); SegPostProcess::SoftMaxArgMax(seg_input.data(), seg_pixel_num, SEG_CHANNEL, seg_opt.data()); },
+        [&] { return GoldenCheck::CompareLabelMap(seg_ref.data(), seg_opt.data(), seg_ref.size(), tolerance_seg); });
+
+    /*** Segmentation softmax + argmax (SEG_LARGE_HEIGHT x SEG_LARGE_WIDTH x SEG_CHANNEL) ***/
+    const int32_t seg_large_pixel_num = SEG_LARGE_HEIGHT * SEG_LARGE_WIDTH;
+    std::vector<float> seg_large_input;
+    GenerateRandom(seg_large_input, static_cast<size_t>(seg_large_pixel_num) * SEG_CHANNEL, -20.0F, 20.0F);
+    std::vector<uint8_t> seg_large_label_ref(seg_large_pixel_num), seg_large_label_opt(seg_large_pixel_num);   /* sized here, so that a case runs alone with the filter */
+    std::vector<float> seg_large_prob_ref, seg_large_prob_opt(static_cast<size_t>(seg_large_pixel_num) * SEG_CHANNEL);
+    GoldenCheck::Tolerance tolerance_seg_prob;
+    tolerance_seg_prob.tensor_abs_diff_max = 1e-5F;     /* the same approximated exp */
+    harness.AddCase("seg_softmax_argmax",
+        [&] { SoftMaxArgMaxReference(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_ref, seg_large_prob_ref); },
+        [&] { SegPostProcess::SoftMaxArgMax(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_opt.data(), seg_large_prob_opt.data()); },
+        [&] {
+            auto result = GoldenCheck::CompareLabelMap(seg_large_label_ref.data(), seg_large_label_opt.data(), seg_large_label_ref.size(), tolerance_seg);
+            return result.is_pass ? GoldenCheck::CompareTensor(seg_large_prob_ref.data(), seg_large_prob_opt.data(), seg_large_prob_ref.size(), tolerance_seg_prob) : result;
+        });
+    harness.AddCase("seg_argmax_large",
+        [&] { ArgMaxReference(seg_large_input, seg_large_label_ref, seg_large_pixel_num, SEG_CHANNEL); },
+        [&] { SegPostProcess::SoftMaxArgMax(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_opt.data()); },
+        [&] { return GoldenCheck::CompareLabelMap(seg_large_label_ref.data(), seg_large_label_opt.data(), seg_large_label_ref.size(), tolerance_seg); });
+
+    /*** Segmentation result for a consumer of argmax + one class (eager maps of all the classes vs SegClassMap) ***/
+    /* step = 2: the map of the class at half resolution */
+    SegClassMap seg_class_map;
+    std::vector<float> seg_class_map_ref, seg_class_map_opt;
+    for (int32_t step = 1; step <= 2; step++) {
+        harness.AddCase(step == 1 ? "seg_class_map" : "seg_class_map_half",
+            [&, step] {
+                SegPostProcess::SoftMaxArgMax(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_ref.data(), seg_large_prob_opt.data());
+                seg_class_map_ref.clear();
+                const float* plane = seg_large_prob_opt.data() + static_cast<size_t>(SEG_CLASS_MAP_CLASS) * seg_large_pixel_num;
+                for (int32_t y = 0; y < SEG_LARGE_HEIGHT; y += step) {
+                    for (int32_t x = 0; x < SEG_LARGE_WIDTH; x += step) seg_class_map_ref.push_back(plane[y * SEG_LARGE_WIDTH + x]);
+                }
+            },
+            [&, step] {
+                SegPostProcess::SoftMaxArgMax(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_opt.data());
+                seg_class_map.Set(seg_large_input.data(), SEG_LARGE_HEIGHT, SEG_LARGE_WIDTH, SEG_CHANNEL, true);
+                const float* plane = seg_class_map.GetProbability(SEG_CLASS_MAP_CLASS, step);
+                seg_class_map_opt.assign(plane, plane + static_cast<size_t>(seg_class_map.GetHeight(step)) * seg_class_map.GetWidth(step));
+            },
+            [&] {
+                auto result = GoldenCheck::CompareLabelMap(seg_large_label_ref.data(), seg_large_label_opt.data(), seg_large_label_ref.size(), tolerance_seg);
+                if (!result.is_pass) return result;
+                if (seg_class_map_ref.size() != seg_class_map_opt.size()) {
+                    result.is_pass = false;
+                    return result;
+                }
+                return GoldenCheck::CompareTensor(seg_class_map_ref.data(), seg_class_map_opt.data(), seg_class_map_ref.size(), tolerance_seg_prob);
+            });
+    }
+
+    /* a consumer of all the classes (paddleseg with kIsDrawAllResult): GetProbability for each class vs GetProbabilityAll (one fused pass) */
+    SegClassMap seg_class_map_lazy;
+    harness.AddCase("seg_class_map_all",
+        [&] {
+            SegPostProcess::SoftMaxArgMax(seg_large_input.data(), seg_large_pixel_num, SEG_CHANNEL, seg_large_label_ref.data());
+            seg_class_map_lazy.Set(seg_large_input.data(), SEG_LARGE_HEIGHT, SEG_LARGE_WIDTH, SEG_CHANNEL, true);
+            seg_class_map_ref.resize(static_cast<size_t>(SEG_CHANNEL) * seg_large_pixel_num);
+            for (int32_t c = 0; c < SEG_CHANNEL; c++) {
+                const float* plane = seg_class_map_lazy.GetProbability(c);
+                std::copy(plane, plane + seg_large_pixel_num, seg_class_map_ref.begin() + static_cast<size_t>(c) * seg_large_pixel_num);
+            }
+        },
+        [&] {
+            seg_class_map.Set(seg_large_input.data(), SEG_LARGE_HEIGHT, SEG_LARGE_WIDTH, SEG_CHANNEL, true);
+            const float* prob = seg_class_map.GetProbabilityAll(seg_large_label_opt.data());
+            seg_class_map_opt.assign(prob, prob + static_cast<size_t>(SEG_CHANNEL) * seg_large_pixel_num);
+        },
+        [&] {
+            auto result = GoldenCheck::CompareLabelMap(seg_large_label_ref.data(), seg_large_label_opt.data(), seg_large_label_ref.size(), tolerance_seg);
+            if (!result.is_pass) return result;
+            return GoldenCheck::CompareTensor(seg_class_map_ref.data(), seg_class_map_opt.data(), seg_class_map_ref.size(), tolerance_seg_prob);
+        });
+
+    /*** Segmentation overlay (SEG_HEIGHT x SEG_WIDTH -> SEG_OVERLAY_WIDTH x SEG_OVERLAY_HEIGHT) ***/
+    /* label: regions of classes with the palette of 19 classes (the same size as paddleseg), alpha: a soft mask (e.g. person mask) in green */
+    std::vector<uint8_t> seg_overlay_label(SEG_HEIGHT * SEG_WIDTH), seg_overlay_alpha(SEG_HEIGHT * SEG_WIDTH);
+    for (int32_t y = 0; y < SEG_HEIGHT; y++) {
+        for (int32_t x = 0; x < SEG_WIDTH; x++) {
+            seg_overlay_label[y * SEG_WIDTH + x] = static_cast<uint8_t>((x / 40 + (y / 30) * 3) % SEG_CHANNEL);
+            const float r = std::hypot(x - SEG_WIDTH / 2.0F, y - SEG_HEIGHT / 2.0F) / (SEG_HEIGHT / 2.0F);
+            seg_overlay_alpha[y * SEG_WIDTH + x] = static_cast<uint8_t>(255 * (std::min)((std::max)(1.5F - r, 0.0F), 1.0F));
+        }
+    }
+    std::vector<uint8_t> seg_overlay_palette(SegOverlay::kColorNumMax * 3);
+    std::mt19937 seg_overlay_engine(1234);
+    for (auto& v : seg_overlay_palette) v = static_cast<uint8_t>(seg_overlay_engine() & 0xFF);
+    const uint8_t seg_overlay_color[3] = { 0, 255, 0 };
+    std::vector<uint8_t> seg_overlay_frame(static_cast<size_t>(SEG_OVERLAY_WIDTH) * SEG_OVERLAY_HEIGHT * 3);
+    for (auto& v : seg_overlay_frame) v = static_cast<uint8_t>(seg_overlay_engine() & 0xFF);
+    std::vector<uint8_t> seg_overlay_ref, seg_overlay_opt;
+    SegOverlay seg_overlay;
+    seg_overlay.SetPalette(seg_overlay_palette.data(), SegOverlay::kColorNumMax);
+    GoldenCheck::Tolerance tolerance_seg_overlay;
+    tolerance_seg_overlay.tensor_abs_diff_max = 2.0F;  /* fixed point (8 bit weights) vs float */
+    auto compare_seg_overlay = [&] {
+        std::vector<float> image_ref(seg_overlay_ref.begin(), seg_overlay_ref.end());
+        std::vector<float> image_opt(seg_overlay_opt.begin(), seg_overlay_opt.end());
+        return GoldenCheck::CompareTensor(image_ref.data(), image_opt.data(), image_ref.size(), tolerance_seg_overlay);
+    };
+    harness.AddCase("seg_overlay_label",
+        [&] {
+            seg_overlay_ref = seg_overlay_frame;
+            SegOverlayReference(seg_overlay_label, SEG_WIDTH, SEG_HEIGHT, seg_overlay_palette.data(), nullptr, seg_overlay_ref, SEG_OVERLAY_WIDTH, SEG_OVERLAY_HEIGHT, SEG_OVERLAY_RATIO);
+        },
+        [&] {
+            seg_overlay_opt = seg_overlay_frame;
+            seg_overlay.BlendLabel(seg_overlay_label.data(), SEG_WIDTH, SEG_HEIGHT, seg_overlay_opt.data(), SEG_OVERLAY_WIDTH, SEG_OVERLAY_HEIGHT, SEG_OVERLAY_RATIO);
+        },
+        compare_seg_overlay);
+    harness.AddCase("seg_overlay_alpha",
+        [&] {
+            seg_overlay_ref = seg_overlay_frame;
+            SegOverlayReference(seg_overlay_alpha, SEG_WIDTH, SEG_HEIGHT, nullptr, seg_overlay_color, seg_overlay_ref, SEG_OVERLAY_WIDTH, SEG_OVERLAY_HEIGHT, 1.0F);
+        },
+        [&] {
+            seg_overlay_opt = seg_overlay_frame;
+            seg_overlay.BlendAlpha(seg_overlay_alpha.data(), SEG_WIDTH, SEG_HEIGHT, seg_overlay_color, seg_overlay_opt.data(), SEG_OVERLAY_WIDTH, SEG_OVERLAY_HEIGHT, 1.0F);
+        },
+        compare_seg_overlay);
+
+    /*** NMS ***/
+    std::vector<BoundingBox> nms_input;
+    if (!GoldenCheck::ReadBoundingBoxFile(data_dir + FILE_NMS_INPUT, nms_input)) {
+        GenerateDetection(nms_input, 500);
+    }
+    std::vector<BoundingBox> nms_ref, nms_opt;
+    GoldenCheck::Tolerance tolerance_nms;
+    harness.AddCase("nms",
+        [&] { auto bbox_list = nms_input; nms_ref.clear(); Reference::Nms(bbox_list, nms_ref, NMS_IOU_THRESHOLD); },
+        [&] { auto bbox_list = nms_input; nms_opt.clear(); BoundingBoxUtils::Nms(bbox_list, nms_opt, NMS_IOU_THRESHOLD); },
+        [&] { return GoldenCheck::CompareBoundingBoxList(nms_ref, nms_opt, tolerance_nms); });
+
+    /*** Tracker ***/
+    std::vector<std::vector<BoundingBox>> tracker_input;
+    if (!ReadDetectionSequence(data_dir + FILE_TRACKER_INPUT, tracker_input)) {
+        GenerateDetectionSequence(tracker_input);
+    }
+    Reference::Tracker tracker_ref;
+    Tracker tracker_opt;
+    GoldenCheck::TrackIdSequence track_id_ref, track_id_opt;
+    GoldenCheck::Tolerance tolerance_tracker;
+    harness.AddCase("tracker",
+        [&] { RunTracker(tracker_ref, tracker_input, track_id_ref); },
+        [&] { RunTracker(tracker_opt, tracker_input, track_id_opt); },
+        [&] { return GoldenCheck::CompareTrackIdSequence(track_id_ref, track_id_opt, tolerance_tracker); });
+
+    /*** TrackerDeepSort: feature of every person vs feature only for dets which are not matched unambiguously by motion ***/
+    /* the time doesn't include the re-ID model. the gain is the number of skipped calls */
+    std::vector<ReidFrame> reid_input;
+    GenerateReidSequence(reid_input);
+    TrackerDeepSort tracker_deepsort_ref, tracker_deepsort_opt;
+    ReidResult reid_ref, reid_opt;
+    harness.AddCase("tracker_deepsort_skip",
+        [&] { RunTrackerDeepSort(tracker_deepsort_ref, reid_input, false, reid_ref); },
+        [&] { RunTrackerDeepSort(tracker_deepsort_opt, reid_input, true, reid_opt); },
+        [&] { return CompareReidResult(reid_ref, reid_opt); });
+
+    /*** Kalman filter (KalmanFilter(SimpleMatrix, double) vs KalmanFilterFixed(float)) ***/
+    std::vector<std::vector<BoundingBox>> kalman_input;
+    GenerateKalmanInput(kalman_input, KALMAN_TRACK_NUM);
+    std::vector<BoundingBox> kalman_ref, kalman_opt;
+    GoldenCheck::Tolerance tolerance_kalman;
+    tolerance_kalman.box_iou_min = 0.95F;   /* float vs double. boxes are rounded to int */
+    harness.AddCase("kalman",
+        [&] { RunKalmanReference(kalman_input, kalman_ref); },
+        [&] { RunKalmanFixed(kalman_input, kalman_opt); },
+        [&] { return GoldenCheck::CompareBoundingBoxList(kalman_ref, kalman_opt, tolerance_kalman); });
+
+    /*** Batched Kalman filter (KalmanFilterFixed for each track vs KalmanFilterBatch) ***/
+    std::vector<std::vector<BoundingBox>> kalman_batch_input;
+    GenerateKalmanInput(kalman_batch_input, KALMAN_BATCH_TRACK_NUM);
+    std::vector<BoundingBox> kalman_batch_ref, kalman_batch_opt;
+    harness.AddCase("kalman_batch",
+        [&] { RunKalmanFixed(kalman_batch_input, kalman_batch_ref); },
+        [&] { RunKalmanBatch(kalman_batch_input, kalman_batch_opt); },
+        [&] { return GoldenCheck::CompareBoundingBoxList(kalman_batch_ref, kalman_batch_opt, tolerance_kalman); });
+
+    /*** Assignment (HungarianAlgorithm with square padding vs Lapjv) ***/
+    /* the total cost must be the same. the assigned pairs can be different when there are ties */
+    /* HungarianAlgorithm takes more than 10 sec for 1000 objects, so Lapjv on the transposed matrix (det x track) is the reference for large sizes */
+    std::vector<float> assignment_cost[ASSIGNMENT_SIZE_NUM], assignment_cost_transposed[ASSIGNMENT_SIZE_NUM];
+    int32_t assignment_track_num[ASSIGNMENT_SIZE_NUM], assignment_det_num[ASSIGNMENT_SIZE_NUM];
+    std::vector<float> assignment_ref[ASSIGNMENT_SIZE_NUM], assignment_opt[ASSIGNMENT_SIZE_NUM];
+    Lapjv<float> assignment_solver, assignment_solver_transposed;
+    GoldenCheck::Tolerance tolerance_assignment;
+    tolerance_assignment.tensor_abs_diff_max = 0.01F;
+    for (int32_t i = 0; i < ASSIGNMENT_SIZE_NUM; i++) {
+        const int32_t object_num = kAssignmentObjectNumList[i];
+        GenerateAssignmentCost(assignment_cost[i], assignment_track_num[i], assignment_det_num[i], object_num);
+        if (object_num <= ASSIGNMENT_HUNGARIAN_MAX) {
+            harness.AddCase("assignment_" + std::to_string(object_num),
+                [&, i] { RunAssignmentHungarian(assignment_cost[i], assignment_track_num[i], assignment_det_num[i], assignment_ref[i]); },
+                [&, i] { RunAssignmentLapjv(assignment_solver, assignment_cost[i], assignment_track_num[i], assignment_det_num[i], assignment_opt[i]); },
+                [&, i] { return GoldenCheck::CompareTensor(assignment_ref[i].data(), assignment_opt[i].data(), assignment_ref[i].size(), tolerance_assignment); });
+        } else {
+            auto& cost_transposed = assignment_cost_transposed[i];
+            cost_transposed.resize(assignment_cost[i].size());
+            for (int32_t i_track = 0; i_track < assignment_track_num[i]; i_track++) {
+                for (int32_t i_det = 0; i_det < assignment_det_num[i]; i_det++) {
+                    cost_transposed[i_det * assignment_track_num[i] + i_track] = assignment_cost[i][i_track * assignment_det_num[i] + i_det];
+                }
+            }
+            harness.AddCase("assignment_" + std::to_string(object_num) + "_transposed",
+                [&, i] { RunAssignmentLapjv(assignment_solver_transposed, assignment_cost_transposed[i], assignment_det_num[i], assignment_track_num[i], assignment_ref[i]); },
+                [&, i] { RunAssignmentLapjv(assignment_solver, assignment_cost[i], assignment_track_num[i], assignment_det_num[i], assignment_opt[i]); },
+                [&, i] { return GoldenCheck::CompareTensor(assignment_ref[i].data(), assignment_opt[i].data(), assignment_ref[i].size(), tolerance_assignment); });
+        }
+    }
+
+    /*** Sparse assignment (dense cost matrix + Lapjv vs SpatialGrid + SparseAssignment) ***/
+    std::vector<BoundingBox> sparse_track_list[ASSIGNMENT_SPARSE_SIZE_NUM], sparse_det_list[ASSIGNMENT_SPARSE_SIZE_NUM];
+    std::vector<int32_t> sparse_assign_ref[ASSIGNMENT_SPARSE_SIZE_NUM], sparse_assign_opt[ASSIGNMENT_SPARSE_SIZE_NUM];
+    std::vector<float> sparse_cost_matrix;
+    SpatialGrid sparse_grid;
+    SparseAssignment sparse_assignment;
+    for (int32_t i = 0; i < ASSIGNMENT_SPARSE_SIZE_NUM; i++) {
+        const int32_t object_num = kAssignmentSparseObjectNumList[i];
+        GenerateAssignmentBox(sparse_track_list[i], sparse_det_list[i], object_num);
+        harness.AddCase("assignment_sparse_" + std::to_string(object_num),
+            [&, i] { RunAssignmentDense(assignment_solver, sparse_cost_matrix, sparse_track_list[i], sparse_det_list[i], sparse_assign_ref[i]); },
+            [&, i] { RunAssignmentSparse(sparse_grid, sparse_assignment, sparse_track_list[i], sparse_det_list[i], sparse_assign_opt[i]); },
+            [&, i] {
+                auto summary_ref = SummarizeAssignment(sparse_track_list[i], sparse_det_list[i], sparse_assign_ref[i]);
+                auto summary_opt = SummarizeAssignment(sparse_track_list[i], sparse_det_list[i], sparse_assign_opt[i]);
+                return GoldenCheck::CompareTensor(summary_ref.data(), summary_opt.data(), summary_ref.size(), tolerance_assignment);
+            });
+    }
+
+    /*** Feature similarity (every gallery feature x every det, dense worst case) ***/
+    std::vector<float> feature_gallery, feature_det;
+    GenerateRandom(feature_gallery, FEATURE_TRACK_NUM * FEATURE_GALLERY_NUM * FEATURE_SIZE, 0.0F, 1.0F);  /* like the output after ReLU */
+    GenerateRandom(feature_det, FEATURE_DET_NUM * FEATURE_SIZE, 0.0F, 1.0F);
+    std::vector<float> feature_gallery_normalized(feature_gallery.size());
+    std::vector<int8_t> feature_gallery_int8(feature_gallery.size());
+    for (size_t i = 0; i < feature_gallery.size(); i += FEATURE_SIZE) {
+        FeatureSimilarity::NormalizeL2(&feature_gallery[i], &feature_gallery_normalized[i], FEATURE_SIZE);
+        FeatureSimilarity::QuantizeInt8(&feature_gallery_normalized[i], &feature_gallery_int8[i], FEATURE_SIZE);
+    }
+    std::vector<float> feature_det_normalized;
+    std::vector<int8_t> feature_det_int8;
+    std::vector<float> similarity_ref, similarity_opt, similarity_int8;
+    GoldenCheck::Tolerance tolerance_similarity;
+    tolerance_similarity.tensor_abs_diff_max = 1e-4F;
+    harness.AddCase("feature_similarity",
+        [&] { RunFeatureSimilarityReference(feature_gallery, feature_det, similarity_ref); },
+        [&] { RunFeatureSimilarityGemm(feature_gallery_normalized, feature_det, feature_det_normalized, similarity_opt); },
+        [&] { return GoldenCheck::CompareTensor(similarity_ref.data(), similarity_opt.data(), similarity_ref.size(), tolerance_similarity); });
+    GoldenCheck::Tolerance tolerance_similarity_int8;
+    tolerance_similarity_int8.tensor_abs_diff_max = 0.02F;
+    harness.AddCase("feature_similarity_int8",
+        [&] { RunFeatureSimilarityReference(feature_gallery, feature_det, similarity_ref); },
+        [&] { RunFeatureSimilarityGemmInt8(feature_gallery_int8, feature_det, feature_det_normalized, feature_det_int8, similarity_int8); },
+        [&] { return GoldenCheck::CompareTensor(similarity_ref.data(), similarity_int8.data(), similarity_ref.size(), tolerance_similarity_int8); });
+
+    /*** Feature index (brute force vs IVF-flat). time is for FEATURE_INDEX_QUERY_NUM queries ***/
+    FeatureIndex feature_index[FEATURE_INDEX_SIZE_NUM];
+    std::vector<float> feature_index_query[FEATURE_INDEX_SIZE_NUM];
+    std::vector<std::vector<FeatureIndex::Neighbor>> feature_index_ref[FEATURE_INDEX_SIZE_NUM], feature_index_opt[FEATURE_INDEX_SIZE_NUM];
+    for (int32_t i = 0; i < FEATURE_INDEX_SIZE_NUM; i++) {
+        const int32_t entry_num = kFeatureIndexEntryNumList[i];
+        const std::string name = "feature_index_" + std::to_string(entry_num);
+        if (!filter.empty() && name.find(filter) == std::string::npos) continue;   /* building the index takes time */
+        std::vector<float> entry_list;
+        GenerateFeatureIndexData(entry_list, feature_index_query[i], entry_num);
+        FeatureIndex::Param param;
+        param.feature_size = FEATURE_SIZE;
+        param.list_num = kFeatureIndexListNumList[i];
+        param.probe_num = kFeatureIndexProbeNumList[i];
+        param.capacity = entry_num;
+        if (entry_num > FeatureIndex::Param().capacity) {
+            /* larger than the archive of the tracker. trained once */
+            param.train_num = param.list_num * 32;
+            param.retrain_num = 0;
+        }
+        /* the max time of an insertion shows the stall of training (amortized vs all at once) */
+        const double insert_time_max = BuildFeatureIndex(feature_index[i], param, entry_list, entry_num);
+        double insert_time_max_at_once = 0;
+        if (param.retrain_num > 0) {
+            FeatureIndex feature_index_at_once;
+            FeatureIndex::Param param_at_once = param;
+            param_at_once.train_step_num = 0;
+            insert_time_max_at_once = BuildFeatureIndex(feature_index_at_once, param_at_once, entry_list, entry_num);
+        }
+        harness.AddCase(name,
+            [&, i] { RunFeatureIndex(feature_index[i], feature_index_query[i], true, feature_index_ref[i]); },
+            [&, i] { RunFeatureIndex(feature_index[i], feature_index_query[i], false, feature_index_opt[i]); },
+            [&, i, insert_time_max, insert_time_max_at_once] {
+                GoldenCheck::CompareResult result = CompareFeatureIndexRecall(feature_index_ref[i], feature_index_opt[i]);
+                char buffer[128];
+                if (insert_time_max_at_once > 0) {
+                    snprintf(buffer, sizeof(buffer), ", max insert = %.1f ms (training at once: %.1f ms)", insert_time_max, insert_time_max_at_once);
+                } else {
+                    snprintf(buffer, sizeof(buffer), ", max insert = %.1f ms", insert_time_max);
+                }
+                result.message += buffer;
+                return result;
+            });
+    }
+
+    /*** Camera projection (small matrices for each point in double vs CameraProjection). PROJECTION_POINT_NUM points ***/
+    const bool projection_use_distortion_list[2] = { false, true };
+    ProjectionParam projection_param[2];
+    CameraProjection projection[2];
+    std::vector<float> projection_object_point[2], projection_image_point[2];
+    std::vector<float> projection_image_ref[2], projection_image_opt[2], projection_ground_ref[2], projection_ground_opt[2];
+    GoldenCheck::Tolerance tolerance_projection_image;
+    tolerance_projection_image.tensor_abs_diff_max = 0.01F;    /* [px] */
+    GoldenCheck::Tolerance tolerance_projection_ground;
+    tolerance_projection_ground.tensor_abs_diff_max = 0.01F;   /* [m] */
+    for (int32_t i = 0; i < 2; i++) {
+        const std::string suffix = projection_use_distortion_list[i] ? "_distortion" : "";
+        projection_param[i] = MakeProjectionParam(projection_use_distortion_list[i]);
+        SetProjection(projection_param[i], projection[i]);
+        GenerateProjectionInput(projection_param[i], projection_object_point[i], projection_image_point[i]);
+        projection_image_opt[i].resize(PROJECTION_POINT_NUM * 2);
+        projection_ground_opt[i].resize(PROJECTION_POINT_NUM * 3);
+        harness.AddCase("projection_world2image" + suffix,
+            [&, i] { RunProjectionWorld2ImageReference(projection_param[i], projection_object_point[i], projection_image_ref[i]); },
+            [&, i] { projection[i].World2Image(projection_object_point[i].data(), PROJECTION_POINT_NUM, projection_image_opt[i].data()); },
+            [&, i] { return GoldenCheck::CompareTensor(projection_image_ref[i].data(), projection_image_opt[i].data(), projection_image_ref[i].size(), tolerance_projection_image); });
+        harness.AddCase("projection_image2ground" + suffix,
+            [&, i] { RunProjectionImage2GroundReference(projection_param[i], projection_image_point[i], projection_ground_ref[i]); },
+            [&, i] { projection[i].Image2GroundPlane(projection_image_point[i].data(), PROJECTION_POINT_NUM, projection_ground_opt[i].data()); },
+            [&, i] { return GoldenCheck::CompareTensor(projection_ground_ref[i].data(), projection_ground_opt[i].data(), projection_ground_ref[i].size(), tolerance_projection_ground); });
+    }
+
+    /*** Image -> ground plane lookup table (CameraProjection vs GroundLut). the same points as projection_image2ground ***/
+    GroundLut ground_lut[2];
+    std::vector<float> ground_lut_ref[2], ground_lut_opt[2];
+    GoldenCheck::Tolerance tolerance_ground_lut[2];
+    tolerance_ground_lut[0].tensor_abs_diff_max = 0.01F;   /* [m]. the homography is used directly without distortion */
+    tolerance_ground_lut[1].tensor_abs_diff_max = 0.05F;   /* [m]. distortion between nodes (about 0.02 m at 100 m with 8 px grid) */
+    for (int32_t i = 0; i < 2; i++) {
+        const std::string suffix = projection_use_distortion_list[i] ? "_distortion" : "";
+        ground_lut[i].Update(projection[i], PROJECTION_WIDTH, PROJECTION_HEIGHT, GROUND_LUT_GRID_STEP);
+        ground_lut_ref[i].resize(PROJECTION_POINT_NUM * 3);
+        ground_lut_opt[i].resize(PROJECTION_POINT_NUM * 3);
+        harness.AddCase("ground_lut" + suffix,
+            [&, i] { projection[i].Image2GroundPlane(projection_image_point[i].data(), PROJECTION_POINT_NUM, ground_lut_ref[i].data()); },
+            [&, i] { ground_lut[i].Image2GroundPlane(projection_image_point[i].data(), PROJECTION_POINT_NUM, ground_lut_opt[i].data()); },
+            [&, i] { return GoldenCheck::CompareTensor(ground_lut_ref[i].data(), ground_lut_opt[i].data(), ground_lut_ref[i].size(), tolerance_ground_lut[i]); });
+    }
+
+    /*** Undistortion map at 1080p (the original multi-pass + convertMaps vs one pass) ***/
+    const UndistortMap::UnifiedParam undistort_map_param = MakeUndistortMapParam();
+    const size_t undistort_map_size = static_cast<size_t>(undistort_map_param.width) * undistort_map_param.height;
+    std::vector<float> undistort_map_x_ref, undistort_map_y_ref;
+    std::vector<float> undistort_map_x_opt(undistort_map_size), undistort_map_y_opt(undistort_map_size);
+    std::vector<int16_t> undistort_map_xy_ref, undistort_map_xy_opt(undistort_map_size * 2);
+    std::vector<uint16_t> undistort_map_frac_ref, undistort_map_frac_opt(undistort_map_size);
+    GoldenCheck::Tolerance tolerance_undistort_map;
+    tolerance_undistort_map.tensor_abs_diff_max = 0.01F;   /* [px] */
+    GoldenCheck::Tolerance tolerance_undistort_map_fixed;
+    tolerance_undistort_map_fixed.tensor_abs_diff_max = 1.0F / UndistortMap::kInterTabSize + 0.001F;  /* a tie can be rounded to the other side */
+    harness.AddCase("undistort_map",
+        [&] { CreateUndistortMapReference(undistort_map_param, undistort_map_x_ref, undistort_map_y_ref); },
+        [&] { UndistortMap::CreateUnified(undistort_map_param, undistort_map_x_opt.data(), undistort_map_y_opt.data()); },
+        [&] {
+            auto result = GoldenCheck::CompareTensor(undistort_map_x_ref.data(), undistort_map_x_opt.data(), undistort_map_size, tolerance_undistort_map);
+            return result.is_pass ? GoldenCheck::CompareTensor(undistort_map_y_ref.data(), undistort_map_y_opt.data(), undistort_map_size, tolerance_undistort_map) : result;
+        });
+    harness.AddCase("undistort_map_fixed",
+        [&] {
+            CreateUndistortMapReference(undistort_map_param, undistort_map_x_ref, undistort_map_y_ref);
+            ConvertMapsReference(undistort_map_x_ref, undistort_map_y_ref, undistort_map_xy_ref, undistort_map_frac_ref);
+        },
+        [&] { UndistortMap::CreateUnifiedFixed(undistort_map_param, undistort_map_xy_opt.data(), undistort_map_frac_opt.data()); },
+        [&] {
+            auto map_ref = DecodeFixedMap(undistort_map_xy_ref, undistort_map_frac_ref);
+            auto map_opt = DecodeFixedMap(undistort_map_xy_opt, undistort_map_frac_opt);
+            return GoldenCheck::CompareTensor(map_ref.data(), map_opt.data(), map_ref.size(), tolerance_undistort_map_fixed);
+        });
+
+    /*** Point-level undistortion (iterative CameraProjection::Undistort vs UndistortPointLut, with distortion). the same points as projection_image2ground ***/
+    UndistortPointLut undistort_point_lut;
+    undistort_point_lut.Update(projection[1], PROJECTION_WIDTH, PROJECTION_HEIGHT, GROUND_LUT_GRID_STEP);
+    std::vector<float> undistort_point_ref(PROJECTION_POINT_NUM * 2), undistort_point_opt(PROJECTION_POINT_NUM * 2);
+    GoldenCheck::Tolerance tolerance_undistort_point;
+    tolerance_undistort_point.tensor_abs_diff_max = 0.05F;  /* [px]. distortion between nodes */
+    harness.AddCase("undistort_points",
+        [&] { projection[1].Undistort(projection_image_point[1].data(), PROJECTION_POINT_NUM, undistort_point_ref.data()); },
+        [&] { undistort_point_lut.Undistort(projection_image_point[1].data(), PROJECTION_POINT_NUM, undistort_point_opt.data()); },
+        [&] { return GoldenCheck::CompareTensor(undistort_point_ref.data(), undistort_point_opt.data(), undistort_point_ref.size(), tolerance_undistort_point); });
+
+    /*** Full-frame remap vs point-level undistortion (unified model of DeepCalib, 640 x 360 -> 1080p) ***/
+    /* ref: the whole frame is remapped every frame (the map is cached) so that inference runs on the undistorted frame */
+    /*   plain C++ emulation of cv::remap. the speedup is not against OpenCV */
+    /* opt: inference runs on the raw frame, and only UNDISTORT_POINT_NUM result points are undistorted (closed form, no map) */
+    /* the undistorted points are mapped back with the map of the full-frame remap, and must hit the original points */
+    std::vector<float> undistort_point_unified_input, undistort_point_unified_opt(UNDISTORT_POINT_NUM * 2), undistort_point_unified_back;
+    GenerateUndistortPointInput(undistort_map_param, undistort_point_unified_input);
+    std::vector<float> undistort_point_unified_map_x, undistort_point_unified_map_y;
+    std::vector<int16_t> undistort_point_unified_map_xy;
+    std::vector<uint16_t> undistort_point_unified_map_frac;
+    CreateUndistortMapReference(undistort_map_param, undistort_point_unified_map_x, undistort_point_unified_map_y);
+    ConvertMapsReference(undistort_point_unified_map_x, undistort_point_unified_map_y, undistort_point_unified_map_xy, undistort_point_unified_map_frac);
+    std::vector<uint8_t> undistort_point_unified_frame(640 * 360 * 3), undistort_point_unified_frame_remapped;
+    std::mt19937 undistort_point_unified_engine(1234);
+    for (auto& v : undistort_point_unified_frame) v = static_cast<uint8_t>(undistort_point_unified_engine() & 0xFF);
+    harness.AddCase("undistort_points_unified",
+        [&] { RemapFixedReference(undistort_point_unified_frame, 640, 360, undistort_point_unified_map_xy, undistort_point_unified_map_frac, undistort_point_unified_frame_remapped); },
+        [&] { UndistortMap::UndistortPointUnified(undistort_map_param, undistort_point_unified_input.data(), UNDISTORT_POINT_NUM, undistort_point_unified_opt.data()); },
+        [&] {
+            MapPointReference(undistort_point_unified_map_x, undistort_point_unified_map_y, undistort_map_param.width, undistort_point_unified_opt, undistort_point_unified_back);
+            return GoldenCheck::CompareTensor(undistort_point_unified_input.data(), undistort_point_unified_back.data(), undistort_point_unified_input.size(), tolerance_undistort_map);
+        });
+
+    /*** Bird's eye view map (each cell with small matrices vs BirdEyeView, with distortion) ***/
+    BirdEyeView bird_eye_view;
+    bird_eye_view.Update(projection[1], PROJECTION_WIDTH, PROJECTION_HEIGHT);
+    std::vector<int16_t> bird_eye_view_map_xy_ref;
+    std::vector<uint16_t> bird_eye_view_map_frac_ref;
+    std::vector<int16_t> bird_eye_view_map_xy_opt;
+    std::vector<uint16_t> bird_eye_view_map_frac_opt;
+    harness.AddCase("bird_eye_view_map",
+        [&] { CreateBirdEyeViewMapReference(projection_param[1], bird_eye_view, bird_eye_view_map_xy_ref, bird_eye_view_map_frac_ref); },
+        [&] {
+            /* force to recreate the map */
+            bird_eye_view.SetParam(bird_eye_view.GetParam());
+            bird_eye_view.Update(projection[1], PROJECTION_WIDTH, PROJECTION_HEIGHT);
+            const size_t size = static_cast<size_t>(bird_eye_view.GetWidth()) * bird_eye_view.GetHeight();
+            bird_eye_view_map_xy_opt.assign(bird_eye_view.GetMapXY(), bird_eye_view.GetMapXY() + size * 2);
+            bird_eye_view_map_frac_opt.assign(bird_eye_view.GetMapFrac(), bird_eye_view.GetMapFrac() + size);
+        },
+        [&] {
+            auto map_ref = DecodeFixedMap(bird_eye_view_map_xy_ref, bird_eye_view_map_frac_ref);
+            auto map_opt = DecodeFixedMap(bird_eye_view_map_xy_opt, bird_eye_view_map_frac_opt);
+            return GoldenCheck::CompareTensor(map_ref.data(), map_opt.data(), map_ref.size(), tolerance_undistort_map_fixed);
+        });
+
+    int32_t fail_num = harness.Run(filter);
+    harness.PrintReport();
+    return fail_num == 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef REFERENCE_
+#define REFERENCE_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <deque>
+
+/* for My modules */
+#include "bounding_box.h"
+#include "kalman_filter.h"
+
+/* Frozen copies of the original implementations (before the optimizations), used as the references of the golden check */
+/*   Tracker: KalmanFilter (SimpleMatrix, double) per track, a square cost matrix and HungarianAlgorithm, std::deque history */
+/*   Nms: BoundingBoxUtils::Nms */
+/*   do not optimize them. the implementations in common_helper are compared against them */
+namespace Reference
+{
+
+class Track {
+private:
+    static constexpr int32_t kMaxHistoryNum = 30;
+
+public:
+    typedef struct Data_ {
+        BoundingBox bbox;
+        BoundingBox bbox_raw;
+    } Data;
+
+public:
+    Track(const int32_t id, const BoundingBox& bbox_det);
+    ~Track();
+
+    BoundingBox Predict();
+    void Update(const BoundingBox& bbox_det);
+    void UpdateNoDetect();
+
+    Data& GetLatestData();
+    BoundingBox& GetLatestBoundingBox();
+
+    int32_t GetId() const { return id_; }
+    int32_t GetUndetectedCount() const { return cnt_undetected_; }
+    int32_t GetDetectedCount() const { return cnt_detected_; }
+
+private:
+    KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
+    SimpleMatrix Bbox2KalmanObserved(const BoundingBox& bbox);
+    SimpleMatrix Bbox2KalmanStatus(const BoundingBox& bbox);
+    BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X);
+
+private:
+    std::deque<Data> data_history_;
+    KalmanFilter kf_;
+    int32_t id_;
+    int32_t cnt_detected_;
+    int32_t cnt_undetected_;
+};
+
+
+class Tracker {
+private:
+    static constexpr float kCostMax = 1.0F;
+
+public:
+    Tracker(int32_t threshold_frame_to_delete = 2);
+    ~Tracker();
+    void Reset();
+
+    void Update(const std::vector<BoundingBox>& det_list);
+
+    std::vector<Track>& GetTrackList() { return track_list_; }
+
+private:
+    float CalculateCost(Track& track, const BoundingBox& det_bbox);
+
+private:
+    std::vector<Track> track_list_;
+    int32_t track_sequence_num_;
+    int32_t threshold_frame_to_delete_;
+};
+
+
+/* the original BoundingBoxUtils::Nms */
+void Nms(std::vector<BoundingBox>& bbox_list, std::vector<BoundingBox>& bbox_nms_list, float threshold_nms_iou, bool check_class_id = false);
+
+}
+
+#endif
@@ -37,6 +37,7 @@ limitations under the License.
 #include "hand_landmark_engine.h"
 #include "classification_engine.h"
 #include "area_selector.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -84,6 +85,7 @@ static bool s_is_palm_by_lm_valid = false;
 static std::vector<OBJECT_TRACKER> s_objectList;
 static int32_t s_animCount = 0;
 static bool s_isDebug = true;
+static ProcessingStats s_stats;
 
 
 /*** Function ***/
@@ -250,6 +252,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
         s_isDebug = !s_isDebug;
         return 0;
@@ -268,6 +276,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     s_frame_cnt++;
 
     bool enforce_palm_det = (s_frame_cnt % INTERVAL_TO_ENFORCE_PALM_DET) == 0;		// to increase accuracy
@@ -420,6 +429,40 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = palm_result.time_inference + landmark_result.time_inference;
     result.time_post_process = palm_result.time_post_process  + landmark_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
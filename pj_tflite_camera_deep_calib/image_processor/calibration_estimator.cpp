@@ -0,0 +1,209 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "calibration_estimator.h"
+
+/*** Macro ***/
+#define TAG "CalibrationEstimator"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/* a class which the model denies completely must not make the posterior 0 forever (a wrong frame can be recovered) */
+static constexpr double kProbMin = 1e-3;
+/* size of the image to detect scene change */
+static constexpr int32_t kThumbnailWidth = 32;
+static constexpr int32_t kThumbnailHeight = 18;
+
+
+/*** Function ***/
+void CalibrationEstimator::Initialize(const Param& param)
+{
+    param_ = param;
+
+    /* Gaussian kernel (+-3 sigma) */
+    const int32_t radius = (std::max)(static_cast<int32_t>(std::ceil(param_.observation_sigma * 3)), 0);
+    blur_kernel_.resize(radius * 2 + 1);
+    float sum = 0;
+    for (int32_t i = -radius; i <= radius; i++) {
+        blur_kernel_[i + radius] = (param_.observation_sigma > 0) ? std::exp(-0.5f * i * i / (param_.observation_sigma * param_.observation_sigma)) : 1.0f;
+        sum += blur_kernel_[i + radius];
+    }
+    for (auto& k : blur_kernel_) k /= sum;
+
+    Reset();
+}
+
+void CalibrationEstimator::Reset()
+{
+    status_ = Status();
+    thumbnail_.release();
+    Restart();
+}
+
+void CalibrationEstimator::Restart()
+{
+    status_.state = kStateEstimating;
+    status_.inference_num = 0;
+    status_.time_convergence = 0;
+    posterior_xi_ = Posterior();
+    posterior_focal_ = Posterior();
+    time_start_ = std::chrono::steady_clock::now();
+    frame_num_since_converged_ = 0;
+    is_auditing_ = false;
+    audit_disagree_num_ = 0;
+    thumbnail_reference_.release();
+}
+
+bool CalibrationEstimator::NeedInference(const cv::Mat& image)
+{
+    /* the thumbnail is compared with the one of the convergence, not with the previous frame, so that a slow change (e.g. the camera is moved slowly) is also detected */
+    UpdateThumbnail(image);
+    if (status_.state == kStateEstimating) return true;
+
+    if (IsSceneChanged()) {
+        PRINT("Scene changed. Restart estimation\n");
+        status_.restart_num++;
+        Restart();
+        return true;
+    }
+
+    if (is_auditing_) return true;   /* the previous audit disagreed */
+    frame_num_since_converged_++;
+    if (param_.audit_interval > 0 && frame_num_since_converged_ >= param_.audit_interval) {
+        frame_num_since_converged_ = 0;
+        is_auditing_ = true;
+        return true;
+    }
+    return false;
+}
+
+void CalibrationEstimator::Update(const CameraCalibrationEngine::Result& result)
+{
+    if (is_auditing_) {
+        const int32_t peak_xi = FindPeak(result.xi_prob_list);
+        const int32_t peak_focal = FindPeak(result.focal_prob_list);
+        if (std::abs(peak_xi - posterior_xi_.peak) <= param_.audit_class_tolerance && std::abs(peak_focal - posterior_focal_.peak) <= param_.audit_class_tolerance) {
+            /* keep the converged parameters as they are (the undistortion map is not changed) */
+            /* the reference of the scene change follows the scene confirmed by the audit (e.g. lighting changes during a day) */
+            is_auditing_ = false;
+            audit_disagree_num_ = 0;
+            thumbnail_.copyTo(thumbnail_reference_);
+            return;
+        }
+        /* a single wrong estimation must not restart the estimation, so audit again in the next frame */
+        audit_disagree_num_++;
+        if (audit_disagree_num_ < param_.audit_fail_num) return;
+        PRINT("Audit failed (xi: %f, f: %f). Restart estimation\n", result.xi, result.focal_length);
+        status_.restart_num++;
+        Restart();
+    }
+
+    Accumulate(posterior_xi_, result.xi_class_list, result.xi_prob_list);
+    Accumulate(posterior_focal_, result.focal_class_list, result.focal_prob_list);
+    status_.inference_num++;
+    status_.xi = posterior_xi_.value;
+    status_.focal_length = posterior_focal_.value;
+    status_.xi_confidence = posterior_xi_.confidence;
+    status_.focal_confidence = posterior_focal_.confidence;
+
+    const bool is_confident = status_.xi_confidence >= param_.confidence_threshold && status_.focal_confidence >= param_.confidence_threshold;
+    if ((status_.inference_num >= param_.inference_num_min && is_confident) || status_.inference_num >= param_.inference_num_max) {
+        status_.state = kStateConverged;
+        status_.time_convergence = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - time_start_).count() * 1000.0;
+        frame_num_since_converged_ = 0;
+        thumbnail_.copyTo(thumbnail_reference_);   /* the frame of the last inference */
+        PRINT("Converged: xi = %f (%.3f), f = %f (%.3f), %d inferences, %.1f [msec]\n",
+            status_.xi, status_.xi_confidence, status_.focal_length, status_.focal_confidence, status_.inference_num, status_.time_convergence);
+    }
+}
+
+void CalibrationEstimator::Accumulate(Posterior& posterior, const std::vector<float>& class_list, const std::vector<float>& prob_list)
+{
+    if (class_list.empty() || class_list.size() != prob_list.size()) return;
+    if (posterior.class_list != class_list) {
+        /* the first frame, or the image size is changed */
+        posterior.class_list = class_list;
+        posterior.log_prob_list.assign(class_list.size(), 0.0);
+    }
+
+    /* posterior is proportional to the product of the probabilities of each frame */
+    /* the probability of a frame is blurred, otherwise the posterior is overconfident (e.g. the regression model gives only two classes) */
+    const int32_t class_num = static_cast<int32_t>(class_list.size());
+    const int32_t radius = static_cast<int32_t>(blur_kernel_.size() / 2);
+    prob_blurred_.assign(class_num, 0.0f);
+    for (int32_t i = 0; i < class_num; i++) {
+        for (int32_t k = -radius; k <= radius; k++) {
+            const int32_t index = (std::min)((std::max)(i + k, 0), class_num - 1);
+            prob_blurred_[i] += prob_list[index] * blur_kernel_[k + radius];
+        }
+    }
+    for (int32_t i = 0; i < class_num; i++) {
+        posterior.log_prob_list[i] += std::log(static_cast<double>(prob_blurred_[i]) + kProbMin);
+    }
+    const double log_prob_max = *std::max_element(posterior.log_prob_list.begin(), posterior.log_prob_list.end());
+    double sum = 0;
+    posterior.prob_list.resize(class_list.size());
+    for (size_t i = 0; i < class_list.size(); i++) {
+        posterior.prob_list[i] = std::exp(posterior.log_prob_list[i] - log_prob_max);
+        sum += posterior.prob_list[i];
+    }
+    for (auto& prob : posterior.prob_list) prob /= sum;
+
+    /* the estimate is the mean around the peak, and the confidence is the probability around the peak (neighbors are almost the same value) */
+    posterior.peak = static_cast<int32_t>(std::max_element(posterior.prob_list.begin(), posterior.prob_list.end()) - posterior.prob_list.begin());
+    const int32_t index_start = (std::max)(posterior.peak - 1, 0);
+    const int32_t index_end = (std::min)(posterior.peak + 1, static_cast<int32_t>(class_list.size()) - 1);
+    double prob_sum = 0;
+    double value_sum = 0;
+    for (int32_t i = index_start; i <= index_end; i++) {
+        prob_sum += posterior.prob_list[i];
+        value_sum += posterior.prob_list[i] * class_list[i];
+    }
+    posterior.confidence = static_cast<float>(prob_sum);
+    posterior.value = static_cast<float>(value_sum / prob_sum);
+}
+
+int32_t CalibrationEstimator::FindPeak(const std::vector<float>& prob_list)
+{
+    if (prob_list.empty()) return -1;
+    return static_cast<int32_t>(std::max_element(prob_list.begin(), prob_list.end()) - prob_list.begin());
+}
+
+void CalibrationEstimator::UpdateThumbnail(const cv::Mat& image)
+{
+    cv::resize(image, thumbnail_, cv::Size(kThumbnailWidth, kThumbnailHeight), 0, 0, cv::INTER_AREA);
+    if (thumbnail_.channels() == 3) cv::cvtColor(thumbnail_, thumbnail_, cv::COLOR_BGR2GRAY);
+}
+
+bool CalibrationEstimator::IsSceneChanged() const
+{
+    if (thumbnail_reference_.empty() || thumbnail_reference_.size() != thumbnail_.size() || thumbnail_reference_.type() != thumbnail_.type()) return false;
+    cv::Mat diff;
+    cv::absdiff(thumbnail_, thumbnail_reference_, diff);
+    return cv::mean(diff)[0] > param_.scene_change_threshold;
+}
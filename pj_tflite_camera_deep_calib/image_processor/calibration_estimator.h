@@ -0,0 +1,119 @@
+/* Copyright 2021 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef CALIBRATION_ESTIMATOR_
+#define CALIBRATION_ESTIMATOR_
+
+/* for general */
+#include <cstdint>
+#include <vector>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "camera_calibration_engine.h"
+
+/* Schedule of the calibration inference for a fixed camera */
+/*   class probabilities of (f, xi) of each frame are accumulated into a posterior (sum of log probabilities) */
+/*   once the posterior converges, the inference is stopped and the converged parameters are used */
+/*   the estimation restarts when the scene changes (e.g. the camera is moved or replaced), */
+/*   or when an audit (one inference every audit_interval frames) doesn't agree with the converged parameters */
+/*   used only with CONTINUOUS_CALIBRATION in image_processor.cpp. by default, the app infers once (at the start and by the command) */
+/*   inference cost: with the default Param, it takes inference_num_min (5) to inference_num_max (100) inferences to converge, */
+/*   then one audit every 300 frames
+/*   (+ up to audit_fail_num - 1 repeats while it disagrees), and the whole estimation again after a scene change */
+class CalibrationEstimator {
+public:
+    enum State {
+        kStateEstimating = 0,
+        kStateConverged,
+    };
+
+    typedef struct Param_ {
+        float   confidence_threshold;   /* posterior probability around the peak (+-1 class) to be converged */
+        float   observation_sigma;      /* [class]. error of the estimation of each frame. the probability of each frame is blurred by this */
+        int32_t inference_num_min;      /* the minimum number of inferences to be converged */
+        int32_t inference_num_max;      /* converged forcibly with the best estimate */
+        int32_t audit_interval;         /* [frame]. 0 = no audit */
+        int32_t audit_class_tolerance;  /* audit disagrees if the peak of the audit is farther than this [class] */
+        int32_t audit_fail_num;         /* restart when audits disagree this number of times in a row (an audit is repeated while it disagrees) */
+        float   scene_change_threshold; /* mean abs diff of the thumbnail (gray, 0 - 255) from the frame of the convergence */
+        Param_() : confidence_threshold(0.95f), observation_sigma(1.5f), inference_num_min(5), inference_num_max(100),
+            audit_interval(300), audit_class_tolerance(3), audit_fail_num(3), scene_change_threshold(40.0f)
+        {}
+    } Param;
+
+    typedef struct Status_ {
+        State   state;
+        float   xi;
+        float   focal_length;
+        float   xi_confidence;
+        float   focal_confidence;
+        int32_t inference_num;          /* since the estimation started */
+        int32_t restart_num;            /* scene change or audit failure */
+        double  time_convergence;       /* [msec] from the start of the estimation to the convergence */
+        Status_() : state(kStateEstimating), xi(0), focal_length(0), xi_confidence(0), focal_confidence(0), inference_num(0), restart_num(0), time_convergence(0)
+        {}
+    } Status;
+
+public:
+    CalibrationEstimator() {}
+    ~CalibrationEstimator() {}
+    void Initialize(const Param& param);
+    void Reset();       /* restart the estimation */
+
+    /* call every frame before the inference. return true if the inference is needed for this frame */
+    bool NeedInference(const cv::Mat& image);
+    /* call with the inference result when NeedInference returns true */
+    void Update(const CameraCalibrationEngine::Result& result);
+
+    bool HasEstimate() const { return status_.inference_num > 0 || status_.state == kStateConverged; }
+    const Status& GetStatus() const { return status_; }
+
+private:
+    typedef struct Posterior_ {
+        std::vector<float>  class_list;
+        std::vector<double> log_prob_list;      /* sum of log probabilities of each frame */
+        std::vector<double> prob_list;          /* normalized */
+        int32_t peak;
+        float   confidence;
+        float   value;
+        Posterior_() : peak(-1), confidence(0), value(0)
+        {}
+    } Posterior;
+
+    void Restart();
+    void Accumulate(Posterior& posterior, const std::vector<float>& class_list, const std::vector<float>& prob_list);
+    static int32_t FindPeak(const std::vector<float>& prob_list);
+    void UpdateThumbnail(const cv::Mat& image);
+    bool IsSceneChanged() const;
+
+private:
+    Param param_;
+    Status status_;
+    Posterior posterior_xi_;
+    Posterior posterior_focal_;
+    std::chrono::steady_clock::time_point time_start_;
+    int32_t frame_num_since_converged_;
+    bool is_auditing_;
+    int32_t audit_disagree_num_;
+    std::vector<float> blur_kernel_;
+    std::vector<float> prob_blurred_;
+    cv::Mat thumbnail_;             /* the current frame */
+    cv::Mat thumbnail_reference_;   /* the frame of the convergence (updated when an audit agrees) */
+};
+
+#endif
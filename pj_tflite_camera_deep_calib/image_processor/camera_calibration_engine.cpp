@@ -193,17 +193,25 @@ int32_t CameraCalibrationEngine::Process(const cv::Mat& original_mat, Result& re
     float xi = class_dist_list_[GetMaxIndex(xi_list)];
     float f = class_focal_list_[GetMaxIndex(f_list)];
     //printf("%f %f\n", xi, f);
+    NormalizeProbability(xi_list, result.xi_prob_list);
+    NormalizeProbability(f_list, result.focal_prob_list);
 
 #elif defined(MODEL_TYPE_REGRESSION)
     //printf("%f %f\n", xi_list[0], f_list[0]);
     float xi = xi_list[0] * 1.2f;
     float f = f_list[0] * (kFocalEnd + 1.0f - kFocalStart) + kFocalStart;
+    ValueToProbability(class_dist_list_, xi, result.xi_prob_list);
+    ValueToProbability(class_focal_list_, f, result.focal_prob_list);
 #else
     error
 #endif
 
-    f = f * crop_w / input_tensor_info.GetWidth();      /* Focal length on the original image size */
+    const float focal_scale = static_cast<float>(crop_w) / input_tensor_info.GetWidth();   /* Focal length on the original image size */
+    f = f * focal_scale;
     PRINT("xi: %f,  f: %f\n", xi, f);
+    result.xi_class_list = class_dist_list_;
+    result.focal_class_list.resize(class_focal_list_.size());
+    for (size_t i = 0; i < class_focal_list_.size(); i++) result.focal_class_list[i] = class_focal_list_[i] * focal_scale;
 
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
@@ -229,3 +237,35 @@ int32_t CameraCalibrationEngine::GetMaxIndex(std::vector<float> value_list)
 
     return static_cast<int32_t>(indices[0]);
 }
+
+void CameraCalibrationEngine::NormalizeProbability(const std::vector<float>& score_list, std::vector<float>& prob_list)
+{
+    /* the output of the classification model is softmax, but normalize it again just in case */
+    prob_list.resize(score_list.size());
+    float sum = 0;
+    for (size_t i = 0; i < score_list.size(); i++) {
+        prob_list[i] = (std::max)(score_list[i], 0.0f);
+        sum += prob_list[i];
+    }
+    for (auto& prob : prob_list) prob = (sum > 0) ? prob / sum : 1.0f / prob_list.size();
+}
+
+void CameraCalibrationEngine::ValueToProbability(const std::vector<float>& class_list, float value, std::vector<float>& prob_list)
+{
+    /* the regression model has no probability, so the value is split into the two nearest classes (linear interpolation) */
+    prob_list.assign(class_list.size(), 0.0f);
+    if (class_list.empty()) return;
+    if (value <= class_list.front()) {
+        prob_list.front() = 1.0f;
+        return;
+    }
+    for (size_t i = 0; i + 1 < class_list.size(); i++) {
+        if (value < class_list[i + 1]) {
+            const float ratio = (value - class_list[i]) / (class_list[i + 1] - class_list[i]);
+            prob_list[i] = 1.0f - ratio;
+            prob_list[i + 1] = ratio;
+            return;
+        }
+    }
+    prob_list.back() = 1.0f;
+}
@@ -40,6 +40,11 @@ public:
     typedef struct Result_ {
         float     xi;
         float     focal_length;
+        /* probability of each class. focal length is on the original image */
+        std::vector<float> xi_class_list;
+        std::vector<float> xi_prob_list;
+        std::vector<float> focal_class_list;
+        std::vector<float> focal_prob_list;
         double    time_pre_process;		// [msec]
         double    time_inference;		// [msec]
         double    time_post_process;	// [msec]
@@ -56,6 +61,8 @@ public:
 
 private:
     int32_t GetMaxIndex(std::vector<float> value_list);
+    static void NormalizeProbability(const std::vector<float>& score_list, std::vector<float>& prob_list);
+    static void ValueToProbability(const std::vector<float>& class_list, float value, std::vector<float>& prob_list);
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
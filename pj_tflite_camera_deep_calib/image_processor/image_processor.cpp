@@ -32,7 +32,10 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "undistort_map.h"
 #include "camera_calibration_engine.h"
+#include "calibration_estimator.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,10 +43,38 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/* the undistortion map is rebuilt only when the quantized estimation is changed, so that small jitter of the estimation doesn't rebuild it */
+#define FOCAL_LENGTH_QUANTUM    2.0f    /* [px] */
+#define XI_QUANTUM              0.01f
+
+/* estimate the camera parameters continuously (CalibrationEstimator), instead of once at the start and by the command */
+/* it needs 5 - 100 inferences to converge, an audit every 300 frames and the estimation again after a scene change */
+//#define CONTINUOUS_CALIBRATION
+
+/* print the time to create the undistortion map and to remap for 1080p output in Initialize (the remap figures are measured only by this switch) */
+//#define BENCHMARK_UNDISTORT_MAP
+
+/* keep the raw frame and undistort only points (e.g. results of inference on the raw frame), instead of remapping the whole frame */
+/* the map is not created. the displacement of a grid on the raw frame is drawn to show the undistortion */
+//#define UNDISTORT_POINT_ONLY
+#define POINT_GRID_STEP 40      /* [px] */
+
 /*** Global variable ***/
 std::unique_ptr<CameraCalibrationEngine> s_engine;
+ProcessingStats s_stats;
 
+#ifdef CONTINUOUS_CALIBRATION
+static CalibrationEstimator s_estimator;
+#else
 static bool s_update_calib = true;
+#endif
+
+/* fixed-point map for cv::remap (the same format as cv::convertMaps(CV_16SC2)) */
+static cv::Mat s_map_xy;        /* CV_16SC2 */
+static cv::Mat s_map_frac;      /* CV_16UC1 */
+static std::array<int32_t, 5> s_map_key = { { 0, 0, 0, 0, 0 } };   /* image width, height, scale, quantized focal length, quantized xi */
+static UndistortMap::UnifiedParam s_undistort_param;    /* parameters for s_map_key (for points) */
+static bool s_has_undistortion = false;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -57,79 +88,115 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
-/* reference: https://github.com/alexvbogdan/DeepCalib/blob/master/undistortion/undistSphIm.m */
 /* Unified projection model */
-static void CreateUndistortMap(cv::Size undist_image_size, float f_undist, float xi, float u0_undist, float v0_undist, float f_dist, float u0_dist, float v0_dist
-    , cv::Mat& mapx, cv::Mat& mapy)
+/*   the undistorted image is new_image_size_scale times larger than the input image, and has the same focal length */
+static UndistortMap::UnifiedParam MakeUndistortMapParam(cv::Size image_size, int32_t new_image_size_scale, float focal_length, float xi)
 {
-    cv::Mat grid_x(undist_image_size, CV_32F);
-    cv::Mat grid_y(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            grid_x.at<float>(y, x) = x + 0.0f;
-            grid_y.at<float>(y, x) = y + 0.0f;
-        }
-    }
+    UndistortMap::UnifiedParam param;
+    param.width = image_size.width * new_image_size_scale;
+    param.height = image_size.height * new_image_size_scale;
+    param.f_undist = focal_length;
+    param.u0_undist = param.width / 2.0f;
+    param.v0_undist = param.height / 2.0f;
+    param.xi = xi;
+    param.f_dist = focal_length;
+    param.u0_dist = image_size.width / 2.0f;
+    param.v0_dist = image_size.height / 2.0f;
+    return param;
+}
 
-    cv::Mat X_Cam(undist_image_size, CV_32F);
-    cv::Mat Y_Cam(undist_image_size, CV_32F);
-    cv::Mat Z_Cam(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            X_Cam.at<float>(y, x) = (grid_x.at<float>(y, x) - u0_undist) / f_undist;
-            Y_Cam.at<float>(y, x) = (grid_y.at<float>(y, x) - v0_undist) / f_undist;
-            Z_Cam.at<float>(y, x) = 1.0f;
-        }
-    }
+static void CreateUndistortMap(const UndistortMap::UnifiedParam& param, cv::Mat& map_xy, cv::Mat& map_frac)
+{
+    map_xy.create(param.height, param.width, CV_16SC2);
+    map_frac.create(param.height, param.width, CV_16UC1);
+    UndistortMap::CreateUnifiedFixed(param, map_xy.ptr<int16_t>(), map_frac.ptr<uint16_t>());
+}
 
-    cv::Mat Alpha_Cam(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            Alpha_Cam.at<float>(y, x) = 1 / sqrtf(
-                X_Cam.at<float>(y, x) * X_Cam.at<float>(y, x)
-                + Y_Cam.at<float>(y, x) * Y_Cam.at<float>(y, x)
-                + Z_Cam.at<float>(y, x) * Z_Cam.at<float>(y, x)
-            );
-        }
-    }
+/* return true if the map is rebuilt */
+static bool UpdateUndistortMap(cv::Size image_size, int32_t new_image_size_scale, float focal_length, float xi)
+{
+    const int32_t focal_length_quantized = static_cast<int32_t>(std::round(focal_length / FOCAL_LENGTH_QUANTUM));
+    const int32_t xi_quantized = static_cast<int32_t>(std::round(xi / XI_QUANTUM));
+    const std::array<int32_t, 5> key = { { image_size.width, image_size.height, new_image_size_scale, focal_length_quantized, xi_quantized } };
+    if (s_has_undistortion && key == s_map_key) return false;
+
+    /* use the quantized values so that the map is the same for the same key */
+    s_undistort_param = MakeUndistortMapParam(image_size, new_image_size_scale, focal_length_quantized * FOCAL_LENGTH_QUANTUM, xi_quantized * XI_QUANTUM);
+#ifndef UNDISTORT_POINT_ONLY
+    CreateUndistortMap(s_undistort_param, s_map_xy, s_map_frac);
+#endif
+    s_map_key = key;
+    s_has_undistortion = true;
+    return true;
+}
 
-    cv::Mat X_Sph(undist_image_size, CV_32F);
-    cv::Mat Y_Sph(undist_image_size, CV_32F);
-    cv::Mat Z_Sph(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            X_Sph.at<float>(y, x) = X_Cam.at<float>(y, x) * Alpha_Cam.at<float>(y, x);
-            Y_Sph.at<float>(y, x) = Y_Cam.at<float>(y, x) * Alpha_Cam.at<float>(y, x);
-            Z_Sph.at<float>(y, x) = Z_Cam.at<float>(y, x) * Alpha_Cam.at<float>(y, x);
+#ifdef UNDISTORT_POINT_ONLY
+/* draw a line from each grid point of the raw frame to its undistorted position (scaled to the output size) */
+static void DrawUndistortedGrid(cv::Mat& mat, int32_t new_image_size_scale)
+{
+    std::vector<cv::Point2f> point_list;
+    for (int32_t y = POINT_GRID_STEP / 2; y < mat.rows; y += POINT_GRID_STEP) {
+        for (int32_t x = POINT_GRID_STEP / 2; x < mat.cols; x += POINT_GRID_STEP) {
+            point_list.push_back(cv::Point2f(static_cast<float>(x), static_cast<float>(y)));
         }
     }
-
-    cv::Mat den(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            den.at<float>(y, x) = xi * sqrtf(
-                X_Sph.at<float>(y, x) * X_Sph.at<float>(y, x)
-                + Y_Sph.at<float>(y, x) * Y_Sph.at<float>(y, x)
-                + Z_Sph.at<float>(y, x) * Z_Sph.at<float>(y, x)
-            ) + Z_Sph.at<float>(y, x);
-        }
+    std::vector<cv::Point2f> point_undistorted_list(point_list.size());
+    UndistortMap::UndistortPointUnified(s_undistort_param, reinterpret_cast<const float*>(point_list.data()), static_cast<int32_t>(point_list.size()), reinterpret_cast<float*>(point_undistorted_list.data()));
+    for (size_t i = 0; i < point_list.size(); i++) {
+        const cv::Point2f& p = point_undistorted_list[i];
+        if (p.x == UndistortMap::kInvalidPoint && p.y == UndistortMap::kInvalidPoint) continue;
+        const cv::Point2f p_scaled(p.x / new_image_size_scale, p.y / new_image_size_scale);
+        cv::line(mat, point_list[i], p_scaled, CommonHelper::CreateCvColor(0, 255, 0), 1);
+        cv::circle(mat, p_scaled, 2, CommonHelper::CreateCvColor(255, 0, 0), -1);
     }
+}
+#endif
 
-    mapx = cv::Mat(undist_image_size, CV_32F);
-    mapy = cv::Mat(undist_image_size, CV_32F);
-#pragma omp parallel for
-    for (int32_t y = 0; y < undist_image_size.height; y++) {
-        for (int32_t x = 0; x < undist_image_size.width; x++) {
-            mapx.at<float>(y, x) = (X_Sph.at<float>(y, x) * f_dist) / den.at<float>(y, x) + u0_dist;
-            mapy.at<float>(y, x) = (Y_Sph.at<float>(y, x) * f_dist) / den.at<float>(y, x) + v0_dist;
-        }
+#ifdef BENCHMARK_UNDISTORT_MAP
+static void BenchmarkUndistortMap()
+{
+    static constexpr int32_t kLoopNum = 20;
+    const cv::Size image_size(640, 360);
+    const UndistortMap::UnifiedParam param = MakeUndistortMapParam(image_size, 3, 200.0f, 0.8f);    /* 1920 x 1080 */
+    cv::Mat image(image_size, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat map_x(param.height, param.width, CV_32FC1);
+    cv::Mat map_y(param.height, param.width, CV_32FC1);
+    cv::Mat map_xy, map_frac, map_xy_converted, map_frac_converted, image_undistorted;
+    /* results of inference on the raw frame (e.g. 100 boxes x 4 corners + keypoints) */
+    static constexpr int32_t kPointNum = 1000;
+    std::vector<float> point(kPointNum * 2), point_undistorted(kPointNum * 2);
+    for (int32_t i = 0; i < kPointNum; i++) {
+        point[i * 2 + 0] = static_cast<float>(std::rand() % image_size.width);
+        point[i * 2 + 1] = static_cast<float>(std::rand() % image_size.height);
     }
+
+    const auto& t0 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) UndistortMap::CreateUnified(param, map_x.ptr<float>(), map_y.ptr<float>());
+    const auto& t1 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) cv::convertMaps(map_x, map_y, map_xy_converted, map_frac_converted, CV_16SC2);
+    const auto& t2 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) CreateUndistortMap(param, map_xy, map_frac);
+    const auto& t3 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) cv::remap(image, image_undistorted, map_x, map_y, cv::INTER_LINEAR);
+    const auto& t4 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) cv::remap(image, image_undistorted, map_xy, map_frac, cv::INTER_LINEAR);
+    const auto& t5 = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < kLoopNum; i++) UndistortMap::UndistortPointUnified(param, point.data(), kPointNum, point_undistorted.data());
+    const auto& t6 = std::chrono::steady_clock::now();
+
+    PRINT("Undistortion map (%d x %d) [msec]\n", param.width, param.height);
+    PRINT("  create float map: %.3f, convertMaps: %.3f, create fixed-point map: %.3f\n",
+        static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0 / kLoopNum,
+        static_cast<std::chrono::duration<double>>(t2 - t1).count() * 1000.0 / kLoopNum,
+        static_cast<std::chrono::duration<double>>(t3 - t2).count() * 1000.0 / kLoopNum);
+    PRINT("  remap with float map: %.3f, remap with fixed-point map: %.3f\n",
+        static_cast<std::chrono::duration<double>>(t4 - t3).count() * 1000.0 / kLoopNum,
+        static_cast<std::chrono::duration<double>>(t5 - t4).count() * 1000.0 / kLoopNum);
+    PRINT("  undistort %d points only (no map, no remap): %.3f\n", kPointNum,
+        static_cast<std::chrono::duration<double>>(t6 - t5).count() * 1000.0 / kLoopNum);
 }
+#endif
 
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
@@ -143,6 +210,13 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
     if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != CameraCalibrationEngine::kRetOk) {
         return -1;
     }
+#ifdef CONTINUOUS_CALIBRATION
+    s_estimator.Initialize(CalibrationEstimator::Param());
+#endif
+
+#ifdef BENCHMARK_UNDISTORT_MAP
+    BenchmarkUndistortMap();
+#endif
     return 0;
 }
 
@@ -171,8 +245,18 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
+#ifdef CONTINUOUS_CALIBRATION
+        s_estimator.Reset();
+#else
         s_update_calib = true;
+#endif
         PRINT_E("Do estimation\n");
         return 0;
     default:
@@ -189,42 +273,71 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     int32_t new_image_size_scale = 3;   /* this value should be adjusted according to distortion level */
-    static cv::Mat mapx, mapy;      /* save these parameters as static to avoid re - calculate maps */
     CameraCalibrationEngine::Result calib_result;
+    bool is_inferred = false;
+
+#ifdef CONTINUOUS_CALIBRATION
+    /*** Predict camera parameters (only until the estimation converges) ***/
+    if (s_estimator.NeedInference(mat)) {
+        if (s_engine->Process(mat, calib_result) != CameraCalibrationEngine::kRetOk) {
+            s_stats.AddCount(ProcessingStats::kCounterDrop);
+            return -1;
+        }
+        is_inferred = true;
+        s_estimator.Update(calib_result);
+    }
 
-    if (mapx.empty() || s_update_calib) {
+    /*** Calibration ***/
+    /* the map is created with the first estimate to show something, and then with the converged parameters */
+    /* the map is not rebuilt while converged (UpdateUndistortMap just compares the parameters) */
+    const CalibrationEstimator::Status& status = s_estimator.GetStatus();
+    const bool is_converged = status.state == CalibrationEstimator::kStateConverged;
+    if (is_converged || (!s_has_undistortion && s_estimator.HasEstimate())) {
+        UpdateUndistortMap(mat.size(), new_image_size_scale, status.focal_length, status.xi);
+    }
+#else
+    if (!s_has_undistortion || s_update_calib) {
         /*** Predict camera parameters ***/
         if (s_engine->Process(mat, calib_result) != CameraCalibrationEngine::kRetOk) {
+            s_stats.AddCount(ProcessingStats::kCounterDrop);
             return -1;
         }
+        is_inferred = true;
 
         /*** Calibration ***/
-        /* Set parameters */
-        float xi = calib_result.xi;
-        float focal_length = calib_result.focal_length;
-
-        
-        cv::Size undist_image_size = mat.size() * new_image_size_scale;
+        /* Calculate undistort map (skipped when the parameters are almost the same as the current map) */
+        bool is_map_updated = UpdateUndistortMap(mat.size(), new_image_size_scale, calib_result.focal_length, calib_result.xi);
 
-        float f_undist = focal_length;
-        float u0_undist = undist_image_size.width / 2.0f;
-        float v0_undist = undist_image_size.height / 2.0f;
-        float f_dist = focal_length;
-        float u0_dist = mat.size().width / 2.0f;
-        float v0_dist = mat.size().height / 2.0f;
-
-        /* Calculate undistort map */
-        CreateUndistortMap(undist_image_size, f_undist, xi, u0_undist, v0_undist, f_dist, u0_dist, v0_dist, mapx, mapy);
-
-        CommonHelper::DrawText(mat, "Calibration Done", cv::Point(100, 100), 0.5, 2, CommonHelper::CreateCvColor(255, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), false);
+        CommonHelper::DrawText(mat, is_map_updated ? "Calibration Done" : "Calibration Done (no change)", cv::Point(100, 100), 0.5, 2, CommonHelper::CreateCvColor(255, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), false);
         s_update_calib = false;
     }
-    
+#endif
+
     /* Undistort image */
     cv::Mat image_undistorted;
-    cv::remap(mat, image_undistorted, mapx, mapy, cv::INTER_LINEAR);
-    cv::resize(image_undistorted, image_undistorted, cv::Size(), 1.0 / new_image_size_scale, 1.0 / new_image_size_scale);
+    if (!s_has_undistortion) {
+        image_undistorted = mat.clone();
+    } else {
+#ifdef UNDISTORT_POINT_ONLY
+        image_undistorted = mat.clone();
+        DrawUndistortedGrid(image_undistorted, new_image_size_scale);
+#else
+        cv::remap(mat, image_undistorted, s_map_xy, s_map_frac, cv::INTER_LINEAR);
+        cv::resize(image_undistorted, image_undistorted, cv::Size(), 1.0 / new_image_size_scale, 1.0 / new_image_size_scale);
+#endif
+    }
+
+#ifdef CONTINUOUS_CALIBRATION
+    char text[128];
+    if (is_converged) {
+        snprintf(text, sizeof(text), "Calibrated: xi = %.2f, f = %.0f (converged in %.0f [ms], %d inferences)", status.xi, status.focal_length, status.time_convergence, status.inference_num);
+    } else {
+        snprintf(text, sizeof(text), "Calibrating: %d inferences, confidence = %.2f / %.2f", status.inference_num, status.xi_confidence, status.focal_confidence);
+    }
+    CommonHelper::DrawText(image_undistorted, text, cv::Point(0, 20), 0.5, 2, CommonHelper::CreateCvColor(255, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+#endif
 
     DrawFps(image_undistorted, calib_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
@@ -234,6 +347,43 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = calib_result.time_inference;
     result.time_post_process = calib_result.time_post_process;
 
+    /* Update runtime stats */
+    /* the model runs only on some frames, so the model stages are recorded only when it ran */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    if (is_inferred) {
+        s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+        s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+        s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    }
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
@@ -27,6 +27,8 @@ namespace cv {
 };
 
 
+#define NUM_MAX_STATS_STAGE 8
+
 namespace ImageProcessor
 {
 
@@ -44,10 +46,34 @@ typedef struct {
     double  time_post_process;  // [msec]
 } Result;
 
+typedef struct {
+    uint64_t frame_num;
+    uint64_t drop_num;
+    uint64_t detection_num;
+    uint64_t track_num;
+    uint64_t second_stage_num;
+    int32_t  stage_num;
+    struct {
+        char     name[32];
+        uint64_t count;
+        double   mean;   // [msec]
+        double   p50;    // [msec]
+        double   p90;    // [msec]
+        double   p99;    // [msec]
+        double   max;    // [msec]
+    } stage_list[NUM_MAX_STATS_STAGE];
+} Stats;
+
+enum {
+    kCommandPrintStats = 1,
+    kCommandResetStats = 2,
+};
+
 int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& mat, Result& result);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+int32_t GetStats(Stats& stats);
 
 }
 
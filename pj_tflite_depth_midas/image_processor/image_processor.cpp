@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "depth_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -42,6 +43,7 @@ limitations under the License.
 
 /*** Global variable ***/
 std::unique_ptr<DepthEngine> s_engine;
+ProcessingStats s_stats;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -94,6 +96,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -109,8 +117,10 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     DepthEngine::Result ss_result;
     if (s_engine->Process(mat, ss_result) != DepthEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
@@ -130,6 +140,40 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = ss_result.time_inference;
     result.time_post_process = ss_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
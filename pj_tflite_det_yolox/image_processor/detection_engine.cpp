@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper_cv.h"
 #include "inference_helper.h"
 #include "detection_engine.h"
+#include "perf_counter.h"
 
 /*** Macro ***/
 #define TAG "DetectionEngine"
@@ -68,6 +69,11 @@ static constexpr int32_t kElementNumOfAnchor = kNumberOfClass + 5;    // x, y, w
 
 #define LABEL_NAME   "label_coco_80.txt"
 
+/* Tensor record / replay */
+#define TENSOR_RECORD_INPUT   true      /* record the input image fed to the interpreter too (large) */
+#define TENSOR_NAME_INPUT     "input"
+#define TENSOR_NAME_META      "meta"    /* crop_x, crop_y, crop_w, crop_h, image_width, image_height */
+
 
 /*** Function ***/
 int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
@@ -93,6 +99,15 @@ int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t n
     output_tensor_info_list_.clear();
     output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
 
+    /* Replay recorded tensors instead of running the model */
+    if (tensor_player_.IsOpened()) {
+        if (ReadLabel(labelFilename, label_list_) != kRetOk) {
+            label_list_.clear();
+            for (int32_t i = 0; i < kNumberOfClass; i++) label_list_.push_back(std::to_string(i));
+        }
+        return kRetOk;
+    }
+
     /* Create and Initialize Inference Helper */
 #if defined(MODEL_TYPE_TFLITE)
     //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
@@ -125,8 +140,26 @@ int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t n
     return kRetOk;
 }
 
+int32_t DetectionEngine::SetTensorRecord(const std::string& filename)
+{
+    return tensor_recorder_.Open(filename) ? kRetOk : kRetErr;
+}
+
+int32_t DetectionEngine::SetTensorReplay(const std::string& filename)
+{
+    return tensor_player_.Open(filename) ? kRetOk : kRetErr;
+}
+
 int32_t DetectionEngine::Finalize()
 {
+    if (tensor_recorder_.IsOpened()) {
+        PRINT("Recorded %d frames\n", tensor_recorder_.GetFrameNum());
+        tensor_recorder_.Close();
+    }
+    if (tensor_player_.IsOpened()) {
+        tensor_player_.Close();
+        return kRetOk;
+    }
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
@@ -173,12 +206,17 @@ void DetectionEngine::GetBoundingBox(const float* data, float scale_x, float  sc
 
 int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
 {
+    if (tensor_player_.IsOpened()) {
+        return ProcessReplay(result);
+    }
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
     /*** PreProcess ***/
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    PerfCounter& perf_counter = PerfCounter::GetThreadInstance();
+    perf_counter.Start();
     InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
     /* do crop, resize and color conversion here because some inference engine doesn't support these operations */
     int32_t crop_x = 0;
@@ -202,22 +240,100 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
     if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+        perf_counter.Stop();
         return kRetErr;
     }
+    const PerfCounter::Values perf_pre_process = perf_counter.Stop();
     const auto& t_pre_process1 = std::chrono::steady_clock::now();
 
     /*** Inference ***/
     const auto& t_inference0 = std::chrono::steady_clock::now();
+    /* the inference engine uses worker threads, so all the threads of the process are counted */
+    PerfCounter& perf_counter_inference = PerfCounter::GetThreadInstance(PerfCounter::kScopeProcess);
+    perf_counter_inference.Start();
     if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+        perf_counter_inference.Stop();
         return kRetErr;
     }
+    const PerfCounter::Values perf_inference = perf_counter_inference.Stop();
     const auto& t_inference1 = std::chrono::steady_clock::now();
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
+    perf_counter.Start();
+    PostProcess(output_tensor_info_list_[0].GetDataAsFloat(), crop_x, crop_y, crop_w, crop_h, result.bbox_list);
+    const PerfCounter::Values perf_post_process = perf_counter.Stop();
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+    /* Record tensors (not included in the processing time) */
+    if (tensor_recorder_.IsOpened()) {
+        const int32_t meta[] = { crop_x, crop_y, crop_w, crop_h, original_mat.cols, original_mat.rows };
+        tensor_recorder_.BeginFrame();
+        tensor_recorder_.AddTensor(TENSOR_NAME_META, TensorRecord::kTypeInt32, { static_cast<int32_t>(sizeof(meta) / sizeof(meta[0])) }, meta);
+        if (TENSOR_RECORD_INPUT) {
+            tensor_recorder_.AddTensor(TENSOR_NAME_INPUT, TensorRecord::kTypeUint8, { 1, img_src.rows, img_src.cols, img_src.channels() }, img_src.data);
+        }
+        tensor_recorder_.AddTensor(OUTPUT_NAME, TensorRecord::kTypeFp32, output_tensor_info_list_[0].tensor_dims, output_tensor_info_list_[0].GetDataAsFloat());
+        tensor_recorder_.EndFrame();
+    }
+
+    /* Return the results */
+    result.crop.x = (std::max)(0, crop_x);
+    result.crop.y = (std::max)(0, crop_y);
+    result.crop.w = (std::min)(crop_w, original_mat.cols - result.crop.x);
+    result.crop.h = (std::min)(crop_h, original_mat.rows - result.crop.y);
+    result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+    result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+    result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
+    result.perf_pre_process = perf_pre_process;
+    result.perf_inference = perf_inference;
+    result.perf_post_process = perf_post_process;
+
+    return kRetOk;
+}
+
+int32_t DetectionEngine::ProcessReplay(Result& result)
+{
+    /* Feed the recorded output tensor to the post-process. pre-process and inference are skipped */
+    if (!tensor_player_.Next()) {
+        return kRetErr;
+    }
+    const int32_t* meta = static_cast<const int32_t*>(tensor_player_.GetTensor(TENSOR_NAME_META));
+    const float* output_data = tensor_player_.GetTensorAsFloat(OUTPUT_NAME);
+    if (!meta || !output_data) {
+        PRINT_E("Recorded tensor is not found\n");
+        return kRetErr;
+    }
+    const int32_t crop_x = meta[0];
+    const int32_t crop_y = meta[1];
+    const int32_t crop_w = meta[2];
+    const int32_t crop_h = meta[3];
+
+    const auto& t_post_process0 = std::chrono::steady_clock::now();
+    PerfCounter& perf_counter = PerfCounter::GetThreadInstance();
+    perf_counter.Start();
+    PostProcess(output_data, crop_x, crop_y, crop_w, crop_h, result.bbox_list);
+    const PerfCounter::Values perf_post_process = perf_counter.Stop();
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+    result.crop.x = (std::max)(0, crop_x);
+    result.crop.y = (std::max)(0, crop_y);
+    result.crop.w = (std::min)(crop_w, meta[4] - result.crop.x);
+    result.crop.h = (std::min)(crop_h, meta[5] - result.crop.y);
+    result.time_pre_process = 0;
+    result.time_inference = 0;
+    result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+    result.perf_post_process = perf_post_process;
+
+    return kRetOk;
+}
+
+void DetectionEngine::PostProcess(const float* output_data, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, std::vector<BoundingBox>& bbox_nms_list)
+{
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+
     /* Get boundig box */
     std::vector<BoundingBox> bbox_list;
-    float* output_data = output_tensor_info_list_[0].GetDataAsFloat();
     for (const auto& grid_scale : kGridScaleList) {
         int32_t grid_w = input_tensor_info.GetWidth() / grid_scale;
         int32_t grid_h = input_tensor_info.GetHeight() / grid_scale;
@@ -236,22 +352,8 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     }
 
     /* NMS */
-    std::vector<BoundingBox> bbox_nms_list;
+    bbox_nms_list.clear();
     BoundingBoxUtils::Nms(bbox_list, bbox_nms_list, threshold_nms_iou_);
-
-    const auto& t_post_process1 = std::chrono::steady_clock::now();
-
-    /* Return the results */
-    result.bbox_list = bbox_nms_list;
-    result.crop.x = (std::max)(0, crop_x);
-    result.crop.y = (std::max)(0, crop_y);
-    result.crop.w = (std::min)(crop_w, original_mat.cols - result.crop.x);
-    result.crop.h = (std::min)(crop_h, original_mat.rows - result.crop.y);
-    result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
-    result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
-    result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
-
-    return kRetOk;
 }
 
 
@@ -29,6 +29,8 @@ limitations under the License.
 /* for My modules */
 #include "inference_helper.h"
 #include "bounding_box.h"
+#include "perf_counter.h"
+#include "tensor_record.h"
 
 
 class DetectionEngine {
@@ -50,6 +52,9 @@ public:
         double                   time_pre_process;		// [msec]
         double                   time_inference;		// [msec]
         double                   time_post_process;	    // [msec]
+        PerfCounter::Values      perf_pre_process;
+        PerfCounter::Values      perf_inference;
+        PerfCounter::Values      perf_post_process;
         Result_() : time_pre_process(0), time_inference(0), time_post_process(0)
         {}
     } Result;
@@ -62,11 +67,15 @@ public:
     }
     ~DetectionEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    int32_t SetTensorRecord(const std::string& filename);   /* call before Initialize */
+    int32_t SetTensorReplay(const std::string& filename);   /* call before Initialize. the interpreter is not created */
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, Result& result);
 
 private:
     int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
+    int32_t ProcessReplay(Result& result);
+    void PostProcess(const float* output_data, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, std::vector<BoundingBox>& bbox_nms_list);
     void GetBoundingBox(const float* data, float scale_x, float  scale_y, int32_t grid_w, int32_t grid_h, std::vector<BoundingBox>& bbox_list);
 
 private:
@@ -74,6 +83,8 @@ private:
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
     std::vector<std::string> label_list_;
+    TensorRecorder tensor_recorder_;
+    TensorPlayer tensor_player_;
 
     float threshold_box_confidence_;
     float threshold_class_confidence_;
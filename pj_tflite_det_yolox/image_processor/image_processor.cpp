@@ -35,6 +35,8 @@ limitations under the License.
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "tracker.h"
+#include "processing_stats.h"
+#include "perf_counter.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -45,6 +47,7 @@ limitations under the License.
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
 Tracker s_tracker;
+ProcessingStats s_stats;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -79,7 +82,13 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
     }
 
     s_engine.reset(new DetectionEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    int32_t ret = DetectionEngine::kRetOk;
+    if (input_param.tensor_mode == kTensorModeRecord) {
+        ret = s_engine->SetTensorRecord(input_param.tensor_file);
+    } else if (input_param.tensor_mode == kTensorModeReplay) {
+        ret = s_engine->SetTensorReplay(input_param.tensor_file);
+    }
+    if (ret != DetectionEngine::kRetOk || s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
@@ -110,6 +119,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -126,8 +141,10 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     DetectionEngine::Result det_result;
     if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
@@ -142,7 +159,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /* Display tracking result  */
+    const auto& t_tracking0 = std::chrono::steady_clock::now();
+    PerfCounter& perf_counter = PerfCounter::GetThreadInstance();
+    perf_counter.Start();
     s_tracker.Update(det_result.bbox_list);
+    const PerfCounter::Values perf_tracking = perf_counter.Stop();
+    const auto& t_tracking1 = std::chrono::steady_clock::now();
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -184,6 +206,53 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = det_result.time_inference;
     result.time_post_process = det_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, det_result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, det_result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, det_result.time_post_process);
+    s_stats.RecordPerf(ProcessingStats::kStagePreProcess, det_result.perf_pre_process);
+    s_stats.RecordPerf(ProcessingStats::kStageInference, det_result.perf_inference);
+    s_stats.RecordPerf(ProcessingStats::kStagePostProcess, det_result.perf_post_process);
+    s_stats.RecordPerf(ProcessingStats::kStageTracking, perf_tracking);
+    s_stats.RecordTime(ProcessingStats::kStageTracking, static_cast<std::chrono::duration<double>>(t_tracking1 - t_tracking0).count() * 1000.0);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.AddCount(ProcessingStats::kCounterDetection, num_det);
+    s_stats.AddCount(ProcessingStats::kCounterTrack, num_track);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        const auto& perf = snapshot.perf_list[i];
+        const double perf_count = static_cast<double>((std::max)(perf.count, static_cast<uint64_t>(1)));
+        dst.cycles = perf.sum[PerfCounter::kEventCycles] / perf_count;
+        dst.instructions = perf.sum[PerfCounter::kEventInstructions] / perf_count;
+        dst.cache_misses = perf.sum[PerfCounter::kEventCacheMisses] / perf_count;
+        dst.branch_misses = perf.sum[PerfCounter::kEventBranchMisses] / perf_count;
+        stats.stage_num++;
+    }
     return 0;
 }
 
@@ -27,13 +27,22 @@ namespace cv {
 };
 
 #define NUM_MAX_RESULT 100
+#define NUM_MAX_STATS_STAGE 8
 
 namespace ImageProcessor
 {
 
+enum {
+    kTensorModeNone = 0,
+    kTensorModeRecord,      /* dump input / output tensors of each frame to tensor_file */
+    kTensorModeReplay,      /* feed the tensors in tensor_file to the post-process instead of running the model */
+};
+
 typedef struct {
     char     work_dir[256];
     int32_t  num_threads;
+    int32_t  tensor_mode;
+    char     tensor_file[256];
 } InputParam;
 
 typedef struct {
@@ -52,10 +61,38 @@ typedef struct {
     double time_post_process;  // [msec]
 } Result;
 
+typedef struct {
+    uint64_t frame_num;
+    uint64_t drop_num;
+    uint64_t detection_num;
+    uint64_t track_num;
+    uint64_t second_stage_num;
+    int32_t  stage_num;
+    struct {
+        char     name[32];
+        uint64_t count;
+        double   mean;   // [msec]
+        double   p50;    // [msec]
+        double   p90;    // [msec]
+        double   p99;    // [msec]
+        double   max;    // [msec]
+        double   cycles;         // average per call (0 = hardware performance counter is not available)
+        double   instructions;
+        double   cache_misses;
+        double   branch_misses;
+    } stage_list[NUM_MAX_STATS_STAGE];
+} Stats;
+
+enum {
+    kCommandPrintStats = 1,
+    kCommandResetStats = 2,
+};
+
 int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& mat, Result& result);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+int32_t GetStats(Stats& stats);
 
 }
 
@@ -26,15 +26,163 @@ limitations under the License.
 /* for My modules */
 #include "image_processor.h"
 #include "common_helper_cv.h"
+#include "replay_source.h"
 
 /*** Macro ***/
 #define WORK_DIR                      RESOURCE_DIR
 #define DEFAULT_INPUT_IMAGE           RESOURCE_DIR"/kite.jpg"
 #define LOOP_NUM_FOR_TIME_MEASUREMENT 10
+#define REPLAY_QUEUE_SIZE             1
+#define REPLAY_JSON_NAME              "replay_report.json"
+#define TENSOR_REPLAY_FRAME_NUM       1000
+#define TENSOR_REPLAY_CANVAS_SIZE     cv::Size(640, 480)
 
 /*** Function ***/
+static int32_t GetReplayPolicy(const std::string& policy_name)
+{
+    if (policy_name == "drop_newest") return ReplaySource::kPolicyDropNewest;
+    if (policy_name == "queue") return ReplaySource::kPolicyQueue;
+    return ReplaySource::kPolicyDropOldest;
+}
+
+/* Per stage latency and hardware counters as a json member ("stages": [...]) */
+static std::string StatsToJson(const ImageProcessor::Stats& stats)
+{
+    std::string json = "\"stages\": [";
+    for (int32_t i = 0; i < stats.stage_num; i++) {
+        const auto& stage = stats.stage_list[i];
+        const double ipc = stage.cycles > 0 ? stage.instructions / stage.cycles : 0;
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+            "%s\n    {\"name\": \"%s\", \"count\": %llu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f, "
+            "\"cycles\": %.0f, \"instructions\": %.0f, \"ipc\": %.3f, \"cache_misses\": %.0f, \"branch_misses\": %.0f}",
+            i > 0 ? "," : "", stage.name, static_cast<unsigned long long>(stage.count), stage.mean, stage.p50, stage.p90, stage.p99, stage.max,
+            stage.cycles, stage.instructions, ipc, stage.cache_misses, stage.branch_misses);
+        json += buffer;
+    }
+    json += "\n  ]";
+    return json;
+}
+
+/* Release frames at the target rate and measure end-to-end latency, deadline misses and drop rate */
+/* usage: main input [fps] [burst_size] [drop_oldest|drop_newest|queue] */
+static int32_t RunReplay(int argc, char* argv[])
+{
+    ReplaySource::Param param;
+    param.fps = std::stod(argv[2]);
+    param.burst_size = (argc > 3) ? std::stoi(argv[3]) : 1;
+    param.policy = (argc > 4) ? GetReplayPolicy(argv[4]) : ReplaySource::kPolicyDropOldest;
+    param.queue_size = REPLAY_QUEUE_SIZE;
+
+    /* the model is loaded before the replay starts (the release clock starts at the first Read) */
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    if (ImageProcessor::Initialize(input_param) != 0) {
+        printf("Initialization Error\n");
+        return -1;
+    }
+    ImageProcessor::Command(ImageProcessor::kCommandResetStats);
+
+    ReplaySource replay_source;
+    if (!replay_source.Open(argv[1], param)) {
+        ImageProcessor::Finalize();
+        return -1;
+    }
+
+    ReplaySource::Frame frame;
+    while (replay_source.Read(frame)) {
+        ImageProcessor::Result result;
+        ImageProcessor::Process(frame.image, result);
+        replay_source.Done(frame);
+    }
+
+    replay_source.PrintReport();
+    ImageProcessor::Stats stats;
+    ImageProcessor::GetStats(stats);
+    replay_source.WriteJson(REPLAY_JSON_NAME, StatsToJson(stats));
+    ImageProcessor::Command(ImageProcessor::kCommandPrintStats);
+    ImageProcessor::Finalize();
+    return 0;
+}
+
+/* Record model input / output tensors of each frame */
+/* usage: main --record tensor_file [input] */
+static int32_t RunTensorRecord(int argc, char* argv[])
+{
+    std::string input_name = (argc > 3) ? argv[3] : DEFAULT_INPUT_IMAGE;
+    cv::VideoCapture cap;
+    if (!CommonHelper::FindSourceImage(input_name, cap)) {
+        return -1;
+    }
+
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4, ImageProcessor::kTensorModeRecord };
+    snprintf(input_param.tensor_file, sizeof(input_param.tensor_file), "%s", argv[2]);
+    if (ImageProcessor::Initialize(input_param) != 0) {
+        printf("Initialization Error\n");
+        return -1;
+    }
+
+    for (int32_t frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
+        cv::Mat image;
+        if (cap.isOpened()) {
+            cap.read(image);
+        } else {
+            image = cv::imread(input_name);
+        }
+        if (image.empty()) break;
+        ImageProcessor::Result result;
+        ImageProcessor::Process(image, result);
+    }
+
+    ImageProcessor::Finalize();
+    return 0;
+}
+
+/* Run post-process and tracking on the recorded tensors without model */
+/* usage: main --replay tensor_file [frame_num] */
+static int32_t RunTensorReplay(int argc, char* argv[])
+{
+    const int32_t frame_num = (argc > 3) ? std::stoi(argv[3]) : TENSOR_REPLAY_FRAME_NUM;
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4, ImageProcessor::kTensorModeReplay };
+    snprintf(input_param.tensor_file, sizeof(input_param.tensor_file), "%s", argv[2]);
+    if (ImageProcessor::Initialize(input_param) != 0) {
+        printf("Initialization Error\n");
+        return -1;
+    }
+    ImageProcessor::Command(ImageProcessor::kCommandResetStats);
+
+    /* the image is only used as a canvas to draw the result. recorded frames are looped */
+    cv::Mat canvas = cv::Mat::zeros(TENSOR_REPLAY_CANVAS_SIZE, CV_8UC3);
+    const auto& t0 = std::chrono::steady_clock::now();
+    int32_t frame_cnt = 0;
+    for (frame_cnt = 0; frame_cnt < frame_num; frame_cnt++) {
+        ImageProcessor::Result result;
+        if (ImageProcessor::Process(canvas, result) != 0) break;
+    }
+    const auto& t1 = std::chrono::steady_clock::now();
+    const double time_total = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    if (frame_cnt > 0) {
+        printf("Replayed %d frames: %.3lf [msec/frame] (%.1lf [fps])\n", frame_cnt, time_total / frame_cnt, frame_cnt * 1000.0 / time_total);
+    }
+    ImageProcessor::Command(ImageProcessor::kCommandPrintStats);
+    ImageProcessor::Finalize();
+    return 0;
+}
+
 int32_t main(int argc, char* argv[])
 {
+    /*** Tensor record / replay mode ***/
+    if (argc > 2 && std::string(argv[1]) == "--record") {
+        return RunTensorRecord(argc, argv);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--replay") {
+        return RunTensorReplay(argc, argv);
+    }
+
+    /*** Real-time replay mode ***/
+    if (argc > 2) {
+        return RunReplay(argc, argv);
+    }
+
     /*** Initialize ***/
     /* variables for processing time measurement */
     double total_time_all = 0;
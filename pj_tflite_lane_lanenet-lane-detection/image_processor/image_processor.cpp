@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "lane_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +41,21 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/* Draw the bird's eye view on the right side of the image (for debug. the output image gets wider) */
+//#define DRAW_BIRD_EYE_VIEW
+#define COLOR_BG  CommonHelper::CreateCvColor(70, 70, 70)
+#ifdef DRAW_BIRD_EYE_VIEW
+#include "bird_eye_view_cv.h"
+#endif
+
 /*** Global variable ***/
 std::unique_ptr<LaneEngine> s_engine;
+ProcessingStats s_stats;
+
+#ifdef DRAW_BIRD_EYE_VIEW
+/* For bird's eye view (the camera is assumed to be a dashcam: BirdEyeViewCv::CameraParam) */
+static BirdEyeViewCv s_bird_eye_view_cv;
+#endif
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -107,6 +121,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -121,8 +141,10 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     LaneEngine::Result lane_result;
     if (s_engine->Process(mat, lane_result) != LaneEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
@@ -135,6 +157,17 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     //cv::add(mat, image_mask, mat);
     cv::add(mat, lane_result.image_instance_seg, mat);
 
+#ifdef DRAW_BIRD_EYE_VIEW
+    /* Draw bird's eye view (lane segmentation on the ground) */
+    if (s_bird_eye_view_cv.Update(mat.cols, mat.rows)) {
+        const auto& bird_eye_view = s_bird_eye_view_cv.GetBirdEyeView();
+        PRINT("Bird's eye view is created (%d x %d). image rows from %d are used\n", bird_eye_view.GetWidth(), bird_eye_view.GetHeight(), bird_eye_view.GetImageRowStart());
+    }
+    cv::Mat mat_bird_eye_view;
+    s_bird_eye_view_cv.CreateImage(mat, mat_bird_eye_view, COLOR_BG);
+    cv::resize(mat_bird_eye_view, mat_bird_eye_view, cv::Size(mat_bird_eye_view.cols * mat.rows / mat_bird_eye_view.rows, mat.rows));
+    cv::hconcat(mat, mat_bird_eye_view, mat);
+#endif
 
     /* Display det num  */
     //CommonHelper::DrawText(mat, "DET: " + std::to_string(0), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
@@ -145,5 +178,39 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = lane_result.time_inference;
     result.time_post_process = lane_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "lane_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +41,22 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/* Draw the bird's eye view on the right side of the image (for debug. the output image gets wider) */
+//#define DRAW_BIRD_EYE_VIEW
+#define COLOR_BG  CommonHelper::CreateCvColor(70, 70, 70)
+#ifdef DRAW_BIRD_EYE_VIEW
+#include "simple_matrix.h"
+#include "bird_eye_view_cv.h"
+#endif
+
 /*** Global variable ***/
 std::unique_ptr<LaneEngine> s_engine;
+ProcessingStats s_stats;
+
+#ifdef DRAW_BIRD_EYE_VIEW
+/* For bird's eye view (the camera is assumed to be a dashcam: BirdEyeViewCv::CameraParam) */
+static BirdEyeViewCv s_bird_eye_view_cv;
+#endif
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -68,6 +83,38 @@ static cv::Scalar GetColorForLine(int32_t id)
     return color_list[id % kMaxNum];
 }
 
+#ifdef DRAW_BIRD_EYE_VIEW
+static bool FitLane(const std::vector<cv::Point3f>& ground_point_list, std::array<float, 3>& coeff, float& z_min, float& z_max)
+{
+    /* x = c0 + c1 * z + c2 * z^2 on the ground (least squares). points out of the view (e.g. above the horizon) are not used */
+    const auto& param = s_bird_eye_view_cv.GetBirdEyeView().GetParam();
+    SimpleMatrix AtA(3, 3);
+    SimpleMatrix Atx(3, 1);
+    int32_t num = 0;
+    z_min = param.z_max;
+    z_max = param.z_min;
+    for (const auto& p : ground_point_list) {
+        if (p.z < param.z_min || p.z > param.z_max) continue;
+        const double a[3] = { 1.0, p.z, p.z * p.z };
+        for (int32_t y = 0; y < 3; y++) {
+            for (int32_t x = 0; x < 3; x++) AtA(y, x) += a[y] * a[x];
+            Atx(y, 0) += a[y] * p.x;
+        }
+        z_min = (std::min)(z_min, p.z);
+        z_max = (std::max)(z_max, p.z);
+        num++;
+    }
+    if (num < 3) return false;
+    try {
+        const SimpleMatrix c = AtA.SolveCholesky(Atx);
+        coeff = { static_cast<float>(c(0, 0)), static_cast<float>(c(1, 0)), static_cast<float>(c(2, 0)) };
+    } catch (const std::out_of_range&) {
+        return false;   /* e.g. all points at the same depth */
+    }
+    return true;
+}
+#endif
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -107,6 +154,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -121,11 +174,23 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     LaneEngine::Result lane_result;
     if (s_engine->Process(mat, lane_result) != LaneEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
+#ifdef DRAW_BIRD_EYE_VIEW
+    /* Bird's eye view of the original image */
+    if (s_bird_eye_view_cv.Update(mat.cols, mat.rows)) {
+        const auto& bird_eye_view = s_bird_eye_view_cv.GetBirdEyeView();
+        PRINT("Bird's eye view is created (%d x %d). image rows from %d are used\n", bird_eye_view.GetWidth(), bird_eye_view.GetHeight(), bird_eye_view.GetImageRowStart());
+    }
+    cv::Mat mat_bird_eye_view;
+    s_bird_eye_view_cv.CreateImage(mat, mat_bird_eye_view, COLOR_BG);
+#endif
+
     /* Display target area  */
     cv::rectangle(mat, cv::Rect(lane_result.crop.x, lane_result.crop.y, lane_result.crop.w, lane_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
 
@@ -137,6 +202,38 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         }
     }
 
+#ifdef DRAW_BIRD_EYE_VIEW
+    /* Draw line on bird's eye view (points only. fitted on the ground in meters) */
+    const auto& bird_eye_view = s_bird_eye_view_cv.GetBirdEyeView();
+    for (int32_t lane_index = 0; lane_index < lane_result.line_list.size(); lane_index++) {
+        const auto& line = lane_result.line_list[lane_index];
+        std::vector<cv::Point2f> image_point_list;
+        for (const auto& p : line) image_point_list.push_back(cv::Point2f(static_cast<float>(p.first), static_cast<float>(p.second)));
+        const int32_t num = static_cast<int32_t>(image_point_list.size());
+        std::vector<cv::Point2f> view_point_list(num);
+        std::vector<cv::Point3f> ground_point_list(num);
+        bird_eye_view.Image2View(reinterpret_cast<const float*>(image_point_list.data()), num, reinterpret_cast<float*>(view_point_list.data()));
+        bird_eye_view.Image2Ground(reinterpret_cast<const float*>(image_point_list.data()), num, reinterpret_cast<float*>(ground_point_list.data()));
+        for (const auto& p : view_point_list) {
+            if (p.x == BirdEyeView::kInvalidView) continue;
+            cv::circle(mat_bird_eye_view, p, 2, GetColorForLine(lane_index), -1);
+        }
+        std::array<float, 3> coeff;
+        float z_min, z_max;
+        if (FitLane(ground_point_list, coeff, z_min, z_max)) {
+            std::vector<cv::Point> curve;
+            for (float z = z_min; z <= z_max; z += 0.5f) {
+                float u, v;
+                bird_eye_view.Ground2View(coeff[0] + coeff[1] * z + coeff[2] * z * z, z, u, v);
+                curve.push_back(cv::Point(static_cast<int32_t>(u), static_cast<int32_t>(v)));
+            }
+            cv::polylines(mat_bird_eye_view, std::vector<std::vector<cv::Point>>{ curve }, false, GetColorForLine(lane_index), 1);
+        }
+    }
+    cv::resize(mat_bird_eye_view, mat_bird_eye_view, cv::Size(mat_bird_eye_view.cols * mat.rows / mat_bird_eye_view.rows, mat.rows));
+    cv::hconcat(mat, mat_bird_eye_view, mat);
+#endif
+
     /* Display det num  */
     //CommonHelper::DrawText(mat, "DET: " + std::to_string(0), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
@@ -146,5 +243,39 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = lane_result.time_inference;
     result.time_post_process = lane_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
@@ -33,9 +33,11 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "camera_model.h"
+#include "seg_overlay.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "tracker.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -47,6 +49,8 @@ limitations under the License.
 std::unique_ptr<DetectionEngine> s_engine;
 Tracker s_tracker;
 CommonHelper::NiceColorGenerator s_nice_color_generator;
+SegOverlay s_seg_overlay;
+ProcessingStats s_stats;
 
 /* For top view transform */
 static CameraModel s_camera_real;
@@ -80,6 +84,11 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    /* Create palette for segmentation. BG (class 0) is transparent */
+    static const uint8_t kPalette[3][3] = { { 0, 0, 0 }, { 0, 255, 0 }, { 0, 0, 255 } };
+    static const uint8_t kAlpha[3] = { 0, 255, 255 };
+    s_seg_overlay.SetPalette(&kPalette[0][0], 3, kAlpha);
     return 0;
 }
 
@@ -106,6 +115,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -180,6 +195,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     /*** Initialize camera parameters for input image size ***/
     static bool s_is_initialize_transform_mat = false;
     if (!s_is_initialize_transform_mat) {
@@ -190,6 +206,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     /*** Call inference ***/
     DetectionEngine::Result det_result;
     if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
@@ -197,20 +214,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
 
     /*** Draw segmentation image for the class of the highest score ***/
-    cv::Mat& mat_seg_max = det_result.mat_seg_max;
-    cv::Mat mat_seg_max_list[] = { mat_seg_max, mat_seg_max, mat_seg_max };
-    cv::merge(mat_seg_max_list, 3, mat_seg_max);
-    cv::Mat mat_lut = cv::Mat::zeros(256, 1, CV_8UC3);
-    mat_lut.at<cv::Vec3b>(0) = cv::Vec3b(0, 0, 0);
-    mat_lut.at<cv::Vec3b>(1) = cv::Vec3b(0, 255, 0);
-    mat_lut.at<cv::Vec3b>(2) = cv::Vec3b(0, 0, 255);
-    cv::LUT(mat_seg_max, mat_lut, mat_seg_max);
-    cv::resize(mat_seg_max, mat_seg_max, mat.size(), 0.0, 0.0, cv::INTER_NEAREST);
-    cv::Mat mat_masked;
-    cv::addWeighted(mat, 0.8, mat_seg_max, 0.5, 0, mat_masked);
-    //cv::add(mat_seg_max * kResultMixRatio, mat * (1.0f - kResultMixRatio), mat_masked);
-    //cv::hconcat(mat, mat_masked, mat);
-    mat = mat_masked;
+    /* (colorize with the palette, resize and blend in one pass) */
+    /* the colorized image at the frame size (BG is black) is also used for the top view */
+    const cv::Mat& mat_seg_max = det_result.mat_seg_max;
+    cv::Mat mat_seg_color = cv::Mat::zeros(mat.size(), CV_8UC3);
+    s_seg_overlay.BlendLabel(mat_seg_max.data, mat_seg_max.cols, mat_seg_max.rows, mat_seg_color.data, mat_seg_color.cols, mat_seg_color.rows, 1.0f, SegOverlay::kInterNearest);
+    s_seg_overlay.BlendLabel(mat_seg_max.data, mat_seg_max.cols, mat_seg_max.rows, mat.data, mat.cols, mat.rows, 0.5f, SegOverlay::kInterNearest);
 
     /*** Draw detection result (black rectangle) ***/
     int32_t num_det = 0;
@@ -220,7 +229,9 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /*** Draw tracking result ***/
+    const auto& t_tracking0 = std::chrono::steady_clock::now();
     s_tracker.Update(det_result.bbox_list);
+    const auto& t_tracking1 = std::chrono::steady_clock::now();
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -243,7 +254,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 
     /*** Draw top view ***/
     cv::Mat mat_topview;
-    CreateTopViewMat(mat_seg_max, mat_topview);
+    CreateTopViewMat(mat_seg_color, mat_topview);
     /* Draw object on top view */
     std::vector<cv::Point2f> normal_points;
     std::vector<cv::Point2f> topview_points;
@@ -253,13 +264,14 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
     if (normal_points.size() > 0) {
         cv::perspectiveTransform(normal_points, topview_points, s_mat_transform_topview);
-        for (int32_t i = 0; i < static_cast<int32_t>(track_list.size()); i++) {
-            auto& track = track_list[i];
+        int32_t i = 0;
+        for (auto& track : track_list) {
             const auto& bbox = track.GetLatestData().bbox;
             cv::Scalar color = bbox.score == 0 ? CommonHelper::CreateCvColor(255, 255, 255) : s_nice_color_generator.Get(track.GetId());
             cv::Point p(static_cast<int32_t>(topview_points[i].x), static_cast<int32_t>(topview_points[i].y));
             cv::circle(mat_topview, p, 10, color, -1);
             cv::circle(mat_topview, p, 10, cv::Scalar(0, 0, 0), 2);
+            i++;
         }
     }
     cv::hconcat(mat, mat_topview, mat);
@@ -286,6 +298,43 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = det_result.time_inference;
     result.time_post_process = det_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTracking, static_cast<std::chrono::duration<double>>(t_tracking1 - t_tracking0).count() * 1000.0);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.AddCount(ProcessingStats::kCounterDetection, num_det);
+    s_stats.AddCount(ProcessingStats::kCounterTrack, num_track);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
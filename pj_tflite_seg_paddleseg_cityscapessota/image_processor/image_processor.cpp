@@ -31,7 +31,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "seg_overlay.h"
 #include "segmentation_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -45,6 +47,8 @@ static constexpr bool  kIsDrawAllResult = true;
 /*** Global variable ***/
 std::unique_ptr<SegmentationEngine> s_engine;
 CommonHelper::NiceColorGenerator s_nice_color_generator(16);
+SegOverlay s_seg_overlay;
+ProcessingStats s_stats;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -72,6 +76,16 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
         s_engine.reset();
         return -1;
     }
+    s_engine->SetOutputAllClass(kIsDrawAllResult);
+
+    /* Create palette for the class of the highest score */
+    cv::Mat mat_seq(256, 1, CV_8UC1);
+    for (int32_t i = 0; i < 256; i++) {
+        mat_seq.at<uint8_t>(i) = cv::saturate_cast<uint8_t>(i * (255 / 19));    // to get nice color
+    }
+    cv::Mat mat_palette;
+    cv::applyColorMap(mat_seq, mat_palette, cv::COLORMAP_JET);
+    s_seg_overlay.SetPalette(mat_palette.ptr<uint8_t>(), mat_palette.rows);
     return 0;
 }
 
@@ -98,6 +112,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -113,44 +133,55 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     cv::resize(mat, mat, cv::Size(640, 640 * mat.rows / mat.cols));
 
     SegmentationEngine::Result segmentation_result;
     if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
     /* Draw segmentation image for all the classes weighted by score */
-    cv::Mat mat_all_class = cv::Mat::zeros(segmentation_result.mat_out_list[0].size(), CV_8UC3);
+    cv::Mat mat_all_class = cv::Mat::zeros(segmentation_result.mat_out_max.size(), CV_8UC3);
     if (kIsDrawAllResult) {
         /* Pile all class */
+        SegClassMap& class_map = *segmentation_result.class_map;
+        std::vector<cv::Mat> mat_out_list(class_map.GetChannel());
+        for (int32_t i = 0; i < class_map.GetChannel(); i++) {
+            /* planes created by the engine in the same pass as argmax (SetOutputAllClass) */
+            mat_out_list[i] = cv::Mat(class_map.GetHeight(), class_map.GetWidth(), CV_32FC1, const_cast<float*>(class_map.GetProbability(i)));
+        }
 #pragma omp parallel for
-        for (int32_t i = 0; i < segmentation_result.mat_out_list.size(); i++) {
-            auto& mat_out = segmentation_result.mat_out_list[i];
+        for (int32_t i = 0; i < mat_out_list.size(); i++) {
+            auto& mat_out = mat_out_list[i];
             cv::cvtColor(mat_out, mat_out, cv::COLOR_GRAY2BGR); /* 1channel -> 3 channel */
             cv::multiply(mat_out, s_nice_color_generator.Get(i), mat_out);
             mat_out.convertTo(mat_out, CV_8UC1);
         }
 
         // don't use parallel
-        for (int32_t i = 0; i < segmentation_result.mat_out_list.size(); i++) {
-            cv::add(mat_all_class, segmentation_result.mat_out_list[i], mat_all_class);
+        for (int32_t i = 0; i < mat_out_list.size(); i++) {
+            cv::add(mat_all_class, mat_out_list[i], mat_all_class);
         }
     }
 
     /* Draw segmentation image for the class of the highest score */
-    cv::Mat& mat_max = segmentation_result.mat_out_max;
-    mat_max *= 255 / 19;    // to get nice color
-    cv::applyColorMap(mat_max, mat_max, cv::COLORMAP_JET);
+    /* (colorize with the palette, resize and blend in one pass) */
+    const cv::Mat& mat_max = segmentation_result.mat_out_max;
+    cv::Mat mat_max_color;
+    if (kIsDrawAllResult) {
+        mat_max_color = cv::Mat::zeros(mat.size(), CV_8UC3);
+        s_seg_overlay.BlendLabel(mat_max.data, mat_max.cols, mat_max.rows, mat_max_color.data, mat_max_color.cols, mat_max_color.rows, 1.0f);
+    }
 
     /* Create result image */
-    cv::resize(mat_max, mat_max, mat.size());
-    cv::Mat mat_masked;
-    cv::add(mat_max * kResultMixRatio, mat * (1.0f - kResultMixRatio), mat_masked);
+    cv::Mat mat_masked = mat.clone();
+    s_seg_overlay.BlendLabel(mat_max.data, mat_max.cols, mat_max.rows, mat_masked.data, mat_masked.cols, mat_masked.rows, kResultMixRatio);
     cv::hconcat(mat, mat_masked, mat);
     if (kIsDrawAllResult) {
-        cv::resize(mat_all_class, mat_all_class, mat_max.size());
-        cv::hconcat(mat_all_class, mat_max, mat_all_class);
+        cv::resize(mat_all_class, mat_all_class, mat_max_color.size());
+        cv::hconcat(mat_all_class, mat_max_color, mat_all_class);
         cv::vconcat(mat, mat_all_class, mat);
     }
     DrawFps(mat, segmentation_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
@@ -160,6 +191,40 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     result.time_inference = segmentation_result.time_inference;
     result.time_post_process = segmentation_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
@@ -155,54 +155,24 @@ int32_t SegmentationEngine::Process(const cv::Mat& original_mat, Result& result)
     /* Retrieve the result */
     const int32_t output_height = input_tensor_info.image_info.height;
     const int32_t output_width = input_tensor_info.image_info.width;
-    const std::vector<float> value_list(output_tensor_info_list_[0].GetDataAsFloat(), output_tensor_info_list_[0].GetDataAsFloat() + output_height * output_width * OUTPUT_CHANNEL);
-    //printf("%f, %f, %f\n", value_list[0], value_list[100], value_list[400]);
+    const float* logit = output_tensor_info_list_[0].GetDataAsFloat();
 
-    /* Scores for all the classes */
-    std::vector<cv::Mat> mat_separated_list(OUTPUT_CHANNEL);
-    for (int32_t c = 0; c < OUTPUT_CHANNEL; c++) {
-        mat_separated_list[c] = cv::Mat::zeros(output_height, output_width, CV_32FC1);
-    }
- #pragma omp parallel for
-    for (int32_t y = 0; y < output_height; y++) {
-        for (int32_t x = 0; x < output_width; x++) {
-#if 1
-            /* Use Score [0.0, 1.0] */
-            size_t offset = (size_t)y * output_width * OUTPUT_CHANNEL + (size_t)x * OUTPUT_CHANNEL;
-            std::vector<float> score_list(OUTPUT_CHANNEL, 0);
-            CommonHelper::SoftMaxFast(value_list.data() + offset, score_list.data(), OUTPUT_CHANNEL);
-            for (int32_t c = 0; c < OUTPUT_CHANNEL; c++) {
-                mat_separated_list[c].at<float>(cv::Point(x, y)) = score_list[c];
-            }
-#else
-            /* Use Logit */
-            size_t offset = (size_t)y * output_width * OUTPUT_CHANNEL + (size_t)x * OUTPUT_CHANNEL;
-            for (int32_t c = 0; c < OUTPUT_CHANNEL; c++) {
-                float val = value_list[offset + c] / 20;    // experimentally determined
-                mat_separated_list[c].at<float>(cv::Point(x, y)) = (std::min)(1.0f, (std::max)(0.0f, val));
-            }
-#endif
-        }
-    }
-
-    /* Argmax */
+    /* Argmax. the output buffer is reused across frames */
     /* ref: https://github.com/PaddlePaddle/PaddleSeg/blob/release/2.3/paddleseg/core/infer.py#L244 */
-    cv::Mat mat_max = cv::Mat::zeros(output_height, output_width, CV_8UC1);
-#pragma omp parallel for
-    for (int32_t y = 0; y < output_height; y++) {
-        for (int32_t x = 0; x < output_width; x++) {
-            const auto& current_iter = value_list.begin() + y * output_width * OUTPUT_CHANNEL + x * OUTPUT_CHANNEL;
-            const auto& max_iter = std::max_element(current_iter, current_iter + OUTPUT_CHANNEL);
-            float max_score = *max_iter;
-            auto max_c = std::distance(current_iter, max_iter);
-            mat_max.at<uint8_t>(cv::Point(x, y)) = static_cast<uint8_t>(max_c);
-        }
+    mat_max_.create(output_height, output_width, CV_8UC1);
+    class_map_.Set(logit, output_height, output_width, OUTPUT_CHANNEL, true);
+    if (is_output_all_class_) {
+        /* Scores for all the classes (softmax) and argmax in one fused pass */
+        class_map_.GetProbabilityAll(mat_max_.ptr<uint8_t>());
+    } else {
+        /* Scores are calculated only for the classes accessed */
+        SegPostProcess::SoftMaxArgMax(logit, output_height * output_width, OUTPUT_CHANNEL, mat_max_.ptr<uint8_t>());
     }
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
-    result.mat_out_list = mat_separated_list;
-    result.mat_out_max = mat_max;
+    result.class_map = &class_map_;
+    result.mat_out_max = mat_max_;
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
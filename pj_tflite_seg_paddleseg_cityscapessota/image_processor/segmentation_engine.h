@@ -28,6 +28,7 @@ limitations under the License.
 
 /* for My modules */
 #include "inference_helper.h"
+#include "seg_post_process.h"
 
 
 class SegmentationEngine {
@@ -38,27 +39,32 @@ public:
     };
 
     typedef struct Result_ {
-        std::vector<cv::Mat> mat_out_list;      // [height, width, 1]. value is 0 - 1.0 (float)
-        cv::Mat           mat_out_max;          // [height, width, 1]. value is 0 - 18  (uint8_t)
+        SegClassMap*      class_map;            // scores of each class (0 - 1.0), computed on access. owned by the engine (the buffers are kept across frames), and valid until the next Process
+        cv::Mat           mat_out_max;          // [height, width, 1]. value is 0 - 18  (uint8_t). shares the buffer of the engine
         double            time_pre_process;		// [msec]
         double            time_inference;		// [msec]
         double            time_post_process;	// [msec]
-        Result_() : time_pre_process(0), time_inference(0), time_post_process(0)
+        Result_() : class_map(nullptr), time_pre_process(0), time_inference(0), time_post_process(0)
         {}
     } Result;
 
 public:
-    SegmentationEngine() {}
+    SegmentationEngine() : is_output_all_class_(false) {}
     ~SegmentationEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    /* true: scores of all the classes are created with argmax in one pass (for consumers of all the classes). false: created on access */
+    void SetOutputAllClass(bool is_output_all_class) { is_output_all_class_ = is_output_all_class; }
 
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+    bool is_output_all_class_;
+    SegClassMap class_map_;
+    cv::Mat mat_max_;       /* [height, width] (uint8_t) */
 };
 
 #endif
@@ -31,7 +31,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "seg_overlay.h"
 #include "segmentation_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -41,6 +43,8 @@ limitations under the License.
 
 /*** Global variable ***/
 static std::unique_ptr<SegmentationEngine> s_engine;
+static SegOverlay s_seg_overlay;
+static ProcessingStats s_stats;
 
 static cv::Scalar s_bg_color;
 static float  s_mask_area_border_x_ratio;
@@ -100,8 +104,17 @@ int32_t ImageProcessor::Command(int32_t cmd)
         return -1;
     }
 
-    //s_mask_area_border_x_ratio = cmd / 100.0f;
-    return 0;
+    switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
+    default:
+        //s_mask_area_border_x_ratio = cmd / 100.0f;
+        return 0;
+    }
 }
 
 static void UpdateMaskArea()
@@ -125,10 +138,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     //cv::resize(mat, mat, cv::Size(640, 640 * mat.rows / mat.cols));
 
     SegmentationEngine::Result segmentation_result;
     if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
@@ -149,19 +164,13 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     UpdateMaskArea();
     cv::rectangle(mat_pha, cv::Rect(static_cast<int32_t>(s_mask_area_border_x_ratio * mat_pha.cols), 0, static_cast<int32_t>((1.0f - s_mask_area_border_x_ratio) * mat_pha.cols), mat_pha.rows), cv::Vec<float, 1>(1.0f), -1);
 
-    /* Extact masked area */
-    cv::Mat mat_composit;
-    cv::resize(mat_pha, mat_pha, mat.size());
-    mat_pha = CommonHelper::CombineMat1to3(mat_pha, mat_pha, mat_pha);  /* 1 channel to 3 channel for masking */
-    mat.convertTo(mat_composit, CV_32FC3);
-    cv::multiply(mat_composit, mat_pha, mat_composit);
-    mat_composit.convertTo(mat_composit, CV_8UC3);
-
-    /* draw background */
-    static const cv::Mat kMatOnes = cv::Mat(mat_pha.size(), CV_32FC3, { 1.0f, 1.0f, 1.0f });
-    cv::multiply(kMatOnes - mat_pha, s_bg_color, mat_pha);
-    mat_pha.convertTo(mat_pha, CV_8UC3);
-    mat_composit = mat_composit + mat_pha;
+    /* Extact masked area and draw background (resize and blend in one pass) */
+    /* the background is blended with the opacity of (1 - alpha), which is made at the model resolution */
+    cv::Mat mat_bg_alpha;
+    mat_pha.convertTo(mat_bg_alpha, CV_8UC1, -255.0, 255.0);
+    const uint8_t bg_color[3] = { static_cast<uint8_t>(s_bg_color[0]), static_cast<uint8_t>(s_bg_color[1]), static_cast<uint8_t>(s_bg_color[2]) };
+    cv::Mat mat_composit = mat.clone();
+    s_seg_overlay.BlendAlpha(mat_bg_alpha.data, mat_bg_alpha.cols, mat_bg_alpha.rows, bg_color, mat_composit.data, mat_composit.cols, mat_composit.rows, 1.0f);
 
     cv::hconcat(mat, mat_composit, mat);
 #endif
@@ -172,6 +181,40 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     result.time_inference = segmentation_result.time_inference;
     result.time_post_process = segmentation_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
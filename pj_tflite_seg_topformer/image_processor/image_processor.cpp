@@ -33,7 +33,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "seg_overlay.h"
 #include "segmentation_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -46,7 +48,9 @@ static constexpr float kResultMixRatio = 0.5f;
 /*** Global variable ***/
 std::unique_ptr<SegmentationEngine> s_engine;
 cv::Mat s_mat_lut;
+SegOverlay s_seg_overlay;
 extern std::vector<std::array<uint8_t, 3>> s_palette;
+ProcessingStats s_stats;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -95,6 +99,7 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
         s_mat_lut.at<cv::Vec3b>(i)[2] = s_palette[i][2];
     }
 #endif
+    s_seg_overlay.SetPalette(s_mat_lut.ptr<uint8_t>(), s_mat_lut.rows);
 
     return 0;
 }
@@ -122,6 +127,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -136,39 +147,62 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     cv::resize(mat, mat, cv::Size(640, 640 * mat.rows / mat.cols));
 
     SegmentationEngine::Result segmentation_result;
     if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
     /* Draw segmentation image for the class of the highest score */
     cv::Mat& mat_seg_max = segmentation_result.mat_out_max;
 
-#if 1
-    cv::Mat mat_seg_max_list[] = { mat_seg_max, mat_seg_max, mat_seg_max };
-    cv::merge(mat_seg_max_list, 3, mat_seg_max);
-    cv::LUT(mat_seg_max, s_mat_lut, mat_seg_max);
-#else
-    mat_seg_max *= 255 / 150;    // to get nice color
-    cv::applyColorMap(mat_seg_max, mat_seg_max, cv::COLORMAP_JET);
-#endif
-
-    /* Create result image */
-    cv::resize(mat_seg_max, mat_seg_max, mat.size());
-    cv::Mat mat_masked;
-    cv::add(mat_seg_max * kResultMixRatio, mat * (1.0f - kResultMixRatio), mat_masked);
-    
-    DrawFps(mat_masked, segmentation_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    /* Create result image (colorize with the LUT, resize and blend in one pass) */
+    s_seg_overlay.BlendLabel(mat_seg_max.data, mat_seg_max.cols, mat_seg_max.rows, mat.data, mat.cols, mat.rows, kResultMixRatio);
 
-    mat = mat_masked;
+    DrawFps(mat, segmentation_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
     /* Return the results */
     result.time_pre_process = segmentation_result.time_pre_process;
     result.time_inference = segmentation_result.time_inference;
     result.time_post_process = segmentation_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
@@ -32,16 +32,22 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "seg_overlay.h"
 #include "semantic_segmentation_engine.h"
+#include "processing_stats.h"
 #include "image_processor.h"
 
 /*** Macro ***/
+static constexpr float kResultMixRatio = 0.5f;
+
 #define TAG "ImageProcessor"
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
 /*** Global variable ***/
 std::unique_ptr<SemanticSegmentationEngine> s_engine;
+SegOverlay s_seg_overlay;
+ProcessingStats s_stats;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -68,6 +74,18 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    /* Create palette */
+    std::vector<uint8_t> palette(SegOverlay::kColorNumMax * 3);
+    for (int32_t i = 0; i < SegOverlay::kColorNumMax; i++) {
+        float color_ratio_b = (i % 2 + 1) / 2.0f;
+        float color_ratio_g = (i % 3 + 1) / 3.0f;
+        float color_ratio_r = (i % 4 + 1) / 4.0f;
+        palette[i * 3 + 0] = static_cast<uint8_t>(255 * color_ratio_b);
+        palette[i * 3 + 1] = static_cast<uint8_t>(255 * color_ratio_g);
+        palette[i * 3 + 2] = static_cast<uint8_t>(255 * (1 - color_ratio_r));
+    }
+    s_seg_overlay.SetPalette(palette.data(), SegOverlay::kColorNumMax);
     return 0;
 }
 
@@ -94,6 +112,12 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -109,14 +133,17 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    const auto& t_process0 = std::chrono::steady_clock::now();
     SemanticSegmentationEngine::Result ss_result;
     if (s_engine->Process(mat, ss_result) != SemanticSegmentationEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
     /* Draw the result */
-    cv::resize(ss_result.image_mask, ss_result.image_mask, mat.size());
-    cv::add(mat, ss_result.image_mask, mat);
+    /* (colorize with the palette, resize and blend in one pass) */
+    const cv::Mat& mat_max = ss_result.mat_out_max;
+    s_seg_overlay.BlendLabel(mat_max.data, mat_max.cols, mat_max.rows, mat.data, mat.cols, mat.rows, kResultMixRatio);
 
     DrawFps(mat, ss_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
@@ -125,6 +152,40 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_inference = ss_result.time_inference;
     result.time_post_process = ss_result.time_post_process;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        stats.stage_num++;
+    }
     return 0;
 }
 
@@ -38,7 +38,7 @@ public:
     };
 
     typedef struct Result_ {
-        cv::Mat             image_mask;
+        cv::Mat             mat_out_max;        /* class id of the highest score (CV_8UC1) */
         double            time_pre_process;		// [msec]
         double            time_inference;		// [msec]
         double            time_post_process;	// [msec]
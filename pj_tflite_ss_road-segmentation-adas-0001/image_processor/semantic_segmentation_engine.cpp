@@ -178,21 +178,17 @@ int32_t SemanticSegmentationEngine::Process(const cv::Mat& original_mat, Result&
     int32_t output_channel = output_tensor_info_list_[0].tensor_dims[3];
     float* output_raw_data = static_cast<float*>(output_tensor_info_list_[0].data);
 
-    std::vector<cv::Mat> image_fp32_list;
-    for (int32_t i = 0; i < output_channel; i++) image_fp32_list.push_back(cv::Mat(output_height, output_width, CV_32FC1));
-
-#pragma omp parallel for num_threads(num_threads_)
-    for (int32_t y = 0; y < output_height; y++) {
-        for (int32_t x = 0; x < output_width; x++) {
-            for (int32_t c = 0; c < output_channel; c++) {
-                image_fp32_list[c].at<float>(cv::Point(x,y)) = output_raw_data[y * (output_width * output_channel) + x * output_channel + c];
-            }
-        }
-    }    
+    /* the class map of each pixel. the output buffer is reused across frames */
+    mat_max_.create(output_height, output_width, CV_8UC1);
+    SegPostProcess::SoftMaxArgMax(output_raw_data, output_height * output_width, output_channel, mat_max_.ptr<uint8_t>());
+
+    /* the output is already probability. maps are created only for the classes accessed */
+    class_map_.Set(output_raw_data, output_height, output_width, output_channel, false);
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
-    result.image_list = image_fp32_list;
+    result.class_map = &class_map_;
+    result.mat_out_max = mat_max_;
     result.crop.x = (std::max)(0, crop_x);
     result.crop.y = (std::max)(0, crop_y);
     result.crop.w = (std::min)(crop_w, original_mat.cols - result.crop.x);
@@ -28,6 +28,7 @@ limitations under the License.
 
 /* for My modules */
 #include "inference_helper.h"
+#include "seg_post_process.h"
 
 
 class SemanticSegmentationEngine {
@@ -38,7 +39,8 @@ public:
     };
 
     typedef struct Result_ {
-        std::vector<cv::Mat> image_list;                // [height, width, 1]. value is 0 - 1.0 (FP32)
+        SegClassMap*      class_map;                    // probability of each class (0 - 1.0), created on access. owned by the engine (the buffers are kept across frames), and valid until the next Process
+        cv::Mat           mat_out_max;                  // [height, width, 1]. class of the highest probability (uint8_t). shares the buffer of the engine
         struct crop_ {
             int32_t x;
             int32_t y;
@@ -49,7 +51,7 @@ public:
         double            time_pre_process;		// [msec]
         double            time_inference;		// [msec]
         double            time_post_process;	// [msec]
-        Result_() : time_pre_process(0), time_inference(0), time_post_process(0)
+        Result_() : class_map(nullptr), time_pre_process(0), time_inference(0), time_post_process(0)
         {}
     } Result;
 
@@ -68,6 +70,8 @@ private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+    cv::Mat mat_max_;
+    SegClassMap class_map_;
 };
 
 #endif
@@ -29,6 +29,7 @@ limitations under the License.
 /* for My modules */
 #include "inference_helper.h"
 #include "bounding_box.h"
+#include "perf_counter.h"
 
 
 class DetectionEngine {
@@ -50,6 +51,9 @@ public:
         double                   time_pre_process;		// [msec]
         double                   time_inference;		// [msec]
         double                   time_post_process;	    // [msec]
+        PerfCounter::Values      perf_pre_process;
+        PerfCounter::Values      perf_inference;
+        PerfCounter::Values      perf_post_process;
         Result_() : time_pre_process(0), time_inference(0), time_post_process(0)
         {}
     } Result;
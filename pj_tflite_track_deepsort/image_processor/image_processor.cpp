@@ -36,6 +36,8 @@ limitations under the License.
 #include "detection_engine.h"
 #include "feature_engine.h"
 #include "tracker_deepsort.h"
+#include "processing_stats.h"
+#include "perf_counter.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -45,6 +47,13 @@ limitations under the License.
 
 #define USE_DEEPSORT
 
+/* How to extract features of the detected objects (see FeatureEngine). kModeBatch and kModePool are opt-in */
+#define FEATURE_ENGINE_MODE     FeatureEngine::kModeSequential
+#define FEATURE_ENGINE_INSTANCE_NUM 2   /* for kModePool */
+
+/* Run all the modes of FeatureEngine on the same bboxes every frame, and print the time of each mode with the stats */
+//#define FEATURE_ENGINE_BENCHMARK
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_det_engine;
 std::unique_ptr<FeatureEngine> s_feature_engine;
@@ -53,16 +62,85 @@ TrackerDeepSort s_tracker(30);
 #else
 TrackerDeepSort s_tracker(2);
 #endif
+ProcessingStats s_stats;
+#ifdef FEATURE_ENGINE_BENCHMARK
+std::array<std::unique_ptr<FeatureEngine>, FeatureEngine::kModeNum> s_feature_engine_benchmark_list;
+std::array<double, FeatureEngine::kModeNum> s_feature_engine_benchmark_time_list;       /* [msec] sum */
+std::array<float, FeatureEngine::kModeNum> s_feature_engine_benchmark_diff_list;        /* max abs diff from the features used for tracking */
+int32_t s_feature_engine_benchmark_frame_num;
+int32_t s_feature_engine_benchmark_bbox_num;
+#endif
 
 /*** Function ***/
-static void DrawFps(cv::Mat& mat, double time_inference_det, double time_inference_feature, int32_t num_feature, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
+#ifdef FEATURE_ENGINE_BENCHMARK
+static void ResetFeatureEngineBenchmark()
+{
+    s_feature_engine_benchmark_time_list.fill(0);
+    s_feature_engine_benchmark_diff_list.fill(0);
+    s_feature_engine_benchmark_frame_num = 0;
+    s_feature_engine_benchmark_bbox_num = 0;
+}
+
+static int32_t InitializeFeatureEngineBenchmark(const ImageProcessor::InputParam& input_param)
+{
+    ResetFeatureEngineBenchmark();
+    for (int32_t mode = 0; mode < FeatureEngine::kModeNum; mode++) {
+        s_feature_engine_benchmark_list[mode].reset(new FeatureEngine());
+        if (s_feature_engine_benchmark_list[mode]->Initialize(input_param.work_dir, input_param.num_threads, mode, FEATURE_ENGINE_INSTANCE_NUM) != FeatureEngine::kRetOk) {
+            s_feature_engine_benchmark_list[mode].reset();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void FinalizeFeatureEngineBenchmark()
+{
+    for (auto& engine : s_feature_engine_benchmark_list) {
+        if (engine) engine->Finalize();
+        engine.reset();
+    }
+}
+
+static void RunFeatureEngineBenchmark(const cv::Mat& mat, const std::vector<BoundingBox>& bbox_list, const std::vector<std::vector<float>>& feature_list_ref)
+{
+    if (bbox_list.empty()) return;
+    for (int32_t mode = 0; mode < FeatureEngine::kModeNum; mode++) {
+        FeatureEngine::ResultList result;
+        if (!s_feature_engine_benchmark_list[mode] || s_feature_engine_benchmark_list[mode]->Process(mat, bbox_list, result) != FeatureEngine::kRetOk) continue;
+        s_feature_engine_benchmark_time_list[mode] += result.time_process;
+        for (size_t i = 0; i < bbox_list.size(); i++) {
+            for (size_t j = 0; j < (std::min)(result.feature_list[i].size(), feature_list_ref[i].size()); j++) {
+                s_feature_engine_benchmark_diff_list[mode] = (std::max)(s_feature_engine_benchmark_diff_list[mode], std::abs(result.feature_list[i][j] - feature_list_ref[i][j]));
+            }
+        }
+    }
+    s_feature_engine_benchmark_frame_num++;
+    s_feature_engine_benchmark_bbox_num += static_cast<int32_t>(bbox_list.size());
+}
+
+static void PrintFeatureEngineBenchmark()
+{
+    if (s_feature_engine_benchmark_frame_num == 0) return;
+    printf("=== FeatureEngine benchmark (%d frames, %.1f bboxes/frame) ===\n", s_feature_engine_benchmark_frame_num, static_cast<double>(s_feature_engine_benchmark_bbox_num) / s_feature_engine_benchmark_frame_num);
+    for (int32_t mode = 0; mode < FeatureEngine::kModeNum; mode++) {
+        if (!s_feature_engine_benchmark_list[mode]) continue;
+        /* the actual mode is shown (kModeBatch falls back to kModePool if the model can't be resized) */
+        printf("%-6s -> %-6s: %9.3lf [msec/frame], max diff = %.6f\n", FeatureEngine::GetModeName(mode), FeatureEngine::GetModeName(s_feature_engine_benchmark_list[mode]->GetMode()),
+            s_feature_engine_benchmark_time_list[mode] / s_feature_engine_benchmark_frame_num, s_feature_engine_benchmark_diff_list[mode]);
+    }
+}
+#endif
+
+
+static void DrawFps(cv::Mat& mat, double time_inference_det, double time_process_feature, int32_t num_feature, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
 {
     char text[128];
     static auto time_previous = std::chrono::steady_clock::now();
     auto time_now = std::chrono::steady_clock::now();
     double fps = 1e9 / (time_now - time_previous).count();
     time_previous = time_now;
-    snprintf(text, sizeof(text), "FPS: %4.1f, Inference: DET: %4.1f[ms], FEATURE:%3d x %4.1f[ms]", fps, time_inference_det, num_feature, time_inference_feature / num_feature);
+    snprintf(text, sizeof(text), "FPS: %4.1f, Inference: DET: %4.1f[ms], FEATURE(%s):%3d, %4.1f[ms]", fps, time_inference_det, FeatureEngine::GetModeName(s_feature_engine->GetMode()), num_feature, time_process_feature);
     CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
@@ -94,11 +172,17 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
     }
 
     s_feature_engine.reset(new FeatureEngine());
-    if (s_feature_engine->Initialize(input_param.work_dir, input_param.num_threads) != FeatureEngine::kRetOk) {
+    if (s_feature_engine->Initialize(input_param.work_dir, input_param.num_threads, FEATURE_ENGINE_MODE, FEATURE_ENGINE_INSTANCE_NUM) != FeatureEngine::kRetOk) {
         s_feature_engine->Finalize();
         s_feature_engine.reset();
         return -1;
     }
+#ifdef FEATURE_ENGINE_BENCHMARK
+    if (InitializeFeatureEngineBenchmark(input_param) != 0) {
+        FinalizeFeatureEngineBenchmark();
+        return -1;
+    }
+#endif
     
     return 0;
 }
@@ -117,6 +201,9 @@ int32_t ImageProcessor::Finalize(void)
     if (s_feature_engine->Finalize() != FeatureEngine::kRetOk) {
         return -1;
     }
+#ifdef FEATURE_ENGINE_BENCHMARK
+    FinalizeFeatureEngineBenchmark();
+#endif
 
     return 0;
 }
@@ -130,6 +217,18 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 
     switch (cmd) {
+    case kCommandPrintStats:
+        s_stats.Print();
+#ifdef FEATURE_ENGINE_BENCHMARK
+        PrintFeatureEngineBenchmark();
+#endif
+        return 0;
+    case kCommandResetStats:
+        s_stats.Reset();
+#ifdef FEATURE_ENGINE_BENCHMARK
+        ResetFeatureEngineBenchmark();
+#endif
+        return 0;
     case 0:
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
@@ -146,34 +245,61 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /* Detection */
+    const auto& t_process0 = std::chrono::steady_clock::now();
     DetectionEngine::Result det_result;
     if (s_det_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
         return -1;
     }
 
+    /* Predict tracks and find detections which are matched by motion only (their feature is not needed) */
+    const auto& t_tracking_predict0 = std::chrono::steady_clock::now();
+    std::vector<uint8_t> is_feature_required_list;
+    s_tracker.Predict(det_result.bbox_list, is_feature_required_list);
+    const auto& t_tracking_predict1 = std::chrono::steady_clock::now();
+
     /* Extract feature for the detected objects */
-    std::vector<std::vector<float>> feature_list;
-    double time_pre_process_feature = 0;   // [msec]
-    double time_inference_feature = 0;    // [msec]
-    double time_post_process_feature = 0;  // [msec]
-    for (const auto& bbox : det_result.bbox_list) {
+    /* all the target bboxes are passed at once, so that FeatureEngine can process them in batch or in parallel */
+    /* FeatureEngine may use worker threads, so all the threads of the process are counted */
+    PerfCounter& perf_counter_second_stage = PerfCounter::GetThreadInstance(PerfCounter::kScopeProcess);
+    perf_counter_second_stage.Start();
+    std::vector<std::vector<float>> feature_list(det_result.bbox_list.size());  /* the length of feature is 0 for non target objects. so it's not used in tracker (DeepSORT) */
+    FeatureEngine::ResultList feature_result;
+    int32_t num_feature_skip = 0;   /* the number of feature calculations saved by Predict (other classes never need feature) */
 #ifdef USE_DEEPSORT
-        if (bbox.class_id == 0) {   /* Calculate face feature for person only */
-            FeatureEngine::Result feature_result;
-            if (s_feature_engine->Process(mat, bbox, feature_result) != DetectionEngine::kRetOk) {
-                return -1;
-            }
-            feature_list.push_back(feature_result.feature);
-            time_pre_process_feature += feature_result.time_pre_process;
-            time_inference_feature += feature_result.time_inference;
-            time_post_process_feature += feature_result.time_post_process;
+    std::vector<BoundingBox> feature_bbox_list;
+    std::vector<int32_t> feature_det_index_list;
+    for (size_t i = 0; i < det_result.bbox_list.size(); i++) {
+        if (det_result.bbox_list[i].class_id != 0) continue;    /* Calculate face feature for person only */
+        if (is_feature_required_list[i]) {
+            feature_bbox_list.push_back(det_result.bbox_list[i]);
+            feature_det_index_list.push_back(static_cast<int32_t>(i));
         } else {
-            feature_list.push_back(std::vector<float>());   /* the length of feature is 0. so it's not used in tracker (DeepSORT) */
+            num_feature_skip++;
         }
-#else
-        feature_list.push_back(std::vector<float>());   /* the length of feature is 0. so it's not used in tracker (DeepSORT) */
-#endif
     }
+    if (s_feature_engine->Process(mat, feature_bbox_list, feature_result) != FeatureEngine::kRetOk) {
+        perf_counter_second_stage.Stop();
+        s_stats.AddCount(ProcessingStats::kCounterDrop);
+        return -1;
+    }
+    for (size_t i = 0; i < feature_det_index_list.size(); i++) {
+        feature_list[feature_det_index_list[i]].swap(feature_result.feature_list[i]);
+    }
+#endif
+    const int32_t num_feature_process = static_cast<int32_t>(feature_result.feature_list.size());
+    const double time_pre_process_feature = feature_result.time_pre_process;
+    const double time_inference_feature = feature_result.time_inference;
+    const double time_post_process_feature = feature_result.time_post_process;
+
+    const PerfCounter::Values perf_second_stage = perf_counter_second_stage.Stop();
+
+#if defined(USE_DEEPSORT) && defined(FEATURE_ENGINE_BENCHMARK)
+    /* not included in the time and the stats of the second stage */
+    std::vector<std::vector<float>> feature_list_ref;
+    for (int32_t index : feature_det_index_list) feature_list_ref.push_back(feature_list[index]);
+    RunFeatureEngineBenchmark(mat, feature_bbox_list, feature_list_ref);
+#endif
 
     /* Display target area  */
     cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
@@ -186,7 +312,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /* Display tracking result  */
+    const auto& t_tracking0 = std::chrono::steady_clock::now();
+    PerfCounter& perf_counter = PerfCounter::GetThreadInstance();
+    perf_counter.Start();
     s_tracker.Update(det_result.bbox_list, feature_list);
+    const PerfCounter::Values perf_tracking = perf_counter.Stop();
+    const auto& t_tracking1 = std::chrono::steady_clock::now();
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -207,13 +338,65 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
     CommonHelper::DrawText(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
 
-    DrawFps(mat, det_result.time_inference, time_inference_feature, static_cast<int32_t>(feature_list.size()), cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    DrawFps(mat, det_result.time_inference, feature_result.time_process, num_feature_process, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
     /* Return the results */
     result.time_pre_process = det_result.time_pre_process + time_pre_process_feature;
     result.time_inference = det_result.time_inference + time_inference_feature;
     result.time_post_process = det_result.time_post_process + time_post_process_feature;
 
+    /* Update runtime stats */
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    s_stats.RecordTime(ProcessingStats::kStagePreProcess, det_result.time_pre_process);
+    s_stats.RecordTime(ProcessingStats::kStageInference, det_result.time_inference);
+    s_stats.RecordTime(ProcessingStats::kStagePostProcess, det_result.time_post_process);
+    s_stats.RecordTime(ProcessingStats::kStageSecondStage, feature_result.time_process);   /* elapsed time (instances may run in parallel) */
+    s_stats.RecordPerf(ProcessingStats::kStagePreProcess, det_result.perf_pre_process);
+    s_stats.RecordPerf(ProcessingStats::kStageInference, det_result.perf_inference);
+    s_stats.RecordPerf(ProcessingStats::kStagePostProcess, det_result.perf_post_process);
+    s_stats.RecordPerf(ProcessingStats::kStageSecondStage, perf_second_stage);
+    s_stats.RecordPerf(ProcessingStats::kStageTracking, perf_tracking);
+    s_stats.RecordTime(ProcessingStats::kStageTracking, static_cast<std::chrono::duration<double>>((t_tracking1 - t_tracking0) + (t_tracking_predict1 - t_tracking_predict0)).count() * 1000.0);
+    s_stats.RecordTime(ProcessingStats::kStageTotal, static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0);
+    s_stats.AddCount(ProcessingStats::kCounterFrame);
+    s_stats.AddCount(ProcessingStats::kCounterDetection, num_det);
+    s_stats.AddCount(ProcessingStats::kCounterTrack, num_track);
+    s_stats.AddCount(ProcessingStats::kCounterSecondStage, num_feature_process);
+    s_stats.AddCount(ProcessingStats::kCounterSecondStageSkip, num_feature_skip);
+    s_stats.Tick();
+
+    return 0;
+}
+
+
+int32_t ImageProcessor::GetStats(ImageProcessor::Stats& stats)
+{
+    const ProcessingStats::Snapshot snapshot = s_stats.GetSnapshot();
+    stats.frame_num = snapshot.counter_list[ProcessingStats::kCounterFrame];
+    stats.drop_num = snapshot.counter_list[ProcessingStats::kCounterDrop];
+    stats.detection_num = snapshot.counter_list[ProcessingStats::kCounterDetection];
+    stats.track_num = snapshot.counter_list[ProcessingStats::kCounterTrack];
+    stats.second_stage_num = snapshot.counter_list[ProcessingStats::kCounterSecondStage];
+    stats.second_stage_skip_num = snapshot.counter_list[ProcessingStats::kCounterSecondStageSkip];
+    stats.stage_num = 0;
+    for (int32_t i = 0; i < ProcessingStats::kStageNum && stats.stage_num < NUM_MAX_STATS_STAGE; i++) {
+        const auto& stage = snapshot.stage_list[i];
+        auto& dst = stats.stage_list[stats.stage_num];
+        snprintf(dst.name, sizeof(dst.name), "%s", ProcessingStats::GetStageName(i));
+        dst.count = stage.count;
+        dst.mean = stage.mean;
+        dst.p50 = stage.p50;
+        dst.p90 = stage.p90;
+        dst.p99 = stage.p99;
+        dst.max = stage.max;
+        const auto& perf = snapshot.perf_list[i];
+        const double perf_count = static_cast<double>((std::max)(perf.count, static_cast<uint64_t>(1)));
+        dst.cycles = perf.sum[PerfCounter::kEventCycles] / perf_count;
+        dst.instructions = perf.sum[PerfCounter::kEventInstructions] / perf_count;
+        dst.cache_misses = perf.sum[PerfCounter::kEventCacheMisses] / perf_count;
+        dst.branch_misses = perf.sum[PerfCounter::kEventBranchMisses] / perf_count;
+        stats.stage_num++;
+    }
     return 0;
 }
 
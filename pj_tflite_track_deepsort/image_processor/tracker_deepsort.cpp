@@ -27,7 +27,111 @@ limitations under the License.
 #include "common_helper.h"
 #include "bounding_box.h"
 #include "tracker_deepsort.h"
-#include "hungarian_algorithm.h"
+
+
+constexpr int32_t FeatureGallery::kAlignmentNum;  // for link error in Android Studio (clang)
+
+bool FeatureGallery::Normalize(const float* src, int32_t feature_size, Element* dst)
+{
+#ifdef FEATURE_GALLERY_INT8
+    std::vector<float> normalized(feature_size);
+    bool is_valid = FeatureSimilarity::NormalizeL2(src, normalized.data(), feature_size);
+    FeatureSimilarity::QuantizeInt8(normalized.data(), dst, feature_size);
+    return is_valid;
+#else
+    return FeatureSimilarity::NormalizeL2(src, dst, feature_size);
+#endif
+}
+
+FeatureGallery::FeatureGallery()
+    : max_num_(0), feature_size_(0), stride_(0), head_(0), num_(0)
+{
+}
+
+FeatureGallery::~FeatureGallery()
+{
+}
+
+void FeatureGallery::Initialize(int32_t max_num)
+{
+    max_num_ = max_num;
+    valid_list_.assign(max_num_, 0);
+    Clear();
+}
+
+void FeatureGallery::Clear()
+{
+    head_ = 0;
+    num_ = 0;
+}
+
+void FeatureGallery::Push(const std::vector<float>& feature)
+{
+    if (max_num_ <= 0) return;
+    head_ = (num_ == 0) ? 0 : (head_ + 1) % max_num_;
+    num_ = (std::min)(num_ + 1, max_num_);
+    Write(head_, feature);
+}
+
+void FeatureGallery::ReplaceNewest(const std::vector<float>& feature)
+{
+    if (num_ == 0) {
+        Push(feature);
+    } else {
+        Write(head_, feature);
+    }
+}
+
+int32_t FeatureGallery::GetInvalidNum() const
+{
+    int32_t invalid_num = 0;
+    for (int32_t i = 0; i < num_; i++) {
+        if (!valid_list_[i]) invalid_num++;
+    }
+    return invalid_num;
+}
+
+bool FeatureGallery::GetMean(std::vector<float>& mean) const
+{
+    mean.assign(feature_size_, 0.0F);
+    int32_t valid_num = 0;
+    for (int32_t slot = 0; slot < num_; slot++) {
+        if (!valid_list_[slot]) continue;
+        const Element* src = &buffer_[static_cast<size_t>(slot) * stride_];
+        for (int32_t i = 0; i < feature_size_; i++) mean[i] += src[i];
+        valid_num++;
+    }
+    if (valid_num == 0) return false;
+#ifdef FEATURE_GALLERY_INT8
+    const float scale = 1.0F / (valid_num * FeatureSimilarity::kInt8Scale);
+#else
+    const float scale = 1.0F / valid_num;
+#endif
+    for (int32_t i = 0; i < feature_size_; i++) mean[i] *= scale;
+    return true;
+}
+
+const FeatureGallery::Element* FeatureGallery::Get(int32_t index) const
+{
+    const int32_t slot = (head_ - index + max_num_) % max_num_;
+    return valid_list_[slot] ? &buffer_[static_cast<size_t>(slot) * stride_] : nullptr;
+}
+
+void FeatureGallery::Write(int32_t slot, const std::vector<float>& feature)
+{
+    const int32_t size = static_cast<int32_t>(feature.size());
+    if (size > 0 && feature_size_ == 0) {
+        /* the buffer is allocated at the first valid feature */
+        feature_size_ = size;
+        stride_ = CalculateStride(size);
+        buffer_.assign(static_cast<size_t>(max_num_) * stride_, 0);
+    }
+    if (size == 0 || size != feature_size_) {
+        valid_list_[slot] = 0;
+        return;
+    }
+    valid_list_[slot] = Normalize(feature.data(), size, &buffer_[static_cast<size_t>(slot) * stride_]) ? 1 : 0;
+}
 
 
 TrackDeepSort::TrackDeepSort(const int32_t id, const BoundingBox& bbox_det, const std::vector<float>& feature)
@@ -35,9 +139,14 @@ TrackDeepSort::TrackDeepSort(const int32_t id, const BoundingBox& bbox_det, cons
     Data data;
     data.bbox = bbox_det;
     data.bbox_raw = bbox_det;
-    data.feature = feature;
     data_history_.push_back(data);
 
+    feature_gallery_.Initialize(kMaxGalleryNum);
+    feature_gallery_.Push(feature);
+    frame_num_ = 0;
+    frame_num_gallery_ = 0;
+    frame_num_feature_ = 0;
+
     kf_ = CreateKalmanFilter_UniformLinearMotion(bbox_det);
 
     cnt_detected_ = 1;
@@ -64,10 +173,8 @@ BoundingBox TrackDeepSort::Predict()
     Data data = GetLatestData();
     data.bbox = bbox;
     data.bbox_raw = bbox;
-    data_history_.push_back(data);
-    if (data_history_.size() > kMaxHistoryNum) {
-        data_history_.pop_front();
-    }
+    data_history_.push_back(data);     /* the oldest one is overwritten */
+    frame_num_++;
 
     return bbox;
 }
@@ -94,16 +201,43 @@ void TrackDeepSort::Update(const BoundingBox& bbox_det)
     cnt_undetected_ = 0;
 }
 
+void TrackDeepSort::UpdateFeature(const std::vector<float>& feature)
+{
+    /* keep the latest feature in the newest slot, and start a new slot every kGalleryInterval frames */
+    if (frame_num_ - frame_num_gallery_ >= kGalleryInterval) {
+        feature_gallery_.Push(feature);
+        frame_num_gallery_ = frame_num_;
+    } else {
+        feature_gallery_.ReplaceNewest(feature);
+    }
+    frame_num_feature_ = frame_num_;
+}
+
 void TrackDeepSort::UpdateNoDetect()
 {
     cnt_undetected_++;
 }
 
-std::deque<TrackDeepSort::Data>& TrackDeepSort::GetDataHistory()
+TrackDeepSort::DataHistory& TrackDeepSort::GetDataHistory()
 {
     return data_history_;
 }
 
+const FeatureGallery& TrackDeepSort::GetFeatureGallery() const
+{
+    return feature_gallery_;
+}
+
+bool TrackDeepSort::HasValidFeature() const
+{
+    return feature_gallery_.GetNum() > 0 && feature_gallery_.GetFeatureSize() > 0 && feature_gallery_.GetInvalidNum() == 0;
+}
+
+int32_t TrackDeepSort::GetFeatureAge() const
+{
+    return frame_num_ - frame_num_feature_;
+}
+
 TrackDeepSort::Data& TrackDeepSort::GetLatestData()
 {
     return data_history_.back();
@@ -130,13 +264,11 @@ const int32_t TrackDeepSort::GetDetectedCount() const
 }
 
 
-static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
-static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
-KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start)
+TrackDeepSort::KalmanFilterBbox TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start)
 {
     /*** X(t) = F * X(t-1) + w(t) ***/
     /* Matrix to calculate X(t) from X(t-1). assume uniform motion: x(t) = x(t-1) + vt, v(t) = v(t-1) */
-    const SimpleMatrix F(kNumStatus, kNumStatus, {
+    const KalmanFilterBbox::MatrixStatus F({
         1, 0, 0, 0, 1, 0, 0,
         0, 1, 0, 0, 0, 1, 0,
         0, 0, 1, 0, 0, 0, 1,
@@ -148,7 +280,7 @@ KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const Boundin
 
 
     /* w(t), = noise, follows Q */
-    const SimpleMatrix Q(kNumStatus, kNumStatus, {
+    const KalmanFilterBbox::MatrixStatus Q({
         1, 0, 0, 0,    0,    0,     0,
         0, 1, 0, 0,    0,    0,     0,
         0, 0, 1, 0,    0,    0,     0,
@@ -160,7 +292,7 @@ KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const Boundin
 
     /*** Z(t) = H * X(t) + v(t) ***/
     /* Matrix to calculate Z(observed value) from X(internal status) */
-    const SimpleMatrix H(kNumObserve, kNumStatus, {
+    const KalmanFilterBbox::MatrixObserveStatus H({
         1, 0, 0, 0, 0, 0, 0,
         0, 1, 0, 0, 0, 0, 0,
         0, 0, 1, 0, 0, 0, 0,
@@ -168,7 +300,7 @@ KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const Boundin
         });
 
     /* v(t), = noise, follows R */
-    const SimpleMatrix R(kNumObserve, kNumObserve, {
+    const KalmanFilterBbox::MatrixObserve R({
         1, 0,  0,  0,
         0, 1,  0,  0,
         0, 0, 10,  0,
@@ -176,12 +308,12 @@ KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const Boundin
         });
 
     /* First internal status */
-    SimpleMatrix P0 = SimpleMatrix::IdentityMatrix(kNumStatus);
-    P0 = P0 * 10;   /* Set big noise at first to make K=1 and trust observed value rather than estimated value */
+    KalmanFilterBbox::MatrixStatus P0 = KalmanFilterBbox::MatrixStatus::IdentityMatrix();
+    P0 = P0 * 10.0F;   /* Set big noise at first to make K=1 and trust observed value rather than estimated value */
 
-    const SimpleMatrix X0 = Bbox2KalmanStatus(bbox_start);
+    const KalmanFilterBbox::VectorStatus X0 = Bbox2KalmanStatus(bbox_start);
 
-    KalmanFilter kf;
+    KalmanFilterBbox kf;
     kf.Initialize(
         F,
         Q,
@@ -194,13 +326,13 @@ KalmanFilter TrackDeepSort::CreateKalmanFilter_UniformLinearMotion(const Boundin
     return kf;
 }
 
-SimpleMatrix TrackDeepSort::Bbox2KalmanStatus(const BoundingBox& bbox)
+TrackDeepSort::KalmanFilterBbox::VectorStatus TrackDeepSort::Bbox2KalmanStatus(const BoundingBox& bbox)
 {
-    SimpleMatrix X(kNumStatus, 1, {
-        static_cast<double>(bbox.x + bbox.w / 2),
-        static_cast<double>(bbox.y + bbox.h / 2),
-        static_cast<double>(bbox.w * bbox.h),
-        static_cast<double>(bbox.w) / bbox.h,
+    KalmanFilterBbox::VectorStatus X({
+        static_cast<float>(bbox.x + bbox.w / 2),
+        static_cast<float>(bbox.y + bbox.h / 2),
+        static_cast<float>(bbox.w * bbox.h),
+        static_cast<float>(bbox.w) / bbox.h,
         0,
         0,
         0
@@ -208,18 +340,18 @@ SimpleMatrix TrackDeepSort::Bbox2KalmanStatus(const BoundingBox& bbox)
     return X;
 }
 
-SimpleMatrix TrackDeepSort::Bbox2KalmanObserved(const BoundingBox& bbox)
+TrackDeepSort::KalmanFilterBbox::VectorObserve TrackDeepSort::Bbox2KalmanObserved(const BoundingBox& bbox)
 {
-    SimpleMatrix Z(kNumObserve, 1, {
-        static_cast<double>(bbox.x + bbox.w / 2),
-        static_cast<double>(bbox.y + bbox.h / 2),
-        static_cast<double>(bbox.w * bbox.h),
-        static_cast<double>(bbox.w) / bbox.h,
+    KalmanFilterBbox::VectorObserve Z({
+        static_cast<float>(bbox.x + bbox.w / 2),
+        static_cast<float>(bbox.y + bbox.h / 2),
+        static_cast<float>(bbox.w * bbox.h),
+        static_cast<float>(bbox.w) / bbox.h,
         });
     return Z;
 }
 
-BoundingBox TrackDeepSort::KalmanStatus2Bbox(const SimpleMatrix& X)
+BoundingBox TrackDeepSort::KalmanStatus2Bbox(const KalmanFilterBbox::VectorStatus& X)
 {
     BoundingBox bbox;
     bbox.w = static_cast<int32_t>(std::sqrt(X(2, 0) * X(3, 0)));
@@ -232,10 +364,22 @@ BoundingBox TrackDeepSort::KalmanStatus2Bbox(const SimpleMatrix& X)
 
 
 constexpr float TrackerDeepSort::kCostMax;  // for link error in Android Studio (clang)
+constexpr float TrackerDeepSort::kIouUnambiguous;  // for link error in Android Studio (clang)
+constexpr int32_t TrackerDeepSort::kFeatureRefreshInterval;  // for link error in Android Studio (clang)
+constexpr int32_t TrackerDeepSort::kArchiveDetectedNumMin;  // for link error in Android Studio (clang)
+constexpr float TrackerDeepSort::kArchiveSimilarityMin;  // for link error in Android Studio (clang)
+constexpr int32_t TrackerDeepSort::kArchiveCapacity;  // for link error in Android Studio (clang)
+constexpr int32_t TrackerDeepSort::kArchiveTtl;  // for link error in Android Studio (clang)
 TrackerDeepSort::TrackerDeepSort(int32_t threshold_frame_to_delete)
 {
     track_sequence_num_ = 0;
     threshold_frame_to_delete_ = threshold_frame_to_delete;
+    is_predicted_ = false;
+    feature_skip_num_ = 0;
+    det_feature_size_ = 0;
+    det_feature_stride_ = 0;
+    frame_count_ = 0;
+    reidentified_num_ = 0;
 }
 
 TrackerDeepSort::~TrackerDeepSort()
@@ -246,31 +390,32 @@ void TrackerDeepSort::Reset()
 {
     track_list_.clear();
     track_sequence_num_ = 0;
+    is_predicted_ = false;
+    feature_skip_num_ = 0;
+    archive_.Clear();
+    frame_count_ = 0;
+    reidentified_num_ = 0;
 }
 
 
-std::vector<TrackDeepSort>& TrackerDeepSort::GetTrackList()
+TrackerDeepSort::TrackList& TrackerDeepSort::GetTrackList()
 {
     return track_list_;
 }
 
-static float CosineSimilarity(const std::vector<float>& feature0, const std::vector<float>& feature1)
+int32_t TrackerDeepSort::GetFeatureSkipNum() const
 {
-    if (feature0.size() == 0 || feature1.size() == 0 || feature0.size() != feature1.size()) {
-        return 999; /* invalid */
-    }
-    float norm_0 = 0;
-    float norm_1 = 0;
-    float dot = 0;
-    for (size_t i = 0; i < feature0.size(); i++) {
-        norm_0 += feature0[i] * feature0[i];
-        norm_1 += feature1[i] * feature1[i];
-        dot += feature0[i] * feature1[i];
-    }
-    
-    if (norm_0 == 0 || norm_1 == 0) return 999; /* invalid */
+    return feature_skip_num_;
+}
 
-    return (std::max)(0.0f, dot / (std::sqrt(norm_0) * std::sqrt(norm_1)));
+int32_t TrackerDeepSort::GetArchiveNum() const
+{
+    return static_cast<int32_t>(archive_.size());
+}
+
+int32_t TrackerDeepSort::GetReidentifiedNum() const
+{
+    return reidentified_num_;
 }
 
 //static float EuclidDistance(const std::array<float, 512>& feature0, const std::array<float, 512>& feature1)
@@ -292,48 +437,101 @@ static inline float AdjustFeatureSimilarity(float value)
     return (std::max)(0.0f, value);
 }
 
-float TrackerDeepSort::CalculateCost(TrackDeepSort& track, const BoundingBox& det_bbox, const std::vector<float>& det_feature)
+void TrackerDeepSort::NormalizeDetFeature(const std::vector<std::vector<float>>& feature_list)
 {
-    const auto& track_bbox = track.GetLatestBoundingBox();
+    /* features of dets are normalized once per frame, and used for all the tracks */
+    const int32_t det_num = static_cast<int32_t>(feature_list.size());
+    det_feature_size_ = 0;
+    for (const auto& feature : feature_list) {
+        if (!feature.empty()) {
+            det_feature_size_ = static_cast<int32_t>(feature.size());
+            break;
+        }
+    }
+    det_feature_stride_ = FeatureGallery::CalculateStride(det_feature_size_);
+    det_feature_buffer_.resize(static_cast<size_t>(det_num) * det_feature_stride_);
+    det_feature_valid_list_.assign(det_num, 0);
+    for (int32_t i = 0; i < det_num; i++) {
+        if (det_feature_size_ == 0 || static_cast<int32_t>(feature_list[i].size()) != det_feature_size_) continue;
+        det_feature_valid_list_[i] = FeatureGallery::Normalize(feature_list[i].data(), det_feature_size_, &det_feature_buffer_[static_cast<size_t>(i) * det_feature_stride_]) ? 1 : 0;
+    }
+}
 
+void TrackerDeepSort::CalculateFeatureSimilarity(const TrackDeepSort& track, const std::vector<int32_t>& det_index_list, std::vector<float>& similarity_list)
+{
+    similarity_list.assign(det_index_list.size(), -1.0F);
+
+    /* do not use appearance feature if it's invalid (objects whose feature is not calculated) */
+    const auto& gallery = track.GetFeatureGallery();
+    const int32_t gallery_num = gallery.GetNum();
+    if (gallery_num == 0 || gallery.GetFeatureSize() != det_feature_size_ || gallery.GetInvalidNum() > 0) return;
+
+    /* pack the features of the candidate dets, then calculate (gallery) x (dets)^T at once */
+    det_pack_index_list_.clear();
+    det_feature_pack_.resize(det_index_list.size() * det_feature_stride_);
+    for (int32_t i = 0; i < static_cast<int32_t>(det_index_list.size()); i++) {
+        const int32_t i_det = det_index_list[i];
+        if (!det_feature_valid_list_[i_det]) continue;
+        const auto* src = &det_feature_buffer_[static_cast<size_t>(i_det) * det_feature_stride_];
+        std::copy(src, src + det_feature_size_, &det_feature_pack_[det_pack_index_list_.size() * det_feature_stride_]);
+        det_pack_index_list_.push_back(i);
+    }
+    const int32_t pack_num = static_cast<int32_t>(det_pack_index_list_.size());
+    if (pack_num == 0) return;
+    similarity_matrix_.resize(static_cast<size_t>(gallery_num) * pack_num);
+    FeatureSimilarity::MultiplyTransposed(gallery.GetData(), gallery_num, gallery.GetStride(), det_feature_pack_.data(), pack_num, det_feature_stride_, det_feature_size_, similarity_matrix_.data(), pack_num);
+
+    /* take average similarity. 0.0(different) - 1.0(same) */
+    for (int32_t j = 0; j < pack_num; j++) {
+        float sum = 0;
+        for (int32_t k = 0; k < gallery_num; k++) {
+            sum += (std::max)(0.0f, similarity_matrix_[static_cast<size_t>(k) * pack_num + j]);
+        }
+        similarity_list[det_pack_index_list_[j]] = sum / gallery_num;
+    }
+}
+
+bool TrackerDeepSort::CheckGate(const BoundingBox& track_bbox, const BoundingBox& det_bbox, float& iou)
+{
     /***  Shouldn't match far object ***/
     const double distance_image_pow2 = std::pow(track_bbox.x - det_bbox.x, 2) + std::pow(track_bbox.y - det_bbox.y, 2);
     const double threshold_distance = std::pow((track_bbox.w + track_bbox.h + det_bbox.w + det_bbox.h) / 4, 2) * 4; /* experimentally determined */
     if (distance_image_pow2 > threshold_distance) {
-        return kCostMax;
+        return false;
     }
 
     /*** Calculate IOU ***/
-    constexpr float weight_iou = 1.0f;
-    float iou = BoundingBoxUtils::CalculateIoU(track_bbox, det_bbox);
+    iou = BoundingBoxUtils::CalculateIoU(track_bbox, det_bbox);
 
     /*** check class id ***/
     /* those two objects are difference if those of class id are difference */
     /* however, if iou is big enough, they can be the same (detector may output wrong class id) */
     if ((iou < 0.8) && (track_bbox.class_id != det_bbox.class_id)) {
+        return false;
+    }
+    return true;
+}
+
+float TrackerDeepSort::CalculateCost(TrackDeepSort& track, const BoundingBox& det_bbox, float similarity_feature)
+{
+    const auto& track_bbox = track.GetLatestBoundingBox();
+
+    /*** Check distance and class id, and calculate IOU ***/
+    constexpr float weight_iou = 1.0f;
+    float iou = 0;
+    if (!CheckGate(track_bbox, det_bbox, iou)) {
         return kCostMax;
     }
 
     /*** Calculate cosine similarity of feature (DEEP) ***/
     float weight_feature = 1.0f;
-    float similarity_feature = 0;
-
     /* compare "the feature of the det object at the current frame" with "the features in the past frames of the tracked object"  */
     /* just comparaing with the previous frame may not be enough. so I compare with those in the past few frames. but no need to compare every frame. maybe once every 5 frames */
-    std::vector<float> similarity_history;
-    for (int32_t i = static_cast<int32_t>(track.GetDataHistory().size()) - 2; i >= 0; i -= 5) {
-        const auto& data = track.GetDataHistory()[i];
-        if (data.bbox_raw.score == 0) continue; /* do not compare if the object was not detected */
-        float val = CosineSimilarity(data.feature, det_feature);    /* 0.0(different) - 1.0(same) */
-        if (val == 999) {
-            weight_feature = 0.0f;  /* do not use appearance feature if it's invalid (objects whose feature is not calculated) */
-            break;
-        }
-        similarity_history.push_back(val);
-        if (similarity_history.size() > 10) break;  /* use the feature up to past 50 (5 * 10) frame */
-    }
-    if (similarity_history.size() > 0) {
-        similarity_feature = std::accumulate(similarity_history.begin(), similarity_history.end(), 0.0f) / similarity_history.size();   /* take average similarity */
+    /* the gallery keeps the latest feature and features sampled every kGalleryInterval frames (up to past 50 (5 * 10) frame) */
+    /* the average similarity is calculated in advance for all the candidates (see CalculateFeatureSimilarity) */
+    if (similarity_feature < 0) {
+        weight_feature = 0.0f;  /* do not use appearance feature if it's invalid (objects whose feature is not calculated) */
+        similarity_feature = 0;
     }
 
     similarity_feature = AdjustFeatureSimilarity(similarity_feature);
@@ -344,40 +542,125 @@ float TrackerDeepSort::CalculateCost(TrackDeepSort& track, const BoundingBox& de
     return kCostMax - similarity;
 }
 
+void TrackerDeepSort::ArchiveTrack(TrackDeepSort& track)
+{
+    if (track.GetDetectedCount() < kArchiveDetectedNumMin) return;
+    if (!track.GetFeatureGallery().GetMean(archive_feature_)) return;
+
+    /* the index is created at the first archived track because feature size is unknown until then */
+    const int32_t feature_size = static_cast<int32_t>(archive_feature_.size());
+    if (!archive_.IsInitialized() || archive_.GetParam().feature_size != feature_size) {
+        FeatureIndex::Param param;
+        param.feature_size = feature_size;
+        param.capacity = kArchiveCapacity;
+        param.ttl = kArchiveTtl;
+        archive_.Initialize(param);
+    }
+    archive_.Insert(track.GetId(), archive_feature_.data(), frame_count_, track.GetLatestBoundingBox().class_id);
+}
+
+int32_t TrackerDeepSort::TakeArchivedId(const std::vector<float>& feature, int32_t class_id)
+{
+    if (archive_.size() == 0 || static_cast<int32_t>(feature.size()) != archive_.GetParam().feature_size) return -1;
+    archive_.Search(feature.data(), 1, archive_neighbor_list_, class_id);   /* only archived tracks of the same class */
+    if (archive_neighbor_list_.empty() || archive_neighbor_list_[0].similarity < kArchiveSimilarityMin) return -1;
+    const int32_t id = archive_neighbor_list_[0].id;
+    archive_.Erase(id);
+    return id;
+}
 
-void TrackerDeepSort::Update(const std::vector<BoundingBox>& det_list, const std::vector<std::vector<float>>& feature_list)
+void TrackerDeepSort::Predict(const std::vector<BoundingBox>& det_list, std::vector<uint8_t>& is_feature_required_list)
 {
     /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
     for (auto& track : track_list_) {
         track.Predict();
     }
-
-    /*** Association ***/
-    /* Calculate IoU b/w predicted position and detected position */
-    size_t size_cost_matrix = (std::max)(track_list_.size(), det_list.size());  /* workaround: my hungarian algorithm sometimes outputs wrong result when the input matrix is not squared */
-    std::vector<std::vector<float>> cost_matrix(size_cost_matrix, std::vector<float>(size_cost_matrix, kCostMax));
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
-        for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
-            cost_matrix[i_track][i_det] = CalculateCost(track_list_[i_track], det_list[i_det], feature_list[i_det]);
+    is_predicted_ = true;
+
+    /*** Find pairs of track and det which are matched by motion only ***/
+    /* a pair is unambiguous when the track and the det have no other candidate (the same gate as CalculateCost) and IoU is big enough */
+    /* such a pair is assigned anyway, so feature of the det is not needed unless the gallery of the track needs refresh */
+    const int32_t slot_num = track_list_.GetCapacity();
+    const int32_t det_num = static_cast<int32_t>(det_list.size());
+    is_feature_required_list.assign(det_num, 1);
+    det_candidate_num_list_.assign(det_num, 0);
+    std::vector<int32_t> det_index_for_track(slot_num, -1);
+    std::vector<float> iou_for_track(slot_num, 0.0f);
+    det_grid_.Build(det_list);
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (!track_list_.IsAlive(i_track)) continue;
+        const auto& track_bbox = track_list_[i_track].GetLatestBoundingBox();
+        const int32_t distance_max = (track_bbox.w + track_bbox.h + det_grid_.GetMaxWidth() + det_grid_.GetMaxHeight()) / 2 + 1;
+        candidate_list_.clear();
+        det_grid_.Query(track_bbox.x - distance_max, track_bbox.y - distance_max, track_bbox.x + distance_max, track_bbox.y + distance_max, candidate_list_);
+        int32_t candidate_num = 0;
+        for (int32_t i_det : candidate_list_) {
+            float iou = 0;
+            if (!CheckGate(track_bbox, det_list[i_det], iou)) continue;
+            det_candidate_num_list_[i_det]++;
+            det_index_for_track[i_track] = i_det;
+            iou_for_track[i_track] = iou;
+            candidate_num++;
         }
+        if (candidate_num != 1) det_index_for_track[i_track] = -1;
     }
 
-    /* Assign track and det */
-    std::vector<int32_t> det_index_for_track(size_cost_matrix, -1);
-    std::vector<int32_t> track_index_for_det(size_cost_matrix, -1);
-    if (track_list_.size() > 0 && det_list.size() > 0) {
-        HungarianAlgorithm<float> solver(cost_matrix);
-        solver.Solve(det_index_for_track, track_index_for_det);
+    feature_skip_num_ = 0;
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        const int32_t i_det = det_index_for_track[i_track];
+        if (i_det < 0 || det_candidate_num_list_[i_det] != 1 || iou_for_track[i_track] <= kIouUnambiguous) continue;
+        const auto& track = track_list_[i_track];
+        if (track.GetUndetectedCount() > 0 || !track.HasValidFeature() || track.GetFeatureAge() >= kFeatureRefreshInterval) continue;
+        is_feature_required_list[i_det] = 0;
+        feature_skip_num_++;
     }
+    det_feature_skip_list_.resize(det_num);
+    for (int32_t i = 0; i < det_num; i++) det_feature_skip_list_[i] = is_feature_required_list[i] ? 0 : 1;
+}
 
-#if 0
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
-        for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
-            printf("%.3f  ", cost_matrix[i_track][i_det]);
+void TrackerDeepSort::Update(const std::vector<BoundingBox>& det_list, const std::vector<std::vector<float>>& feature_list)
+{
+    /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
+    if (!is_predicted_) {
+        for (auto& track : track_list_) {
+            track.Predict();
         }
-        printf("\n");
+        det_feature_skip_list_.clear();
+        feature_skip_num_ = 0;
     }
+    is_predicted_ = false;
+    if (det_feature_skip_list_.size() != det_list.size()) det_feature_skip_list_.clear();  /* det_list must be the same as Predict() */
 
+    /*** Association ***/
+    /* Calculate IoU b/w predicted position and detected position */
+    /* only for pairs which are not too far (see CalculateCost). dets are searched by their top-left point using the spatial grid */
+    /* rows of the assignment are slot indices (free slots have no edge) */
+    const int32_t slot_num = track_list_.GetCapacity();
+    const int32_t det_num = static_cast<int32_t>(det_list.size());
+    NormalizeDetFeature(feature_list);
+    det_grid_.Build(det_list);
+    assignment_.Reset(slot_num, det_num);
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (!track_list_.IsAlive(i_track)) continue;
+        const auto& track_bbox = track_list_[i_track].GetLatestBoundingBox();
+        const int32_t distance_max = (track_bbox.w + track_bbox.h + det_grid_.GetMaxWidth() + det_grid_.GetMaxHeight()) / 2 + 1;
+        candidate_list_.clear();
+        det_grid_.Query(track_bbox.x - distance_max, track_bbox.y - distance_max, track_bbox.x + distance_max, track_bbox.y + distance_max, candidate_list_);
+        CalculateFeatureSimilarity(track_list_[i_track], candidate_list_, similarity_list_);
+        for (size_t i = 0; i < candidate_list_.size(); i++) {
+            const int32_t i_det = candidate_list_[i];
+            float cost = CalculateCost(track_list_[i_track], det_list[i_det], similarity_list_[i]);
+            if (cost < kCostMax) assignment_.AddEdge(i_track, i_det, cost);
+        }
+    }
+
+    /* Assign track and det. each connected component of the graph is solved independently */
+    std::vector<int32_t> det_index_for_track;
+    std::vector<int32_t> track_index_for_det;
+    assignment_.Solve(kCostMax, det_index_for_track, track_index_for_det);
+
+#if 0
+    printf("edge = %d, component = %d, max component size = %d\n", assignment_.GetEdgeNum(), assignment_.GetComponentNum(), assignment_.GetMaxComponentSize());
     printf("track:  det\n");
     for (size_t i = 0; i < det_index_for_track.size(); i++) {
         printf("%3d:  %3d\n", i, det_index_for_track[i]);
@@ -389,12 +672,15 @@ void TrackerDeepSort::Update(const std::vector<BoundingBox>& det_list, const std
 #endif
 
     /*** Update track ***/
-    std::vector<bool> is_det_assigned_list(size_cost_matrix, false);
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
+    std::vector<bool> is_det_assigned_list(det_num, false);
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (!track_list_.IsAlive(i_track)) continue;
         int32_t assigned_det_index = det_index_for_track[i_track];
-        if (assigned_det_index >= 0 && assigned_det_index < static_cast<int32_t>(det_list.size()) && cost_matrix[i_track][assigned_det_index] < kCostMax) {
+        if (assigned_det_index >= 0) {
             track_list_[i_track].Update(det_list[assigned_det_index]);
-            track_list_[i_track].GetLatestData().feature = feature_list[assigned_det_index];
+            if (det_feature_skip_list_.empty() || !det_feature_skip_list_[assigned_det_index]) {
+                track_list_[i_track].UpdateFeature(feature_list[assigned_det_index]);   /* keep the gallery if feature is skipped */
+            }
             is_det_assigned_list[assigned_det_index] = true;
         } else{
             track_list_[i_track].UpdateNoDetect();
@@ -402,20 +688,30 @@ void TrackerDeepSort::Update(const std::vector<BoundingBox>& det_list, const std
     }
 
     /*** Delete tracks ***/
-    for (auto it = track_list_.begin(); it != track_list_.end();) {
-        if (it->GetUndetectedCount() >= threshold_frame_to_delete_) {
-            it = track_list_.erase(it);
-        } else {
-            it++;
+    /* their appearance is kept in the archive to re-identify them when they appear again */
+    for (int32_t i_track = 0; i_track < slot_num; i_track++) {
+        if (track_list_.IsAlive(i_track) && track_list_[i_track].GetUndetectedCount() >= threshold_frame_to_delete_) {
+            ArchiveTrack(track_list_[i_track]);
+            track_list_.Erase(i_track);
         }
     }
+    archive_.RemoveExpired(frame_count_);
 
     /*** Add new tracks ***/
-    for (size_t i = 0; i < det_list.size(); i++) {
+    /* take over the id of the archived track if the appearance is the same */
+    reidentified_num_ = 0;
+    for (int32_t i = 0; i < det_num; i++) {
         if (is_det_assigned_list[i] == false) {
-            track_list_.push_back(TrackDeepSort(track_sequence_num_, det_list[i], feature_list[i]));
-            track_sequence_num_++;
+            int32_t id = TakeArchivedId(feature_list[i], det_list[i].class_id);
+            if (id >= 0) {
+                reidentified_num_++;
+            } else {
+                id = track_sequence_num_;
+                track_sequence_num_++;
+            }
+            track_list_.Insert(TrackDeepSort(id, det_list[i], feature_list[i]));
         }
     }
+    frame_count_++;
 }
 
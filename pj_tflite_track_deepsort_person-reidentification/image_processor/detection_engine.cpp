@@ -33,6 +33,7 @@ limitations under the License.
 #include "common_helper_cv.h"
 #include "inference_helper.h"
 #include "detection_engine.h"
+#include "perf_counter.h"
 
 /*** Macro ***/
 #define TAG "DetectionEngine"
@@ -179,6 +180,8 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     }
     /*** PreProcess ***/
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    PerfCounter& perf_counter = PerfCounter::GetThreadInstance();
+    perf_counter.Start();
     InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
     /* do crop, resize and color conversion here because some inference engine doesn't support these operations */
     int32_t crop_x = 0;
@@ -202,19 +205,27 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
     if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+        perf_counter.Stop();
         return kRetErr;
     }
+    const PerfCounter::Values perf_pre_process = perf_counter.Stop();
     const auto& t_pre_process1 = std::chrono::steady_clock::now();
 
     /*** Inference ***/
     const auto& t_inference0 = std::chrono::steady_clock::now();
+    /* the inference engine uses worker threads, so all the threads of the process are counted */
+    PerfCounter& perf_counter_inference = PerfCounter::GetThreadInstance(PerfCounter::kScopeProcess);
+    perf_counter_inference.Start();
     if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+        perf_counter_inference.Stop();
         return kRetErr;
     }
+    const PerfCounter::Values perf_inference = perf_counter_inference.Stop();
     const auto& t_inference1 = std::chrono::steady_clock::now();
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
+    perf_counter.Start();
     /* Get boundig box */
     std::vector<BoundingBox> bbox_list;
     float* output_data = output_tensor_info_list_[0].GetDataAsFloat();
@@ -239,6 +250,7 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     std::vector<BoundingBox> bbox_nms_list;
     BoundingBoxUtils::Nms(bbox_list, bbox_nms_list, threshold_nms_iou_);
 
+    const PerfCounter::Values perf_post_process = perf_counter.Stop();
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
@@ -250,6 +262,9 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
+    result.perf_pre_process = perf_pre_process;
+    result.perf_inference = perf_inference;
+    result.perf_post_process = perf_post_process;
 
     return kRetOk;
 }
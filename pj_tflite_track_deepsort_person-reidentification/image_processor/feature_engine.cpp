@@ -24,6 +24,7 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <thread>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -51,15 +52,69 @@ limitations under the License.
 static constexpr int32_t kNumFeature = 512;
 
 /*** Function ***/
-int32_t FeatureEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
+constexpr int32_t FeatureEngine::kBatchSize;  // for link error in Android Studio (clang)
+
+const char* FeatureEngine::GetModeName(int32_t mode)
+{
+    switch (mode) {
+    case kModeSequential: return "SEQ";
+    case kModeBatch: return "BATCH";
+    case kModePool: return "POOL";
+    default: return "UNKNOWN";
+    }
+}
+
+int32_t FeatureEngine::Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t mode, const int32_t num_instance)
 {
     /* Set model information */
     std::string model_filename = work_dir + "/model/" + MODEL_NAME;
 
+    mode_ = mode;
+    instance_list_.clear();
+    if (mode_ == kModeBatch) {
+        /* the input tensor is resized to the batch size. it depends on the inference helper and the model, so the output is checked */
+        instance_list_.resize(1);
+        if (InitializeInstance(instance_list_[0], model_filename, num_threads, kBatchSize) == kRetOk && IsBatchAvailable(instance_list_[0])) {
+            return kRetOk;
+        }
+        PRINT_E("The model can't run with batch size %d. kModePool is used instead\n", kBatchSize);
+        if (instance_list_[0].inference_helper) instance_list_[0].inference_helper->Finalize();
+        instance_list_.clear();
+        mode_ = kModePool;
+    }
+
+    const int32_t instance_num = (mode_ == kModePool) ? (std::max)(1, num_instance) : 1;
+    instance_list_.resize(instance_num);
+    for (auto& instance : instance_list_) {
+        /* each instance uses its own interpreter, so threads are divided */
+        if (InitializeInstance(instance, model_filename, (std::max)(1, num_threads / instance_num), 1) != kRetOk) {
+            instance_list_.clear();
+            return kRetErr;
+        }
+    }
+
+    return kRetOk;
+}
+
+bool FeatureEngine::IsBatchAvailable(const Instance& instance)
+{
+    /* the output tensor must have the batch dimension (otherwise the interpreter was not resized) */
+    const auto& dims = instance.output_tensor_info_list[0].tensor_dims;
+    if (dims.empty() || dims[0] != instance.batch_size) return false;
+    int32_t element_num = 1;
+    for (const auto& dim : dims) element_num *= dim;
+    return element_num == instance.batch_size * kNumFeature;
+}
+
+int32_t FeatureEngine::InitializeInstance(Instance& instance, const std::string& model_filename, int32_t num_threads, int32_t batch_size)
+{
+    instance.batch_size = batch_size;
+
     /* Set input tensor info */
-    input_tensor_info_list_.clear();
+    instance.input_tensor_info_list.clear();
     InputTensorInfo input_tensor_info(INPUT_NAME, TENSORTYPE, IS_NCHW);
     input_tensor_info.tensor_dims = INPUT_DIMS;
+    input_tensor_info.tensor_dims[0] = batch_size;  /* the interpreter is resized to the batch size at initialization (see IsBatchAvailable) */
     input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
     input_tensor_info.normalize.mean[0] = 0.0f;
     input_tensor_info.normalize.mean[1] = 0.0f;
@@ -67,29 +122,29 @@ int32_t FeatureEngine::Initialize(const std::string& work_dir, const int32_t num
     input_tensor_info.normalize.norm[0] = 1.0f / 255.0f;
     input_tensor_info.normalize.norm[1] = 1.0f / 255.0f;
     input_tensor_info.normalize.norm[2] = 1.0f / 255.0f;
-    input_tensor_info_list_.push_back(input_tensor_info);
+    instance.input_tensor_info_list.push_back(input_tensor_info);
 
     /* Set output tensor info */
-    output_tensor_info_list_.clear();
-    output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
+    instance.output_tensor_info_list.clear();
+    instance.output_tensor_info_list.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
 
     /* Create and Initialize Inference Helper */
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
-//    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack));
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteQnn));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi));
-
-    if (!inference_helper_) {
+    //instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
+//    instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack));
+    instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteQnn));
+    //instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu));
+    //instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu));
+    //instance.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi));
+
+    if (!instance.inference_helper) {
         return kRetErr;
     }
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (instance.inference_helper->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
+        instance.inference_helper.reset();
         return kRetErr;
     }
-    if (inference_helper_->Initialize(model_filename, input_tensor_info_list_, output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
+    if (instance.inference_helper->Initialize(model_filename, instance.input_tensor_info_list, instance.output_tensor_info_list) != InferenceHelper::kRetOk) {
+        instance.inference_helper.reset();
         return kRetErr;
     }
 
@@ -98,26 +153,118 @@ int32_t FeatureEngine::Initialize(const std::string& work_dir, const int32_t num
 
 int32_t FeatureEngine::Finalize()
 {
-    if (!inference_helper_) {
+    if (instance_list_.empty()) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
-    inference_helper_->Finalize();
+    for (auto& instance : instance_list_) {
+        instance.inference_helper->Finalize();
+    }
     return kRetOk;
 }
 
 
 int32_t FeatureEngine::Process(const cv::Mat& original_mat, const BoundingBox& bbox, Result& result)
 {
-    if (!inference_helper_) {
+    if (instance_list_.empty()) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
 
-    InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const std::vector<BoundingBox> bbox_list(1, bbox);
+    ResultList result_list;
+    result_list.feature_list.resize(1);
+    if (ProcessInstance(instance_list_[0], original_mat, bbox_list, 0, 1, result_list, result) != kRetOk) {
+        return kRetErr;
+    }
+    result.feature.swap(result_list.feature_list[0]);
+    return kRetOk;
+}
+
+int32_t FeatureEngine::Process(const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, ResultList& result_list)
+{
+    if (instance_list_.empty()) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
 
-    /*** PreProcess ***/
-    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    const auto& t_process0 = std::chrono::steady_clock::now();
+    const int32_t bbox_num = static_cast<int32_t>(bbox_list.size());
+    const int32_t instance_num = (std::min)(static_cast<int32_t>(instance_list_.size()), bbox_num);
+    result_list.feature_list.resize(bbox_num);
+    std::vector<Result> time_result_list((std::max)(1, instance_num));
+    std::vector<int32_t> ret_list((std::max)(1, instance_num), kRetOk);
+
+    if (instance_num <= 1) {
+        ret_list[0] = ProcessInstance(instance_list_[0], original_mat, bbox_list, 0, bbox_num, result_list, time_result_list[0]);
+    } else {
+        /* bboxes are divided into contiguous blocks, and each instance processes one block in its own thread */
+        /* features are stored at the index of the bbox, so the order of the results is the same as bbox_list */
+        const int32_t block_size = (bbox_num + instance_num - 1) / instance_num;
+        std::vector<std::thread> thread_list;
+        for (int32_t i = 1; i < instance_num; i++) {
+            thread_list.push_back(std::thread([&, i] {
+                ret_list[i] = ProcessInstance(instance_list_[i], original_mat, bbox_list, i * block_size, (std::min)(bbox_num, (i + 1) * block_size), result_list, time_result_list[i]);
+            }));
+        }
+        ret_list[0] = ProcessInstance(instance_list_[0], original_mat, bbox_list, 0, (std::min)(bbox_num, block_size), result_list, time_result_list[0]);
+        for (auto& thread : thread_list) {
+            thread.join();
+        }
+    }
+
+    for (size_t i = 0; i < ret_list.size(); i++) {
+        if (ret_list[i] != kRetOk) return kRetErr;
+        result_list.time_pre_process += time_result_list[i].time_pre_process;
+        result_list.time_inference += time_result_list[i].time_inference;
+        result_list.time_post_process += time_result_list[i].time_post_process;
+    }
+    const auto& t_process1 = std::chrono::steady_clock::now();
+    result_list.time_process += static_cast<std::chrono::duration<double>>(t_process1 - t_process0).count() * 1000.0;
+
+    return kRetOk;
+}
+
+int32_t FeatureEngine::ProcessInstance(Instance& instance, const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, int32_t index_start, int32_t index_end, ResultList& result_list, Result& time_result)
+{
+    for (int32_t index = index_start; index < index_end; index += instance.batch_size) {
+        const int32_t num = (std::min)(instance.batch_size, index_end - index);
+
+        /*** PreProcess ***/
+        const auto& t_pre_process0 = std::chrono::steady_clock::now();
+        int32_t ret = (instance.batch_size == 1) ? PreProcessImage(instance, original_mat, bbox_list[index]) : PreProcessBatch(instance, original_mat, bbox_list, index, num);
+        if (ret != kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_pre_process1 = std::chrono::steady_clock::now();
+
+        /*** Inference ***/
+        const auto& t_inference0 = std::chrono::steady_clock::now();
+        if (instance.inference_helper->Process(instance.output_tensor_info_list) != InferenceHelper::kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_inference1 = std::chrono::steady_clock::now();
+
+        /*** PostProcess ***/
+        const auto& t_post_process0 = std::chrono::steady_clock::now();
+        const float* raw_feature_list = instance.output_tensor_info_list[0].GetDataAsFloat();
+        for (int32_t i = 0; i < num; i++) {
+            const float* raw_feature = raw_feature_list + i * kNumFeature;
+            result_list.feature_list[index + i].assign(raw_feature, raw_feature + kNumFeature);
+        }
+        const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+        time_result.time_pre_process += static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+        time_result.time_inference += static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+        time_result.time_post_process += static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+    }
+
+    return kRetOk;
+}
+
+int32_t FeatureEngine::PreProcessImage(Instance& instance, const cv::Mat& original_mat, const BoundingBox& bbox)
+{
+    InputTensorInfo& input_tensor_info = instance.input_tensor_info_list[0];
     int32_t crop_x = std::max(0, bbox.x);
     int32_t crop_y = std::max(0, bbox.y);
     int32_t crop_w = std::min(bbox.w, original_mat.cols - crop_x);
@@ -136,28 +283,57 @@ int32_t FeatureEngine::Process(const cv::Mat& original_mat, const BoundingBox& b
     input_tensor_info.image_info.crop_height = img_src.rows;
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
-    if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (instance.inference_helper->PreProcess(instance.input_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
-    const auto& t_pre_process1 = std::chrono::steady_clock::now();
+    return kRetOk;
+}
 
-    /*** Inference ***/
-    const auto& t_inference0 = std::chrono::steady_clock::now();
-    if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        return kRetErr;
+int32_t FeatureEngine::PreProcessBatch(Instance& instance, const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, int32_t index_start, int32_t num)
+{
+    /* InferenceHelper converts only one image, so the batch is converted to a blob here (the same normalization as InferenceHelper) */
+    /* the rest of the batch (num < batch_size) is filled with 0 and its output is ignored */
+    InputTensorInfo& input_tensor_info = instance.input_tensor_info_list[0];
+    const int32_t width = input_tensor_info.GetWidth();
+    const int32_t height = input_tensor_info.GetHeight();
+    const int32_t image_size = width * height * 3;
+    instance.blob.assign(static_cast<size_t>(instance.batch_size) * image_size, 0.0f);
+
+    float mean[3];
+    float scale[3];
+    for (int32_t c = 0; c < 3; c++) {
+        mean[c] = input_tensor_info.normalize.mean[c] * 255.0f;
+        scale[c] = 1.0f / (input_tensor_info.normalize.norm[c] * 255.0f);
     }
-    const auto& t_inference1 = std::chrono::steady_clock::now();
 
-    /*** PostProcess ***/
-    const auto& t_post_process0 = std::chrono::steady_clock::now();
-    float* raw_feature_list = output_tensor_info_list_[0].GetDataAsFloat();
-    result.feature.reserve(kNumFeature);
-    result.feature.assign(raw_feature_list, raw_feature_list + kNumFeature);
-    const auto& t_post_process1 = std::chrono::steady_clock::now();
+    cv::Mat img_src = cv::Mat::zeros(height, width, CV_8UC3);
+    for (int32_t i = 0; i < num; i++) {
+        const BoundingBox& bbox = bbox_list[index_start + i];
+        int32_t crop_x = std::max(0, bbox.x);
+        int32_t crop_y = std::max(0, bbox.y);
+        int32_t crop_w = std::min(bbox.w, original_mat.cols - crop_x);
+        int32_t crop_h = std::min(bbox.h, original_mat.rows - crop_y);
+        img_src.setTo(cv::Scalar(0, 0, 0));
+        CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
 
-    result.time_pre_process += static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
-    result.time_inference += static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
-    result.time_post_process += static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+        float* dst = instance.blob.data() + static_cast<size_t>(i) * image_size;
+        const uint8_t* src = img_src.data;
+        for (int32_t p = 0; p < width * height; p++) {
+            for (int32_t c = 0; c < 3; c++) {
+                const float value = (src[p * 3 + c] - mean[c]) * scale[c];
+                if (IS_NCHW) {
+                    dst[c * width * height + p] = value;
+                } else {
+                    dst[p * 3 + c] = value;
+                }
+            }
+        }
+    }
 
+    input_tensor_info.data = instance.blob.data();
+    input_tensor_info.data_type = IS_NCHW ? InputTensorInfo::kDataTypeBlobNchw : InputTensorInfo::kDataTypeBlobNhwc;
+    if (instance.inference_helper->PreProcess(instance.input_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
     return kRetOk;
 }
@@ -38,6 +38,15 @@ public:
         kRetErr = -1,
     };
 
+    /* How to process a list of bboxes */
+    enum {
+        kModeSequential = 0,    /* one interpreter, one invoke per bbox */
+        kModeBatch,             /* one interpreter whose batch size is kBatchSize, one invoke per kBatchSize bboxes. kModePool is used if the model can't be resized */
+        kModePool,              /* num_instance interpreters running in parallel, one invoke per bbox */
+        kModeNum,
+    };
+    static constexpr int32_t kBatchSize = 8;
+
     typedef struct Result_ {
         std::vector<float> feature;
         double time_pre_process;    // [msec]
@@ -47,18 +56,47 @@ public:
         {}
     } Result;
 
+    typedef struct ResultList_ {
+        std::vector<std::vector<float>> feature_list;   /* in the same order as bbox_list */
+        double time_pre_process;    // [msec] (sum of all instances)
+        double time_inference;      // [msec] (sum of all instances)
+        double time_post_process;   // [msec] (sum of all instances)
+        double time_process;        // [msec] (elapsed time of the frame)
+        ResultList_() : time_pre_process(0), time_inference(0), time_post_process(0), time_process(0)
+        {}
+    } ResultList;
+
 public:
-    FeatureEngine() {}
+    FeatureEngine() : mode_(kModeSequential) {}
     ~FeatureEngine() {}
-    int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    /* num_instance is used only for kModePool (also when kModeBatch falls back to it). num_threads is divided among the instances */
+    int32_t Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t mode = kModeSequential, const int32_t num_instance = 1);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, const BoundingBox& bbox, Result& result);
+    int32_t Process(const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, ResultList& result_list);
+
+    int32_t GetMode() const { return mode_; }   /* the actual mode (may be different from the requested one) */
+    static const char* GetModeName(int32_t mode);
+
+private:
+    typedef struct Instance_ {
+        std::unique_ptr<InferenceHelper> inference_helper;
+        std::vector<InputTensorInfo> input_tensor_info_list;
+        std::vector<OutputTensorInfo> output_tensor_info_list;
+        int32_t batch_size;
+        std::vector<float> blob;    /* input of batch (NHWC or NCHW) */
+    } Instance;
 
+    static int32_t InitializeInstance(Instance& instance, const std::string& model_filename, int32_t num_threads, int32_t batch_size);
+    static bool IsBatchAvailable(const Instance& instance);
+    /* process bbox_list[index_start, index_end) and store the features into result_list.feature_list */
+    static int32_t ProcessInstance(Instance& instance, const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, int32_t index_start, int32_t index_end, ResultList& result_list, Result& time_result);
+    static int32_t PreProcessImage(Instance& instance, const cv::Mat& original_mat, const BoundingBox& bbox);
+    static int32_t PreProcessBatch(Instance& instance, const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, int32_t index_start, int32_t num);
 
 private:
-    std::unique_ptr<InferenceHelper> inference_helper_;
-    std::vector<InputTensorInfo> input_tensor_info_list_;
-    std::vector<OutputTensorInfo> output_tensor_info_list_;
+    int32_t mode_;
+    std::vector<Instance> instance_list_;
 };
 
 #endif
@@ -27,19 +27,85 @@ limitations under the License.
 
 /* for My modules */
 #include "bounding_box.h"
-#include "kalman_filter.h"
+#include "kalman_filter_fixed.h"
+#include "spatial_grid.h"
+#include "sparse_assignment.h"
+#include "ring_buffer.h"
+#include "slot_map.h"
+#include "feature_similarity.h"
+#include "feature_index.h"
+
+/*** Switch ***/
+//#define FEATURE_GALLERY_INT8    /* store features as int8 (a quarter of memory of float, but similarity has error of about 0.01) */
+
+
+/* Appearance features of a track. features are stored once in one contiguous buffer (ring buffer of max_num features) */
+/*   the stride of a feature is a multiple of kAlignmentNum elements so that every feature starts at an aligned position */
+/*   features are L2-normalized when stored, so cosine similarity is just a dot product (see FeatureSimilarity) */
+class FeatureGallery {
+public:
+#ifdef FEATURE_GALLERY_INT8
+    typedef int8_t Element;
+#else
+    typedef float Element;
+#endif
+    static constexpr int32_t kAlignmentNum = 16;
+
+    static int32_t CalculateStride(int32_t feature_size) { return (feature_size + kAlignmentNum - 1) / kAlignmentNum * kAlignmentNum; }
+    /* return false if the feature is invalid (norm = 0) */
+    static bool Normalize(const float* src, int32_t feature_size, Element* dst);
+
+public:
+    FeatureGallery();
+    ~FeatureGallery();
+
+    void Initialize(int32_t max_num);
+    void Clear();
+    /* add a new feature. the oldest one is overwritten when full. an empty (or zero) feature is stored as invalid */
+    void Push(const std::vector<float>& feature);
+    /* overwrite the newest feature */
+    void ReplaceNewest(const std::vector<float>& feature);
+
+    int32_t GetNum() const { return num_; }
+    int32_t GetFeatureSize() const { return feature_size_; }
+    int32_t GetStride() const { return stride_; }
+    int32_t GetInvalidNum() const;
+    /* index 0 = the newest. return nullptr if the feature is invalid */
+    const Element* Get(int32_t index) const;
+    /* all the stored features are in [0, GetNum()) slots in any order: [GetNum()][GetStride()] */
+    const Element* GetData() const { return buffer_.data(); }
+    /* mean of the valid features (not normalized). return false if there is no valid feature */
+    bool GetMean(std::vector<float>& mean) const;
+
+private:
+    void Write(int32_t slot, const std::vector<float>& feature);
+
+private:
+    int32_t max_num_;
+    int32_t feature_size_;
+    int32_t stride_;
+    int32_t head_;      /* slot of the newest feature */
+    int32_t num_;
+    std::vector<Element> buffer_;       /* [max_num][stride] */
+    std::vector<uint8_t> valid_list_;   /* [max_num] */
+};
 
 
 class TrackDeepSort {
 private:
     static constexpr int32_t kMaxHistoryNum = 500;
+    static constexpr int32_t kMaxGalleryNum = 100;
+    static constexpr int32_t kGalleryInterval = 5;  /* [frame]. features in the gallery are at least this interval apart (except the newest one) */
+    static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
+    static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
+    typedef KalmanFilterFixed<kNumStatus, kNumObserve, float> KalmanFilterBbox;
 
 public:
     typedef struct Data_ {
         BoundingBox bbox;
         BoundingBox bbox_raw;
-        std::vector<float> feature;
     } Data;
+    typedef RingBuffer<Data, kMaxHistoryNum> DataHistory;
 
 public:
     TrackDeepSort(const int32_t id, const BoundingBox& bbox_det, const std::vector<float>& feature);
@@ -47,9 +113,13 @@ public:
 
     BoundingBox Predict();
     void Update(const BoundingBox& bbox_det);
+    void UpdateFeature(const std::vector<float>& feature);     /* call after Update() */
     void UpdateNoDetect();
 
-    std::deque<Data>& GetDataHistory();
+    DataHistory& GetDataHistory();
+    const FeatureGallery& GetFeatureGallery() const;
+    bool HasValidFeature() const;
+    int32_t GetFeatureAge() const;      /* [frame] since the last UpdateFeature() */
     Data& GetLatestData() ;
     BoundingBox& GetLatestBoundingBox();
 
@@ -58,14 +128,18 @@ public:
     const int32_t GetDetectedCount() const;
 
 private:
-    KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
-    SimpleMatrix Bbox2KalmanObserved(const BoundingBox& bbox);
-    SimpleMatrix Bbox2KalmanStatus(const BoundingBox& bbox);
-    BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X);
+    KalmanFilterBbox CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
+    KalmanFilterBbox::VectorObserve Bbox2KalmanObserved(const BoundingBox& bbox);
+    KalmanFilterBbox::VectorStatus Bbox2KalmanStatus(const BoundingBox& bbox);
+    BoundingBox KalmanStatus2Bbox(const KalmanFilterBbox::VectorStatus& X);
 
 private:
-    std::deque<Data> data_history_;
-    KalmanFilter kf_;
+    DataHistory data_history_;
+    FeatureGallery feature_gallery_;
+    int32_t frame_num_;
+    int32_t frame_num_gallery_;     /* frame_num_ when the newest slot of the gallery was started */
+    int32_t frame_num_feature_;     /* frame_num_ when the feature was updated last time */
+    KalmanFilterBbox kf_;
     int32_t id_;
     int32_t cnt_detected_;
     int32_t cnt_undetected_;
@@ -75,24 +149,76 @@ private:
 class TrackerDeepSort {
 private:
     static constexpr float kCostMax = 1.0F;
+    static constexpr float kIouUnambiguous = 0.7F;          /* a pair of track and det with only one candidate each and IoU more than this doesn't need feature */
+    static constexpr int32_t kFeatureRefreshInterval = 5;   /* [frame]. feature of a track is updated at least this interval even if it's unambiguous */
+    /* deleted tracks are archived in FeatureIndex, and a new track takes over the id of the most similar archived one */
+    static constexpr int32_t kArchiveDetectedNumMin = 10;   /* tracks detected less than this are not archived (may be false positive) */
+    static constexpr float   kArchiveSimilarityMin = 0.7F;  /* cosine similarity to take over the archived id */
+    static constexpr int32_t kArchiveCapacity = 10000;     /* the max number of archived ids (the least recently archived one is removed) */
+    static constexpr int32_t kArchiveTtl = 30 * 60 * 10;   /* [frame]. archived ids are removed after this (10 min at 30 fps) */
+
+public:
+    /* tracks never move in the list */
+    typedef SlotMap<TrackDeepSort> TrackList;
 
 public:
     TrackerDeepSort(int32_t threshold_frame_to_delete = 2);
     ~TrackerDeepSort();
     void Reset();
 
+    /* Phase 1 (optional): predict tracks and check which dets need appearance features */
+    /*   is_feature_required_list[i] = 0 if det_list[i] is matched unambiguously with a track by motion (its feature can be empty in Update) */
+    void Predict(const std::vector<BoundingBox>& det_list, std::vector<uint8_t>& is_feature_required_list);
+    /* Phase 2: association. tracks are predicted here if Predict() is not called */
     void Update(const std::vector<BoundingBox>& det_list, const std::vector<std::vector<float>>& feature_list);
+    int32_t GetFeatureSkipNum() const;  /* the number of dets whose feature is not required at the last Predict() (of all the classes) */
+    int32_t GetArchiveNum() const;
+    int32_t GetReidentifiedNum() const; /* the number of new tracks which took over archived ids at the last Update() */
 
-    std::vector<TrackDeepSort>& GetTrackList();
+    TrackList& GetTrackList();
 
 private:
-    float CalculateCost(TrackDeepSort& track, const BoundingBox& det_bbox, const std::vector<float>& det_feature);
+    void NormalizeDetFeature(const std::vector<std::vector<float>>& feature_list);
+    /* similarity_list[i] = mean cosine similarity b/w the gallery of the track and the feature of det_index_list[i]. -1 = invalid */
+    void CalculateFeatureSimilarity(const TrackDeepSort& track, const std::vector<int32_t>& det_index_list, std::vector<float>& similarity_list);
+    static bool CheckGate(const BoundingBox& track_bbox, const BoundingBox& det_bbox, float& iou);
+    float CalculateCost(TrackDeepSort& track, const BoundingBox& det_bbox, float similarity_feature);
+    void ArchiveTrack(TrackDeepSort& track);
+    /* return -1 if no archived id of the class is similar enough. the found id is removed from the archive */
+    int32_t TakeArchivedId(const std::vector<float>& feature, int32_t class_id);
 
 private:
-    std::vector<TrackDeepSort> track_list_;
+    TrackList track_list_;
     int32_t track_sequence_num_;
 
     int32_t threshold_frame_to_delete_;
+
+    bool is_predicted_;
+    int32_t feature_skip_num_;
+    std::vector<uint8_t> det_feature_skip_list_;
+
+    /* appearance of deleted tracks */
+    FeatureIndex archive_;
+    int32_t frame_count_;
+    int32_t reidentified_num_;
+    std::vector<float> archive_feature_;
+    std::vector<FeatureIndex::Neighbor> archive_neighbor_list_;
+
+    /* reused every frame to avoid allocation */
+    SpatialGrid det_grid_;
+    SparseAssignment assignment_;
+    std::vector<int32_t> candidate_list_;
+    std::vector<int32_t> det_candidate_num_list_;
+    std::vector<float> similarity_list_;
+    /* normalized features of dets at the current frame: [det_num][det_feature_stride_] */
+    int32_t det_feature_size_;
+    int32_t det_feature_stride_;
+    std::vector<FeatureGallery::Element> det_feature_buffer_;
+    std::vector<uint8_t> det_feature_valid_list_;
+    /* features of candidate dets packed for matrix product, and the product: [gallery num][candidate num] */
+    std::vector<FeatureGallery::Element> det_feature_pack_;
+    std::vector<int32_t> det_pack_index_list_;
+    std::vector<float> similarity_matrix_;
 };
 
 #endif